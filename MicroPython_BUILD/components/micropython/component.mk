@@ -40,6 +40,24 @@ MICROPY_FATFS = 0
 FROZEN_DIR = $(COMPONENT_PATH)/esp32/scripts
 FROZEN_MPY_DIR = $(COMPONENT_PATH)/esp32/modules
 
+ifdef CONFIG_MICROPY_USE_BYTECODE_CACHE
+MPY_CROSS_FLAGS = -mcache-lookup-bc
+else
+MPY_CROSS_FLAGS =
+endif
+ifdef CONFIG_MICROPY_USE_SUPERINSTRUCTIONS
+MPY_CROSS_FLAGS += -msuperinstructions
+endif
+ifdef CONFIG_MICROPY_USE_NATIVE_EMITTER
+MPY_CROSS_FLAGS += -march=xtensawin
+endif
+
+ifdef CONFIG_MICROPY_FROZEN_ROM_GLOBALS
+MPY_TOOL_FLAGS = --rom-globals
+else
+MPY_TOOL_FLAGS =
+endif
+
 # Includes for Qstr&Frozen modules
 #---------------------------------
 ESPCOMP = $(IDF_PATH)/components
@@ -157,7 +175,6 @@ SRC_C =  $(addprefix esp32/,\
 	modmachine.c \
 	modnetwork.c \
 	modsocket.c \
-	moduhashlib.c \
 	machine_hw_spi.c \
 	mpthreadport.c \
 	mpsleep.c \
@@ -251,6 +268,8 @@ LIBS_SRC_C = $(addprefix esp32/libs/,\
 	ow/owb.c \
 	ow/ds18b20.c \
 	littleflash.c \
+	adc_filter.c \
+	adc_collect.c \
 	)
 
 ifdef CONFIG_MICROPY_USE_DISPLAY
@@ -0,0 +1,73 @@
+/*
+ * This file is part of the MicroPython ESP32 project, https://github.com/loboris/MicroPython_ESP32_psRAM_LoBo
+ *
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2018 LoBo (https://github.com/loboris)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include "adc_collect.h"
+
+//--------------------------------------------------------------------------------------------
+void adc_collect_init(adc_collect_t *c, int nbuf, uint32_t count, uint16_t decimate, int average)
+{
+	adc_filter_init(&c->filter, decimate, average);
+	c->nbuf = nbuf;
+	c->cur = 0;
+	c->pos = 0;
+	c->count = count;
+	c->filled = 0;
+	c->dropped = 0;
+	c->busy[0] = 0;
+	c->busy[1] = 0;
+	c->stop = 0;
+}
+
+//-----------------------------------------------------------------------------------------------------
+int adc_collect_put(adc_collect_t *c, const uint16_t *in, size_t n, adc_collect_full_t full, void *arg)
+{
+	while ((n > 0) && (!c->stop)) {
+		int b = c->cur;
+		if (c->busy[b]) {
+			// the buffer wasn't copied yet, drop the samples
+			c->dropped += n;
+			break;
+		}
+		size_t out_n;
+		size_t used = adc_filter_run(&c->filter, in, n, c->data[b] + c->pos, c->len[b] - c->pos, &out_n);
+		in += used;
+		n -= used;
+		c->pos += out_n;
+		if (c->pos < c->len[b]) continue;
+
+		// buffer full, have it copied to its buffer object and switch to the next one
+		c->pos = 0;
+		c->filled++;
+		c->cur = (b + 1) % c->nbuf;
+		c->busy[b] = 1;
+		if (!full(b, arg)) {
+			c->busy[b] = 0;
+			c->dropped += c->len[b] * c->filter.decimate;
+		}
+		if ((c->count > 0) && (c->filled >= c->count)) c->stop = 1;
+	}
+	return c->stop;
+}
@@ -0,0 +1,70 @@
+/*
+ * This file is part of the MicroPython ESP32 project, https://github.com/loboris/MicroPython_ESP32_psRAM_LoBo
+ *
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2018 LoBo (https://github.com/loboris)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+/*
+ * Buffer handling of the continuous ADC collection: fills the collect buffers
+ * from the sample stream, hands full ones over and counts dropped samples.
+ * No ESP-IDF dependencies, so it can be tested on the host with the I2S driver stubbed.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "adc_filter.h"
+
+typedef struct _adc_collect_t {
+	adc_filter_t filter;
+	uint16_t *data[2];			// filled by the collect task and copied to the buffer objects under the GIL
+	size_t len[2];				// buffers length in samples when the collection started
+	size_t pos;					// fill position in the current buffer
+	uint32_t count;				// number of buffers to fill, 0 for continuous collection
+	uint32_t filled;			// number of buffers filled
+	uint32_t dropped;			// ADC samples dropped while no buffer was free
+	uint8_t nbuf;
+	uint8_t cur;
+	volatile uint8_t busy[2];	// buffer full, not yet copied to its buffer object
+	volatile uint8_t stop;
+} adc_collect_t;
+
+// Called when buffer 'b' is full and marked busy. Returns 0 if it can't be handed over,
+// the buffer is then free again and its samples are counted as dropped.
+typedef int (*adc_collect_full_t)(int b, void *arg);
+
+// Start a collection into 'nbuf' buffers, 'data' and 'len' must be set already.
+void adc_collect_init(adc_collect_t *c, int nbuf, uint32_t count, uint16_t decimate, int average);
+
+// Put 'n' samples into the collect buffers, switching to the next buffer when one is full.
+// Samples are dropped while the current buffer is busy.
+// Returns nonzero when the collection is to stop, because 'count' buffers are filled or it was stopped.
+int adc_collect_put(adc_collect_t *c, const uint16_t *in, size_t n, adc_collect_full_t full, void *arg);
+
+// Give a busy buffer back once it was copied
+static inline void adc_collect_release(adc_collect_t *c, int b)
+{
+	c->busy[b] = 0;
+}
@@ -0,0 +1,81 @@
+/*
+ * This file is part of the MicroPython ESP32 project, https://github.com/loboris/MicroPython_ESP32_psRAM_LoBo
+ *
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2018 LoBo (https://github.com/loboris)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include "adc_filter.h"
+
+//-------------------------------------------------------------------
+void adc_filter_init(adc_filter_t *f, uint16_t decimate, int average)
+{
+	f->acc = 0;
+	f->count = 0;
+	f->decimate = (decimate == 0) ? 1 : decimate;
+	f->average = (average != 0);
+}
+
+//---------------------------------------------------------
+void adc_filter_unpack(uint16_t *buf, size_t len, int swap)
+{
+	size_t i = 0;
+	if (swap) {
+		for (; (i + 1) < len; i += 2) {
+			uint16_t s = buf[i];
+			buf[i] = buf[i+1] & ADC_FILTER_VALUE_MASK;
+			buf[i+1] = s & ADC_FILTER_VALUE_MASK;
+		}
+	}
+	for (; i < len; i++) buf[i] &= ADC_FILTER_VALUE_MASK;
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+size_t adc_filter_run(adc_filter_t *f, const uint16_t *in, size_t in_len, uint16_t *out, size_t out_len, size_t *out_n)
+{
+	size_t i = 0, o = 0;
+
+	if (f->decimate == 1) {
+		// no decimation, plain copy
+		o = (in_len < out_len) ? in_len : out_len;
+		for (; i < o; i++) out[i] = in[i];
+		*out_n = o;
+		return o;
+	}
+
+	uint32_t acc = f->acc;
+	uint16_t count = f->count;
+	while ((i < in_len) && (o < out_len)) {
+		uint16_t v = in[i++];
+		acc += v;
+		if (++count == f->decimate) {
+			// window complete, output its rounded average or its last sample
+			out[o++] = (f->average) ? (uint16_t)((acc + (count >> 1)) / count) : v;
+			acc = 0;
+			count = 0;
+		}
+	}
+	f->acc = acc;
+	f->count = count;
+	*out_n = o;
+	return i;
+}
@@ -0,0 +1,57 @@
+/*
+ * This file is part of the MicroPython ESP32 project, https://github.com/loboris/MicroPython_ESP32_psRAM_LoBo
+ *
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2018 LoBo (https://github.com/loboris)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+/*
+ * Sample stream processing for continuous ADC collection.
+ * No ESP-IDF dependencies, so the same code can be built and checked on the host.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define ADC_FILTER_VALUE_MASK	0x0FFF	// I2S ADC sample: 12-bit value, channel number in bits 12~15
+
+typedef struct _adc_filter_t {
+	uint32_t acc;		// sum of the samples in the current decimation window
+	uint16_t decimate;	// input samples per output sample
+	uint16_t count;		// samples already in the current window
+	uint8_t average;	// output the window average instead of its last sample
+} adc_filter_t;
+
+void adc_filter_init(adc_filter_t *f, uint16_t decimate, int average);
+
+// Convert 'len' raw I2S ADC words in place to sample values.
+// If 'swap' is set, the samples are stored in swapped pairs (as read from the 32-bit I2S FIFO)
+// and are put back in time order.
+void adc_filter_unpack(uint16_t *buf, size_t len, int swap);
+
+// Decimate (and optionally average) up to 'in_len' samples from 'in' into 'out'.
+// Stops when 'out_len' output samples are written, the window state is kept in 'f',
+// so the remaining input can be passed in the next call with a new output buffer.
+// Returns the number of input samples consumed, the number of output samples is set in 'out_n'.
+size_t adc_filter_run(adc_filter_t *f, const uint16_t *in, size_t in_len, uint16_t *out, size_t out_len, size_t *out_n);
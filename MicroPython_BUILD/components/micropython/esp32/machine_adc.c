@@ -27,11 +27,15 @@
 
 
 #include <stdio.h>
+#include <string.h>
 
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
 #include "esp_log.h"
 
 #include "driver/gpio.h"
 #include "driver/adc.h"
+#include "driver/i2s.h"
 #include "esp_adc_cal.h"
 #include "soc/rtc_cntl_reg.h"
 #include "soc/sens_reg.h"
@@ -40,9 +44,18 @@
 #include "py/mphal.h"
 #include "modmachine.h"
 #include "machine_pin.h"
+#include "libs/adc_filter.h"
+#include "libs/adc_collect.h"
 
 #define ADC1_CHANNEL_HALL	ADC1_CHANNEL_MAX
 
+#define ADC_COLLECT_I2S			I2S_NUM_0	// only I2S0 can sample the built-in ADC
+#define ADC_COLLECT_DMA_LEN		256			// samples per DMA buffer
+#define ADC_COLLECT_DMA_COUNT	4
+#define ADC_COLLECT_MIN_RATE	1000		// ADC sampling rate range (Hz)
+#define ADC_COLLECT_MAX_RATE	200000
+#define ADC_COLLECT_MAX_DECIMATE	1024
+
 typedef struct _madc_obj_t {
     mp_obj_base_t base;
     int gpio_id;
@@ -50,8 +63,17 @@ typedef struct _madc_obj_t {
     adc1_channel_t adc_chan;
     adc_atten_t atten;
     adc_bits_width_t width;
+    mp_obj_t collect_buf[2];
+    uint16_t *collect_data[2];
+    mp_obj_t collect_cb;
 } madc_obj_t;
 
+// Continuous collection state, there can be only one as it uses the I2S0 DMA
+static adc_collect_t collect = { 0 };
+static madc_obj_t *collect_adc = NULL;		// last collecting ADC, referenced by MP_STATE_PORT(machine_adc_collect)
+static TaskHandle_t collect_task = NULL;	// NULL if not running
+static uint16_t collect_raw[ADC_COLLECT_DMA_LEN];
+
 static uint16_t adc1_chan_used = 0;
 static uint16_t adc2_chan_used = 0;
 static int8_t adc_width = -1;
@@ -104,6 +126,61 @@ static int get_adc_channel(adc_unit_t adc_num, int pin)
 	return channel;
 }
 
+STATIC mp_obj_t madc_collect_done(mp_obj_t buf_in);
+STATIC MP_DEFINE_CONST_FUN_OBJ_1(madc_collect_done_obj, madc_collect_done);
+
+// Schedule the copy of a full collect buffer to its buffer object
+//--------------------------------------------------
+static int adc_collect_schedule(int b, void *arg)
+{
+	return mp_sched_schedule((mp_obj_t)&madc_collect_done_obj, collect_adc->collect_buf[b], NULL);
+}
+
+// Reads the I2S DMA buffers and fills the collect buffers, runs until stopped or 'count' buffers are filled
+//----------------------------------------------
+static void adc_collect_task(void *pvParameters)
+{
+	size_t bytes_read;
+	while (!collect.stop) {
+		if (i2s_read(ADC_COLLECT_I2S, collect_raw, sizeof(collect_raw), &bytes_read, 100 / portTICK_PERIOD_MS) != ESP_OK) break;
+
+		size_t n = bytes_read / sizeof(uint16_t);
+		adc_filter_unpack(collect_raw, n, 1);
+		adc_collect_put(&collect, collect_raw, n, adc_collect_schedule, NULL);
+	}
+
+	i2s_adc_disable(ADC_COLLECT_I2S);
+	i2s_driver_uninstall(ADC_COLLECT_I2S);
+	collect_task = NULL;
+	vTaskDelete(NULL);
+}
+
+// Copy a full collect buffer to its buffer object and return it to the collect task.
+// Runs with the GIL, the buffer object is fetched again as it may have been resized.
+//---------------------------------------------------
+static void adc_collect_copy(madc_obj_t *self, int b)
+{
+	mp_buffer_info_t bufinfo;
+	if (mp_get_buffer(self->collect_buf[b], &bufinfo, MP_BUFFER_WRITE)) {
+		size_t len = bufinfo.len / sizeof(uint16_t);
+		if (len > collect.len[b]) len = collect.len[b];
+		memcpy(bufinfo.buf, collect.data[b], len * sizeof(uint16_t));
+	}
+	adc_collect_release(&collect, b);
+}
+
+// Stop the collection and wait for the collect task to finish
+//--------------------------------
+static void adc_collect_stop(void)
+{
+	collect.stop = 1;
+	while (collect_task != NULL) {
+		MP_THREAD_GIL_EXIT();
+		vTaskDelay(1);
+		MP_THREAD_GIL_ENTER();
+	}
+}
+
 //------------------------------------------------------------------------------------------------------------
 STATIC mp_obj_t madc_make_new(const mp_obj_type_t *type, size_t n_args, size_t n_kw, const mp_obj_t *all_args)
 {
@@ -132,6 +209,11 @@ STATIC mp_obj_t madc_make_new(const mp_obj_type_t *type, size_t n_args, size_t n
     }
     self->atten = ADC_ATTEN_DB_0;
     self->width = ADC_WIDTH_BIT_12;
+    self->collect_buf[0] = mp_const_none;
+    self->collect_buf[1] = mp_const_none;
+    self->collect_data[0] = NULL;
+    self->collect_data[1] = NULL;
+    self->collect_cb = mp_const_none;
 
 	if (pin_id != ADC1_CHANNEL_HALL) {
 		int channel = get_adc_channel(self->adc_num, pin_id);
@@ -185,6 +267,8 @@ STATIC mp_obj_t madc_deinit(mp_obj_t self_in)
     madc_obj_t *self = self_in;
 	if (self->gpio_id < 0) return mp_const_none;
 
+	if (collect_adc == self) adc_collect_stop();
+
 	if (self->adc_num == ADC_UNIT_1) {
 		if (self->adc_chan == ADC1_CHANNEL_HALL) {
 			adc1_chan_used &= 0x00FF;
@@ -241,6 +325,7 @@ STATIC mp_obj_t madc_readraw(mp_obj_t self_in) {
 
 	int val = 0;
 	if (self->adc_num == ADC_UNIT_1) {
+		if (collect_task != NULL) mp_raise_ValueError("ADC1 used by collect");
 		set_width(self);
 
 		if (self->gpio_id == GPIO_NUM_MAX) val= hall_sensor_read();
@@ -266,6 +351,7 @@ STATIC mp_obj_t madc_read(mp_obj_t self_in) {
 	if (self->gpio_id < 0) {
 		mp_raise_ValueError("Not initialized");
 	}
+	if ((self->adc_num == ADC_UNIT_1) && (collect_task != NULL)) mp_raise_ValueError("ADC1 used by collect");
 
     set_width(self);
 
@@ -373,6 +459,167 @@ STATIC mp_obj_t madc_vref_togpio(mp_uint_t n_args, const mp_obj_t *pos_args, mp_
 }
 STATIC MP_DEFINE_CONST_FUN_OBJ_KW(madc_vref_togpio_obj, 0, madc_vref_togpio);
 
+// Called from the scheduler when a collect buffer is full
+//------------------------------------------------
+STATIC mp_obj_t madc_collect_done(mp_obj_t buf_in)
+{
+	madc_obj_t *self = MP_STATE_PORT(machine_adc_collect);
+	if (self == NULL) return mp_const_none;
+
+	for (int b = 0; b < 2; b++) {
+		if ((self->collect_buf[b] == buf_in) && collect.busy[b]) {
+			// the collect task can go on filling the buffer while the callback runs
+			adc_collect_copy(self, b);
+			if (self->collect_cb != mp_const_none) mp_call_function_1_protected(self->collect_cb, buf_in);
+		}
+	}
+	return mp_const_none;
+}
+
+//-----------------------------------------------------------------------------------------------------------------------------------------------------------------
+static void madc_collect_start(madc_obj_t *self, mp_int_t freq, const mp_obj_t *bufs, int nbuf, mp_obj_t callback, mp_int_t decimate, bool average, uint32_t count)
+{
+	if (self->gpio_id < 0) {
+		mp_raise_ValueError("Not initialized");
+	}
+	if ((self->adc_num != ADC_UNIT_1) || (self->adc_chan == ADC1_CHANNEL_HALL)) mp_raise_ValueError("only ADC1 channels can be collected");
+	if (collect_task != NULL) mp_raise_ValueError("collect already running");
+	#if MICROPY_PY_THREAD_WORKERS
+	if (!MP_STATE_IS_MAIN()) mp_raise_ValueError("collect not available in worker");
+	#endif
+	if ((decimate < 1) || (decimate > ADC_COLLECT_MAX_DECIMATE)) mp_raise_ValueError("decimate range: 1~1024");
+	if ((freq < 1) || (freq > ADC_COLLECT_MAX_RATE) || ((freq * decimate) < ADC_COLLECT_MIN_RATE) || ((freq * decimate) > ADC_COLLECT_MAX_RATE)) {
+		mp_raise_ValueError("ADC sample rate (freq*decimate) range: 1000~200000 Hz");
+	}
+	if ((callback != mp_const_none) && (!mp_obj_is_callable(callback))) mp_raise_ValueError("callback must be a function");
+
+	// the collect task fills buffers of its own, which are copied to the buffer objects with the GIL
+	for (int b = 0; b < nbuf; b++) {
+		mp_buffer_info_t bufinfo;
+		mp_get_buffer_raise(bufs[b], &bufinfo, MP_BUFFER_WRITE);
+		if ((bufinfo.typecode != 'H') || (bufinfo.len < sizeof(uint16_t))) mp_raise_ValueError("buffer must be a non-empty array('H')");
+		if ((b > 0) && (bufs[b] == bufs[0])) mp_raise_ValueError("buffers must be different");
+		collect.len[b] = bufinfo.len / sizeof(uint16_t);
+		self->collect_data[b] = m_new(uint16_t, collect.len[b]);
+		collect.data[b] = self->collect_data[b];
+		self->collect_buf[b] = bufs[b];
+	}
+	if (nbuf < 2) {
+		self->collect_buf[1] = mp_const_none;
+		self->collect_data[1] = NULL;
+	}
+	self->collect_cb = callback;
+
+	collect_adc = self;
+	MP_STATE_PORT(machine_adc_collect) = self;
+	adc_collect_init(&collect, nbuf, count, decimate, average);
+
+	i2s_config_t i2s_config = {
+		.mode = I2S_MODE_MASTER | I2S_MODE_RX | I2S_MODE_ADC_BUILT_IN,
+		.sample_rate = freq * decimate,
+		.bits_per_sample = I2S_BITS_PER_SAMPLE_16BIT,
+		.channel_format = I2S_CHANNEL_FMT_ONLY_RIGHT,
+		.communication_format = I2S_COMM_FORMAT_I2S_MSB,
+		.intr_alloc_flags = ESP_INTR_FLAG_LEVEL1,
+		.dma_buf_count = ADC_COLLECT_DMA_COUNT,
+		.dma_buf_len = ADC_COLLECT_DMA_LEN,
+		.use_apll = false,
+	};
+	if (i2s_driver_install(ADC_COLLECT_I2S, &i2s_config, 0, NULL) != ESP_OK) mp_raise_ValueError("Error installing I2S driver");
+	adc1_config_channel_atten(self->adc_chan, self->atten);
+	i2s_set_adc_mode(ADC_UNIT_1, self->adc_chan);
+	i2s_adc_enable(ADC_COLLECT_I2S);
+	// the I2S driver changes the ADC1 configuration, force the reconfiguration on next read
+	adc_width = -1;
+
+	if (xTaskCreate(adc_collect_task, "adc_collect_task", 2048, NULL, CONFIG_MICROPY_TASK_PRIORITY+4, &collect_task) != pdPASS) {
+		collect_task = NULL;
+		i2s_adc_disable(ADC_COLLECT_I2S);
+		i2s_driver_uninstall(ADC_COLLECT_I2S);
+		mp_raise_ValueError("Error creating collect task");
+	}
+}
+
+//--------------------------------------------------------------------------------------
+STATIC mp_obj_t madc_collect(size_t n_args, const mp_obj_t *pos_args, mp_map_t *kw_args)
+{
+    enum { ARG_freq, ARG_buffer, ARG_buffer2, ARG_callback, ARG_decimate, ARG_average, ARG_count };
+    const mp_arg_t allowed_args[] = {
+			{ MP_QSTR_freq,		MP_ARG_REQUIRED | MP_ARG_INT, {.u_int = 0} },
+			{ MP_QSTR_buffer,	MP_ARG_REQUIRED | MP_ARG_OBJ, {.u_obj = mp_const_none} },
+			{ MP_QSTR_buffer2,	MP_ARG_OBJ,                   {.u_obj = mp_const_none} },
+			{ MP_QSTR_callback,	MP_ARG_KW_ONLY  | MP_ARG_OBJ, {.u_obj = mp_const_none} },
+			{ MP_QSTR_decimate,	MP_ARG_KW_ONLY  | MP_ARG_INT, {.u_int = 1} },
+			{ MP_QSTR_average,	MP_ARG_KW_ONLY  | MP_ARG_BOOL, {.u_bool = false} },
+			{ MP_QSTR_count,	MP_ARG_KW_ONLY  | MP_ARG_INT, {.u_int = 0} },
+	};
+    madc_obj_t *self = pos_args[0];
+	mp_arg_val_t args[MP_ARRAY_SIZE(allowed_args)];
+    mp_arg_parse_all(n_args - 1, pos_args + 1, kw_args, MP_ARRAY_SIZE(allowed_args), allowed_args, args);
+
+    if (args[ARG_count].u_int < 0) mp_raise_ValueError("count must be >= 0");
+    mp_obj_t bufs[2] = { args[ARG_buffer].u_obj, args[ARG_buffer2].u_obj };
+    madc_collect_start(self, args[ARG_freq].u_int, bufs, (bufs[1] == mp_const_none) ? 1 : 2,
+    		args[ARG_callback].u_obj, args[ARG_decimate].u_int, args[ARG_average].u_bool, args[ARG_count].u_int);
+
+    return mp_const_none;
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_KW(madc_collect_obj, 3, madc_collect);
+
+//-----------------------------------------------------------------------------------------
+STATIC mp_obj_t madc_read_timed(size_t n_args, const mp_obj_t *pos_args, mp_map_t *kw_args)
+{
+    enum { ARG_buffer, ARG_freq, ARG_decimate, ARG_average };
+    const mp_arg_t allowed_args[] = {
+			{ MP_QSTR_buffer,	MP_ARG_REQUIRED | MP_ARG_OBJ, {.u_obj = mp_const_none} },
+			{ MP_QSTR_freq,		MP_ARG_REQUIRED | MP_ARG_INT, {.u_int = 0} },
+			{ MP_QSTR_decimate,	MP_ARG_KW_ONLY  | MP_ARG_INT, {.u_int = 1} },
+			{ MP_QSTR_average,	MP_ARG_KW_ONLY  | MP_ARG_BOOL, {.u_bool = false} },
+	};
+    madc_obj_t *self = pos_args[0];
+	mp_arg_val_t args[MP_ARRAY_SIZE(allowed_args)];
+    mp_arg_parse_all(n_args - 1, pos_args + 1, kw_args, MP_ARRAY_SIZE(allowed_args), allowed_args, args);
+
+    madc_collect_start(self, args[ARG_freq].u_int, &args[ARG_buffer].u_obj, 1, mp_const_none, args[ARG_decimate].u_int, args[ARG_average].u_bool, 1);
+    // wait until the buffer is filled, on exception the collection finishes in background
+    while (collect_task != NULL) {
+    	MICROPY_EVENT_POLL_HOOK;
+    }
+    // copy it now if the scheduled copy didn't run yet
+    if (collect.busy[0]) adc_collect_copy(self, 0);
+
+    return mp_const_none;
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_KW(madc_read_timed_obj, 3, madc_read_timed);
+
+//------------------------------------------------
+STATIC mp_obj_t madc_stopcollect(mp_obj_t self_in)
+{
+    madc_obj_t *self = self_in;
+	if (collect_adc == self) adc_collect_stop();
+	return mp_const_none;
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_1(madc_stopcollect_obj, madc_stopcollect);
+
+//----------------------------------------------
+STATIC mp_obj_t madc_collected(mp_obj_t self_in)
+{
+    madc_obj_t *self = self_in;
+    mp_obj_t tuple[3];
+    if (collect_adc == self) {
+    	tuple[0] = mp_obj_new_bool(collect_task != NULL);
+    	tuple[1] = mp_obj_new_int_from_uint(collect.filled);
+    	tuple[2] = mp_obj_new_int_from_uint(collect.dropped);
+    }
+    else {
+    	tuple[0] = mp_const_false;
+    	tuple[1] = MP_OBJ_NEW_SMALL_INT(0);
+    	tuple[2] = MP_OBJ_NEW_SMALL_INT(0);
+    }
+    return mp_obj_new_tuple(3, tuple);
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_1(madc_collected_obj, madc_collected);
+
 
 //=========================================================
 STATIC const mp_rom_map_elem_t madc_locals_dict_table[] = {
@@ -381,6 +628,10 @@ STATIC const mp_rom_map_elem_t madc_locals_dict_table[] = {
     { MP_ROM_QSTR(MP_QSTR_atten),		MP_ROM_PTR(&madc_atten_obj) },
     { MP_ROM_QSTR(MP_QSTR_width),		MP_ROM_PTR(&madc_width_obj) },
     { MP_ROM_QSTR(MP_QSTR_vref),		MP_ROM_PTR(&madc_vref_togpio_obj) },
+    { MP_ROM_QSTR(MP_QSTR_collect),		MP_ROM_PTR(&madc_collect_obj) },
+    { MP_ROM_QSTR(MP_QSTR_read_timed),	MP_ROM_PTR(&madc_read_timed_obj) },
+    { MP_ROM_QSTR(MP_QSTR_stopcollect),	MP_ROM_PTR(&madc_stopcollect_obj) },
+    { MP_ROM_QSTR(MP_QSTR_collected),	MP_ROM_PTR(&madc_collected_obj) },
     { MP_ROM_QSTR(MP_QSTR_deinit),		MP_ROM_PTR(&madc_deinit_obj) },
 
     { MP_ROM_QSTR(MP_QSTR_HALL),		MP_ROM_INT(ADC1_CHANNEL_MAX) },
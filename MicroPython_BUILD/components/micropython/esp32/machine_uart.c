@@ -39,6 +39,7 @@
 #include "py/mperrno.h"
 #include "py/mphal.h"
 #include "modmachine.h"
+#include "uart_ringbuf.h"
 
 #define UART_CB_TYPE_DATA		1
 #define UART_CB_TYPE_PATTERN	2
@@ -65,15 +66,10 @@ typedef struct _machine_uart_obj_t {
     uint32_t *error_cb;
     uint8_t end_task;
     uint8_t lineend[3];
+    uart_matcher_t pattern_match;
+    uart_matcher_t lineend_match;
 } machine_uart_obj_t;
 
-typedef struct _uart_ringbuf_t {
-    uint8_t *buf;
-    uint16_t size;
-    uint16_t iget;
-    uint16_t iput;
-} uart_ringbuf_t;
-
 static const char *_parity_name[] = {"None", "None", "Even", "Odd"};
 static const char *_stopbits_name[] = {"?", "1", "1.5", "2"};
 static QueueHandle_t UART_QUEUE[2] = {NULL};
@@ -84,63 +80,17 @@ static uart_ringbuf_t uart_buffer[2];
 static uart_ringbuf_t *uart_buf[2] = {NULL};
 
 //-----------------------------------------------------------
-static void uart_ringbuf_alloc(uint8_t uart_num, uint16_t sz)
+static void uart_ringbuf_alloc(uint8_t uart_num, uint32_t sz)
 {
-	uart_buffer[uart_num].buf = m_new(uint8_t, sz);
+	// The buffer is used by uart_event_task, outside of the MicroPython heap
+	uart_buffer[uart_num].buf = malloc(sz);
+	if (uart_buffer[uart_num].buf == NULL) return;
 	uart_buffer[uart_num].size = sz;
-	uart_buffer[uart_num].iget = 0;
-	uart_buffer[uart_num].iput = 0;
+	uart_buffer[uart_num].head = 0;
+	uart_buffer[uart_num].tail = 0;
 	uart_buf[uart_num] = &uart_buffer[uart_num];
 }
 
-//-----------------------------------------------------------------------
-static int uart_buf_get(uart_ringbuf_t *r, uint8_t *dest, uint16_t len) {
-    if (r->iget == r->iput) return -1; // input buffer empty
-
-    int res = 0;
-	for (int i=0; i<len; i++) {
-		dest[i] = r->buf[r->iget++];
-		res++;
-	    if (r->iget == r->iput) break;
-	}
-	// move the buffer and adjust the pointers
-	memmove(r->buf, r->buf+res, r->iput - res);
-	r->iget -= res;
-	r->iput -= res;
-
-    return res;
-}
-
-//-------------------------------------------------------------------------
-static int uart_buf_put(uart_ringbuf_t *r, uint8_t *source, uint16_t len) {
-	int res = 0;
-	for (int i=0; i<len; i++) {
-	    if (r->iput >= r->size) return 1; // overflow
-	    r->buf[r->iput++] = source[i];
-	}
-	return res;
-}
-
-//---------------------------------------------------------------------------------------------
-static int match_pattern(uint8_t *text, int text_length, uint8_t *pattern, int pattern_length)
-{
-	int c, d, e, position = -1;
-
-	if (pattern_length > text_length) return -1;
-
-	for (c = 0; c <= (text_length - pattern_length); c++) {
-		position = e = c;
-		// check pattern
-		for (d = 0; d < pattern_length; d++) {
-			if (pattern[d] == text[e]) e++;
-			else break;
-		}
-		if (d == pattern_length) return position;
-	}
-
-	return -1;
-}
-
 //--------------------------------------------------------------------------------------------
 static void _sched_callback(mp_obj_t function, int uart, int type, int iarglen, uint8_t *sarg)
 {
@@ -164,7 +114,9 @@ static void uart_event_task(void *pvParameters)
     uart_event_t event;
     size_t datasize;
     int res;
-    uint8_t* dtmp = (uint8_t*) malloc(UART_BUFF_SIZE);
+    uart_ringbuf_t *rbuf = uart_buf[self->uart_num];
+    // large enough for any data or pattern callback
+    uint8_t* dtmp = (uint8_t*) malloc(rbuf->size);
 
     for(;;) {
     	if (self->end_task) break;
@@ -174,38 +126,40 @@ static void uart_event_task(void *pvParameters)
     	}
         //Waiting for UART event.
         if (xQueueReceive(UART_QUEUE[self->uart_num], (void * )&event, 1000 / portTICK_PERIOD_MS)) {
-        	if (uart_mutex) xSemaphoreTake(uart_mutex, 200 / portTICK_PERIOD_MS);
-            bzero(dtmp, UART_BUFF_SIZE);
             switch(event.type) {
                 //Event of UART receiving data
                 case UART_DATA:
-                	// move UART data to MPy buffer
+                	// move UART data to MPy buffer, no lock is needed to put the data
                     uart_get_buffered_data_len(self->uart_num+1, &datasize);
+                    if (datasize > rbuf->size) datasize = rbuf->size;
                     if (datasize > 0) {
                     	// read data from UART buffer
 						if (uart_read_bytes(self->uart_num+1, dtmp, datasize, 0) > 0) {
-							res = uart_buf_put(uart_buf[self->uart_num], dtmp, datasize);
+							res = uart_buf_put(rbuf, dtmp, datasize);
+							mp_hal_poll_notify();
 							if (res) {
 								// MPy buffer full
 								if (self->error_cb) {
 									_sched_callback(self->error_cb, self->uart_num+1, UART_CB_TYPE_ERROR, UART_BUFFER_FULL, NULL);
 								}
 							}
-							else {
-								if ((self->data_cb) && (self->data_cb_size > 0) && (uart_buf[self->uart_num]->iput >= self->data_cb_size)) {
+							else if ((self->data_cb) || (self->pattern_cb)) {
+					        	if (uart_mutex) xSemaphoreTake(uart_mutex, 200 / portTICK_PERIOD_MS);
+								if ((self->data_cb) && (self->data_cb_size > 0) && (uart_buf_count(rbuf) >= self->data_cb_size)) {
 									// ** callback on data length received
-									uart_buf_get(uart_buf[self->uart_num], dtmp, self->data_cb_size);
+									uart_buf_get(rbuf, dtmp, self->data_cb_size);
 									_sched_callback(self->data_cb, self->uart_num+1, UART_CB_TYPE_DATA, self->data_cb_size, dtmp);
 								}
 								else if (self->pattern_cb) {
 									// ** callback on pattern received
-									res = match_pattern(uart_buf[self->uart_num]->buf, uart_buf[self->uart_num]->iput, self->pattern, self->pattern_len);
+									res = uart_buf_match(rbuf, &self->pattern_match);
 									if (res >= 0) {
 										// found, pull data, including pattern from buffer
-										uart_buf_get(uart_buf[self->uart_num], dtmp, res+self->pattern_len);
-										_sched_callback(self->pattern_cb, self->uart_num+1, UART_CB_TYPE_PATTERN, res, dtmp);
+										uart_buf_get(rbuf, dtmp, res);
+										_sched_callback(self->pattern_cb, self->uart_num+1, UART_CB_TYPE_PATTERN, res-self->pattern_len, dtmp);
 									}
 								}
+					        	if (uart_mutex) xSemaphoreGive(uart_mutex);
 							}
 						}
                     }
@@ -254,8 +208,6 @@ static void uart_event_task(void *pvParameters)
                     //ESP_LOGI(TAG, "uart event type: %d", event.type);
                     break;
             }
-
-        	if (uart_mutex) xSemaphoreGive(uart_mutex);
         }
     }
     free(dtmp);
@@ -451,6 +403,7 @@ STATIC void machine_uart_init_helper(machine_uart_obj_t *self, size_t n_args, co
 			if ((lnend_buff.len > 0) && (lnend_buff.len < sizeof(self->lineend))) {
 				memset(self->lineend, 0, sizeof(self->lineend));
 				memcpy(self->lineend, lnend_buff.buf, lnend_buff.len);
+				uart_matcher_init(&self->lineend_match, self->lineend, lnend_buff.len);
 			}
 		}
 	}
@@ -505,6 +458,8 @@ STATIC mp_obj_t machine_uart_make_new(const mp_obj_type_t *type, size_t n_args,
     self->data_cb_size = 0;
     self->end_task = 0;
     sprintf((char *)self->lineend, "\r\n");
+    uart_matcher_init(&self->pattern_match, self->pattern, 0);
+    uart_matcher_init(&self->lineend_match, self->lineend, 2);
 
 
     switch (uart_num) {
@@ -528,10 +483,9 @@ STATIC mp_obj_t machine_uart_make_new(const mp_obj_type_t *type, size_t n_args,
     mp_arg_val_t kargs[MP_ARRAY_SIZE(allowed_args)];
     mp_arg_parse_all(n_args-1, args+1, &kw_args, MP_ARRAY_SIZE(allowed_args), allowed_args, kargs);
 
-    // Set buffer size
-    int bufsize = kargs[ARG_buffer_size].u_int;
-    if (bufsize < 512) bufsize = 512;
-    if (bufsize > 8192) bufsize = 8192;
+    // Set buffer size, rounded up to the power of two
+    int bufsize = 512;
+    while ((bufsize < kargs[ARG_buffer_size].u_int) && (bufsize < 8192)) bufsize <<= 1;
     self->buffer_size = bufsize;
 
 	if (uart_buf[self->uart_num] == NULL) {
@@ -579,9 +533,7 @@ MP_DEFINE_CONST_FUN_OBJ_KW(machine_uart_init_obj, 1, machine_uart_init);
 STATIC mp_obj_t machine_uart_any(mp_obj_t self_in) {
     machine_uart_obj_t *self = MP_OBJ_TO_PTR(self_in);
 
-    if (uart_mutex) xSemaphoreTake(uart_mutex, 200 / portTICK_PERIOD_MS);
-    int res = uart_buf[self->uart_num]->iput;
-	if (uart_mutex) xSemaphoreGive(uart_mutex);
+    int res = uart_buf_count(uart_buf[self->uart_num]);
 
     return MP_OBJ_NEW_SMALL_INT(res);
 }
@@ -593,8 +545,7 @@ STATIC mp_obj_t machine_uart_flush(mp_obj_t self_in) {
 
     if (uart_mutex) xSemaphoreTake(uart_mutex, 200 / portTICK_PERIOD_MS);
     uart_flush_input(self->uart_num+1);
-    uart_buf[self->uart_num]->iput = 0;
-    uart_buf[self->uart_num]->iget = 0;
+    uart_buf_clear(uart_buf[self->uart_num]);
 	if (uart_mutex) xSemaphoreGive(uart_mutex);
 
 	return mp_const_none;
@@ -604,6 +555,7 @@ STATIC MP_DEFINE_CONST_FUN_OBJ_1(machine_uart_flush_obj, machine_uart_flush);
 //------------------------------------------------------------------------
 STATIC mp_obj_t machine_uart_readln(size_t n_args, const mp_obj_t *args) {
     machine_uart_obj_t *self = MP_OBJ_TO_PTR(args[0]);
+    uart_ringbuf_t *rbuf = uart_buf[self->uart_num];
 
     uint8_t *rdstr = NULL;
     int rdlen = -1;
@@ -616,17 +568,12 @@ STATIC mp_obj_t machine_uart_readln(size_t n_args, const mp_obj_t *args) {
 	if (timeout == 0) {
 		if (uart_mutex) xSemaphoreTake(uart_mutex, 200 / portTICK_PERIOD_MS);
     	// just return the buffer content if line end was found
-		if (uart_buf[self->uart_num]->iput < lnendlen) {
-	    	if (uart_mutex) xSemaphoreGive(uart_mutex);
-	    	return mp_const_none;
-		}
-		rdlen = match_pattern(uart_buf[self->uart_num]->buf, uart_buf[self->uart_num]->iput, self->lineend, lnendlen);
+		rdlen = uart_buf_match(rbuf, &self->lineend_match);
 		if (rdlen >= 0) {
 			// found, pull data, including pattern from buffer
-			rdlen += lnendlen;
 			rdstr = calloc(rdlen+1, 1);
 			if (rdstr) {
-				uart_buf_get(uart_buf[self->uart_num], rdstr, rdlen);
+				uart_buf_get(rbuf, rdstr, rdlen);
 				rdstr[rdlen] = 0;
 			}
 		}
@@ -636,29 +583,22 @@ STATIC mp_obj_t machine_uart_readln(size_t n_args, const mp_obj_t *args) {
     else {
     	// wait until line end received or timeout
     	int wait = timeout;
-        int buflen = 0;
+        uint32_t buflen = 0;
     	mp_hal_set_wdt_tmo();
 		MP_THREAD_GIL_EXIT();
 		while (wait > 0) {
-			if (uart_mutex) xSemaphoreTake(uart_mutex, 200 / portTICK_PERIOD_MS);
-			if (buflen < uart_buf[self->uart_num]->iput) {
-				buflen = uart_buf[self->uart_num]->iput;
+			if (buflen < uart_buf_count(rbuf)) {
+				buflen = uart_buf_count(rbuf);
 				wait = timeout; // new data received, reset timeout
 			}
-			if (uart_buf[self->uart_num]->iput < lnendlen) {
-		    	if (uart_mutex) xSemaphoreGive(uart_mutex);
-	    		vTaskDelay(10 / portTICK_PERIOD_MS);
-				wait -= 10;
-				mp_hal_reset_wdt();
-				continue;
-			}
-			rdlen = match_pattern(uart_buf[self->uart_num]->buf, uart_buf[self->uart_num]->iput, self->lineend, lnendlen);
+			if (uart_mutex) xSemaphoreTake(uart_mutex, 200 / portTICK_PERIOD_MS);
+			// only the data received since the last check is searched
+			rdlen = uart_buf_match(rbuf, &self->lineend_match);
 			if (rdlen >= 0) {
-				rdlen += lnendlen;
 				// found, pull data, including pattern from buffer
 				rdstr = calloc(rdlen+1, 1);
 				if (rdstr) {
-					uart_buf_get(uart_buf[self->uart_num], rdstr, rdlen);
+					uart_buf_get(rbuf, rdstr, rdlen);
 					rdstr[rdlen] = 0;
 				}
 		    	if (uart_mutex) xSemaphoreGive(uart_mutex);
@@ -711,6 +651,7 @@ STATIC mp_obj_t machine_uart_callback(size_t n_args, const mp_obj_t *pos_args, m
             	self->pattern_cb = NULL;
             	self->pattern[0] = 0;
             	self->pattern_len = 0;
+            	uart_matcher_init(&self->pattern_match, self->pattern, 0);
                 break;
             case UART_CB_TYPE_ERROR:
             	self->error_cb = NULL;
@@ -759,6 +700,7 @@ STATIC mp_obj_t machine_uart_callback(size_t n_args, const mp_obj_t *pos_args, m
         case UART_CB_TYPE_PATTERN:
 			memcpy(self->pattern, pattern_buff.buf, pattern_buff.len);
 			self->pattern_len = pattern_buff.len;
+			uart_matcher_init(&self->pattern_match, self->pattern, self->pattern_len);
     		self->pattern_cb = args[ARG_func].u_obj;
             break;
         case UART_CB_TYPE_ERROR:
@@ -820,14 +762,13 @@ STATIC mp_uint_t machine_uart_read(mp_obj_t self_in, void *buf_in, mp_uint_t siz
 		int wait = self->timeout;
 		MP_THREAD_GIL_EXIT();
 		while (wait > 0) {
-	    	if (uart_mutex) xSemaphoreTake(uart_mutex, 200 / portTICK_PERIOD_MS);
-			if (uart_buf[self->uart_num]->iput < size) {
-		    	if (uart_mutex) xSemaphoreGive(uart_mutex);
+			if (uart_buf_count(uart_buf[self->uart_num]) < size) {
 	    		vTaskDelay(2 / portTICK_PERIOD_MS);
 				wait -= 2;
 				mp_hal_reset_wdt();
 				continue;
 			}
+	    	if (uart_mutex) xSemaphoreTake(uart_mutex, 200 / portTICK_PERIOD_MS);
 	    	bytes_read = uart_buf_get(uart_buf[self->uart_num], (uint8_t *)buf_in, size);
 	    	if (uart_mutex) xSemaphoreGive(uart_mutex);
 			break;
@@ -865,10 +806,7 @@ STATIC mp_uint_t machine_uart_ioctl(mp_obj_t self_in, mp_uint_t request, mp_uint
     if (request == MP_STREAM_POLL) {
         mp_uint_t flags = arg;
         ret = 0;
-        size_t rxbufsize;
-    	if (uart_mutex) xSemaphoreTake(uart_mutex, 200 / portTICK_PERIOD_MS);
-        rxbufsize = uart_buf[self->uart_num]->iput;
-    	if (uart_mutex) xSemaphoreGive(uart_mutex);
+        size_t rxbufsize = uart_buf_count(uart_buf[self->uart_num]);
 
         if ((flags & MP_STREAM_POLL_RD) && rxbufsize > 0) {
             ret |= MP_STREAM_POLL_RD;
@@ -876,6 +814,9 @@ STATIC mp_uint_t machine_uart_ioctl(mp_obj_t self_in, mp_uint_t request, mp_uint
         if ((flags & MP_STREAM_POLL_WR) && 1) { // FIXME: uart_tx_any_room(self->uart_num)
             ret |= MP_STREAM_POLL_WR;
         }
+    } else if (request == MP_STREAM_POLL_NOTIFY) {
+        // uart_event_task() wakes a sleeping poll when data is received
+        ret = 0;
     } else {
         *errcode = MP_EINVAL;
         ret = MP_STREAM_ERROR;
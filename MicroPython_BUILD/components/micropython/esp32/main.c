@@ -339,3 +339,89 @@ void nlr_jump_fail(void *val) {
     esp_restart();
 }
 
+
+#if MICROPY_EMIT_XTENSAWIN
+// Native code is executed from IRAM, which can only be accessed with 32-bit
+// loads and stores.  Each interpreter keeps a list of its chunks, which the
+// GC marks when it finds a pointer into them, traces for the object pointers
+// held in their literal pools, and frees once they are unreachable.
+enum {
+    NATIVE_CODE_UNMARKED,
+    NATIVE_CODE_MARKED,
+    NATIVE_CODE_TRACED,
+};
+
+typedef struct _native_code_chunk_t {
+    struct _native_code_chunk_t *next;
+    size_t len; // in words
+    int mark;
+    uint32_t code[];
+} native_code_chunk_t;
+
+//--------------------------------------------------
+void *esp_native_code_commit(void *buf, size_t len) {
+    len = (len + 3) / 4;
+    native_code_chunk_t *chunk = heap_caps_malloc(sizeof(native_code_chunk_t) + len * 4, MALLOC_CAP_EXEC);
+    if (chunk == NULL) {
+        // unreachable native code may be holding on to the IRAM
+        gc_collect();
+        chunk = heap_caps_malloc(sizeof(native_code_chunk_t) + len * 4, MALLOC_CAP_EXEC);
+        if (chunk == NULL) {
+            nlr_raise(mp_obj_new_exception_msg_varg(&mp_type_MemoryError,
+                "no IRAM left for %u bytes of native code", (uint)len * 4));
+        }
+    }
+    // buf comes from the GC heap so it is word aligned and padded
+    const uint32_t *src = buf;
+    for (size_t i = 0; i < len; i++) {
+        chunk->code[i] = src[i];
+    }
+    chunk->len = len;
+    chunk->mark = NATIVE_CODE_UNMARKED;
+    chunk->next = MP_STATE_MEM(gc_exec_list);
+    MP_STATE_MEM(gc_exec_list) = chunk;
+    return chunk->code;
+}
+
+//-------------------------------------
+void esp_native_code_gc_mark(void *ptr) {
+    for (native_code_chunk_t *chunk = MP_STATE_MEM(gc_exec_list); chunk != NULL; chunk = chunk->next) {
+        if ((uint32_t*)ptr >= chunk->code && (uint32_t*)ptr < chunk->code + chunk->len) {
+            if (chunk->mark == NATIVE_CODE_UNMARKED) {
+                chunk->mark = NATIVE_CODE_MARKED;
+            }
+            return;
+        }
+    }
+}
+
+//---------------------------------
+bool esp_native_code_gc_trace(void) {
+    bool traced = false;
+    for (native_code_chunk_t *chunk = MP_STATE_MEM(gc_exec_list); chunk != NULL; chunk = chunk->next) {
+        if (chunk->mark == NATIVE_CODE_MARKED) {
+            chunk->mark = NATIVE_CODE_TRACED;
+            gc_collect_root((void**)chunk->code, chunk->len);
+            traced = true;
+        }
+    }
+    return traced;
+}
+
+// Outside of a collection nothing is marked, so this then frees all the
+// native code of the interpreter
+//---------------------------------
+void esp_native_code_gc_sweep(void) {
+    native_code_chunk_t **link = (native_code_chunk_t**)&MP_STATE_MEM(gc_exec_list);
+    while (*link != NULL) {
+        native_code_chunk_t *chunk = *link;
+        if (chunk->mark == NATIVE_CODE_UNMARKED) {
+            *link = chunk->next;
+            heap_caps_free(chunk);
+        } else {
+            chunk->mark = NATIVE_CODE_UNMARKED;
+            link = &chunk->next;
+        }
+    }
+}
+#endif
@@ -40,7 +40,6 @@
 #include "esp_err.h"
 #include "esp_partition.h"
 #include "esp_spi_flash.h"
-#include "mbedtls/md5.h"
 #include "esp_ota_ops.h"
 #include "rom/queue.h"
 #include "rom/crc.h"
@@ -51,6 +50,7 @@
 #include "modmachine.h"
 #include "mphalport.h"
 #include "extmod/vfs_native.h"
+#include "extmod/moduhashlib.h"
 
 
 #define BUFFSIZE 4096
@@ -269,15 +269,14 @@ static esp_err_t mpy_ota_update(const char *server, const char *port, const char
    	ESP_LOGI(TAG, "Writing to '%s' partition at offset 0x%x", update_partition->label, update_partition->address);
 
     unsigned char md5_byte_array[16] = {0};
-    mbedtls_md5_context ctx;
-    mbedtls_md5_init( &ctx );
-    mbedtls_md5_starts( &ctx );
+    mp_hash_ctx_t ctx;
+    mp_hash_md5.init(&ctx);
 	int binary_file_length = 0;  // image total length
 
 	while (body_len > 0) {
 		mp_hal_reset_wdt();
         err = esp_ota_write( update_handle, (const void *)ota_write_data, body_len);
-        mbedtls_md5_update( &ctx, (const unsigned char *)ota_write_data, body_len);
+        mp_hash_md5.update(&ctx, (const byte *)ota_write_data, body_len);
         if (err != ESP_OK) {
         	mp_hal_stdout_tx_newline();
             ESP_LOGE(TAG, "Error: esp_ota_write failed! err=0x%x", err);
@@ -295,11 +294,8 @@ static esp_err_t mpy_ota_update(const char *server, const char *port, const char
     		goto exit;
 		}
     }
-    mbedtls_md5_finish( &ctx, md5_byte_array );
-    mbedtls_md5_free( &ctx );
-    for (int i = 0; i<16; i++){
-        sprintf(local_md5+(i*2),"%02x", md5_byte_array[i]);
-    }
+    mp_hash_md5.final(&ctx, md5_byte_array);
+    mp_hash_hex(local_md5, md5_byte_array, 16);
 
     mp_printf(&mp_plat_print,"                                                         \n");
     ESP_LOGI(TAG, "Connection closed, all packets received");
@@ -454,17 +450,16 @@ static esp_err_t mpy_ota_fileupdate(const char *fname, uint8_t force_fact)
     // Start writing data
    	ESP_LOGI(TAG, "Writing to '%s' partition at offset 0x%x", update_partition->label, update_partition->address);
 
-   	unsigned char md5_byte_array[16] = {0};
-    mbedtls_md5_context ctx;
-    mbedtls_md5_init( &ctx );
-    mbedtls_md5_starts( &ctx );
+    unsigned char md5_byte_array[16] = {0};
+    mp_hash_ctx_t ctx;
+    mp_hash_md5.init(&ctx);
 	int binary_file_length = 0;  // image total length
 	int remaining = expect_len;
 
 	while (rd_len > 0) {
 		mp_hal_reset_wdt();
         err = esp_ota_write( update_handle, (const void *)ota_write_data, rd_len);
-        mbedtls_md5_update( &ctx, (const unsigned char *)ota_write_data, rd_len);
+        mp_hash_md5.update(&ctx, (const byte *)ota_write_data, rd_len);
         if (err != ESP_OK) {
         	mp_hal_stdout_tx_newline();
             ESP_LOGE(TAG, "Error: esp_ota_write failed! err=0x%x", err);
@@ -485,11 +480,8 @@ static esp_err_t mpy_ota_fileupdate(const char *fname, uint8_t force_fact)
     		goto exit;
 		}
     }
-    mbedtls_md5_finish( &ctx, md5_byte_array );
-    mbedtls_md5_free( &ctx );
-    for (int i = 0; i<16; i++){
-        sprintf(local_md5+(i*2),"%02x", md5_byte_array[i]);
-    }
+    mp_hash_md5.final(&ctx, md5_byte_array);
+    mp_hash_hex(local_md5, md5_byte_array, 16);
 
 	ESP_LOGI(TAG, "Image written, total length = %d bytes\n", binary_file_length);
 	if (expect_len != binary_file_length) {
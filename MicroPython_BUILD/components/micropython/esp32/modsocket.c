@@ -510,6 +510,12 @@ STATIC mp_uint_t socket_stream_ioctl(mp_obj_t self_in, mp_uint_t request, uintpt
         if (FD_ISSET(socket->fd, &wfds)) ret |= MP_STREAM_POLL_WR;
         if (FD_ISSET(socket->fd, &efds)) ret |= MP_STREAM_POLL_HUP;
         return ret;
+    } else if (request == MP_STREAM_GET_FILENO) {
+        if (socket->fd < 0) {
+            *errcode = MP_EBADF;
+            return MP_STREAM_ERROR;
+        }
+        return socket->fd;
     } else if (request == MP_STREAM_CLOSE) {
         if (socket->fd >= 0) {
             int ret = lwip_close_r(socket->fd);
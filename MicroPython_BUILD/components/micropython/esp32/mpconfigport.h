@@ -28,6 +28,7 @@
 // overriding defaults in py/mpconfig.h.
 
 #include <stdint.h>
+#include <stdbool.h>
 #include <alloca.h>
 #include "rom/ets_sys.h"
 #include "sdkconfig.h"
@@ -42,6 +43,11 @@
 // emitters
 #define MICROPY_PERSISTENT_CODE_LOAD        (1)
 #define MICROPY_EMIT_XTENSA					(0)
+#ifdef CONFIG_MICROPY_USE_NATIVE_EMITTER
+#define MICROPY_EMIT_XTENSAWIN              (1)
+#else
+#define MICROPY_EMIT_XTENSAWIN              (0)
+#endif
 
 // compiler configuration
 #define MICROPY_COMP_MODULE_CONST           (1)
@@ -50,11 +56,35 @@
 // optimisations
 #define MICROPY_OPT_COMPUTED_GOTO           (1)
 #define MICROPY_OPT_MPZ_BITWISE             (1)
+#define MICROPY_OPT_MPZ_KARATSUBA           (1)
+#define MICROPY_OPT_MPZ_MONTGOMERY          (1)
+#ifdef CONFIG_MICROPY_USE_BYTECODE_CACHE
+#define MICROPY_OPT_CACHE_MAP_LOOKUP_IN_BYTECODE (1)
+#else
+#define MICROPY_OPT_CACHE_MAP_LOOKUP_IN_BYTECODE (0)
+#endif
+#ifdef CONFIG_MICROPY_USE_SUPERINSTRUCTIONS
+#define MICROPY_OPT_BYTECODE_SUPERINSTRUCTIONS (1)
+#else
+#define MICROPY_OPT_BYTECODE_SUPERINSTRUCTIONS (0)
+#endif
+#ifdef CONFIG_MICROPY_USE_VM_BINARY_OP_FAST_PATH
+#define MICROPY_OPT_VM_BINARY_OP_FAST_PATH  (1)
+#else
+#define MICROPY_OPT_VM_BINARY_OP_FAST_PATH  (0)
+#endif
+#ifdef CONFIG_MICROPY_USE_VM_FLOAT_TEMP_REUSE
+#define MICROPY_OPT_VM_FLOAT_TEMP_REUSE     (1)
+#else
+#define MICROPY_OPT_VM_FLOAT_TEMP_REUSE     (0)
+#endif
 
 // Python internal features
 #define MICROPY_READER_VFS                  (1)
 #define MICROPY_ENABLE_GC                   (1)
 #define MICROPY_ENABLE_FINALISER            (1)
+#define MICROPY_GC_INCREMENTAL_SWEEP        (1)
+#define MICROPY_GC_ALLOC_SIZE_CLASSES       (8)
 #define MICROPY_STACK_CHECK                 (1)
 #define MICROPY_ENABLE_EMERGENCY_EXCEPTION_BUF (1)
 #define MICROPY_KBD_EXCEPTION               (1)
@@ -75,7 +105,13 @@
 #define MICROPY_MODULE_WEAK_LINKS           (1)
 #define MICROPY_MODULE_FROZEN_STR           (0) // do not support frozen str modules
 #define MICROPY_MODULE_FROZEN_MPY           (1)
+#ifdef CONFIG_MICROPY_FROZEN_ROM_GLOBALS
+#define MICROPY_MODULE_FROZEN_MPY_ROM_GLOBALS (1)
+#else
+#define MICROPY_MODULE_FROZEN_MPY_ROM_GLOBALS (0)
+#endif
 #define MICROPY_QSTR_EXTRA_POOL             mp_qstr_frozen_const_pool
+#define MICROPY_QSTR_INDEX                  (1)
 #define MICROPY_CAN_OVERRIDE_BUILTINS       (1)
 #define MICROPY_USE_INTERNAL_ERRNO          (1)
 #define MICROPY_USE_INTERNAL_PRINTF         (0) // ESP32 SDK requires its own printf
@@ -132,6 +168,7 @@
 #define MICROPY_PY_IO_BYTESIO               (1)
 #define MICROPY_PY_IO_BUFFEREDWRITER        (1)
 #define MICROPY_PY_STRUCT                   (1)
+#define MICROPY_PY_STRUCT_CACHE_SIZE        (8)
 #define MICROPY_PY_SYS                      (1)
 #define MICROPY_PY_SYS_MAXSIZE              (1)
 #define MICROPY_PY_SYS_MODULES              (1)
@@ -140,16 +177,28 @@
 #define MICROPY_PY_SYS_STDIO_BUFFER         (1)
 #define MICROPY_PY_UERRNO                   (1)
 #define MICROPY_PY_USELECT                  (1)
+#define MICROPY_PY_USELECT_SELECT           (1) // sockets are select()ed by lwIP
+#define MICROPY_PY_USELECT_SELECT_H         "lwip/sockets.h"
+#define MICROPY_PY_USELECT_WAIT(ms)         mp_hal_poll_wait(ms)
 #define MICROPY_PY_UTIME_MP_HAL             (1)
 #define MICROPY_PY_THREAD                   (1)
 #define MICROPY_PY_THREAD_GIL               (1)
 #define MICROPY_PY_THREAD_GIL_VM_DIVISOR    (32)
+#define MICROPY_PY_THREAD_GIL_ADAPTIVE      (1)
+#ifdef CONFIG_MICROPY_USE_THREAD_WORKERS
+#define MICROPY_PY_THREAD_WORKERS           (1)
+#endif
 
 // extended modules
 #define MICROPY_PY_UCTYPES                  (1)
 #define MICROPY_PY_UZLIB                    (1)
+#define MICROPY_PY_UZLIB_COMPRESS           (1)
 #define MICROPY_PY_UJSON                    (1)
+#define MICROPY_PY_UJSON_BUF_SIZE           (256)
+#define MICROPY_PY_UJSON_ITERPARSE          (1)
 #define MICROPY_PY_URE                      (1)
+#define MICROPY_PY_URE_CACHE_SIZE           (8)
+#define MICROPY_PY_URE_PIKEVM               (1)
 #define MICROPY_PY_UHEAPQ                   (1)
 #define MICROPY_PY_UTIMEQ                   (1)
 #define MICROPY_PY_UBINASCII                (1)
@@ -169,8 +218,11 @@
 #define MICROPY_PY_USSL                     (1)
 #define MICROPY_SSL_MBEDTLS                 (1)
 #define MICROPY_PY_USSL_FINALISER           (1)
-#define MICROPY_PY_UHASHLIB                 (0) // We use the ESP32 version
-#define MICROPY_PY_UHASHLIB_SHA1            (MICROPY_PY_USSL && MICROPY_SSL_MBEDTLS)
+#define MICROPY_PY_UHASHLIB                 (1)
+#define MICROPY_PY_UHASHLIB_MBEDTLS         (1) // uses the SHA hardware
+#define MICROPY_PY_UHASHLIB_MD5             (1)
+#define MICROPY_PY_UHASHLIB_SHA1            (1)
+#define MICROPY_PY_UHASHLIB_SHA512          (1)
 
 #ifdef CONFIG_MICROPY_USE_WEBSOCKETS
 #define MICROPY_PY_WEBSOCKET                (1)
@@ -186,6 +238,12 @@
 #define MICROPY_PY_FRAMEBUF                 (0)
 #endif
 
+#ifdef CONFIG_MICROPY_PY_VECTOR
+#define MICROPY_PY_VECTOR                   (1)
+#else
+#define MICROPY_PY_VECTOR                   (0)
+#endif
+
 /*
  * Defined in 'component.mk'
 #ifdef CONFIG_MICROPY_PY_USE_BTREE
@@ -292,7 +350,6 @@ extern const struct _mp_obj_module_t mp_module_bluetooth;
     { MP_OBJ_NEW_QSTR(MP_QSTR_machine),  (mp_obj_t)&mp_module_machine }, \
     { MP_OBJ_NEW_QSTR(MP_QSTR_network),  (mp_obj_t)&mp_module_network }, \
     { MP_OBJ_NEW_QSTR(MP_QSTR_ymodem),   (mp_obj_t)&mp_module_ymodem }, \
-	{ MP_OBJ_NEW_QSTR(MP_QSTR_uhashlib), (mp_obj_t)&mp_module_uhashlib }, \
 	BUILTIN_MODULE_DISPLAY \
 	BUILTIN_MODULE_CURL \
 	BUILTIN_MODULE_SSH \
@@ -324,16 +381,36 @@ extern const struct _mp_obj_module_t mp_module_bluetooth;
 #define MICROPY_PORT_ROOT_POINTERS \
     const char *readline_hist[80]; \
     mp_obj_list_t mod_network_nic_list;                         \
-    mp_obj_t machine_pin_irq_handler[40];
+    mp_obj_t machine_pin_irq_handler[40]; \
+    void *machine_adc_collect;
 #else
 #define MICROPY_PORT_ROOT_POINTERS \
     const char *readline_hist[16]; \
-    mp_obj_t machine_pin_irq_handler[40];
+    mp_obj_t machine_pin_irq_handler[40]; \
+    void *machine_adc_collect;
 #endif
 
 // type definitions for the specific machine
 #define BYTES_PER_WORD (4)
 #define MICROPY_MAKE_POINTER_CALLABLE(p) ((void*)((mp_uint_t)(p)))
+#if MICROPY_EMIT_XTENSAWIN
+#include "soc/soc.h"
+void *esp_native_code_commit(void *buf, size_t len);
+void esp_native_code_gc_mark(void *ptr);
+bool esp_native_code_gc_trace(void);
+void esp_native_code_gc_sweep(void);
+#define MP_PLAT_COMMIT_EXEC(buf, len) esp_native_code_commit(buf, len)
+// the native code is in IRAM, so only words in that range need to be looked up
+#define MP_PLAT_GC_MARK_EXEC(ptr) do { \
+        if ((uintptr_t)(ptr) - SOC_IRAM_LOW < SOC_IRAM_HIGH - SOC_IRAM_LOW) { \
+            esp_native_code_gc_mark(ptr); \
+        } \
+    } while (0)
+#define MP_PLAT_GC_TRACE_EXEC() esp_native_code_gc_trace()
+#define MP_PLAT_GC_SWEEP_EXEC() esp_native_code_gc_sweep()
+// frozen native code is run from flash, where the linker puts .irom0.text
+#define MP_PLAT_FROZEN_EXEC_ATTR __attribute__((section(".irom0.text")))
+#endif
 #define MP_PLAT_PRINT_STRN(str, len) mp_hal_stdout_tx_strn_cooked(str, len)
 #define MP_SSIZE_MAX (0x7fffffff)
 
@@ -92,6 +92,98 @@ void mp_hal_set_wdt_tmo()
 	#endif
 }
 
+// Each task which blocks in a uselect poll sleeps on its own semaphore, taken
+// from this table; streams which can't be select()ed on, but support
+// MP_STREAM_POLL_NOTIFY, give all of them when they may have become ready, so
+// every poller wakes and not only one of them.  A task keeps its slot between
+// polls, so a notification given while it is checking its objects is still
+// pending when it goes to sleep.  The semaphores are never deleted, which lets
+// a notifier give them without a lock.  If there are more polling tasks than
+// slots the oldest slot is taken over, and the task which loses it falls back
+// to the MICROPY_PY_USELECT_MAX_WAIT_MS cap on each sleep.
+#define POLL_WAITERS (8)
+
+typedef struct _poll_waiter_t {
+	TaskHandle_t task;
+	SemaphoreHandle_t sem;
+} poll_waiter_t;
+
+static poll_waiter_t poll_waiters[POLL_WAITERS];
+static uint8_t poll_waiters_next = 0;
+static portMUX_TYPE poll_waiters_mux = portMUX_INITIALIZER_UNLOCKED;
+
+//-------------------------
+void mp_hal_poll_notify(void)
+{
+	for (int i = 0; i < POLL_WAITERS; i++) {
+		SemaphoreHandle_t sem = poll_waiters[i].sem;
+		if (sem) xSemaphoreGive(sem);
+	}
+}
+
+//----------------------------------------------------------
+void IRAM_ATTR mp_hal_poll_notify_from_isr(int *task_woken)
+{
+	for (int i = 0; i < POLL_WAITERS; i++) {
+		SemaphoreHandle_t sem = poll_waiters[i].sem;
+		if (sem) xSemaphoreGiveFromISR(sem, task_woken);
+	}
+}
+
+//-------------------------------
+void mp_hal_poll_wait(uint32_t ms)
+{
+	TaskHandle_t task = xTaskGetCurrentTaskHandle();
+	poll_waiter_t *w = NULL;
+	bool claimed = false;
+
+	portENTER_CRITICAL(&poll_waiters_mux);
+	for (int i = 0; i < POLL_WAITERS; i++) {
+		if (poll_waiters[i].task == task) {
+			w = &poll_waiters[i];
+			break;
+		}
+	}
+	if (w == NULL) {
+		for (int i = 0; i < POLL_WAITERS; i++) {
+			if (poll_waiters[i].task == NULL) {
+				w = &poll_waiters[i];
+				break;
+			}
+		}
+		// take over the oldest slot, unless its owner is still creating
+		// the semaphore, which only the task that claimed a slot does
+		for (int i = 0; w == NULL && i < POLL_WAITERS; i++) {
+			poll_waiter_t *old = &poll_waiters[poll_waiters_next];
+			poll_waiters_next = (poll_waiters_next + 1) % POLL_WAITERS;
+			if (old->sem != NULL) w = old;
+		}
+		if (w != NULL) {
+			w->task = task;
+			claimed = true;
+		}
+	}
+	portEXIT_CRITICAL(&poll_waiters_mux);
+
+	// round up, so that a wait shorter than a tick still sleeps
+	TickType_t ticks = (ms + portTICK_PERIOD_MS - 1) / portTICK_PERIOD_MS;
+	if (w != NULL) {
+		if (w->sem == NULL) w->sem = xSemaphoreCreateBinary();
+		if (claimed) {
+			// a notification may have come before the slot was ours, so
+			// return at once and let the caller check its objects again
+			xSemaphoreTake(w->sem, 0);
+			return;
+		}
+	}
+	mp_hal_reset_wdt();
+
+	MP_THREAD_GIL_EXIT();
+	if (w != NULL) xSemaphoreTake(w->sem, ticks);
+	else vTaskDelay(ticks);
+	MP_THREAD_GIL_ENTER();
+}
+
 
 STATIC uint8_t stdin_ringbuf_array[CONFIG_MICROPY_RX_BUFFER_SIZE];
 ringbuf_t stdin_ringbuf = {stdin_ringbuf_array, sizeof(stdin_ringbuf_array), 0, 0};
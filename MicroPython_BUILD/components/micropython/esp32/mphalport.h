@@ -45,6 +45,10 @@ void disableStdin(const char *pat);
 void mp_hal_set_wdt_tmo();
 void mp_hal_reset_wdt();
 
+void mp_hal_poll_notify(void);
+void mp_hal_poll_notify_from_isr(int *task_woken);
+void mp_hal_poll_wait(uint32_t ms);
+
 uint64_t mp_hal_ticks_us(void);
 __attribute__((always_inline)) static inline uint32_t mp_hal_ticks_cpu(void) {
   uint32_t ccount;
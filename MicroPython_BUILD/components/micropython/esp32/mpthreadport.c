@@ -26,7 +26,6 @@
 
 #include <stdio.h>
 #include <string.h>
-#include <sys/time.h>
 #include <time.h>
 
 #include "py/mpconfig.h"
@@ -42,6 +41,20 @@
 #include "mpthreadport.h"
 #include "modnetwork.h"
 
+#if MICROPY_PY_THREAD_WORKERS
+#include "py/compile.h"
+#include "py/objmodule.h"
+#include "py/runtime.h"
+#include "py/stackctrl.h"
+#if MICROPY_VFS
+#include "extmod/vfs.h"
+#include "extmod/vfs_native.h"
+#endif
+#if CONFIG_SPIRAM_SUPPORT
+#include "esp_heap_caps.h"
+#endif
+#endif
+
 #if defined(CONFIG_MICROPY_USE_TELNET) || defined(CONFIG_MICROPY_USE_FTPSERVER)
 #include "tcpip_adapter.h"
 #include "esp_wifi_types.h"
@@ -83,13 +96,63 @@ typedef struct _thread_t {
     int8_t deleted;
     int16_t notifyed;
     uint16_t type;
+    void *mailbox;						// thread's Queue object, a GC root pointer
+    #if MICROPY_PY_THREAD_GIL_ADAPTIVE
+    uint64_t gil_held_us;				// total time holding the GIL
+    uint64_t gil_wait_us;				// total time waiting for the GIL
+    #endif
     struct _thread_t *next;
+    struct _thread_t *hash_next;		// next node in the same thread_hash bucket
 } thread_t;
 
-// the mutex controls access to the linked list
+// Besides the linked list, the nodes are kept in a small hash table keyed by
+// the task handle, and each thread's own node is also stored in its thread
+// local storage, so finding a thread never walks the list.
+#define THREAD_TLS_NODE			2		// index 1 holds the mp_state_thread_t
+#define THREAD_HASH_SIZE		16
+#define THREAD_HASH(id)			((((uintptr_t)(id)) >> 4) & (THREAD_HASH_SIZE - 1))
+
+// the mutex controls access to the linked list and the hash table
 STATIC mp_thread_mutex_t thread_mutex;
 STATIC thread_t thread_entry0;
 STATIC thread_t *thread; // root pointer, handled by mp_thread_gc_others
+STATIC thread_t *thread_hash[THREAD_HASH_SIZE];
+
+// Find the node of thread 'id', the caller must hold thread_mutex
+//-------------------------------------------
+STATIC thread_t *thread_find(TaskHandle_t id)
+{
+    for (thread_t *th = thread_hash[THREAD_HASH(id)]; th != NULL; th = th->hash_next) {
+        if (th->id == id) return th;
+    }
+    return NULL;
+}
+
+//-------------------------------------
+STATIC void thread_hash_add(thread_t *th)
+{
+    th->hash_next = thread_hash[THREAD_HASH(th->id)];
+    thread_hash[THREAD_HASH(th->id)] = th;
+}
+
+//----------------------------------------
+STATIC void thread_hash_remove(thread_t *th)
+{
+    for (thread_t **p = &thread_hash[THREAD_HASH(th->id)]; *p != NULL; p = &(*p)->hash_next) {
+        if (*p == th) {
+            *p = th->hash_next;
+            break;
+        }
+    }
+}
+
+// The calling thread's node, NULL if it is not a MicroPython thread.
+// The node is not freed while its thread is running.
+//------------------------------
+STATIC thread_t *thread_self(void)
+{
+    return pvTaskGetThreadLocalStoragePointer(NULL, THREAD_TLS_NODE);
+}
 
 //-------------------------------
 void vPortCleanUpTCB(void *tcb) {
@@ -104,6 +167,7 @@ void vPortCleanUpTCB(void *tcb) {
                 // move the start pointer
                 thread = th->next;
             }
+            thread_hash_remove(th);
             // explicitly release all its memory
             if (th->tcb) free(th->tcb);
             if (th->stack) free(th->stack);
@@ -135,7 +199,14 @@ void mp_thread_preinit(void *stack, uint32_t stack_len) {
     thread->deleted = 0;
     thread->notifyed = 0;
     thread->type = THREAD_TYPE_MAIN;
+    thread->mailbox = NULL;
+    #if MICROPY_PY_THREAD_GIL_ADAPTIVE
+    thread->gil_held_us = 0;
+    thread->gil_wait_us = 0;
+    #endif
     thread->next = NULL;
+    thread_hash_add(thread);
+    vTaskSetThreadLocalStoragePointer(NULL, THREAD_TLS_NODE, thread);
     MainTaskHandle = thread->id;
 }
 
@@ -146,13 +217,17 @@ void mp_thread_init(void) {
 
 //------------------------------
 void mp_thread_gc_others(void) {
+    // the threads all belong to the main interpreter
+    if (!MP_STATE_IS_MAIN()) return;
+
     mp_thread_mutex_lock(&thread_mutex, 1);
     for (thread_t *th = thread; th != NULL; th = th->next) {
-    	if (th->type == THREAD_TYPE_SERVICE) {
+    	if ((th->type == THREAD_TYPE_SERVICE) || (th->type == THREAD_TYPE_WORKER)) {
     		continue;
     	}
         gc_collect_root((void**)&th, 1);
         gc_collect_root(&th->arg, 1); // probably not needed
+        gc_collect_root(&th->mailbox, 1);
         if (th->id == xTaskGetCurrentTaskHandle()) {
             continue;
         }
@@ -160,7 +235,7 @@ void mp_thread_gc_others(void) {
             continue;
         }
         //ToDo: Check if needed
-        gc_collect_root(th->stack, th->stack_len); // probably not needed
+        gc_collect_root(th->stack, th->stack_len / sizeof(void*)); // stack_len is in bytes
     }
     mp_thread_mutex_unlock(&thread_mutex);
 }
@@ -177,13 +252,10 @@ void mp_thread_set_state(void *state) {
 
 //--------------------------
 void mp_thread_start(void) {
+    // thread_mutex is held by the creator until the node is set up
     mp_thread_mutex_lock(&thread_mutex, 1);
-    for (thread_t *th = thread; th != NULL; th = th->next) {
-        if (th->id == xTaskGetCurrentTaskHandle()) {
-            th->ready = 1;
-            break;
-        }
-    }
+    thread_t *th = thread_self();
+    if (th) th->ready = 1;
     mp_thread_mutex_unlock(&thread_mutex);
 }
 
@@ -200,6 +272,10 @@ STATIC void freertos_entry(void *arg) {
 //------------------------------------------------------------------------------------------------------------------------------
 TaskHandle_t mp_thread_create_ex(void *(*entry)(void*), void *arg, size_t *stack_size, int priority, char *name, bool same_core)
 {
+    if (!MP_STATE_IS_MAIN()) {
+        nlr_raise(mp_obj_new_exception_msg(&mp_type_OSError, "can't create thread in a worker"));
+    }
+
     // store thread entry function into a global variable so we can access it
     ext_thread_entry = entry;
 
@@ -266,7 +342,14 @@ TaskHandle_t mp_thread_create_ex(void *(*entry)(void*), void *arg, size_t *stack
     th->deleted = 0;
     th->notifyed = 0;
     th->type = THREAD_TYPE_PYTHON;
+    th->mailbox = NULL;
+    #if MICROPY_PY_THREAD_GIL_ADAPTIVE
+    th->gil_held_us = 0;
+    th->gil_wait_us = 0;
+    #endif
     thread = th;
+    thread_hash_add(th);
+    vTaskSetThreadLocalStoragePointer(id, THREAD_TLS_NODE, th);
 
     mp_thread_mutex_unlock(&thread_mutex);
     return id;
@@ -293,6 +376,7 @@ STATIC void mp_clean_thread(thread_t *th)
 		if (th->threadQueue) vQueueDelete(th->threadQueue);
 		th->threadQueue = NULL;
 	}
+	th->mailbox = NULL;
     th->ready = 0;
 	th->deleted = 1;
 }
@@ -300,15 +384,278 @@ STATIC void mp_clean_thread(thread_t *th)
 //---------------------------
 void mp_thread_finish(void) {
     mp_thread_mutex_lock(&thread_mutex, 1);
-    for (thread_t *th = thread; th != NULL; th = th->next) {
-        if (th->id == xTaskGetCurrentTaskHandle()) {
-        	mp_clean_thread(th);
-            break;
-        }
+    thread_t *th = thread_self();
+    if (th) mp_clean_thread(th);
+    mp_thread_mutex_unlock(&thread_mutex);
+}
+
+
+// ===== WORKER INTERPRETERS ==========================================
+
+#if MICROPY_PY_THREAD_WORKERS
+
+mp_worker_core_t mp_worker_core[portNUM_PROCESSORS];
+
+//-------------------------------------------
+STATIC void worker_free(mp_worker_t *worker)
+{
+	mp_worker_msg_t msg;
+	while (xQueueReceive(worker->inbox, &msg, 0) == pdTRUE) free(msg.data);
+	while (xQueueReceive(worker->outbox, &msg, 0) == pdTRUE) free(msg.data);
+	vQueueDelete(worker->inbox);
+	vQueueDelete(worker->outbox);
+	if (worker->heap) free(worker->heap);
+	if (worker->source) free(worker->source);
+	free(worker->ctx);
+	free(worker);
+}
+
+// Drop one reference to the worker, the last one frees it
+//----------------------------------------------------------
+STATIC void worker_unref(mp_worker_t *worker, QueueHandle_t peer)
+{
+    mp_thread_mutex_lock(&thread_mutex, 1);
+    int refs = --worker->refs;
+    mp_thread_mutex_unlock(&thread_mutex);
+    if (refs == 0) {
+    	worker_free(worker);
+    }
+    else {
+    	// wake up the other side if it waits for a message
+    	mp_worker_msg_t msg = { NULL, 0 };
+    	xQueueSend(peer, &msg, 0);
+    }
+}
+
+//------------------------------------
+STATIC void worker_entry(void *arg) {
+	mp_worker_t *worker = (mp_worker_t *)arg;
+	int stack_dummy;
+
+	// From here on MP_STATE_VM and MP_STATE_MEM of this task refer to the
+	// worker's interpreter, and so does its thread state
+	mp_worker_core[worker->core].task = xTaskGetCurrentTaskHandle();
+	mp_worker_core[worker->core].ctx = worker->ctx;
+	mp_thread_set_state(&worker->ctx->thread);
+
+	mp_stack_set_top(&stack_dummy);
+	mp_stack_set_limit(worker->stack_size - 1024);
+	gc_init(worker->heap, worker->heap + worker->heap_size);
+	mp_init();
+	mp_obj_list_init(mp_sys_path, 0);
+	mp_obj_list_append(mp_sys_path, MP_OBJ_NEW_QSTR(MP_QSTR_));
+	mp_obj_list_append(mp_sys_path, MP_OBJ_NEW_QSTR(MP_QSTR__slash_lib));
+	mp_obj_list_init(mp_sys_argv, 0);
+
+	nlr_buf_t nlr;
+	if (nlr_push(&nlr) == 0) {
+		mp_obj_module_t *main_module = m_new_obj(mp_obj_module_t);
+		main_module->base.type = &mp_type_module;
+		main_module->globals = &MP_STATE_VM(dict_main);
+		mp_module_register(MP_QSTR___main__, MP_OBJ_FROM_PTR(main_module));
+		#if MICROPY_VFS
+		// The file system is already mounted by the main interpreter, the
+		// worker only gets its own mount table entry for it
+		if (mount_vfs(VFS_NATIVE_TYPE_SPIFLASH, NULL) == 0) {
+			MP_STATE_VM(vfs_cur) = MP_STATE_VM(vfs_mount_table);
+		}
+		#endif
+		mp_lexer_t *lex = mp_lexer_new_from_str_len(MP_QSTR__lt_string_gt_, worker->source, worker->source_len, 0);
+		qstr source_name = lex->source_name;
+		mp_parse_tree_t parse_tree = mp_parse(lex, MP_PARSE_FILE_INPUT);
+		mp_obj_t module_fun = mp_compile(&parse_tree, source_name, MP_EMIT_OPT_NONE, false);
+		free(worker->source);
+		worker->source = NULL;
+		mp_call_function_0(module_fun);
+		nlr_pop();
+	}
+	else {
+		mp_obj_base_t *exc = (mp_obj_base_t*)nlr.ret_val;
+		if (!mp_obj_is_subclass_fast(MP_OBJ_FROM_PTR(exc->type), MP_OBJ_FROM_PTR(&mp_type_SystemExit))) {
+			mp_printf(&mp_plat_print, "Unhandled exception in worker\n");
+			mp_obj_print_exception(&mp_plat_print, MP_OBJ_FROM_PTR(exc));
+		}
+	}
+
+	mp_deinit();
+	#if MICROPY_EMIT_XTENSAWIN
+	// free the native code compiled by the worker
+	esp_native_code_gc_sweep();
+	#endif
+	MP_THREAD_GIL_EXIT();
+
+	// Leave the interpreter, its heap is no longer needed
+	mp_worker_core[worker->core].ctx = NULL;
+	mp_worker_core[worker->core].task = NULL;
+	if (worker->source) free(worker->source);
+	worker->source = NULL;
+	free(worker->heap);
+	worker->heap = NULL;
+
+	mp_thread_finish();
+	mp_thread_mutex_lock(&thread_mutex, 1);
+	mp_worker_core[worker->core].worker = NULL;
+	worker->running = 0;
+	mp_thread_mutex_unlock(&thread_mutex);
+	worker_unref(worker, worker->outbox);
+
+	vTaskDelete(NULL);
+}
+
+// Start a worker interpreter running the given source code, on a core which
+// has no worker yet, preferably not the one of the main task
+//------------------------------------------------------------------------------------------------------------------------------------
+mp_worker_t *mp_thread_worker_start(const char *name, const char *source, size_t source_len, size_t heap_size, size_t stack_size)
+{
+	if (!MP_STATE_IS_MAIN()) {
+        nlr_raise(mp_obj_new_exception_msg(&mp_type_OSError, "can't create worker in a worker"));
+	}
+	if (stack_size == 0) stack_size = MP_WORKER_DEFAULT_STACK_SIZE;
+	else if (stack_size < MP_THREAD_MIN_STACK_SIZE) stack_size = MP_THREAD_MIN_STACK_SIZE;
+	else if (stack_size > MP_THREAD_MAX_STACK_SIZE) stack_size = MP_THREAD_MAX_STACK_SIZE;
+	if (heap_size == 0) heap_size = MP_WORKER_DEFAULT_HEAP_SIZE;
+	else if (heap_size < MP_WORKER_MIN_HEAP_SIZE) heap_size = MP_WORKER_MIN_HEAP_SIZE;
+
+	// Everything is allocated outside of the MicroPython heap, which the
+	// worker's task outlives
+	mp_worker_t *worker = calloc(1, sizeof(mp_worker_t));
+	StaticTask_t *tcb = malloc(sizeof(StaticTask_t));
+	StackType_t *stack = malloc(stack_size+256);
+	thread_t *th = (thread_t *)malloc(sizeof(thread_t));
+	if (worker) {
+		worker->ctx = calloc(1, sizeof(mp_state_ctx_t));
+		#if CONFIG_SPIRAM_SUPPORT && CONFIG_SPIRAM_USE_CAPS_ALLOC
+		worker->heap = heap_caps_malloc(heap_size, MALLOC_CAP_SPIRAM);
+		#else
+		worker->heap = malloc(heap_size);
+		#endif
+		worker->source = malloc(source_len + 1);
+		worker->inbox = xQueueCreate(THREAD_QUEUE_MAX_ITEMS, sizeof(mp_worker_msg_t));
+		worker->outbox = xQueueCreate(THREAD_QUEUE_MAX_ITEMS, sizeof(mp_worker_msg_t));
+	}
+	if ((!worker) || (!worker->ctx) || (!worker->heap) || (!worker->source) || (!worker->inbox) || (!worker->outbox) || (!tcb) || (!stack) || (!th)) {
+		if (worker) {
+			if (worker->inbox) vQueueDelete(worker->inbox);
+			if (worker->outbox) vQueueDelete(worker->outbox);
+			if (worker->heap) free(worker->heap);
+			if (worker->source) free(worker->source);
+			if (worker->ctx) free(worker->ctx);
+			free(worker);
+		}
+		if (tcb) free(tcb);
+		if (stack) free(stack);
+		if (th) free(th);
+        nlr_raise(mp_obj_new_exception_msg(&mp_type_OSError, "not enough memory for worker"));
+	}
+	memcpy(worker->source, source, source_len);
+	worker->source[source_len] = '\0';
+	worker->source_len = source_len;
+	worker->heap_size = heap_size;
+	worker->stack_size = stack_size;
+	worker->running = 1;
+	worker->linked = 1;
+	worker->refs = 2;
+
+    mp_thread_mutex_lock(&thread_mutex, 1);
+
+	#if CONFIG_FREERTOS_UNICORE
+	worker->core = 0;
+	#else
+	worker->core = MainTaskCore ^ 1;
+	if (mp_worker_core[worker->core].worker != NULL) worker->core = MainTaskCore;
+	#endif
+	TaskHandle_t id = NULL;
+	bool free_core = (mp_worker_core[worker->core].worker == NULL);
+	if (free_core) {
+		mp_worker_core[worker->core].worker = worker;
+		id = xTaskCreateStaticPinnedToCore(worker_entry, name, stack_size, worker, MP_THREAD_PRIORITY, stack, tcb, worker->core);
+		if (id == NULL) mp_worker_core[worker->core].worker = NULL;
+	}
+    if (id == NULL) {
+        mp_thread_mutex_unlock(&thread_mutex);
+        worker->refs = 1;
+        worker_free(worker);
+        free(tcb);
+        free(stack);
+        free(th);
+        nlr_raise(mp_obj_new_exception_msg(&mp_type_OSError, (free_core) ? "can't create worker" : "no free core for worker"));
     }
+
+    // add the worker's task to the list of threads
+    th->id = id;
+    th->ready = 1;
+    th->arg = NULL;
+    th->stack = stack;
+    th->tcb = tcb;
+    th->stack_len = stack_size;
+    th->next = thread;
+    snprintf(th->name, THREAD_NAME_MAX_SIZE, name);
+    th->threadQueue = xQueueCreate( THREAD_QUEUE_MAX_ITEMS, sizeof(thread_msg_t) );
+    th->allow_suspend = 0;
+    th->suspended = 0;
+    th->waiting = 0;
+    th->deleted = 0;
+    th->notifyed = 0;
+    th->type = THREAD_TYPE_WORKER;
+    th->mailbox = NULL;
+    #if MICROPY_PY_THREAD_GIL_ADAPTIVE
+    th->gil_held_us = 0;
+    th->gil_wait_us = 0;
+    #endif
+    thread = th;
+    thread_hash_add(th);
+    vTaskSetThreadLocalStoragePointer(id, THREAD_TLS_NODE, th);
+
+    mp_thread_mutex_unlock(&thread_mutex);
+    return worker;
+}
+
+// The worker the caller runs in, NULL in the main interpreter
+//---------------------------------------
+mp_worker_t *mp_thread_worker_self(void)
+{
+	mp_worker_core_t *slot = &mp_worker_core[xPortGetCoreID()];
+	if ((slot->ctx != NULL) && (slot->task == xTaskGetCurrentTaskHandle())) {
+		return slot->worker;
+	}
+	return NULL;
+}
+
+// The parent closes its channel to the worker, which keeps running
+//--------------------------------------------------
+void mp_thread_worker_release(mp_worker_t *worker)
+{
+	worker->linked = 0;
+	// nobody will read the worker's messages, drop them so that
+	// a worker waiting to send is not blocked forever
+	mp_worker_msg_t msg;
+	while (xQueueReceive(worker->outbox, &msg, 0) == pdTRUE) free(msg.data);
+	worker_unref(worker, worker->inbox);
+}
+
+// Raise KeyboardInterrupt in the worker, as Ctrl-C does in the main interpreter
+//--------------------------------------------------
+int mp_thread_worker_interrupt(mp_worker_t *worker)
+{
+	int res = 0;
+	#if MICROPY_KBD_EXCEPTION
+    mp_thread_mutex_lock(&thread_mutex, 1);
+	if (worker->running) {
+		worker->ctx->vm.mp_pending_exception = MP_OBJ_FROM_PTR(&worker->ctx->vm.mp_kbd_exception);
+		#if MICROPY_ENABLE_SCHEDULER
+		if (worker->ctx->vm.sched_state == MP_SCHED_IDLE) {
+			worker->ctx->vm.sched_state = MP_SCHED_PENDING;
+		}
+		#endif
+		res = 1;
+	}
     mp_thread_mutex_unlock(&thread_mutex);
+	#endif
+	return res;
 }
 
+#endif // MICROPY_PY_THREAD_WORKERS
+
 //---------------------------------------------------
 void mp_thread_mutex_init(mp_thread_mutex_t *mutex) {
     mutex->handle = xSemaphoreCreateMutexStatic(&mutex->buffer);
@@ -324,15 +671,87 @@ void mp_thread_mutex_unlock(mp_thread_mutex_t *mutex) {
     xSemaphoreGive(mutex->handle);
 }
 
+#if MICROPY_PY_THREAD_GIL_ADAPTIVE
+// The VM only releases the GIL when gil_waiting tells that a thread waits
+// for it, so an uncontended GIL costs no mutex operations at all.  The time
+// each thread holds and waits for the GIL is accounted in its node.
+
+// gil_waiting is updated from both cores
+STATIC portMUX_TYPE gil_mux = portMUX_INITIALIZER_UNLOCKED;
+
+// Wait for the GIL held by another thread, the caller wants it since 'since'
+//------------------------------------------------------------
+STATIC void gil_wait(mp_state_ctx_t *ctx, uint32_t since) {
+    if (xSemaphoreTake(ctx->vm.gil_mutex.handle, 0) != pdTRUE) {
+        portENTER_CRITICAL(&gil_mux);
+        ctx->vm.gil_waiting++;
+        portEXIT_CRITICAL(&gil_mux);
+        xSemaphoreTake(ctx->vm.gil_mutex.handle, portMAX_DELAY);
+        portENTER_CRITICAL(&gil_mux);
+        ctx->vm.gil_waiting--;
+        portEXIT_CRITICAL(&gil_mux);
+        ctx->vm.gil_handoffs++;
+    }
+    ctx->vm.gil_taken_us = (uint32_t)mp_hal_ticks_us();
+    thread_t *th = thread_self();
+    if (th) th->gil_wait_us += ctx->vm.gil_taken_us - since;
+}
+
+//----------------------------
+void mp_thread_gil_enter(void) {
+    mp_state_ctx_t *ctx = &MP_STATE_CTX;
+    if (xSemaphoreTake(ctx->vm.gil_mutex.handle, 0) == pdTRUE) {
+        ctx->vm.gil_taken_us = (uint32_t)mp_hal_ticks_us();
+        return;
+    }
+    gil_wait(ctx, (uint32_t)mp_hal_ticks_us());
+}
+
+//---------------------------
+void mp_thread_gil_exit(void) {
+    mp_state_ctx_t *ctx = &MP_STATE_CTX;
+    thread_t *th = thread_self();
+    if (th) th->gil_held_us += (uint32_t)mp_hal_ticks_us() - ctx->vm.gil_taken_us;
+    xSemaphoreGive(ctx->vm.gil_mutex.handle);
+}
+
+//-----------------------------
+void mp_thread_gil_switch(void) {
+    mp_state_ctx_t *ctx = &MP_STATE_CTX;
+    uint32_t now = (uint32_t)mp_hal_ticks_us();
+    if ((now - ctx->vm.gil_taken_us) < ctx->vm.gil_switch_us) return;
+
+    uint16_t handoffs = ctx->vm.gil_handoffs;
+    thread_t *th = thread_self();
+    if (th) th->gil_held_us += now - ctx->vm.gil_taken_us;
+    xSemaphoreGive(ctx->vm.gil_mutex.handle);
+    // A waiter with the same priority on this core only runs when we yield,
+    // let it take the GIL before competing for it again (for at most a tick,
+    // the waiter may have been suspended meanwhile)
+    TickType_t start = xTaskGetTickCount();
+    while ((ctx->vm.gil_handoffs == handoffs) && (ctx->vm.gil_waiting != 0) && ((xTaskGetTickCount() - start) < 2)) {
+        taskYIELD();
+    }
+    // the whole time given away counts as waiting
+    gil_wait(ctx, now);
+}
+
+// Set the holder's time slice in microseconds, returns the previous one
+//-------------------------------------------------------
+uint32_t mp_thread_gil_switchinterval(int32_t interval) {
+    uint32_t prev = MP_STATE_VM(gil_switch_us);
+    if (interval >= 0) MP_STATE_VM(gil_switch_us) = interval;
+    return prev;
+}
+#endif
+
 //--------------------------------------
 void mp_thread_allowsuspend(int allow) {
     mp_thread_mutex_lock(&thread_mutex, 1);
-    for (thread_t *th = thread; th != NULL; th = th->next) {
-        // don't allow suspending main task task
-        if ((th->id != MainTaskHandle) && (th->id == xTaskGetCurrentTaskHandle())) {
-        	th->allow_suspend = allow & 1;
-            break;
-        }
+    thread_t *th = thread_self();
+    // don't allow suspending main task task
+    if ((th) && (th->id != MainTaskHandle)) {
+    	th->allow_suspend = allow & 1;
     }
     mp_thread_mutex_unlock(&thread_mutex);
 }
@@ -341,19 +760,14 @@ void mp_thread_allowsuspend(int allow) {
 int mp_thread_suspend(TaskHandle_t id) {
 	int res = 0;
     mp_thread_mutex_lock(&thread_mutex, 1);
-    for (thread_t *th = thread; th != NULL; th = th->next) {
-        // don't suspend the current task
-        if (th->id == xTaskGetCurrentTaskHandle()) {
-            continue;
-        }
-        if (th->id == id) {
-        	if ((th->allow_suspend) && (th->suspended == 0) && (th->waiting == 0)) {
-        		th->suspended = 1;
-        		vTaskSuspend(th->id);
-        		res = 1;
-        	}
-            break;
-        }
+    thread_t *th = thread_find(id);
+    // don't suspend the current task
+    if ((th) && (th->id != xTaskGetCurrentTaskHandle())) {
+    	if ((th->allow_suspend) && (th->suspended == 0) && (th->waiting == 0)) {
+    		th->suspended = 1;
+    		vTaskSuspend(th->id);
+    		res = 1;
+    	}
     }
     mp_thread_mutex_unlock(&thread_mutex);
     return res;
@@ -363,19 +777,14 @@ int mp_thread_suspend(TaskHandle_t id) {
 int mp_thread_resume(TaskHandle_t id) {
 	int res = 0;
     mp_thread_mutex_lock(&thread_mutex, 1);
-    for (thread_t *th = thread; th != NULL; th = th->next) {
-        // don't resume the current task
-        if (th->id == xTaskGetCurrentTaskHandle()) {
-            continue;
-        }
-        if (th->id == id) {
-        	if ((th->allow_suspend) && (th->suspended) && (th->waiting == 0)) {
-        		th->suspended = 0;
-        		vTaskResume(th->id);
-        		res = 1;
-        	}
-            break;
-        }
+    thread_t *th = thread_find(id);
+    // don't resume the current task
+    if ((th) && (th->id != xTaskGetCurrentTaskHandle())) {
+    	if ((th->allow_suspend) && (th->suspended) && (th->waiting == 0)) {
+    		th->suspended = 0;
+    		vTaskResume(th->id);
+    		res = 1;
+    	}
     }
     mp_thread_mutex_unlock(&thread_mutex);
     return res;
@@ -385,12 +794,10 @@ int mp_thread_resume(TaskHandle_t id) {
 int mp_thread_setblocked() {
 	int res = 0;
     mp_thread_mutex_lock(&thread_mutex, 1);
-    for (thread_t *th = thread; th != NULL; th = th->next) {
-        if (th->id == xTaskGetCurrentTaskHandle()) {
-			th->waiting = 1;
-			res = 1;
-            break;
-        }
+    thread_t *th = thread_self();
+    if (th) {
+    	th->waiting = 1;
+    	res = 1;
     }
     mp_thread_mutex_unlock(&thread_mutex);
     return res;
@@ -400,12 +807,10 @@ int mp_thread_setblocked() {
 int mp_thread_setnotblocked() {
 	int res = 0;
     mp_thread_mutex_lock(&thread_mutex, 1);
-    for (thread_t *th = thread; th != NULL; th = th->next) {
-        if (th->id == xTaskGetCurrentTaskHandle()) {
-        	th->waiting = 0;
-        	res = 1;
-            break;
-        }
+    thread_t *th = thread_self();
+    if (th) {
+    	th->waiting = 0;
+    	res = 1;
     }
     mp_thread_mutex_unlock(&thread_mutex);
     return res;
@@ -417,14 +822,22 @@ int mp_thread_setnotblocked() {
 int mp_thread_notify(TaskHandle_t id, uint32_t value) {
 	int res = 0;
     mp_thread_mutex_lock(&thread_mutex, 1);
-    for (thread_t *th = thread; th != NULL; th = th->next) {
-        if ( (th->id != xTaskGetCurrentTaskHandle()) && ( (id == 0) || (th->id == id) ) ) {
+    if (id != 0) {
+    	thread_t *th = thread_find(id);
+        if ((th) && (th->id != xTaskGetCurrentTaskHandle())) {
         	res = xTaskNotify(th->id, value, eSetValueWithOverwrite); //eSetValueWithoutOverwrite
         	th->notifyed = 1;
-            if (id != 0) break;
         }
     }
-    if (id == 0) res = 1;
+    else {
+		for (thread_t *th = thread; th != NULL; th = th->next) {
+			if (th->id != xTaskGetCurrentTaskHandle()) {
+				xTaskNotify(th->id, value, eSetValueWithOverwrite);
+				th->notifyed = 1;
+			}
+		}
+		res = 1;
+    }
     mp_thread_mutex_unlock(&thread_mutex);
     return res;
 }
@@ -444,15 +857,13 @@ int mp_thread_num_threads() {
 uint32_t mp_thread_getnotify(bool check_only) {
 	uint32_t value = 0;
     mp_thread_mutex_lock(&thread_mutex, 1);
-    for (thread_t *th = thread; th != NULL; th = th->next) {
-        if (th->id == xTaskGetCurrentTaskHandle()) {
-        	xTaskNotifyWait(0, 0, &value, 0);
-      		if (!check_only) {
-      			xTaskNotifyWait(ULONG_MAX, ULONG_MAX, NULL, 0);
-          		th->notifyed = 0;
-      		}
-			break;
-        }
+    thread_t *th = thread_self();
+    if (th) {
+    	xTaskNotifyWait(0, 0, &value, 0);
+  		if (!check_only) {
+  			xTaskNotifyWait(ULONG_MAX, ULONG_MAX, NULL, 0);
+      		th->notifyed = 0;
+  		}
     }
     mp_thread_mutex_unlock(&thread_mutex);
     return value;
@@ -462,12 +873,8 @@ uint32_t mp_thread_getnotify(bool check_only) {
 int mp_thread_notifyPending(TaskHandle_t id) {
 	int res = -1;
     mp_thread_mutex_lock(&thread_mutex, 1);
-    for (thread_t *th = thread; th != NULL; th = th->next) {
-        if (th->id == id) {
-        	res = th->notifyed;
-            break;
-        }
-    }
+    thread_t *th = thread_find(id);
+    if (th) res = th->notifyed;
     mp_thread_mutex_unlock(&thread_mutex);
     return res;
 }
@@ -475,27 +882,15 @@ int mp_thread_notifyPending(TaskHandle_t id) {
 //-----------------------------
 void mp_thread_resetPending() {
     mp_thread_mutex_lock(&thread_mutex, 1);
-    for (thread_t *th = thread; th != NULL; th = th->next) {
-        if (th->id == xTaskGetCurrentTaskHandle()) {
-        	th->notifyed = 0;
-            break;
-        }
-    }
+    thread_t *th = thread_self();
+    if (th) th->notifyed = 0;
     mp_thread_mutex_unlock(&thread_mutex);
 }
 
 //------------------------------
 uint32_t mp_thread_getSelfID() {
-	uint32_t id = 0;
-    mp_thread_mutex_lock(&thread_mutex, 1);
-    for (thread_t *th = thread; th != NULL; th = th->next) {
-        if (th->id == xTaskGetCurrentTaskHandle()) {
-        	id = (uint32_t)th->id;
-			break;
-        }
-    }
-    mp_thread_mutex_unlock(&thread_mutex);
-    return id;
+    thread_t *th = thread_self();
+    return (th) ? (uint32_t)th->id : 0;
 }
 
 //-------------------------------------
@@ -503,15 +898,11 @@ int mp_thread_getSelfname(char *name) {
 	int res = 0;
 	name[0] = '?';
 	name[1] = '\0';
-    mp_thread_mutex_lock(&thread_mutex, 1);
-    for (thread_t *th = thread; th != NULL; th = th->next) {
-        if (th->id == xTaskGetCurrentTaskHandle()) {
-        	sprintf(name, th->name);
-        	res = 1;
-			break;
-        }
+    thread_t *th = thread_self();
+    if (th) {
+    	sprintf(name, th->name);
+    	res = 1;
     }
-    mp_thread_mutex_unlock(&thread_mutex);
     return res;
 }
 
@@ -521,92 +912,115 @@ int mp_thread_getname(TaskHandle_t id, char *name) {
 	name[0] = '?';
 	name[1] = '\0';
     mp_thread_mutex_lock(&thread_mutex, 1);
-    for (thread_t *th = thread; th != NULL; th = th->next) {
-        if (th->id == id) {
-        	sprintf(name, th->name);
-        	res = 1;
-			break;
-        }
+    thread_t *th = thread_find(id);
+    if (th) {
+    	sprintf(name, th->name);
+    	res = 1;
     }
     mp_thread_mutex_unlock(&thread_mutex);
     return res;
 }
 
+// Queue a message for thread 'th', the caller must hold thread_mutex
+//-------------------------------------------------------------------
+STATIC int thread_post(thread_t *th, thread_msg_t *msg, uint8_t *buf)
+{
+    // don't send to the current task or service thread
+    if ((th->id == xTaskGetCurrentTaskHandle()) || (th->type == THREAD_TYPE_SERVICE)) return 0;
+	if (th->threadQueue == NULL) return 0;
+
+	if (msg->type == THREAD_MSG_TYPE_STRING) {
+		// each receiver owns (and frees) its copy
+		msg->strdata = malloc(msg->intdata+1);
+		if (msg->strdata == NULL) return 0;
+		memcpy(msg->strdata, buf, msg->intdata);
+		msg->strdata[msg->intdata] = 0;
+	}
+	if (xQueueSend(th->threadQueue, msg, 0) != pdTRUE) {
+		if (msg->strdata != NULL) free(msg->strdata);
+		msg->strdata = NULL;
+		return 0;
+	}
+	return 1;
+}
+
 //-------------------------------------------------------------------------------------------------
 int mp_thread_semdmsg(TaskHandle_t id, int type, uint32_t msg_int, uint8_t *buf, uint32_t buflen) {
 	int res = 0;
+	if ((type != THREAD_MSG_TYPE_INTEGER) && (type != THREAD_MSG_TYPE_STRING)) return 0;
+
+	thread_msg_t msg;
+	msg.type = type;
+	msg.sender_id = xTaskGetCurrentTaskHandle();
+	msg.intdata = (type == THREAD_MSG_TYPE_STRING) ? buflen : msg_int;
+	msg.strdata = NULL;
+	msg.timestamp = xTaskGetTickCount() * portTICK_PERIOD_MS;
+
     mp_thread_mutex_lock(&thread_mutex, 1);
-    for (thread_t *th = thread; th != NULL; th = th->next) {
-        // don't send to the current task or service thread
-        if ((th->id == xTaskGetCurrentTaskHandle()) || (th->type == THREAD_TYPE_SERVICE)) {
-            continue;
-        }
-        if ((id == 0) || (th->id == id)) {
-        	if (th->threadQueue == NULL) break;
-    		thread_msg_t msg;
-    	    struct timeval tv;
-    	    uint64_t tmstamp;
-    	    gettimeofday(&tv, NULL);
-    	    tmstamp = (tv.tv_sec * 1000) + (tv.tv_usec / 1000);
-    	    msg.timestamp = tmstamp;
-			msg.sender_id = xTaskGetCurrentTaskHandle();
-			if (type == THREAD_MSG_TYPE_INTEGER) {
-				msg.intdata = msg_int;
-				msg.strdata = NULL;
-				msg.type = type;
-				res = 1;
-			}
-			else if (type == THREAD_MSG_TYPE_STRING) {
-				msg.intdata = buflen;
-				msg.strdata = malloc(buflen+1);
-				if (msg.strdata != NULL) {
-					memcpy(msg.strdata, buf, buflen);
-					msg.strdata[buflen] = 0;
-					msg.type = type;
-					res = 1;
-				}
-			}
-			if (res) {
-				if (xQueueSend(th->threadQueue, &msg, 0) != pdTRUE) res = 0;
-			}
-            if (id != 0) break;
-        }
+    if (id != 0) {
+    	thread_t *th = thread_find(id);
+    	if (th) res = thread_post(th, &msg, buf);
+    }
+    else {
+		for (thread_t *th = thread; th != NULL; th = th->next) {
+			if (thread_post(th, &msg, buf)) res = 1;
+			msg.strdata = NULL;
+		}
     }
     mp_thread_mutex_unlock(&thread_mutex);
     return res;
 }
 
+// Only the thread itself deletes its message queue, no lock is needed
 //------------------------------------------------------------------------------------------
 int mp_thread_getmsg(uint32_t *msg_int, uint8_t **buf, uint32_t *buflen, uint32_t *sender) {
 	int res = 0;
+    thread_t *th = thread_self();
+    // get message for current task
+    if ((th == NULL) || (th->type == THREAD_TYPE_SERVICE) || (th->threadQueue == NULL)) return 0;
+
+	thread_msg_t msg;
+	if (xQueueReceive(th->threadQueue, &msg, 0) == pdTRUE) {
+		*sender = (uint32_t)msg.sender_id;
+		if (msg.type == THREAD_MSG_TYPE_INTEGER) {
+			*msg_int = msg.intdata;
+			*buflen = 0;
+			res = THREAD_MSG_TYPE_INTEGER;
+		}
+		else if (msg.type == THREAD_MSG_TYPE_STRING) {
+			*msg_int = 0;
+			if ((msg.strdata != NULL) && (msg.intdata > 0)) {
+    			*buflen = msg.intdata;
+    			*buf = msg.strdata;
+    			res = THREAD_MSG_TYPE_STRING;
+			}
+		}
+	}
+    return res;
+}
+
+// The mailbox (a _thread.Queue object) of thread 'id', or of the calling
+// thread if id is 0; NULL if it has none yet or there is no such thread
+//-----------------------------------------------
+void *mp_thread_getmailbox(TaskHandle_t id) {
+	void *mailbox = NULL;
     mp_thread_mutex_lock(&thread_mutex, 1);
-    for (thread_t *th = thread; th != NULL; th = th->next) {
-        // get message for current task
-        if ((th->id == xTaskGetCurrentTaskHandle()) && (th->type != THREAD_TYPE_SERVICE)) {
-        	if (th->threadQueue == NULL) break;
-
-        	thread_msg_t msg;
-        	if (xQueueReceive(th->threadQueue, &msg, 0) == pdTRUE) {
-        		*sender = (uint32_t)msg.sender_id;
-        		if (msg.type == THREAD_MSG_TYPE_INTEGER) {
-        			*msg_int = msg.intdata;
-        			*buflen = 0;
-        			res = THREAD_MSG_TYPE_INTEGER;
-        		}
-        		else if (msg.type == THREAD_MSG_TYPE_STRING) {
-        			*msg_int = 0;
-        			if ((msg.strdata != NULL) && (msg.intdata > 0)) {
-            			*buflen = msg.intdata;
-            			*buf = msg.strdata;
-            			res = THREAD_MSG_TYPE_STRING;
-        			}
-        		}
-        	}
-        	break;
-        }
-    }
+    thread_t *th = (id == 0) ? thread_self() : thread_find(id);
+    if ((th) && (!th->deleted)) mailbox = th->mailbox;
     mp_thread_mutex_unlock(&thread_mutex);
+    return mailbox;
+}
 
+//-------------------------------------------------------------
+int mp_thread_setmailbox(TaskHandle_t id, void *mailbox) {
+	int res = 0;
+    mp_thread_mutex_lock(&thread_mutex, 1);
+    thread_t *th = (id == 0) ? thread_self() : thread_find(id);
+    if ((th) && (!th->deleted) && ((th->type == THREAD_TYPE_MAIN) || (th->type == THREAD_TYPE_PYTHON))) {
+    	th->mailbox = mailbox;
+    	res = 1;
+    }
+    mp_thread_mutex_unlock(&thread_mutex);
     return res;
 }
 
@@ -614,18 +1028,13 @@ int mp_thread_getmsg(uint32_t *msg_int, uint8_t **buf, uint32_t *buflen, uint32_
 int mp_thread_status(TaskHandle_t id) {
 	int res = -1;
     mp_thread_mutex_lock(&thread_mutex, 1);
-    for (thread_t *th = thread; th != NULL; th = th->next) {
-        if ((th->id == xTaskGetCurrentTaskHandle()) || (th->type == THREAD_TYPE_SERVICE)) {
-            continue;
-        }
-        if (th->id == id) {
-			if (!th->deleted) {
-				if (th->suspended) res = 1;
-				else if (th->waiting) res = 2;
-				else res = 0;
-			}
-			break;
-        }
+    thread_t *th = thread_find(id);
+    if ((th) && (th->id != xTaskGetCurrentTaskHandle()) && (th->type != THREAD_TYPE_SERVICE)) {
+		if (!th->deleted) {
+			if (th->suspended) res = 1;
+			else if (th->waiting) res = 2;
+			else res = 0;
+		}
     }
     mp_thread_mutex_unlock(&thread_mutex);
     return res;
@@ -654,7 +1063,7 @@ int mp_thread_list(thread_list_t *list) {
 		threadlistitem_t *thr = NULL;
 		uint32_t min_stack;
 		for (thread_t *th = thread; th != NULL; th = th->next) {
-			thr = list->threads + (sizeof(threadlistitem_t) * nth);
+			thr = list->threads + nth;
 	        if (th->id == xTaskGetCurrentTaskHandle()) min_stack = uxTaskGetStackHighWaterMark(NULL);
 	        else min_stack = uxTaskGetStackHighWaterMark(th->id);
 
@@ -665,6 +1074,10 @@ int mp_thread_list(thread_list_t *list) {
 			thr->type = th->type;
 			thr->stack_len = th->stack_len;
 			thr->stack_max = th->stack_len - min_stack;
+			#if MICROPY_PY_THREAD_GIL_ADAPTIVE
+			thr->gil_held_us = th->gil_held_us;
+			thr->gil_wait_us = th->gil_wait_us;
+			#endif
 			nth++;
 			if (nth > num) break;
 		}
@@ -681,16 +1094,9 @@ int mp_thread_list(thread_list_t *list) {
 //------------------------------------------
 int mp_thread_replAcceptMsg(int8_t accept) {
 	int res = main_accept_msg;
-    mp_thread_mutex_lock(&thread_mutex, 1);
-    for (thread_t *th = thread; th != NULL; th = th->next) {
-    	 if (th->id == xTaskGetCurrentTaskHandle()) {
-    		 if ((th->id == MainTaskHandle) && (accept >= 0)) {
-    			 main_accept_msg = accept & 1;
-    		 }
-			 break;
-    	 }
+    if ((xTaskGetCurrentTaskHandle() == MainTaskHandle) && (accept >= 0)) {
+		main_accept_msg = accept & 1;
     }
-    mp_thread_mutex_unlock(&thread_mutex);
 
     return res;
 }
@@ -39,6 +39,7 @@
 #define THREAD_TYPE_MAIN		1
 #define THREAD_TYPE_PYTHON		2
 #define THREAD_TYPE_SERVICE		3
+#define THREAD_TYPE_WORKER		4
 
 // Reserved thread notification constants
 #define THREAD_NOTIFY_PAUSE		0x01000000
@@ -75,6 +76,10 @@
 #define MP_THREAD_DEFAULT_STACK_SIZE		(CONFIG_MICROPY_THREAD_STACK_SIZE*1024)
 #define MP_THREAD_MAX_STACK_SIZE			(48*1024)
 
+#define MP_WORKER_DEFAULT_STACK_SIZE		(16*1024)
+#define MP_WORKER_DEFAULT_HEAP_SIZE			(32*1024)
+#define MP_WORKER_MIN_HEAP_SIZE				(8*1024)
+
 typedef struct _mp_thread_mutex_t {
     SemaphoreHandle_t handle;
     StaticSemaphore_t buffer;
@@ -105,6 +110,10 @@ typedef struct _thread_listitem_t {
     uint8_t type;
     uint32_t stack_len;
     uint32_t stack_max;
+    #if MICROPY_PY_THREAD_GIL_ADAPTIVE
+    uint64_t gil_held_us;
+    uint64_t gil_wait_us;
+    #endif
 } threadlistitem_t;
 
 typedef struct _thread_list_t {
@@ -112,6 +121,60 @@ typedef struct _thread_list_t {
     threadlistitem_t *threads;		// pointer to thread info
 } thread_list_t;
 
+#if MICROPY_PY_THREAD_WORKERS
+// A worker is a separate interpreter, with its own state, heap and GIL,
+// running Python code in a task pinned to a core, in parallel with the main
+// interpreter.  Objects can't be shared with it, the parent and the worker
+// exchange messages which are copied between the heaps.
+typedef struct _mp_worker_t {
+    struct _mp_state_ctx_t *ctx;	// the worker's interpreter state
+    uint8_t *heap;
+    size_t heap_size;
+    size_t stack_size;
+    char *source;					// code to run, freed once compiled
+    size_t source_len;
+    QueueHandle_t inbox;			// messages from the parent to the worker
+    QueueHandle_t outbox;			// messages from the worker to the parent
+    int core;
+    volatile int8_t running;		// the worker task has not finished yet
+    volatile int8_t linked;			// the parent has not closed its channel
+    int8_t refs;					// worker task and parent's channel
+} mp_worker_t;
+
+// Message item of the worker queues, data is malloc'ed by the sender and
+// freed by the receiver.  A NULL data tells that the other side has gone.
+typedef struct _mp_worker_msg_t {
+    uint8_t *data;
+    size_t len;
+} mp_worker_msg_t;
+
+// The worker running on each core, at most one per core
+typedef struct _mp_worker_core_t {
+    TaskHandle_t task;
+    struct _mp_state_ctx_t *ctx;
+    mp_worker_t *worker;
+} mp_worker_core_t;
+
+extern struct _mp_state_ctx_t mp_state_ctx;
+extern mp_worker_core_t mp_worker_core[portNUM_PROCESSORS];
+
+// The state of the interpreter the calling task, or the interrupted task,
+// belongs to.  This is on the path of every MP_STATE_VM access, so the
+// main interpreter only pays for reading the core's slot.
+static inline struct _mp_state_ctx_t *mp_thread_get_ctx(void) {
+    mp_worker_core_t *slot = &mp_worker_core[xPortGetCoreID()];
+    if ((slot->ctx != NULL) && (slot->task == xTaskGetCurrentTaskHandle())) {
+        return slot->ctx;
+    }
+    return &mp_state_ctx;
+}
+
+mp_worker_t *mp_thread_worker_start(const char *name, const char *source, size_t source_len, size_t heap_size, size_t stack_size);
+mp_worker_t *mp_thread_worker_self(void);
+void mp_thread_worker_release(mp_worker_t *worker);
+int mp_thread_worker_interrupt(mp_worker_t *worker);
+#endif
+
 thread_msg_t thread_messages[MAX_THREAD_MESSAGES];
 
 uint8_t main_accept_msg;
@@ -130,6 +193,8 @@ int mp_thread_notifyPending(TaskHandle_t id);
 void mp_thread_resetPending();
 int mp_thread_semdmsg(TaskHandle_t id, int type, uint32_t msg_int, uint8_t *buf, uint32_t buflen);
 int mp_thread_getmsg(uint32_t *msg_int, uint8_t **buf, uint32_t *buflen, uint32_t *sender);
+void *mp_thread_getmailbox(TaskHandle_t id);
+int mp_thread_setmailbox(TaskHandle_t id, void *mailbox);
 int mp_thread_status(TaskHandle_t id);
 
 int mp_thread_setblocked();
@@ -139,6 +204,9 @@ uint32_t mp_thread_getSelfID();
 int mp_thread_getSelfname(char *name);
 int mp_thread_getname(TaskHandle_t id, char *name);
 int mp_thread_list(thread_list_t *list);
+#if MICROPY_PY_THREAD_GIL_ADAPTIVE
+uint32_t mp_thread_gil_switchinterval(int32_t interval);
+#endif
 int mp_thread_replAcceptMsg(int8_t accept);
 
 #ifdef CONFIG_MICROPY_USE_TELNET
@@ -73,6 +73,8 @@ STATIC void IRAM_ATTR uart_irq_handler(void *arg)
 				MP_STATE_VM(sched_state) = MP_SCHED_PENDING;
 			}
 			#endif
+			// wake a sleeping uselect poll to raise it
+			mp_hal_poll_notify_from_isr(&xHigherPriorityTaskWoken);
 		}
 		else {
 			// this is an inline function so will be in IRAM
@@ -0,0 +1,159 @@
+/*
+ * This file is part of the MicroPython ESP32 project, https://github.com/loboris/MicroPython_ESP32_psRAM_LoBo
+ *
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2018 LoBo (https://github.com/loboris)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+// The UART receive ring buffer and pattern matcher.  They only depend on the
+// C library, so tests/host/uart_ringbuf.c can test them on the host.
+
+#ifndef UART_RINGBUF_H_
+#define UART_RINGBUF_H_
+
+#include <stdint.h>
+#include <string.h>
+
+#define UART_MATCH_RESTART		0xFF
+
+// Single producer / single consumer ring buffer for the received data.
+// uart_event_task() is the only writer of 'head' and the readers are the
+// only writers of 'tail', so data is put and taken without a lock.  Both are
+// free running counters, 'head - tail' is the number of bytes held even after
+// they wrap; 'size' is a power of two and the counters are masked to index
+// the buffer.  The readers (Python side and the data/pattern callbacks in the
+// event task) still serialize among themselves on uart_mutex.
+typedef struct _uart_ringbuf_t {
+    uint8_t *buf;
+    uint32_t size;
+    uint32_t head;
+    uint32_t tail;
+} uart_ringbuf_t;
+
+// Incremental KMP search of a short pattern in the ring buffer.  Only the
+// bytes received since the previous search are scanned, the length of the
+// pattern prefix matched so far is carried over in 'state'.
+typedef struct _uart_matcher_t {
+    const uint8_t *pat;
+    uint8_t len;
+    uint8_t state;          // UART_MATCH_RESTART: search from the start of the buffer
+    uint8_t fail[16];
+    uint32_t pos;           // ring counter up to which the data was scanned
+} uart_matcher_t;
+
+// Number of bytes available to the reader
+//--------------------------------------------------------
+static inline uint32_t uart_buf_count(uart_ringbuf_t *r) {
+	return __atomic_load_n(&r->head, __ATOMIC_ACQUIRE) - r->tail;
+}
+
+// Copy up to len bytes straight into dest, returns -1 if the buffer is empty
+//------------------------------------------------------------------------------
+static inline int uart_buf_get(uart_ringbuf_t *r, uint8_t *dest, uint32_t len) {
+	uint32_t tail = r->tail;
+	uint32_t avail = __atomic_load_n(&r->head, __ATOMIC_ACQUIRE) - tail;
+	if (avail == 0) return -1; // input buffer empty
+
+	if (len > avail) len = avail;
+	uint32_t idx = tail & (r->size - 1);
+	uint32_t n = r->size - idx;
+	if (n > len) n = len;
+	memcpy(dest, r->buf + idx, n);
+	memcpy(dest + n, r->buf, len - n);
+	__atomic_store_n(&r->tail, tail + len, __ATOMIC_RELEASE);
+	return len;
+}
+
+// Discard everything received so far
+//----------------------------------------------------
+static inline void uart_buf_clear(uart_ringbuf_t *r) {
+	__atomic_store_n(&r->tail, __atomic_load_n(&r->head, __ATOMIC_ACQUIRE), __ATOMIC_RELEASE);
+}
+
+// Store as much of source as fits, returns 1 if some of it was dropped
+//--------------------------------------------------------------------------------------
+static inline int uart_buf_put(uart_ringbuf_t *r, const uint8_t *source, uint32_t len) {
+	int res = 0;
+	uint32_t head = r->head;
+	uint32_t room = r->size - (head - __atomic_load_n(&r->tail, __ATOMIC_ACQUIRE));
+	if (len > room) {
+		len = room;
+		res = 1; // overflow
+	}
+	uint32_t idx = head & (r->size - 1);
+	uint32_t n = r->size - idx;
+	if (n > len) n = len;
+	memcpy(r->buf + idx, source, n);
+	memcpy(r->buf, source + n, len - n);
+	__atomic_store_n(&r->head, head + len, __ATOMIC_RELEASE);
+	return res;
+}
+
+//--------------------------------------------------------------------------------------
+static inline void uart_matcher_init(uart_matcher_t *m, const uint8_t *pattern, int len)
+{
+	m->pat = pattern;
+	m->len = len;
+	m->state = UART_MATCH_RESTART;
+	m->pos = 0;
+	if (len == 0) return;
+	// fail[i] is the length of the longest proper prefix of pattern[0..i]
+	// which is also its suffix
+	m->fail[0] = 0;
+	for (int i = 1, k = 0; i < len; i++) {
+		while ((k > 0) && (pattern[i] != pattern[k])) k = m->fail[k-1];
+		if (pattern[i] == pattern[k]) k++;
+		m->fail[i] = k;
+	}
+}
+
+// Returns the number of bytes up to and including the first occurrence of
+// the pattern in the buffer, or -1 if it was not received yet.
+// Must be called by the reader.
+//--------------------------------------------------------------------
+static inline int uart_buf_match(uart_ringbuf_t *r, uart_matcher_t *m)
+{
+	if (m->len == 0) return -1;
+
+	uint32_t tail = r->tail;
+	uint32_t head = __atomic_load_n(&r->head, __ATOMIC_ACQUIRE);
+	if ((m->state == UART_MATCH_RESTART) || ((m->pos - tail) > (head - tail)) || ((m->pos - tail) < m->state)) {
+		// new pattern, or data (or part of the partial match) was taken since the last search
+		m->pos = tail;
+		m->state = 0;
+	}
+	if (m->state == m->len) return m->pos - tail;
+
+	uint32_t mask = r->size - 1;
+	int q = m->state;
+	while (m->pos != head) {
+		uint8_t c = r->buf[m->pos & mask];
+		while ((q > 0) && (m->pat[q] != c)) q = m->fail[q-1];
+		if (m->pat[q] == c) q++;
+		m->pos++;
+		if (q == m->len) break;
+	}
+	m->state = q;
+	return (q == m->len) ? (int)(m->pos - tail) : -1;
+}
+
+#endif // UART_RINGBUF_H_
@@ -0,0 +1,182 @@
+/*********************************************************************
+* Filename:   md5.c
+* Copyright:
+* Disclaimer: This code is presented "as is" without any guarantees.
+* Details:    Implementation of the MD5 hashing algorithm.
+              Algorithm specification can be found here:
+               * http://tools.ietf.org/html/rfc1321
+              This implementation uses little endian byte order.
+*********************************************************************/
+
+/*************************** HEADER FILES ***************************/
+#include <stdlib.h>
+#include <string.h>
+#include "md5.h"
+
+/****************************** MACROS ******************************/
+#define ROTLEFT(a,b) (((a) << (b)) | ((a) >> (32-(b))))
+
+#define F(x,y,z) ((z) ^ ((x) & ((y) ^ (z))))
+#define G(x,y,z) ((y) ^ ((z) & ((x) ^ (y))))
+#define H(x,y,z) ((x) ^ (y) ^ (z))
+#define I(x,y,z) ((y) ^ ((x) | ~(z)))
+
+#define STEP(f,a,b,c,d,m,ac,s) { (a) += f(b,c,d) + (m) + (ac); (a) = ROTLEFT(a,s) + (b); }
+
+/*********************** FUNCTION DEFINITIONS ***********************/
+static void md5_transform(CRYAL_MD5_CTX *ctx, const BYTE data[])
+{
+	WORD a, b, c, d, i, j, m[16];
+
+	// MD5 specifies little endian byte order, so read the words that way
+	// regardless of the machine's byte order.
+	for (i = 0, j = 0; i < 16; ++i, j += 4)
+		m[i] = (data[j]) | (data[j + 1] << 8) | (data[j + 2] << 16) | (data[j + 3] << 24);
+
+	a = ctx->state[0];
+	b = ctx->state[1];
+	c = ctx->state[2];
+	d = ctx->state[3];
+
+	STEP(F, a, b, c, d, m[0],  0xd76aa478, 7);
+	STEP(F, d, a, b, c, m[1],  0xe8c7b756, 12);
+	STEP(F, c, d, a, b, m[2],  0x242070db, 17);
+	STEP(F, b, c, d, a, m[3],  0xc1bdceee, 22);
+	STEP(F, a, b, c, d, m[4],  0xf57c0faf, 7);
+	STEP(F, d, a, b, c, m[5],  0x4787c62a, 12);
+	STEP(F, c, d, a, b, m[6],  0xa8304613, 17);
+	STEP(F, b, c, d, a, m[7],  0xfd469501, 22);
+	STEP(F, a, b, c, d, m[8],  0x698098d8, 7);
+	STEP(F, d, a, b, c, m[9],  0x8b44f7af, 12);
+	STEP(F, c, d, a, b, m[10], 0xffff5bb1, 17);
+	STEP(F, b, c, d, a, m[11], 0x895cd7be, 22);
+	STEP(F, a, b, c, d, m[12], 0x6b901122, 7);
+	STEP(F, d, a, b, c, m[13], 0xfd987193, 12);
+	STEP(F, c, d, a, b, m[14], 0xa679438e, 17);
+	STEP(F, b, c, d, a, m[15], 0x49b40821, 22);
+
+	STEP(G, a, b, c, d, m[1],  0xf61e2562, 5);
+	STEP(G, d, a, b, c, m[6],  0xc040b340, 9);
+	STEP(G, c, d, a, b, m[11], 0x265e5a51, 14);
+	STEP(G, b, c, d, a, m[0],  0xe9b6c7aa, 20);
+	STEP(G, a, b, c, d, m[5],  0xd62f105d, 5);
+	STEP(G, d, a, b, c, m[10], 0x02441453, 9);
+	STEP(G, c, d, a, b, m[15], 0xd8a1e681, 14);
+	STEP(G, b, c, d, a, m[4],  0xe7d3fbc8, 20);
+	STEP(G, a, b, c, d, m[9],  0x21e1cde6, 5);
+	STEP(G, d, a, b, c, m[14], 0xc33707d6, 9);
+	STEP(G, c, d, a, b, m[3],  0xf4d50d87, 14);
+	STEP(G, b, c, d, a, m[8],  0x455a14ed, 20);
+	STEP(G, a, b, c, d, m[13], 0xa9e3e905, 5);
+	STEP(G, d, a, b, c, m[2],  0xfcefa3f8, 9);
+	STEP(G, c, d, a, b, m[7],  0x676f02d9, 14);
+	STEP(G, b, c, d, a, m[12], 0x8d2a4c8a, 20);
+
+	STEP(H, a, b, c, d, m[5],  0xfffa3942, 4);
+	STEP(H, d, a, b, c, m[8],  0x8771f681, 11);
+	STEP(H, c, d, a, b, m[11], 0x6d9d6122, 16);
+	STEP(H, b, c, d, a, m[14], 0xfde5380c, 23);
+	STEP(H, a, b, c, d, m[1],  0xa4beea44, 4);
+	STEP(H, d, a, b, c, m[4],  0x4bdecfa9, 11);
+	STEP(H, c, d, a, b, m[7],  0xf6bb4b60, 16);
+	STEP(H, b, c, d, a, m[10], 0xbebfbc70, 23);
+	STEP(H, a, b, c, d, m[13], 0x289b7ec6, 4);
+	STEP(H, d, a, b, c, m[0],  0xeaa127fa, 11);
+	STEP(H, c, d, a, b, m[3],  0xd4ef3085, 16);
+	STEP(H, b, c, d, a, m[6],  0x04881d05, 23);
+	STEP(H, a, b, c, d, m[9],  0xd9d4d039, 4);
+	STEP(H, d, a, b, c, m[12], 0xe6db99e5, 11);
+	STEP(H, c, d, a, b, m[15], 0x1fa27cf8, 16);
+	STEP(H, b, c, d, a, m[2],  0xc4ac5665, 23);
+
+	STEP(I, a, b, c, d, m[0],  0xf4292244, 6);
+	STEP(I, d, a, b, c, m[7],  0x432aff97, 10);
+	STEP(I, c, d, a, b, m[14], 0xab9423a7, 15);
+	STEP(I, b, c, d, a, m[5],  0xfc93a039, 21);
+	STEP(I, a, b, c, d, m[12], 0x655b59c3, 6);
+	STEP(I, d, a, b, c, m[3],  0x8f0ccc92, 10);
+	STEP(I, c, d, a, b, m[10], 0xffeff47d, 15);
+	STEP(I, b, c, d, a, m[1],  0x85845dd1, 21);
+	STEP(I, a, b, c, d, m[8],  0x6fa87e4f, 6);
+	STEP(I, d, a, b, c, m[15], 0xfe2ce6e0, 10);
+	STEP(I, c, d, a, b, m[6],  0xa3014314, 15);
+	STEP(I, b, c, d, a, m[13], 0x4e0811a1, 21);
+	STEP(I, a, b, c, d, m[4],  0xf7537e82, 6);
+	STEP(I, d, a, b, c, m[11], 0xbd3af235, 10);
+	STEP(I, c, d, a, b, m[2],  0x2ad7d2bb, 15);
+	STEP(I, b, c, d, a, m[9],  0xeb86d391, 21);
+
+	ctx->state[0] += a;
+	ctx->state[1] += b;
+	ctx->state[2] += c;
+	ctx->state[3] += d;
+}
+
+void md5_init(CRYAL_MD5_CTX *ctx)
+{
+	ctx->datalen = 0;
+	ctx->bitlen = 0;
+	ctx->state[0] = 0x67452301;
+	ctx->state[1] = 0xefcdab89;
+	ctx->state[2] = 0x98badcfe;
+	ctx->state[3] = 0x10325476;
+}
+
+void md5_update(CRYAL_MD5_CTX *ctx, const BYTE data[], size_t len)
+{
+	size_t i = 0;
+
+	// Top up a partial block, then transform whole blocks straight from the
+	// input without copying them.
+	if (ctx->datalen > 0) {
+		while (i < len && ctx->datalen < 64)
+			ctx->data[ctx->datalen++] = data[i++];
+		if (ctx->datalen < 64)
+			return;
+		md5_transform(ctx, ctx->data);
+		ctx->bitlen += 512;
+		ctx->datalen = 0;
+	}
+	for ( ; i + 64 <= len; i += 64) {
+		md5_transform(ctx, data + i);
+		ctx->bitlen += 512;
+	}
+	while (i < len)
+		ctx->data[ctx->datalen++] = data[i++];
+}
+
+void md5_final(CRYAL_MD5_CTX *ctx, BYTE hash[])
+{
+	WORD i;
+
+	i = ctx->datalen;
+
+	// Pad whatever data is left in the buffer.
+	if (ctx->datalen < 56) {
+		ctx->data[i++] = 0x80;
+		while (i < 56)
+			ctx->data[i++] = 0x00;
+	}
+	else {
+		ctx->data[i++] = 0x80;
+		while (i < 64)
+			ctx->data[i++] = 0x00;
+		md5_transform(ctx, ctx->data);
+		memset(ctx->data, 0, 56);
+	}
+
+	// Append to the padding the total message's length in bits, least
+	// significant byte first, and transform.
+	ctx->bitlen += ctx->datalen * 8;
+	for (i = 0; i < 8; ++i)
+		ctx->data[56 + i] = ctx->bitlen >> (i * 8);
+	md5_transform(ctx, ctx->data);
+
+	// MD5 output is the state words in little endian byte order.
+	for (i = 0; i < 4; ++i) {
+		hash[i]      = (ctx->state[0] >> (i * 8)) & 0x000000ff;
+		hash[i + 4]  = (ctx->state[1] >> (i * 8)) & 0x000000ff;
+		hash[i + 8]  = (ctx->state[2] >> (i * 8)) & 0x000000ff;
+		hash[i + 12] = (ctx->state[3] >> (i * 8)) & 0x000000ff;
+	}
+}
@@ -97,17 +97,25 @@ void sha256_init(CRYAL_SHA256_CTX *ctx)
 
 void sha256_update(CRYAL_SHA256_CTX *ctx, const BYTE data[], size_t len)
 {
-	WORD i;
-
-	for (i = 0; i < len; ++i) {
-		ctx->data[ctx->datalen] = data[i];
-		ctx->datalen++;
-		if (ctx->datalen == 64) {
-			sha256_transform(ctx, ctx->data);
-			ctx->bitlen += 512;
-			ctx->datalen = 0;
-		}
+	size_t i = 0;
+
+	// Top up a partial block, then transform whole blocks straight from the
+	// input without copying them.
+	if (ctx->datalen > 0) {
+		while (i < len && ctx->datalen < 64)
+			ctx->data[ctx->datalen++] = data[i++];
+		if (ctx->datalen < 64)
+			return;
+		sha256_transform(ctx, ctx->data);
+		ctx->bitlen += 512;
+		ctx->datalen = 0;
+	}
+	for ( ; i + 64 <= len; i += 64) {
+		sha256_transform(ctx, data + i);
+		ctx->bitlen += 512;
 	}
+	while (i < len)
+		ctx->data[ctx->datalen++] = data[i++];
 }
 
 void sha256_final(CRYAL_SHA256_CTX *ctx, BYTE hash[])
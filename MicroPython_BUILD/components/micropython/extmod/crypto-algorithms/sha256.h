@@ -16,8 +16,11 @@
 #define SHA256_BLOCK_SIZE 32            // SHA256 outputs a 32 byte digest
 
 /**************************** DATA TYPES ****************************/
+#ifndef CRYAL_TYPES_DEFINED
+#define CRYAL_TYPES_DEFINED
 typedef unsigned char BYTE;             // 8-bit byte
 typedef unsigned int  WORD;             // 32-bit word, change to "long" for 16-bit machines
+#endif
 
 typedef struct {
 	BYTE data[64];
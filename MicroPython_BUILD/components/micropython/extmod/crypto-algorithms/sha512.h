@@ -0,0 +1,37 @@
+/*********************************************************************
+* Filename:   sha512.h
+* Copyright:
+* Disclaimer: This code is presented "as is" without any guarantees.
+* Details:    Defines the API for the corresponding SHA-512 implementation.
+*********************************************************************/
+
+#ifndef SHA512_H
+#define SHA512_H
+
+/*************************** HEADER FILES ***************************/
+#include <stddef.h>
+
+/****************************** MACROS ******************************/
+#define SHA512_BLOCK_SIZE 64            // SHA512 outputs a 64 byte digest
+
+/**************************** DATA TYPES ****************************/
+#ifndef CRYAL_TYPES_DEFINED
+#define CRYAL_TYPES_DEFINED
+typedef unsigned char BYTE;             // 8-bit byte
+typedef unsigned int  WORD;             // 32-bit word, change to "long" for 16-bit machines
+#endif
+typedef unsigned long long DWORD;       // 64-bit word
+
+typedef struct {
+	BYTE data[128];
+	WORD datalen;
+	DWORD bitlen;                   // messages are limited to 2^64 bits
+	DWORD state[8];
+} CRYAL_SHA512_CTX;
+
+/*********************** FUNCTION DECLARATIONS **********************/
+void sha512_init(CRYAL_SHA512_CTX *ctx);
+void sha512_update(CRYAL_SHA512_CTX *ctx, const BYTE data[], size_t len);
+void sha512_final(CRYAL_SHA512_CTX *ctx, BYTE hash[]);
+
+#endif   // SHA512_H
@@ -29,124 +29,491 @@
 #include <string.h>
 
 #include "py/runtime.h"
+#include "py/stream.h"
+#include "py/builtin.h"
 
 #if MICROPY_PY_UHASHLIB
 
-#include "crypto-algorithms/sha256.h"
+#include "extmod/moduhashlib.h"
+
+// Context sizes are rounded up so an HMAC's outer context, which follows the
+// inner one, stays aligned.
+#define HASH_CTX_SIZE(t) ((sizeof(t) + 7) & ~7)
+
+/******************************************************************************/
+// Hash algorithms
+
+#if MICROPY_PY_UHASHLIB_MBEDTLS
+
+// On the ESP32 mbedtls drives the SHA hardware.  A context which holds the
+// hardware keeps it until it's finished or freed, and cloning one reads its
+// state out into a software context, so digest() leaves it running.
+
+#if MICROPY_PY_UHASHLIB_MD5
+STATIC void md5_init_(void *ctx) {
+    mbedtls_md5_init(ctx);
+    mbedtls_md5_starts(ctx);
+}
+STATIC void md5_update_(void *ctx, const byte *data, size_t len) {
+    mbedtls_md5_update(ctx, data, len);
+}
+STATIC void md5_final_(void *ctx, byte *digest) {
+    mbedtls_md5_finish(ctx, digest);
+    mbedtls_md5_free(ctx);
+}
+STATIC void md5_copy_(void *dst, const void *src) {
+    mbedtls_md5_init(dst);
+    mbedtls_md5_clone(dst, src);
+}
+#endif
+
 #if MICROPY_PY_UHASHLIB_SHA1
-#include "mbedtls/sha1.h"
+STATIC void sha1_init_(void *ctx) {
+    mbedtls_sha1_init(ctx);
+    mbedtls_sha1_starts(ctx);
+}
+STATIC void sha1_update_(void *ctx, const byte *data, size_t len) {
+    mbedtls_sha1_update(ctx, data, len);
+}
+STATIC void sha1_final_(void *ctx, byte *digest) {
+    mbedtls_sha1_finish(ctx, digest);
+    mbedtls_sha1_free(ctx);
+}
+STATIC void sha1_copy_(void *dst, const void *src) {
+    mbedtls_sha1_init(dst);
+    mbedtls_sha1_clone(dst, src);
+}
+#endif
+
+STATIC void sha256_init_(void *ctx) {
+    mbedtls_sha256_init(ctx);
+    mbedtls_sha256_starts(ctx, 0);
+}
+STATIC void sha256_update_(void *ctx, const byte *data, size_t len) {
+    mbedtls_sha256_update(ctx, data, len);
+}
+STATIC void sha256_final_(void *ctx, byte *digest) {
+    mbedtls_sha256_finish(ctx, digest);
+    mbedtls_sha256_free(ctx);
+}
+STATIC void sha256_copy_(void *dst, const void *src) {
+    mbedtls_sha256_init(dst);
+    mbedtls_sha256_clone(dst, src);
+}
+
+#if MICROPY_PY_UHASHLIB_SHA512
+STATIC void sha512_init_(void *ctx) {
+    mbedtls_sha512_init(ctx);
+    mbedtls_sha512_starts(ctx, 0);
+}
+STATIC void sha512_update_(void *ctx, const byte *data, size_t len) {
+    mbedtls_sha512_update(ctx, data, len);
+}
+STATIC void sha512_final_(void *ctx, byte *digest) {
+    mbedtls_sha512_finish(ctx, digest);
+    mbedtls_sha512_free(ctx);
+}
+STATIC void sha512_copy_(void *dst, const void *src) {
+    mbedtls_sha512_init(dst);
+    mbedtls_sha512_clone(dst, src);
+}
+#endif
+
+#define MD5_CTX_T mbedtls_md5_context
+#define SHA256_CTX_T mbedtls_sha256_context
+#define SHA512_CTX_T mbedtls_sha512_context
+
+#else // MICROPY_PY_UHASHLIB_MBEDTLS
+
+// Software implementations; their contexts are plain structs.
+
+#if MICROPY_PY_UHASHLIB_MD5
+STATIC void md5_init_(void *ctx) {
+    md5_init(ctx);
+}
+STATIC void md5_update_(void *ctx, const byte *data, size_t len) {
+    md5_update(ctx, data, len);
+}
+STATIC void md5_final_(void *ctx, byte *digest) {
+    md5_final(ctx, digest);
+}
+STATIC void md5_copy_(void *dst, const void *src) {
+    memcpy(dst, src, sizeof(CRYAL_MD5_CTX));
+}
 #endif
 
+STATIC void sha256_init_(void *ctx) {
+    sha256_init(ctx);
+}
+STATIC void sha256_update_(void *ctx, const byte *data, size_t len) {
+    sha256_update(ctx, data, len);
+}
+STATIC void sha256_final_(void *ctx, byte *digest) {
+    sha256_final(ctx, digest);
+}
+STATIC void sha256_copy_(void *dst, const void *src) {
+    memcpy(dst, src, sizeof(CRYAL_SHA256_CTX));
+}
+
+#if MICROPY_PY_UHASHLIB_SHA512
+STATIC void sha512_init_(void *ctx) {
+    sha512_init(ctx);
+}
+STATIC void sha512_update_(void *ctx, const byte *data, size_t len) {
+    sha512_update(ctx, data, len);
+}
+STATIC void sha512_final_(void *ctx, byte *digest) {
+    sha512_final(ctx, digest);
+}
+STATIC void sha512_copy_(void *dst, const void *src) {
+    memcpy(dst, src, sizeof(CRYAL_SHA512_CTX));
+}
+#endif
+
+#if MICROPY_PY_UHASHLIB_SHA1
+STATIC void sha1_init_(void *ctx) {
+    mbedtls_sha1_init(ctx);
+    mbedtls_sha1_starts(ctx);
+}
+STATIC void sha1_update_(void *ctx, const byte *data, size_t len) {
+    mbedtls_sha1_update(ctx, data, len);
+}
+STATIC void sha1_final_(void *ctx, byte *digest) {
+    mbedtls_sha1_finish(ctx, digest);
+    mbedtls_sha1_free(ctx);
+}
+STATIC void sha1_copy_(void *dst, const void *src) {
+    memcpy(dst, src, sizeof(mbedtls_sha1_context));
+}
+#endif
+
+#define MD5_CTX_T CRYAL_MD5_CTX
+#define SHA256_CTX_T CRYAL_SHA256_CTX
+#define SHA512_CTX_T CRYAL_SHA512_CTX
+
+#endif // MICROPY_PY_UHASHLIB_MBEDTLS
+
+#if MICROPY_PY_UHASHLIB_MD5
+const mp_hash_desc_t mp_hash_md5 = {
+    MP_QSTR_md5, 16, 64, HASH_CTX_SIZE(MD5_CTX_T),
+    md5_init_, md5_update_, md5_final_, md5_copy_,
+};
+#endif
+
+#if MICROPY_PY_UHASHLIB_SHA1
+const mp_hash_desc_t mp_hash_sha1 = {
+    MP_QSTR_sha1, 20, 64, HASH_CTX_SIZE(mbedtls_sha1_context),
+    sha1_init_, sha1_update_, sha1_final_, sha1_copy_,
+};
+#endif
+
+const mp_hash_desc_t mp_hash_sha256 = {
+    MP_QSTR_sha256, 32, 64, HASH_CTX_SIZE(SHA256_CTX_T),
+    sha256_init_, sha256_update_, sha256_final_, sha256_copy_,
+};
+
+#if MICROPY_PY_UHASHLIB_SHA512
+const mp_hash_desc_t mp_hash_sha512 = {
+    MP_QSTR_sha512, 64, 128, HASH_CTX_SIZE(SHA512_CTX_T),
+    sha512_init_, sha512_update_, sha512_final_, sha512_copy_,
+};
+#endif
+
+void mp_hash_hex(char *hex, const byte *digest, size_t len) {
+    static const char hexdig[] = "0123456789abcdef";
+    for (size_t i = 0; i < len; i++) {
+        *hex++ = hexdig[digest[i] >> 4];
+        *hex++ = hexdig[digest[i] & 0xf];
+    }
+    *hex = '\0';
+}
+
+/******************************************************************************/
+// Hash and HMAC objects
+
 typedef struct _mp_obj_hash_t {
     mp_obj_base_t base;
-    char state[0];
+    const mp_hash_desc_t *desc;
+    bool hmac;
+    // The running context, followed for an HMAC by the keyed outer context
+    uint64_t state[0];
 } mp_obj_hash_t;
 
+STATIC const mp_hash_desc_t *hash_desc_from_type(const mp_obj_type_t *type);
+STATIC const mp_hash_desc_t *hash_desc_from_name(mp_obj_t name);
 STATIC mp_obj_t hash_update(mp_obj_t self_in, mp_obj_t arg);
 
+STATIC mp_obj_hash_t *hash_new(const mp_obj_type_t *type, const mp_hash_desc_t *desc, size_t n_ctx) {
+    #if MICROPY_PY_UHASHLIB_MBEDTLS
+    // mbedtls contexts may hold the hash hardware, which a finaliser gives back
+    mp_obj_hash_t *o = m_new_obj_var_with_finaliser(mp_obj_hash_t, uint64_t, n_ctx * desc->ctx_size / 8);
+    #else
+    mp_obj_hash_t *o = m_new_obj_var(mp_obj_hash_t, uint64_t, n_ctx * desc->ctx_size / 8);
+    #endif
+    o->base.type = type;
+    o->desc = desc;
+    o->hmac = (n_ctx == 2);
+    desc->init(o->state);
+    return o;
+}
+
 STATIC mp_obj_t hash_make_new(const mp_obj_type_t *type, size_t n_args, size_t n_kw, const mp_obj_t *args) {
     mp_arg_check_num(n_args, n_kw, 0, 1, false);
-    mp_obj_hash_t *o = m_new_obj_var(mp_obj_hash_t, char, sizeof(CRYAL_SHA256_CTX));
-    o->base.type = type;
-    sha256_init((CRYAL_SHA256_CTX*)o->state);
+    mp_obj_hash_t *o = hash_new(type, hash_desc_from_type(type), 1);
     if (n_args == 1) {
         hash_update(MP_OBJ_FROM_PTR(o), args[0]);
     }
     return MP_OBJ_FROM_PTR(o);
 }
 
-#if MICROPY_PY_UHASHLIB_SHA1
-STATIC mp_obj_t sha1_update(mp_obj_t self_in, mp_obj_t arg);
+// uhashlib.hmac(key, msg=None, digestmod=uhashlib.sha256)
+STATIC mp_obj_t hmac_make_new(const mp_obj_type_t *type, size_t n_args, size_t n_kw, const mp_obj_t *args) {
+    enum { ARG_key, ARG_msg, ARG_digestmod };
+    static const mp_arg_t allowed_args[] = {
+        { MP_QSTR_key, MP_ARG_REQUIRED | MP_ARG_OBJ, {.u_rom_obj = MP_ROM_PTR(&mp_const_none_obj)} },
+        { MP_QSTR_msg, MP_ARG_OBJ, {.u_rom_obj = MP_ROM_PTR(&mp_const_none_obj)} },
+        { MP_QSTR_digestmod, MP_ARG_OBJ, {.u_rom_obj = MP_ROM_PTR(&mp_const_none_obj)} },
+    };
+    mp_arg_val_t vals[MP_ARRAY_SIZE(allowed_args)];
+    mp_arg_parse_all_kw_array(n_args, n_kw, args, MP_ARRAY_SIZE(allowed_args), allowed_args, vals);
 
-STATIC mp_obj_t sha1_make_new(const mp_obj_type_t *type, size_t n_args, size_t n_kw, const mp_obj_t *args) {
-    mp_arg_check_num(n_args, n_kw, 0, 1, false);
-    mp_obj_hash_t *o = m_new_obj_var(mp_obj_hash_t, char, sizeof(mbedtls_sha1_context));
-    o->base.type = type;
-    mbedtls_sha1_init((mbedtls_sha1_context*)o->state);
-    mbedtls_sha1_starts((mbedtls_sha1_context*)o->state);
-    if (n_args == 1) {
-        sha1_update(MP_OBJ_FROM_PTR(o), args[0]);
+    // digestmod is one of the hash types, or the name of one
+    const mp_hash_desc_t *desc = &mp_hash_sha256;
+    mp_obj_t digestmod = vals[ARG_digestmod].u_obj;
+    if (MP_OBJ_IS_STR(digestmod)) {
+        desc = hash_desc_from_name(digestmod);
+    } else if (digestmod != mp_const_none) {
+        desc = hash_desc_from_type(MP_OBJ_TO_PTR(digestmod));
+    }
+    if (desc == NULL) {
+        mp_raise_ValueError("unsupported digestmod");
+    }
+
+    mp_buffer_info_t key;
+    mp_get_buffer_raise(vals[ARG_key].u_obj, &key, MP_BUFFER_READ);
+
+    mp_obj_hash_t *o = hash_new(type, desc, 2);
+    void *outer = (byte*)o->state + desc->ctx_size;
+
+    // Keys longer than a block are hashed first; the inner and outer
+    // contexts then start with the padded key xor'ed with ipad and opad.
+    byte pad[128];
+    memset(pad, 0, desc->block_size);
+    if (key.len > desc->block_size) {
+        desc->update(o->state, key.buf, key.len);
+        desc->final(o->state, pad);
+        desc->init(o->state);
+    } else {
+        memcpy(pad, key.buf, key.len);
+    }
+    for (size_t i = 0; i < desc->block_size; i++) {
+        pad[i] ^= 0x36;
+    }
+    desc->update(o->state, pad, desc->block_size);
+    for (size_t i = 0; i < desc->block_size; i++) {
+        pad[i] ^= 0x36 ^ 0x5c;
+    }
+    desc->init(outer);
+    desc->update(outer, pad, desc->block_size);
+
+    if (vals[ARG_msg].u_obj != mp_const_none) {
+        hash_update(MP_OBJ_FROM_PTR(o), vals[ARG_msg].u_obj);
     }
     return MP_OBJ_FROM_PTR(o);
 }
-#endif
 
 STATIC mp_obj_t hash_update(mp_obj_t self_in, mp_obj_t arg) {
     mp_obj_hash_t *self = MP_OBJ_TO_PTR(self_in);
     mp_buffer_info_t bufinfo;
     mp_get_buffer_raise(arg, &bufinfo, MP_BUFFER_READ);
-    sha256_update((CRYAL_SHA256_CTX*)self->state, bufinfo.buf, bufinfo.len);
+    self->desc->update(self->state, bufinfo.buf, bufinfo.len);
     return mp_const_none;
 }
-MP_DEFINE_CONST_FUN_OBJ_2(hash_update_obj, hash_update);
+STATIC MP_DEFINE_CONST_FUN_OBJ_2(hash_update_obj, hash_update);
 
-#if MICROPY_PY_UHASHLIB_SHA1
-STATIC mp_obj_t sha1_update(mp_obj_t self_in, mp_obj_t arg) {
-    mp_obj_hash_t *self = MP_OBJ_TO_PTR(self_in);
-    mp_buffer_info_t bufinfo;
-    mp_get_buffer_raise(arg, &bufinfo, MP_BUFFER_READ);
-    mbedtls_sha1_update((mbedtls_sha1_context*)self->state, bufinfo.buf, bufinfo.len);
-    return mp_const_none;
+// Finish a snapshot of the context, so the hash can carry on being updated
+// and digest() can be called more than once.
+STATIC void hash_get_digest(mp_obj_hash_t *self, byte *digest) {
+    const mp_hash_desc_t *desc = self->desc;
+    mp_hash_ctx_t ctx;
+    desc->copy(&ctx, self->state);
+    desc->final(&ctx, digest);
+    if (self->hmac) {
+        desc->copy(&ctx, (byte*)self->state + desc->ctx_size);
+        desc->update(&ctx, digest, desc->digest_size);
+        desc->final(&ctx, digest);
+    }
 }
-MP_DEFINE_CONST_FUN_OBJ_2(sha1_update_obj, sha1_update);
-#endif
 
 STATIC mp_obj_t hash_digest(mp_obj_t self_in) {
     mp_obj_hash_t *self = MP_OBJ_TO_PTR(self_in);
     vstr_t vstr;
-    vstr_init_len(&vstr, SHA256_BLOCK_SIZE);
-    sha256_final((CRYAL_SHA256_CTX*)self->state, (byte*)vstr.buf);
+    vstr_init_len(&vstr, self->desc->digest_size);
+    hash_get_digest(self, (byte*)vstr.buf);
     return mp_obj_new_str_from_vstr(&mp_type_bytes, &vstr);
 }
-MP_DEFINE_CONST_FUN_OBJ_1(hash_digest_obj, hash_digest);
+STATIC MP_DEFINE_CONST_FUN_OBJ_1(hash_digest_obj, hash_digest);
 
-#if MICROPY_PY_UHASHLIB_SHA1
-STATIC mp_obj_t sha1_digest(mp_obj_t self_in) {
+STATIC mp_obj_t hash_hexdigest(mp_obj_t self_in) {
     mp_obj_hash_t *self = MP_OBJ_TO_PTR(self_in);
+    byte digest[64];
     vstr_t vstr;
-    vstr_init_len(&vstr, 20);
-    mbedtls_sha1_finish((mbedtls_sha1_context*)self->state, (byte*)vstr.buf);
-    mbedtls_sha1_free((mbedtls_sha1_context*)self->state);
-    return mp_obj_new_str_from_vstr(&mp_type_bytes, &vstr);
+    vstr_init_len(&vstr, self->desc->digest_size * 2);
+    hash_get_digest(self, digest);
+    mp_hash_hex(vstr.buf, digest, self->desc->digest_size);
+    return mp_obj_new_str_from_vstr(&mp_type_str, &vstr);
 }
-MP_DEFINE_CONST_FUN_OBJ_1(sha1_digest_obj, sha1_digest);
+STATIC MP_DEFINE_CONST_FUN_OBJ_1(hash_hexdigest_obj, hash_hexdigest);
+
+// hash.hash_stream(stream, chunk=1024, size=-1)
+// Feed the hash from a stream until EOF, or until size bytes have been read,
+// reading into one buffer which is never seen from Python.
+STATIC mp_obj_t hash_hash_stream(size_t n_args, const mp_obj_t *args) {
+    mp_obj_hash_t *self = MP_OBJ_TO_PTR(args[0]);
+    const mp_stream_p_t *stream_p = mp_get_stream_raise(args[1], MP_STREAM_OP_READ);
+    mp_int_t chunk = 1024;
+    if (n_args > 2) {
+        chunk = mp_obj_get_int(args[2]);
+        if (chunk <= 0) {
+            mp_raise_ValueError(NULL);
+        }
+    }
+    mp_int_t remaining = -1;
+    if (n_args > 3) {
+        remaining = mp_obj_get_int(args[3]);
+    }
+
+    byte *buf = m_new(byte, chunk);
+    mp_uint_t total = 0;
+    while (remaining != 0) {
+        mp_uint_t len = chunk;
+        if (remaining > 0 && remaining < chunk) {
+            len = remaining;
+        }
+        int error;
+        mp_uint_t n = stream_p->read(args[1], buf, len, &error);
+        if (n == MP_STREAM_ERROR) {
+            m_del(byte, buf, chunk);
+            mp_raise_OSError(error);
+        }
+        if (n == 0) {
+            break;
+        }
+        self->desc->update(self->state, buf, n);
+        total += n;
+        if (remaining > 0) {
+            remaining -= n;
+        }
+    }
+    m_del(byte, buf, chunk);
+    return mp_obj_new_int_from_uint(total);
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_VAR_BETWEEN(hash_hash_stream_obj, 2, 4, hash_hash_stream);
+
+#if MICROPY_PY_UHASHLIB_MBEDTLS
+STATIC mp_obj_t hash_del(mp_obj_t self_in) {
+    mp_obj_hash_t *self = MP_OBJ_TO_PTR(self_in);
+    // finishing is how a context is released through the descriptor, and
+    // it gives back the hardware
+    byte digest[64];
+    self->desc->final(self->state, digest);
+    if (self->hmac) {
+        self->desc->final((byte*)self->state + self->desc->ctx_size, digest);
+    }
+    return mp_const_none;
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_1(hash_del_obj, hash_del);
 #endif
 
 STATIC const mp_rom_map_elem_t hash_locals_dict_table[] = {
     { MP_ROM_QSTR(MP_QSTR_update), MP_ROM_PTR(&hash_update_obj) },
     { MP_ROM_QSTR(MP_QSTR_digest), MP_ROM_PTR(&hash_digest_obj) },
+    { MP_ROM_QSTR(MP_QSTR_hexdigest), MP_ROM_PTR(&hash_hexdigest_obj) },
+    { MP_ROM_QSTR(MP_QSTR_hash_stream), MP_ROM_PTR(&hash_hash_stream_obj) },
+    #if MICROPY_PY_UHASHLIB_MBEDTLS
+    { MP_ROM_QSTR(MP_QSTR___del__), MP_ROM_PTR(&hash_del_obj) },
+    #endif
 };
 
 STATIC MP_DEFINE_CONST_DICT(hash_locals_dict, hash_locals_dict_table);
 
-STATIC const mp_obj_type_t sha256_type = {
+#define HASH_TYPE(type_name, qst) \
+    STATIC const mp_obj_type_t type_name = { \
+        { &mp_type_type }, \
+        .name = qst, \
+        .make_new = hash_make_new, \
+        .locals_dict = (void*)&hash_locals_dict, \
+    }
+
+#if MICROPY_PY_UHASHLIB_MD5
+HASH_TYPE(md5_type, MP_QSTR_md5);
+#endif
+#if MICROPY_PY_UHASHLIB_SHA1
+HASH_TYPE(sha1_type, MP_QSTR_sha1);
+#endif
+HASH_TYPE(sha256_type, MP_QSTR_sha256);
+#if MICROPY_PY_UHASHLIB_SHA512
+HASH_TYPE(sha512_type, MP_QSTR_sha512);
+#endif
+
+STATIC const mp_obj_type_t hmac_type = {
     { &mp_type_type },
-    .name = MP_QSTR_sha256,
-    .make_new = hash_make_new,
+    .name = MP_QSTR_hmac,
+    .make_new = hmac_make_new,
     .locals_dict = (void*)&hash_locals_dict,
 };
 
-#if MICROPY_PY_UHASHLIB_SHA1
-STATIC const mp_rom_map_elem_t sha1_locals_dict_table[] = {
-    { MP_ROM_QSTR(MP_QSTR_update), MP_ROM_PTR(&sha1_update_obj) },
-    { MP_ROM_QSTR(MP_QSTR_digest), MP_ROM_PTR(&sha1_digest_obj) },
+STATIC const struct {
+    const mp_obj_type_t *type;
+    const mp_hash_desc_t *desc;
+} hash_types[] = {
+    #if MICROPY_PY_UHASHLIB_MD5
+    { &md5_type, &mp_hash_md5 },
+    #endif
+    #if MICROPY_PY_UHASHLIB_SHA1
+    { &sha1_type, &mp_hash_sha1 },
+    #endif
+    { &sha256_type, &mp_hash_sha256 },
+    #if MICROPY_PY_UHASHLIB_SHA512
+    { &sha512_type, &mp_hash_sha512 },
+    #endif
 };
-STATIC MP_DEFINE_CONST_DICT(sha1_locals_dict, sha1_locals_dict_table);
 
-STATIC const mp_obj_type_t sha1_type = {
-    { &mp_type_type },
-    .name = MP_QSTR_sha1,
-    .make_new = sha1_make_new,
-    .locals_dict = (void*)&sha1_locals_dict,
-};
-#endif
+STATIC const mp_hash_desc_t *hash_desc_from_type(const mp_obj_type_t *type) {
+    for (size_t i = 0; i < MP_ARRAY_SIZE(hash_types); i++) {
+        if (hash_types[i].type == type) {
+            return hash_types[i].desc;
+        }
+    }
+    return NULL;
+}
+
+STATIC const mp_hash_desc_t *hash_desc_from_name(mp_obj_t name) {
+    size_t len;
+    const char *str = mp_obj_str_get_data(name, &len);
+    for (size_t i = 0; i < MP_ARRAY_SIZE(hash_types); i++) {
+        size_t n;
+        const byte *s = qstr_data(hash_types[i].desc->name, &n);
+        if (n == len && memcmp(s, str, len) == 0) {
+            return hash_types[i].desc;
+        }
+    }
+    return NULL;
+}
 
 STATIC const mp_rom_map_elem_t mp_module_hashlib_globals_table[] = {
     { MP_ROM_QSTR(MP_QSTR___name__), MP_ROM_QSTR(MP_QSTR_uhashlib) },
-    { MP_ROM_QSTR(MP_QSTR_sha256), MP_ROM_PTR(&sha256_type) },
+    #if MICROPY_PY_UHASHLIB_MD5
+    { MP_ROM_QSTR(MP_QSTR_md5), MP_ROM_PTR(&md5_type) },
+    #endif
     #if MICROPY_PY_UHASHLIB_SHA1
     { MP_ROM_QSTR(MP_QSTR_sha1), MP_ROM_PTR(&sha1_type) },
     #endif
+    { MP_ROM_QSTR(MP_QSTR_sha256), MP_ROM_PTR(&sha256_type) },
+    #if MICROPY_PY_UHASHLIB_SHA512
+    { MP_ROM_QSTR(MP_QSTR_sha512), MP_ROM_PTR(&sha512_type) },
+    #endif
+    { MP_ROM_QSTR(MP_QSTR_hmac), MP_ROM_PTR(&hmac_type) },
 };
 
 STATIC MP_DEFINE_CONST_DICT(mp_module_hashlib_globals, mp_module_hashlib_globals_table);
@@ -156,6 +523,14 @@ const mp_obj_module_t mp_module_uhashlib = {
     .globals = (mp_obj_dict_t*)&mp_module_hashlib_globals,
 };
 
+#if !MICROPY_PY_UHASHLIB_MBEDTLS
+#if MICROPY_PY_UHASHLIB_MD5
+#include "crypto-algorithms/md5.c"
+#endif
 #include "crypto-algorithms/sha256.c"
+#if MICROPY_PY_UHASHLIB_SHA512
+#include "crypto-algorithms/sha512.c"
+#endif
+#endif
 
 #endif //MICROPY_PY_UHASHLIB
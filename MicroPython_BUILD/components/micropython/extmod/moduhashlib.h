@@ -0,0 +1,97 @@
+/*
+ * This file is part of the MicroPython project, http://micropython.org/
+ *
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2018 LoBo (https://github.com/loboris)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#ifndef MICROPY_INCLUDED_EXTMOD_MODUHASHLIB_H
+#define MICROPY_INCLUDED_EXTMOD_MODUHASHLIB_H
+
+#include "py/obj.h"
+
+#if MICROPY_PY_UHASHLIB
+
+#if MICROPY_PY_UHASHLIB_MBEDTLS
+#include "mbedtls/md5.h"
+#include "mbedtls/sha1.h"
+#include "mbedtls/sha256.h"
+#include "mbedtls/sha512.h"
+#else
+#include "crypto-algorithms/md5.h"
+#include "crypto-algorithms/sha256.h"
+#include "crypto-algorithms/sha512.h"
+#if MICROPY_PY_UHASHLIB_SHA1
+#include "mbedtls/sha1.h"
+#endif
+#endif
+
+// Large enough for the context of any of the algorithms, so one can live on
+// the C stack.
+typedef union _mp_hash_ctx_t {
+    #if MICROPY_PY_UHASHLIB_MBEDTLS
+    mbedtls_md5_context md5;
+    mbedtls_sha1_context sha1;
+    mbedtls_sha256_context sha256;
+    mbedtls_sha512_context sha512;
+    #else
+    CRYAL_MD5_CTX md5;
+    CRYAL_SHA256_CTX sha256;
+    CRYAL_SHA512_CTX sha512;
+    #if MICROPY_PY_UHASHLIB_SHA1
+    mbedtls_sha1_context sha1;
+    #endif
+    #endif
+    uint64_t align;
+} mp_hash_ctx_t;
+
+// An incremental hash algorithm, usable from C as well as through the
+// uhashlib objects.  final() releases the context; copy() takes a snapshot
+// of a live context which must itself be finalised.
+typedef struct _mp_hash_desc_t {
+    qstr name;
+    uint8_t digest_size;
+    uint8_t block_size;
+    uint16_t ctx_size;
+    void (*init)(void *ctx);
+    void (*update)(void *ctx, const byte *data, size_t len);
+    void (*final)(void *ctx, byte *digest);
+    void (*copy)(void *dst, const void *src);
+} mp_hash_desc_t;
+
+#if MICROPY_PY_UHASHLIB_MD5
+extern const mp_hash_desc_t mp_hash_md5;
+#endif
+#if MICROPY_PY_UHASHLIB_SHA1
+extern const mp_hash_desc_t mp_hash_sha1;
+#endif
+extern const mp_hash_desc_t mp_hash_sha256;
+#if MICROPY_PY_UHASHLIB_SHA512
+extern const mp_hash_desc_t mp_hash_sha512;
+#endif
+
+// Write the lower case hex form of digest, and a terminating NUL, to hex,
+// which must have room for 2 * len + 1 chars.
+void mp_hash_hex(char *hex, const byte *digest, size_t len);
+
+#endif // MICROPY_PY_UHASHLIB
+
+#endif // MICROPY_INCLUDED_EXTMOD_MODUHASHLIB_H
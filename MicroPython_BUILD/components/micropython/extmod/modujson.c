@@ -25,35 +25,213 @@
  */
 
 #include <stdio.h>
+#include <string.h>
 
+#include "py/mperrno.h"
 #include "py/objlist.h"
-#include "py/objstringio.h"
+#include "py/objstr.h"
 #include "py/parsenum.h"
 #include "py/runtime.h"
+#include "py/stackctrl.h"
 #include "py/stream.h"
 
 #if MICROPY_PY_UJSON
 
-STATIC mp_obj_t mod_ujson_dump(mp_obj_t obj, mp_obj_t stream) {
-    if (!MP_OBJ_IS_OBJ(stream)) {
+// The functions below implement the JSON encoder.
+//
+// Output is assembled in a block of MICROPY_PY_UJSON_BUF_SIZE bytes on the
+// C stack, which dump writes to the stream each time it fills up.  dumps
+// returns the block directly when the whole output fits in it; otherwise it
+// only counts the bytes of the rest of the output, then allocates the str
+// once at its exact size and encodes the object a second time into it.
+//
+// dict, list, tuple, str, int, float, bool and None are encoded here; other
+// objects are printed by their type with PRINT_JSON, as before.
+
+typedef struct _ujson_enc_t {
+    mp_print_t print; // appends to buf, for the objects printed by their type
+    mp_obj_t stream_obj; // MP_OBJ_NULL when encoding for dumps
+    vstr_t *vstr; // output of the second pass of dumps, NULL in the first one
+    size_t len; // bytes in buf
+    size_t flushed; // bytes written out (or counted) before those in buf
+    const char *item_sep;
+    const char *key_sep;
+    size_t item_sep_len;
+    size_t key_sep_len;
+    byte buf[MICROPY_PY_UJSON_BUF_SIZE];
+} ujson_enc_t;
+
+STATIC void ujson_enc_flush(ujson_enc_t *enc) {
+    if (enc->stream_obj != MP_OBJ_NULL) {
+        int errcode;
+        mp_uint_t out_sz = mp_stream_rw(enc->stream_obj, enc->buf, enc->len, &errcode, MP_STREAM_RW_WRITE);
+        if (errcode != 0) {
+            mp_raise_OSError(errcode);
+        }
+        if (out_sz != enc->len) {
+            mp_raise_OSError(MP_EIO);
+        }
+    } else if (enc->vstr != NULL) {
+        vstr_add_strn(enc->vstr, (const char*)enc->buf, enc->len);
+    }
+    enc->flushed += enc->len;
+    enc->len = 0;
+}
+
+STATIC void ujson_enc_write(ujson_enc_t *enc, const char *str, size_t len) {
+    while (len > MICROPY_PY_UJSON_BUF_SIZE - enc->len) {
+        size_t n = MICROPY_PY_UJSON_BUF_SIZE - enc->len;
+        memcpy(enc->buf + enc->len, str, n);
+        enc->len += n;
+        str += n;
+        len -= n;
+        ujson_enc_flush(enc);
+    }
+    memcpy(enc->buf + enc->len, str, len);
+    enc->len += len;
+}
+
+STATIC void ujson_enc_print_strn(void *data, const char *str, size_t len) {
+    ujson_enc_write(data, str, len);
+}
+
+STATIC void ujson_enc_init(ujson_enc_t *enc, mp_obj_t stream_obj, mp_obj_t separators) {
+    enc->print.data = enc;
+    enc->print.print_strn = ujson_enc_print_strn;
+    enc->stream_obj = stream_obj;
+    enc->vstr = NULL;
+    enc->len = 0;
+    enc->flushed = 0;
+    if (separators == mp_const_none) {
+        enc->item_sep = ", ";
+        enc->item_sep_len = 2;
+        enc->key_sep = ": ";
+        enc->key_sep_len = 2;
+    } else {
+        mp_obj_t *items;
+        mp_obj_get_array_fixed_n(separators, 2, &items);
+        enc->item_sep = mp_obj_str_get_data(items[0], &enc->item_sep_len);
+        enc->key_sep = mp_obj_str_get_data(items[1], &enc->key_sep_len);
+    }
+}
+
+STATIC void ujson_enc_obj(ujson_enc_t *enc, mp_obj_t obj) {
+    MP_STACK_CHECK();
+    if (MP_OBJ_IS_SMALL_INT(obj)) {
+        // format the digits from the end of a local buffer
+        char buf[sizeof(mp_int_t) * 3 + 2];
+        char *b = buf + sizeof(buf);
+        mp_int_t val = MP_OBJ_SMALL_INT_VALUE(obj);
+        mp_uint_t uval = val < 0 ? -(mp_uint_t)val : (mp_uint_t)val;
+        do {
+            *--b = '0' + uval % 10;
+            uval /= 10;
+        } while (uval != 0);
+        if (val < 0) {
+            *--b = '-';
+        }
+        ujson_enc_write(enc, b, buf + sizeof(buf) - b);
+    } else if (MP_OBJ_IS_STR_OR_BYTES(obj)) {
+        GET_STR_DATA_LEN(obj, str_data, str_len);
+        mp_str_print_json(&enc->print, str_data, str_len);
+    } else if (obj == mp_const_none) {
+        ujson_enc_write(enc, "null", 4);
+    } else if (obj == mp_const_true) {
+        ujson_enc_write(enc, "true", 4);
+    } else if (obj == mp_const_false) {
+        ujson_enc_write(enc, "false", 5);
+    } else if (MP_OBJ_IS_TYPE(obj, &mp_type_list) || MP_OBJ_IS_TYPE(obj, &mp_type_tuple)) {
+        size_t len;
+        mp_obj_t *items;
+        mp_obj_get_array(obj, &len, &items);
+        ujson_enc_write(enc, "[", 1);
+        for (size_t i = 0; i < len; i++) {
+            if (i > 0) {
+                ujson_enc_write(enc, enc->item_sep, enc->item_sep_len);
+            }
+            ujson_enc_obj(enc, items[i]);
+        }
+        ujson_enc_write(enc, "]", 1);
+    } else if (MP_OBJ_IS_TYPE(obj, &mp_type_dict)
+        #if MICROPY_PY_COLLECTIONS_ORDEREDDICT
+        || MP_OBJ_IS_TYPE(obj, &mp_type_ordereddict)
+        #endif
+        ) {
+        mp_map_t *map = mp_obj_dict_get_map(obj);
+        bool first = true;
+        ujson_enc_write(enc, "{", 1);
+        for (size_t i = 0; i < map->alloc; i++) {
+            if (MP_MAP_SLOT_IS_FILLED(map, i)) {
+                if (!first) {
+                    ujson_enc_write(enc, enc->item_sep, enc->item_sep_len);
+                }
+                first = false;
+                ujson_enc_obj(enc, map->table[i].key);
+                ujson_enc_write(enc, enc->key_sep, enc->key_sep_len);
+                ujson_enc_obj(enc, map->table[i].value);
+            }
+        }
+        ujson_enc_write(enc, "}", 1);
+    } else {
+        // floats, big ints and anything else print themselves
+        mp_obj_print_helper(&enc->print, obj, PRINT_JSON);
+    }
+}
+
+STATIC mp_obj_t mod_ujson_dump(size_t n_args, const mp_obj_t *pos_args, mp_map_t *kw_args) {
+    enum { ARG_obj, ARG_stream, ARG_separators };
+    static const mp_arg_t allowed_args[] = {
+        { MP_QSTR_obj, MP_ARG_REQUIRED | MP_ARG_OBJ, {.u_obj = MP_OBJ_NULL} },
+        { MP_QSTR_stream, MP_ARG_REQUIRED | MP_ARG_OBJ, {.u_obj = MP_OBJ_NULL} },
+        { MP_QSTR_separators, MP_ARG_KW_ONLY | MP_ARG_OBJ, {.u_obj = mp_const_none} },
+    };
+    mp_arg_val_t args[MP_ARRAY_SIZE(allowed_args)];
+    mp_arg_parse_all(n_args, pos_args, kw_args, MP_ARRAY_SIZE(allowed_args), allowed_args, args);
+
+    if (!MP_OBJ_IS_OBJ(args[ARG_stream].u_obj)) {
         mp_raise_TypeError(NULL);
     }
-    mp_print_t print = {MP_OBJ_TO_PTR(stream), mp_stream_write_adaptor};
-    mp_obj_print_helper(&print, obj, PRINT_JSON);
+    mp_get_stream_raise(args[ARG_stream].u_obj, MP_STREAM_OP_WRITE);
+    ujson_enc_t enc;
+    ujson_enc_init(&enc, args[ARG_stream].u_obj, args[ARG_separators].u_obj);
+    ujson_enc_obj(&enc, args[ARG_obj].u_obj);
+    if (enc.len != 0) {
+        ujson_enc_flush(&enc);
+    }
     return mp_const_none;
 }
-STATIC MP_DEFINE_CONST_FUN_OBJ_2(mod_ujson_dump_obj, mod_ujson_dump);
+STATIC MP_DEFINE_CONST_FUN_OBJ_KW(mod_ujson_dump_obj, 2, mod_ujson_dump);
 
-STATIC mp_obj_t mod_ujson_dumps(mp_obj_t obj) {
+STATIC mp_obj_t mod_ujson_dumps(size_t n_args, const mp_obj_t *pos_args, mp_map_t *kw_args) {
+    enum { ARG_obj, ARG_separators };
+    static const mp_arg_t allowed_args[] = {
+        { MP_QSTR_obj, MP_ARG_REQUIRED | MP_ARG_OBJ, {.u_obj = MP_OBJ_NULL} },
+        { MP_QSTR_separators, MP_ARG_KW_ONLY | MP_ARG_OBJ, {.u_obj = mp_const_none} },
+    };
+    mp_arg_val_t args[MP_ARRAY_SIZE(allowed_args)];
+    mp_arg_parse_all(n_args, pos_args, kw_args, MP_ARRAY_SIZE(allowed_args), allowed_args, args);
+
+    ujson_enc_t enc;
+    ujson_enc_init(&enc, MP_OBJ_NULL, args[ARG_separators].u_obj);
+    ujson_enc_obj(&enc, args[ARG_obj].u_obj);
+    if (enc.flushed == 0) {
+        return mp_obj_new_str_copy(&mp_type_str, enc.buf, enc.len);
+    }
+
+    // the output didn't fit in the buffer, so encode it again into a vstr
+    // that was allocated at its final size
     vstr_t vstr;
-    mp_print_t print;
-    vstr_init_print(&vstr, 8, &print);
-    mp_obj_print_helper(&print, obj, PRINT_JSON);
+    vstr_init(&vstr, enc.flushed + enc.len + 1);
+    enc.vstr = &vstr;
+    enc.len = 0;
+    enc.flushed = 0;
+    ujson_enc_obj(&enc, args[ARG_obj].u_obj);
+    ujson_enc_flush(&enc);
     return mp_obj_new_str_from_vstr(&mp_type_str, &vstr);
 }
-STATIC MP_DEFINE_CONST_FUN_OBJ_1(mod_ujson_dumps_obj, mod_ujson_dumps);
+STATIC MP_DEFINE_CONST_FUN_OBJ_KW(mod_ujson_dumps_obj, 1, mod_ujson_dumps);
 
-// The function below implements a simple non-recursive JSON parser.
+// The functions below implement a simple non-recursive JSON parser.
 //
 // The JSON specification is at http://www.ietf.org/rfc/rfc4627.txt
 // The parser here will parse any valid JSON and return the correct
@@ -65,51 +243,112 @@ STATIC MP_DEFINE_CONST_FUN_OBJ_1(mod_ujson_dumps_obj, mod_ujson_dumps);
 // Most of the work is parsing the primitives (null, false, true, numbers,
 // strings).  It does 1 pass over the input stream.  It tries to be fast and
 // small in code size, while not using more RAM than necessary.
+//
+// The stream is read in blocks of MICROPY_PY_UJSON_BUF_SIZE bytes (loads
+// parses the string in place), and strings and numbers that lie within one
+// block are created straight from it rather than copied to a vstr first.
 
 typedef struct _ujson_stream_t {
     mp_obj_t stream_obj;
     mp_uint_t (*read)(mp_obj_t obj, void *buf, mp_uint_t size, int *errcode);
-    int errcode;
-    byte cur;
+    const byte *pos; // current char
+    const byte *end; // end of the chars read so far
+    byte *buf;
 } ujson_stream_t;
 
 #define S_EOF (0) // null is not allowed in json stream so is ok as EOF marker
-#define S_END(s) ((s).cur == S_EOF)
-#define S_CUR(s) ((s).cur)
-#define S_NEXT(s) (ujson_stream_next(&(s)))
-
-STATIC byte ujson_stream_next(ujson_stream_t *s) {
-    mp_uint_t ret = s->read(s->stream_obj, &s->cur, 1, &s->errcode);
-    if (s->errcode != 0) {
-        mp_raise_OSError(s->errcode);
-    }
-    if (ret == 0) {
-        s->cur = S_EOF;
+#define S_END(s) (S_CUR(s) == S_EOF)
+#define S_CUR(s) (*(s).pos)
+#define S_NEXT(s) (++(s).pos < (s).end ? *(s).pos : ujson_stream_fill(&(s)))
+
+// token returned by ujson_next_token for a primitive value
+#define UJSON_TOK_VALUE ('v')
+
+STATIC const byte ujson_eof = S_EOF;
+
+// Read the next block of the stream, or set the current char to S_EOF.
+STATIC byte ujson_stream_fill(ujson_stream_t *s) {
+    if (s->read != NULL) {
+        int errcode;
+        mp_uint_t ret = s->read(s->stream_obj, s->buf, MICROPY_PY_UJSON_BUF_SIZE, &errcode);
+        if (ret == MP_STREAM_ERROR) {
+            mp_raise_OSError(errcode);
+        }
+        if (ret != 0) {
+            s->pos = s->buf;
+            s->end = s->buf + ret;
+            return *s->pos;
+        }
     }
-    return s->cur;
+    s->pos = &ujson_eof;
+    s->end = &ujson_eof + 1;
+    return S_EOF;
 }
 
-STATIC mp_obj_t mod_ujson_load(mp_obj_t stream_obj) {
+STATIC void ujson_stream_init(ujson_stream_t *s, mp_obj_t stream_obj, byte *buf) {
     const mp_stream_p_t *stream_p = mp_get_stream_raise(stream_obj, MP_STREAM_OP_READ);
-    ujson_stream_t s = {stream_obj, stream_p->read, 0, 0};
-    vstr_t vstr;
-    vstr_init(&vstr, 8);
-    mp_obj_list_t stack; // we use a list as a simple stack for nested JSON
-    stack.len = 0;
-    stack.items = NULL;
-    mp_obj_t stack_top = MP_OBJ_NULL;
-    mp_obj_type_t *stack_top_type = NULL;
-    mp_obj_t stack_key = MP_OBJ_NULL;
-    S_NEXT(s);
-    for (;;) {
-        cont:
-        if (S_END(s)) {
-            break;
+    s->stream_obj = stream_obj;
+    s->read = stream_p->read;
+    s->buf = buf;
+    ujson_stream_fill(s);
+}
+
+STATIC NORETURN void ujson_syntax_error(void) {
+    mp_raise_ValueError("syntax error in JSON");
+}
+
+// Consume the rest of the literal whose first char is the current one.
+STATIC void ujson_match(ujson_stream_t *s, const char *rest) {
+    for (; *rest != '\0'; ++rest) {
+        if (S_NEXT(*s) != (byte)*rest) {
+            ujson_syntax_error();
         }
-        mp_obj_t next = MP_OBJ_NULL;
-        bool enter = false;
-        byte cur = S_CUR(s);
-        S_NEXT(s);
+    }
+    S_NEXT(*s);
+}
+
+STATIC mp_obj_t ujson_new_num(const char *data, size_t len, bool flt) {
+    if (!flt && len < 10) {
+        // at most 9 digits always fit in a small int
+        const char *str = data;
+        const char *top = data + len;
+        bool neg = *str == '-';
+        if (neg) {
+            ++str;
+        }
+        if (str < top) {
+            mp_int_t val = 0;
+            for (; str < top && unichar_isdigit(*str); ++str) {
+                val = val * 10 + (*str - '0');
+            }
+            if (str == top) {
+                return MP_OBJ_NEW_SMALL_INT(neg ? -val : val);
+            }
+        }
+    }
+    if (flt) {
+        return mp_parse_num_decimal(data, len, false, false, NULL);
+    } else {
+        return mp_parse_num_integer(data, len, 10, NULL);
+    }
+}
+
+STATIC inline bool ujson_is_num_char(byte c, bool *flt) {
+    if (unichar_isdigit(c) || c == '-') {
+        return true;
+    }
+    if (c == '.' || c == 'E' || c == 'e' || c == '+') {
+        *flt = true;
+        return true;
+    }
+    return false;
+}
+
+// Skip whitespace, commas and colons and return the next token: one of
+// [ ] { }, UJSON_TOK_VALUE with the primitive in *value, or S_EOF.
+STATIC byte ujson_next_token(ujson_stream_t *s, vstr_t *vstr, mp_obj_t *value) {
+    for (;;) {
+        byte cur = S_CUR(*s);
         switch (cur) {
             case ',':
             case ':':
@@ -117,90 +356,136 @@ STATIC mp_obj_t mod_ujson_load(mp_obj_t stream_obj) {
             case '\t':
             case '\n':
             case '\r':
-                goto cont;
-            case 'n':
-                if (S_CUR(s) == 'u' && S_NEXT(s) == 'l' && S_NEXT(s) == 'l') {
-                    S_NEXT(s);
-                    next = mp_const_none;
-                } else {
-                    goto fail;
+                S_NEXT(*s);
+                continue;
+            case S_EOF:
+            case '[':
+            case ']':
+            case '{':
+            case '}':
+                if (cur != S_EOF) {
+                    S_NEXT(*s);
                 }
-                break;
+                return cur;
+            case 'n':
+                ujson_match(s, "ull");
+                *value = mp_const_none;
+                return UJSON_TOK_VALUE;
             case 'f':
-                if (S_CUR(s) == 'a' && S_NEXT(s) == 'l' && S_NEXT(s) == 's' && S_NEXT(s) == 'e') {
-                    S_NEXT(s);
-                    next = mp_const_false;
-                } else {
-                    goto fail;
-                }
-                break;
+                ujson_match(s, "alse");
+                *value = mp_const_false;
+                return UJSON_TOK_VALUE;
             case 't':
-                if (S_CUR(s) == 'r' && S_NEXT(s) == 'u' && S_NEXT(s) == 'e') {
-                    S_NEXT(s);
-                    next = mp_const_true;
-                } else {
-                    goto fail;
-                }
-                break;
-            case '"':
-                vstr_reset(&vstr);
-                for (; !S_END(s) && S_CUR(s) != '"';) {
-                    byte c = S_CUR(s);
-                    if (c == '\\') {
-                        c = S_NEXT(s);
-                        switch (c) {
-                            case 'b': c = 0x08; break;
-                            case 'f': c = 0x0c; break;
-                            case 'n': c = 0x0a; break;
-                            case 'r': c = 0x0d; break;
-                            case 't': c = 0x09; break;
-                            case 'u': {
-                                mp_uint_t num = 0;
-                                for (int i = 0; i < 4; i++) {
-                                    c = (S_NEXT(s) | 0x20) - '0';
-                                    if (c > 9) {
-                                        c -= ('a' - ('9' + 1));
-                                    }
-                                    num = (num << 4) | c;
+                ujson_match(s, "rue");
+                *value = mp_const_true;
+                return UJSON_TOK_VALUE;
+            case '"': {
+                S_NEXT(*s);
+                vstr_reset(vstr);
+                for (;;) {
+                    // take the run of plain chars that are in the buffer
+                    const byte *start = s->pos;
+                    const byte *p = start;
+                    while (p < s->end && *p != '"' && *p != '\\' && *p != S_EOF) {
+                        ++p;
+                    }
+                    if (p < s->end && *p == '"' && vstr->len == 0) {
+                        // the whole string is in the buffer
+                        *value = mp_obj_new_str((const char*)start, p - start);
+                        s->pos = p;
+                        S_NEXT(*s);
+                        return UJSON_TOK_VALUE;
+                    }
+                    vstr_add_strn(vstr, (const char*)start, p - start);
+                    if (p == s->end) {
+                        ujson_stream_fill(s);
+                        continue;
+                    }
+                    s->pos = p;
+                    byte c = *p;
+                    if (c == '"') {
+                        S_NEXT(*s);
+                        *value = mp_obj_new_str(vstr->buf, vstr->len);
+                        return UJSON_TOK_VALUE;
+                    } else if (c == S_EOF) {
+                        ujson_syntax_error();
+                    }
+                    c = S_NEXT(*s);
+                    switch (c) {
+                        case 'b': c = 0x08; break;
+                        case 'f': c = 0x0c; break;
+                        case 'n': c = 0x0a; break;
+                        case 'r': c = 0x0d; break;
+                        case 't': c = 0x09; break;
+                        case 'u': {
+                            mp_uint_t num = 0;
+                            for (int i = 0; i < 4; i++) {
+                                c = (S_NEXT(*s) | 0x20) - '0';
+                                if (c > 9) {
+                                    c -= ('a' - ('9' + 1));
                                 }
-                                vstr_add_char(&vstr, num);
-                                goto str_cont;
+                                num = (num << 4) | c;
                             }
+                            vstr_add_char(vstr, num);
+                            S_NEXT(*s);
+                            continue;
                         }
                     }
-                    vstr_add_byte(&vstr, c);
-                str_cont:
-                    S_NEXT(s);
+                    vstr_add_byte(vstr, c);
+                    S_NEXT(*s);
                 }
-                if (S_END(s)) {
-                    goto fail;
-                }
-                S_NEXT(s);
-                next = mp_obj_new_str(vstr.buf, vstr.len);
-                break;
+            }
             case '-':
             case '0': case '1': case '2': case '3': case '4': case '5': case '6': case '7': case '8': case '9': {
                 bool flt = false;
-                vstr_reset(&vstr);
-                for (;;) {
-                    vstr_add_byte(&vstr, cur);
-                    cur = S_CUR(s);
-                    if (cur == '.' || cur == 'E' || cur == 'e') {
-                        flt = true;
-                    } else if (cur == '-' || unichar_isdigit(cur)) {
-                        // pass
-                    } else {
-                        break;
-                    }
-                    S_NEXT(s);
+                const byte *start = s->pos;
+                const byte *p = start + 1;
+                while (p < s->end && ujson_is_num_char(*p, &flt)) {
+                    ++p;
                 }
-                if (flt) {
-                    next = mp_parse_num_decimal(vstr.buf, vstr.len, false, false, NULL);
-                } else {
-                    next = mp_parse_num_integer(vstr.buf, vstr.len, 10, NULL);
+                if (p < s->end) {
+                    // the whole number is in the buffer
+                    s->pos = p;
+                    *value = ujson_new_num((const char*)start, p - start, flt);
+                    return UJSON_TOK_VALUE;
                 }
-                break;
+                // the number continues in the next block
+                vstr_reset(vstr);
+                vstr_add_strn(vstr, (const char*)start, p - start);
+                s->pos = p - 1;
+                while (ujson_is_num_char(S_NEXT(*s), &flt)) {
+                    vstr_add_byte(vstr, S_CUR(*s));
+                }
+                *value = ujson_new_num(vstr->buf, vstr->len, flt);
+                return UJSON_TOK_VALUE;
             }
+            default:
+                ujson_syntax_error();
+        }
+    }
+}
+
+// number of nested containers that ujson_load tracks without allocating
+#define UJSON_STACK_INLINE_LEN (16)
+
+STATIC mp_obj_t ujson_load(ujson_stream_t *s) {
+    vstr_t vstr;
+    vstr_init(&vstr, 8);
+    // we use an array as a simple stack for nested JSON, which is moved to
+    // the heap if the nesting gets deep
+    mp_obj_t stack_inline[UJSON_STACK_INLINE_LEN];
+    mp_obj_t *stack = stack_inline;
+    size_t stack_alloc = UJSON_STACK_INLINE_LEN;
+    size_t stack_len = 0;
+    mp_obj_t stack_top = MP_OBJ_NULL;
+    bool stack_top_is_list = false;
+    mp_obj_t stack_key = MP_OBJ_NULL;
+    for (;;) {
+        mp_obj_t next = MP_OBJ_NULL;
+        bool enter = false;
+        switch (ujson_next_token(s, &vstr, &next)) {
+            case S_EOF:
+                goto success;
             case '[':
                 next = mp_obj_new_list(0, NULL);
                 enter = true;
@@ -215,28 +500,27 @@ STATIC mp_obj_t mod_ujson_load(mp_obj_t stream_obj) {
                     // no object at all
                     goto fail;
                 }
-                if (stack.len == 0) {
+                if (stack_len == 0) {
                     // finished; compound object
                     goto success;
                 }
-                stack.len -= 1;
-                stack_top = stack.items[stack.len];
-                stack_top_type = mp_obj_get_type(stack_top);
-                goto cont;
+                stack_top = stack[--stack_len];
+                stack_top_is_list = MP_OBJ_IS_TYPE(stack_top, &mp_type_list);
+                continue;
             }
             default:
-                goto fail;
+                break;
         }
         if (stack_top == MP_OBJ_NULL) {
             stack_top = next;
-            stack_top_type = mp_obj_get_type(stack_top);
+            stack_top_is_list = MP_OBJ_IS_TYPE(stack_top, &mp_type_list);
             if (!enter) {
                 // finished; single primitive only
                 goto success;
             }
         } else {
             // append to list or dict
-            if (stack_top_type == &mp_type_list) {
+            if (stack_top_is_list) {
                 mp_obj_list_append(stack_top, next);
             } else {
                 if (stack_key == MP_OBJ_NULL) {
@@ -250,53 +534,173 @@ STATIC mp_obj_t mod_ujson_load(mp_obj_t stream_obj) {
                 }
             }
             if (enter) {
-                if (stack.items == NULL) {
-                    mp_obj_list_init(&stack, 1);
-                    stack.items[0] = stack_top;
-                } else {
-                    mp_obj_list_append(MP_OBJ_FROM_PTR(&stack), stack_top);
+                if (stack_len == stack_alloc) {
+                    mp_obj_t *new_stack = m_new(mp_obj_t, stack_alloc * 2);
+                    memcpy(new_stack, stack, stack_alloc * sizeof(mp_obj_t));
+                    if (stack != stack_inline) {
+                        m_del(mp_obj_t, stack, stack_alloc);
+                    }
+                    stack = new_stack;
+                    stack_alloc *= 2;
                 }
+                stack[stack_len++] = stack_top;
                 stack_top = next;
-                stack_top_type = mp_obj_get_type(stack_top);
+                stack_top_is_list = MP_OBJ_IS_TYPE(stack_top, &mp_type_list);
             }
         }
     }
     success:
     // eat trailing whitespace
-    while (unichar_isspace(S_CUR(s))) {
-        S_NEXT(s);
+    while (unichar_isspace(S_CUR(*s))) {
+        S_NEXT(*s);
     }
-    if (!S_END(s)) {
+    if (!S_END(*s)) {
         // unexpected chars
         goto fail;
     }
-    if (stack_top == MP_OBJ_NULL || stack.len != 0) {
+    if (stack_top == MP_OBJ_NULL || stack_len != 0) {
         // not exactly 1 object
         goto fail;
     }
+    if (stack != stack_inline) {
+        m_del(mp_obj_t, stack, stack_alloc);
+    }
     vstr_clear(&vstr);
     return stack_top;
 
     fail:
-    mp_raise_ValueError("syntax error in JSON");
+    ujson_syntax_error();
+}
+
+STATIC mp_obj_t mod_ujson_load(mp_obj_t stream_obj) {
+    byte buf[MICROPY_PY_UJSON_BUF_SIZE];
+    ujson_stream_t s;
+    ujson_stream_init(&s, stream_obj, buf);
+    return ujson_load(&s);
 }
 STATIC MP_DEFINE_CONST_FUN_OBJ_1(mod_ujson_load_obj, mod_ujson_load);
 
 STATIC mp_obj_t mod_ujson_loads(mp_obj_t obj) {
     size_t len;
     const char *buf = mp_obj_str_get_data(obj, &len);
-    vstr_t vstr = {len, len, (char*)buf, true};
-    mp_obj_stringio_t sio = {{&mp_type_stringio}, &vstr, 0, MP_OBJ_NULL};
-    return mod_ujson_load(MP_OBJ_FROM_PTR(&sio));
+    // parse the string in place, as a stream whose only block it is
+    ujson_stream_t s = {MP_OBJ_NULL, NULL, (const byte*)buf, (const byte*)buf + len, NULL};
+    if (len == 0) {
+        ujson_stream_fill(&s);
+    }
+    return ujson_load(&s);
 }
 STATIC MP_DEFINE_CONST_FUN_OBJ_1(mod_ujson_loads_obj, mod_ujson_loads);
 
+#if MICROPY_PY_UJSON_ITERPARSE
+
+// ujson.iterparse(stream) yields an (event, value) tuple for each token of
+// the JSON values in the stream, without building them, so it walks a
+// document of any size in constant memory.  The events are "start_map",
+// "map_key", "end_map", "start_array", "end_array" and "value"; only
+// "map_key" and "value" carry a value, the others carry None.
+
+typedef struct _mp_obj_ujson_iterparse_t {
+    mp_obj_base_t base;
+    ujson_stream_t s;
+    vstr_t vstr;
+    uint16_t depth;
+    bool expect_key;
+    // bit n is set if the container at depth n is a dict
+    uint8_t in_map[(MICROPY_PY_UJSON_ITERPARSE_MAX_DEPTH + 7) / 8];
+    byte buf[MICROPY_PY_UJSON_BUF_SIZE];
+} mp_obj_ujson_iterparse_t;
+
+#define ITERPARSE_IN_MAP(self, n) ((self)->in_map[(n) / 8] & (1 << ((n) & 7)))
+
+STATIC mp_obj_t ujson_iterparse_iternext(mp_obj_t self_in) {
+    mp_obj_ujson_iterparse_t *self = MP_OBJ_TO_PTR(self_in);
+    bool in_map = self->depth > 0 && ITERPARSE_IN_MAP(self, self->depth - 1);
+    mp_obj_t value = mp_const_none;
+    byte tok = ujson_next_token(&self->s, &self->vstr, &value);
+    qstr event;
+    switch (tok) {
+        case S_EOF:
+            if (self->depth != 0) {
+                ujson_syntax_error();
+            }
+            return MP_OBJ_STOP_ITERATION;
+        case '[':
+        case '{': {
+            if (in_map && self->expect_key) {
+                ujson_syntax_error();
+            }
+            if (self->depth == MICROPY_PY_UJSON_ITERPARSE_MAX_DEPTH) {
+                mp_raise_ValueError("JSON nested too deeply");
+            }
+            uint8_t bit = 1 << (self->depth & 7);
+            if (tok == '{') {
+                self->in_map[self->depth / 8] |= bit;
+                event = MP_QSTR_start_map;
+            } else {
+                self->in_map[self->depth / 8] &= ~bit;
+                event = MP_QSTR_start_array;
+            }
+            self->depth += 1;
+            self->expect_key = tok == '{';
+            break;
+        }
+        case ']':
+        case '}':
+            if (self->depth == 0 || in_map != (tok == '}') || (in_map && !self->expect_key)) {
+                ujson_syntax_error();
+            }
+            self->depth -= 1;
+            // the container was a value of the enclosing one
+            self->expect_key = self->depth > 0 && ITERPARSE_IN_MAP(self, self->depth - 1);
+            event = tok == '}' ? MP_QSTR_end_map : MP_QSTR_end_array;
+            break;
+        default:
+            if (in_map && self->expect_key) {
+                if (!MP_OBJ_IS_STR(value)) {
+                    // JSON object keys must be strings
+                    ujson_syntax_error();
+                }
+                event = MP_QSTR_map_key;
+            } else {
+                event = MP_QSTR_value;
+            }
+            self->expect_key = in_map && !self->expect_key;
+            break;
+    }
+    mp_obj_t items[2] = {MP_OBJ_NEW_QSTR(event), value};
+    return mp_obj_new_tuple(2, items);
+}
+
+STATIC const mp_obj_type_t ujson_iterparse_type = {
+    { &mp_type_type },
+    .name = MP_QSTR_iterparse,
+    .getiter = mp_identity_getiter,
+    .iternext = ujson_iterparse_iternext,
+};
+
+STATIC mp_obj_t mod_ujson_iterparse(mp_obj_t stream_obj) {
+    mp_obj_ujson_iterparse_t *o = m_new_obj(mp_obj_ujson_iterparse_t);
+    o->base.type = &ujson_iterparse_type;
+    o->depth = 0;
+    o->expect_key = false;
+    vstr_init(&o->vstr, 8);
+    ujson_stream_init(&o->s, stream_obj, o->buf);
+    return MP_OBJ_FROM_PTR(o);
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_1(mod_ujson_iterparse_obj, mod_ujson_iterparse);
+
+#endif // MICROPY_PY_UJSON_ITERPARSE
+
 STATIC const mp_rom_map_elem_t mp_module_ujson_globals_table[] = {
     { MP_ROM_QSTR(MP_QSTR___name__), MP_ROM_QSTR(MP_QSTR_ujson) },
     { MP_ROM_QSTR(MP_QSTR_dump), MP_ROM_PTR(&mod_ujson_dump_obj) },
     { MP_ROM_QSTR(MP_QSTR_dumps), MP_ROM_PTR(&mod_ujson_dumps_obj) },
     { MP_ROM_QSTR(MP_QSTR_load), MP_ROM_PTR(&mod_ujson_load_obj) },
     { MP_ROM_QSTR(MP_QSTR_loads), MP_ROM_PTR(&mod_ujson_loads_obj) },
+    #if MICROPY_PY_UJSON_ITERPARSE
+    { MP_ROM_QSTR(MP_QSTR_iterparse), MP_ROM_PTR(&mod_ujson_iterparse_obj) },
+    #endif
 };
 
 STATIC MP_DEFINE_CONST_DICT(mp_module_ujson_globals, mp_module_ujson_globals_table);
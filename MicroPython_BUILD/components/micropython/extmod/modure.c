@@ -43,6 +43,10 @@
 
 typedef struct _mp_obj_re_t {
     mp_obj_base_t base;
+    mp_obj_t pattern;
+    #if MICROPY_PY_URE_PIKEVM
+    void *work; // work area for re1_5_pikevm, for (re.sub + 1) * 2 captures
+    #endif
     ByteProg re;
 } mp_obj_re_t;
 
@@ -53,6 +57,15 @@ typedef struct _mp_obj_match_t {
     const char *caps[0];
 } mp_obj_match_t;
 
+typedef struct _mp_obj_re_finditer_t {
+    mp_obj_base_t base;
+    mp_fun_1_t iternext;
+    mp_obj_re_t *re;
+    mp_obj_t str;
+    const char *pos; // where to search from next, NULL when done
+} mp_obj_re_finditer_t;
+
+STATIC const mp_obj_type_t re_type;
 
 STATIC void match_print(const mp_print_t *print, mp_obj_t self_in, mp_print_kind_t kind) {
     (void)kind;
@@ -60,12 +73,17 @@ STATIC void match_print(const mp_print_t *print, mp_obj_t self_in, mp_print_kind
     mp_printf(print, "<match num=%d>", self->num_matches);
 }
 
-STATIC mp_obj_t match_group(mp_obj_t self_in, mp_obj_t no_in) {
-    mp_obj_match_t *self = MP_OBJ_TO_PTR(self_in);
+STATIC mp_int_t match_get_no(mp_obj_match_t *self, mp_obj_t no_in) {
     mp_int_t no = mp_obj_get_int(no_in);
     if (no < 0 || no >= self->num_matches) {
         nlr_raise(mp_obj_new_exception_arg1(&mp_type_IndexError, no_in));
     }
+    return no;
+}
+
+STATIC mp_obj_t match_group(mp_obj_t self_in, mp_obj_t no_in) {
+    mp_obj_match_t *self = MP_OBJ_TO_PTR(self_in);
+    mp_int_t no = match_get_no(self, no_in);
 
     const char *start = self->caps[no * 2];
     if (start == NULL) {
@@ -77,8 +95,53 @@ STATIC mp_obj_t match_group(mp_obj_t self_in, mp_obj_t no_in) {
 }
 MP_DEFINE_CONST_FUN_OBJ_2(match_group_obj, match_group);
 
+// Get the offsets of the start and end of a group in the subject, which are
+// -1 if the group didn't take part in the match.
+STATIC void match_span_helper(size_t n_args, const mp_obj_t *args, mp_obj_t span[2]) {
+    mp_obj_match_t *self = MP_OBJ_TO_PTR(args[0]);
+    mp_int_t no = 0;
+    if (n_args > 1) {
+        no = match_get_no(self, args[1]);
+    }
+    mp_int_t s = -1;
+    mp_int_t e = -1;
+    const char *start = self->caps[no * 2];
+    if (start != NULL) {
+        size_t len;
+        const char *begin = mp_obj_str_get_data(self->str, &len);
+        s = start - begin;
+        e = self->caps[no * 2 + 1] - begin;
+    }
+    span[0] = MP_OBJ_NEW_SMALL_INT(s);
+    span[1] = MP_OBJ_NEW_SMALL_INT(e);
+}
+
+STATIC mp_obj_t match_span(size_t n_args, const mp_obj_t *args) {
+    mp_obj_t span[2];
+    match_span_helper(n_args, args, span);
+    return mp_obj_new_tuple(2, span);
+}
+MP_DEFINE_CONST_FUN_OBJ_VAR_BETWEEN(match_span_obj, 1, 2, match_span);
+
+STATIC mp_obj_t match_start(size_t n_args, const mp_obj_t *args) {
+    mp_obj_t span[2];
+    match_span_helper(n_args, args, span);
+    return span[0];
+}
+MP_DEFINE_CONST_FUN_OBJ_VAR_BETWEEN(match_start_obj, 1, 2, match_start);
+
+STATIC mp_obj_t match_end(size_t n_args, const mp_obj_t *args) {
+    mp_obj_t span[2];
+    match_span_helper(n_args, args, span);
+    return span[1];
+}
+MP_DEFINE_CONST_FUN_OBJ_VAR_BETWEEN(match_end_obj, 1, 2, match_end);
+
 STATIC const mp_rom_map_elem_t match_locals_dict_table[] = {
     { MP_ROM_QSTR(MP_QSTR_group), MP_ROM_PTR(&match_group_obj) },
+    { MP_ROM_QSTR(MP_QSTR_span), MP_ROM_PTR(&match_span_obj) },
+    { MP_ROM_QSTR(MP_QSTR_start), MP_ROM_PTR(&match_start_obj) },
+    { MP_ROM_QSTR(MP_QSTR_end), MP_ROM_PTR(&match_end_obj) },
 };
 
 STATIC MP_DEFINE_CONST_DICT(match_locals_dict, match_locals_dict_table);
@@ -96,18 +159,97 @@ STATIC void re_print(const mp_print_t *print, mp_obj_t self_in, mp_print_kind_t
     mp_printf(print, "<re %p>", self);
 }
 
+STATIC mp_obj_t re_compile_str(mp_obj_t pattern, int flags) {
+    const char *re_str = mp_obj_str_get_str(pattern);
+    int size = re1_5_sizecode(re_str);
+    if (size == -1) {
+        goto error;
+    }
+    mp_obj_re_t *o = m_new_obj_var(mp_obj_re_t, char, size);
+    o->base.type = &re_type;
+    o->pattern = pattern;
+    int error = re1_5_compilecode(&o->re, re_str);
+    if (error != 0) {
+error:
+        mp_raise_ValueError("Error in regex");
+    }
+    #if MICROPY_PY_URE_PIKEVM
+    o->work = m_new(char, re1_5_pikevm_worksize(&o->re, (o->re.sub + 1) * 2));
+    #endif
+    if (flags & FLAG_DEBUG) {
+        re1_5_dumpcode(&o->re);
+    }
+    return MP_OBJ_FROM_PTR(o);
+}
+
+#if MICROPY_PY_URE_CACHE_SIZE
+STATIC bool ure_pattern_equal(mp_obj_t re, mp_obj_t pattern) {
+    mp_obj_t p = ((mp_obj_re_t*)MP_OBJ_TO_PTR(re))->pattern;
+    // patterns that aren't interned are different objects on each call
+    return p == pattern || (MP_OBJ_IS_STR(pattern) && mp_obj_str_equal(p, pattern));
+}
+#endif
+
+// Get the compiled form of a pattern, which may already be compiled.  The
+// most recently used patterns are kept in a cache, so that functions of the
+// module don't compile the same pattern on every call.
+STATIC mp_obj_re_t *ure_get(mp_obj_t pattern) {
+    if (MP_OBJ_IS_TYPE(pattern, &re_type)) {
+        return MP_OBJ_TO_PTR(pattern);
+    }
+    #if MICROPY_PY_URE_CACHE_SIZE
+    mp_obj_t *cache = MP_STATE_VM(ure_cache);
+    mp_obj_t re = MP_OBJ_NULL;
+    size_t i;
+    for (i = 0; i < MICROPY_PY_URE_CACHE_SIZE - 1 && cache[i] != MP_OBJ_NULL; i++) {
+        if (ure_pattern_equal(cache[i], pattern)) {
+            re = cache[i];
+            break;
+        }
+    }
+    if (re == MP_OBJ_NULL) {
+        if (cache[i] != MP_OBJ_NULL && ure_pattern_equal(cache[i], pattern)) {
+            re = cache[i];
+        } else {
+            // not found, replace the least recently used pattern
+            re = re_compile_str(pattern, 0);
+        }
+    }
+    // move to the front
+    memmove(cache + 1, cache, i * sizeof(mp_obj_t));
+    cache[0] = re;
+    return MP_OBJ_TO_PTR(re);
+    #else
+    return MP_OBJ_TO_PTR(re_compile_str(pattern, 0));
+    #endif
+}
+
+// Run the program on subj, filling in all caps_num = (re.sub + 1) * 2 captures.
+STATIC int ure_exec_prog(mp_obj_re_t *self, Subject *subj, const char **caps, int caps_num, bool is_anchored) {
+    // cast is a workaround for a bug in msvc: it treats const char** as a const pointer instead of a pointer to pointer to const char
+    memset((char*)caps, 0, caps_num * sizeof(char*));
+    #if MICROPY_PY_URE_PIKEVM
+    return re1_5_pikevm(&self->re, subj, caps, caps_num, is_anchored, self->work);
+    #else
+    return re1_5_recursiveloopprog(&self->re, subj, caps, caps_num, is_anchored);
+    #endif
+}
+
+// The following functions take either a compiled regex or a pattern as their
+// first argument, so they serve both as methods of the regex and functions of
+// the module.
+
 STATIC mp_obj_t ure_exec(bool is_anchored, uint n_args, const mp_obj_t *args) {
     (void)n_args;
-    mp_obj_re_t *self = MP_OBJ_TO_PTR(args[0]);
+    mp_obj_re_t *self = ure_get(args[0]);
     Subject subj;
     size_t len;
     subj.begin = mp_obj_str_get_data(args[1], &len);
     subj.end = subj.begin + len;
+    subj.begin_line = subj.begin;
     int caps_num = (self->re.sub + 1) * 2;
     mp_obj_match_t *match = m_new_obj_var(mp_obj_match_t, char*, caps_num);
-    // cast is a workaround for a bug in msvc: it treats const char** as a const pointer instead of a pointer to pointer to const char
-    memset((char*)match->caps, 0, caps_num * sizeof(char*));
-    int res = re1_5_recursiveloopprog(&self->re, &subj, match->caps, caps_num, is_anchored);
+    int res = ure_exec_prog(self, &subj, match->caps, caps_num, is_anchored);
     if (res == 0) {
         m_del_var(mp_obj_match_t, char*, caps_num, match);
         return mp_const_none;
@@ -130,12 +272,13 @@ STATIC mp_obj_t re_search(size_t n_args, const mp_obj_t *args) {
 MP_DEFINE_CONST_FUN_OBJ_VAR_BETWEEN(re_search_obj, 2, 4, re_search);
 
 STATIC mp_obj_t re_split(size_t n_args, const mp_obj_t *args) {
-    mp_obj_re_t *self = MP_OBJ_TO_PTR(args[0]);
+    mp_obj_re_t *self = ure_get(args[0]);
     Subject subj;
     size_t len;
     const mp_obj_type_t *str_type = mp_obj_get_type(args[1]);
     subj.begin = mp_obj_str_get_data(args[1], &len);
     subj.end = subj.begin + len;
+    subj.begin_line = subj.begin;
     int caps_num = (self->re.sub + 1) * 2;
 
     int maxsplit = 0;
@@ -146,9 +289,7 @@ STATIC mp_obj_t re_split(size_t n_args, const mp_obj_t *args) {
     mp_obj_t retval = mp_obj_new_list(0, NULL);
     const char **caps = mp_local_alloc(caps_num * sizeof(char*));
     while (true) {
-        // cast is a workaround for a bug in msvc: it treats const char** as a const pointer instead of a pointer to pointer to const char
-        memset((char**)caps, 0, caps_num * sizeof(char*));
-        int res = re1_5_recursiveloopprog(&self->re, &subj, caps, caps_num, false);
+        int res = ure_exec_prog(self, &subj, caps, caps_num, false);
 
         // if we didn't have a match, or had an empty match, it's time to stop
         if (!res || caps[0] == caps[1]) {
@@ -174,10 +315,179 @@ STATIC mp_obj_t re_split(size_t n_args, const mp_obj_t *args) {
 }
 MP_DEFINE_CONST_FUN_OBJ_VAR_BETWEEN(re_split_obj, 2, 3, re_split);
 
+// Where to search from after a match that ended at end: an empty match must
+// not be found again at the same place, so skip a character after it.
+STATIC const char *ure_next_pos(const mp_obj_type_t *str_type, const char *start, const char *end) {
+    if (start != end) {
+        return end;
+    }
+    if (str_type == &mp_type_str) {
+        return (const char*)utf8_next_char((const byte*)end);
+    }
+    return end + 1;
+}
+
+STATIC mp_obj_t re_finditer_iternext(mp_obj_t self_in) {
+    mp_obj_re_finditer_t *self = MP_OBJ_TO_PTR(self_in);
+    if (self->pos == NULL) {
+        return MP_OBJ_STOP_ITERATION;
+    }
+    Subject subj;
+    size_t len;
+    subj.begin_line = mp_obj_str_get_data(self->str, &len);
+    subj.begin = self->pos;
+    subj.end = subj.begin_line + len;
+    int caps_num = (self->re->re.sub + 1) * 2;
+    mp_obj_match_t *match = m_new_obj_var(mp_obj_match_t, char*, caps_num);
+    if (!ure_exec_prog(self->re, &subj, match->caps, caps_num, false)) {
+        m_del_var(mp_obj_match_t, char*, caps_num, match);
+        self->pos = NULL;
+        return MP_OBJ_STOP_ITERATION;
+    }
+    match->base.type = &match_type;
+    match->num_matches = caps_num / 2;
+    match->str = self->str;
+    self->pos = ure_next_pos(mp_obj_get_type(self->str), match->caps[0], match->caps[1]);
+    if (self->pos > subj.end) {
+        self->pos = NULL;
+    }
+    return MP_OBJ_FROM_PTR(match);
+}
+
+STATIC mp_obj_t re_finditer(mp_obj_t self_in, mp_obj_t str_in) {
+    mp_obj_re_finditer_t *o = m_new_obj(mp_obj_re_finditer_t);
+    o->base.type = &mp_type_polymorph_iter;
+    o->iternext = re_finditer_iternext;
+    o->re = ure_get(self_in);
+    o->str = str_in;
+    size_t len;
+    o->pos = mp_obj_str_get_data(str_in, &len);
+    return MP_OBJ_FROM_PTR(o);
+}
+MP_DEFINE_CONST_FUN_OBJ_2(re_finditer_obj, re_finditer);
+
+// Append the replacement repl for a match to vstr, substituting \N and \g<N>
+// by the groups of the match.
+STATIC void re_sub_add_repl(vstr_t *vstr, const char *repl, const char *repl_end, mp_obj_match_t *match) {
+    while (repl < repl_end) {
+        // copy the run of plain characters in one go
+        const char *run = repl;
+        while (repl < repl_end && *repl != '\\') {
+            ++repl;
+        }
+        vstr_add_strn(vstr, run, repl - run);
+        if (repl == repl_end) {
+            break;
+        }
+        ++repl;
+        bool is_g_format = false;
+        if (repl + 1 < repl_end && *repl == 'g' && repl[1] == '<') {
+            // group specified with syntax "\g<number>"
+            repl += 2;
+            is_g_format = true;
+        }
+        if (repl < repl_end && unichar_isdigit(*repl)) {
+            // group specified with syntax "\g<number>" or "\number"
+            unsigned int match_no = 0;
+            do {
+                match_no = match_no * 10 + (*repl++ - '0');
+            } while (repl < repl_end && unichar_isdigit(*repl));
+            if (is_g_format && repl < repl_end && *repl == '>') {
+                ++repl;
+            }
+            if (match_no >= (unsigned int)match->num_matches) {
+                nlr_raise(mp_obj_new_exception_arg1(&mp_type_IndexError, MP_OBJ_NEW_SMALL_INT(match_no)));
+            }
+            const char *start = match->caps[match_no * 2];
+            if (start != NULL) {
+                vstr_add_strn(vstr, start, match->caps[match_no * 2 + 1] - start);
+            }
+        } else {
+            // any other escape is kept as it is
+            vstr_add_byte(vstr, '\\');
+        }
+    }
+}
+
+STATIC mp_obj_t re_sub(size_t n_args, const mp_obj_t *args) {
+    mp_obj_re_t *self = ure_get(args[0]);
+    mp_obj_t repl_in = args[1];
+    mp_obj_t where = args[2];
+    mp_int_t count = 0;
+    if (n_args > 3) {
+        count = mp_obj_get_int(args[3]);
+    }
+    const mp_obj_type_t *str_type = mp_obj_get_type(where);
+
+    Subject subj;
+    size_t len;
+    subj.begin_line = mp_obj_str_get_data(where, &len);
+    subj.end = subj.begin_line + len;
+    const char *pos = subj.begin_line;
+
+    // a callable replacement gets a new match object each time, as it may keep it
+    bool is_callable = mp_obj_is_callable(repl_in);
+    int caps_num = (self->re.sub + 1) * 2;
+    mp_obj_match_t *match = NULL;
+
+    vstr_t vstr;
+    vstr.buf = NULL; // initialised at the first match
+    while (pos <= subj.end) {
+        if (match == NULL || is_callable) {
+            match = m_new_obj_var(mp_obj_match_t, char*, caps_num);
+            match->base.type = &match_type;
+            match->num_matches = caps_num / 2;
+            match->str = where;
+        }
+        subj.begin = pos;
+        if (!ure_exec_prog(self, &subj, match->caps, caps_num, false)) {
+            break;
+        }
+        if (vstr.buf == NULL) {
+            vstr_init(&vstr, len + 16);
+        }
+
+        // the text before the match, then the replacement
+        vstr_add_strn(&vstr, pos, match->caps[0] - pos);
+        mp_obj_t repl = repl_in;
+        if (is_callable) {
+            repl = mp_call_function_1(repl_in, MP_OBJ_FROM_PTR(match));
+        }
+        size_t repl_len;
+        const char *repl_str = mp_obj_str_get_data(repl, &repl_len);
+        if (is_callable) {
+            vstr_add_strn(&vstr, repl_str, repl_len);
+        } else {
+            re_sub_add_repl(&vstr, repl_str, repl_str + repl_len, match);
+        }
+
+        pos = ure_next_pos(str_type, match->caps[0], match->caps[1]);
+        if (pos > match->caps[1]) {
+            // keep the character skipped after an empty match
+            vstr_add_strn(&vstr, match->caps[1], MIN(pos, subj.end) - match->caps[1]);
+        }
+        if (count > 0 && --count == 0) {
+            break;
+        }
+    }
+
+    if (vstr.buf == NULL) {
+        // nothing was replaced
+        return where;
+    }
+    if (pos < subj.end) {
+        vstr_add_strn(&vstr, pos, subj.end - pos);
+    }
+    return mp_obj_new_str_from_vstr(str_type, &vstr);
+}
+MP_DEFINE_CONST_FUN_OBJ_VAR_BETWEEN(re_sub_obj, 3, 4, re_sub);
+
 STATIC const mp_rom_map_elem_t re_locals_dict_table[] = {
     { MP_ROM_QSTR(MP_QSTR_match), MP_ROM_PTR(&re_match_obj) },
     { MP_ROM_QSTR(MP_QSTR_search), MP_ROM_PTR(&re_search_obj) },
     { MP_ROM_QSTR(MP_QSTR_split), MP_ROM_PTR(&re_split_obj) },
+    { MP_ROM_QSTR(MP_QSTR_finditer), MP_ROM_PTR(&re_finditer_obj) },
+    { MP_ROM_QSTR(MP_QSTR_sub), MP_ROM_PTR(&re_sub_obj) },
 };
 
 STATIC MP_DEFINE_CONST_DICT(re_locals_dict, re_locals_dict_table);
@@ -190,53 +500,24 @@ STATIC const mp_obj_type_t re_type = {
 };
 
 STATIC mp_obj_t mod_re_compile(size_t n_args, const mp_obj_t *args) {
-    const char *re_str = mp_obj_str_get_str(args[0]);
-    int size = re1_5_sizecode(re_str);
-    if (size == -1) {
-        goto error;
-    }
-    mp_obj_re_t *o = m_new_obj_var(mp_obj_re_t, char, size);
-    o->base.type = &re_type;
     int flags = 0;
     if (n_args > 1) {
         flags = mp_obj_get_int(args[1]);
     }
-    int error = re1_5_compilecode(&o->re, re_str);
-    if (error != 0) {
-error:
-        mp_raise_ValueError("Error in regex");
-    }
-    if (flags & FLAG_DEBUG) {
-        re1_5_dumpcode(&o->re);
+    if (flags == 0) {
+        return MP_OBJ_FROM_PTR(ure_get(args[0]));
     }
-    return MP_OBJ_FROM_PTR(o);
+    return re_compile_str(args[0], flags);
 }
 MP_DEFINE_CONST_FUN_OBJ_VAR_BETWEEN(mod_re_compile_obj, 1, 2, mod_re_compile);
 
-STATIC mp_obj_t mod_re_exec(bool is_anchored, uint n_args, const mp_obj_t *args) {
-    (void)n_args;
-    mp_obj_t self = mod_re_compile(1, args);
-
-    const mp_obj_t args2[] = {self, args[1]};
-    mp_obj_t match = ure_exec(is_anchored, 2, args2);
-    return match;
-}
-
-STATIC mp_obj_t mod_re_match(size_t n_args, const mp_obj_t *args) {
-    return mod_re_exec(true, n_args, args);
-}
-MP_DEFINE_CONST_FUN_OBJ_VAR_BETWEEN(mod_re_match_obj, 2, 4, mod_re_match);
-
-STATIC mp_obj_t mod_re_search(size_t n_args, const mp_obj_t *args) {
-    return mod_re_exec(false, n_args, args);
-}
-MP_DEFINE_CONST_FUN_OBJ_VAR_BETWEEN(mod_re_search_obj, 2, 4, mod_re_search);
-
 STATIC const mp_rom_map_elem_t mp_module_re_globals_table[] = {
     { MP_ROM_QSTR(MP_QSTR___name__), MP_ROM_QSTR(MP_QSTR_ure) },
     { MP_ROM_QSTR(MP_QSTR_compile), MP_ROM_PTR(&mod_re_compile_obj) },
-    { MP_ROM_QSTR(MP_QSTR_match), MP_ROM_PTR(&mod_re_match_obj) },
-    { MP_ROM_QSTR(MP_QSTR_search), MP_ROM_PTR(&mod_re_search_obj) },
+    { MP_ROM_QSTR(MP_QSTR_match), MP_ROM_PTR(&re_match_obj) },
+    { MP_ROM_QSTR(MP_QSTR_search), MP_ROM_PTR(&re_search_obj) },
+    { MP_ROM_QSTR(MP_QSTR_finditer), MP_ROM_PTR(&re_finditer_obj) },
+    { MP_ROM_QSTR(MP_QSTR_sub), MP_ROM_PTR(&re_sub_obj) },
     { MP_ROM_QSTR(MP_QSTR_DEBUG), MP_ROM_INT(FLAG_DEBUG) },
 };
 
@@ -253,7 +534,11 @@ const mp_obj_module_t mp_module_ure = {
 #define re1_5_fatal(x) assert(!x)
 #include "re1.5/compilecode.c"
 #include "re1.5/dumpcode.c"
+#if MICROPY_PY_URE_PIKEVM
+#include "re1.5/pike.c"
+#else
 #include "re1.5/recursiveloop.c"
+#endif
 #include "re1.5/charclass.c"
 
 #endif //MICROPY_PY_URE
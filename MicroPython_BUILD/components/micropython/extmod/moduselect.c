@@ -36,6 +36,11 @@
 #include "py/stream.h"
 #include "py/mperrno.h"
 #include "py/mphal.h"
+#include "py/mpthread.h"
+
+#if MICROPY_PY_USELECT_SELECT
+#include MICROPY_PY_USELECT_SELECT_H
+#endif
 
 // Flags for poll()
 #define FLAG_ONESHOT (1)
@@ -44,11 +49,26 @@
 ///
 /// This module provides the select function.
 
+// How a registered object is waited for
+#define POLL_KIND_IOCTL  (0) // polled with its ioctl on every pass
+#define POLL_KIND_NOTIFY (1) // polled with its ioctl, but wakes a sleeping poll
+#define POLL_KIND_FD     (2) // waited for by select() on its native fd
+
+#if MICROPY_ENABLE_SCHEDULER
+#define POLL_HANDLE_PENDING() mp_handle_pending()
+#else
+#define POLL_HANDLE_PENDING()
+#endif
+
 typedef struct _poll_obj_t {
     mp_obj_t obj;
     mp_uint_t (*ioctl)(mp_obj_t obj, mp_uint_t request, mp_uint_t arg, int *errcode);
     mp_uint_t flags;
     mp_uint_t flags_ret;
+    byte kind;
+    #if MICROPY_PY_USELECT_SELECT
+    int fd;
+    #endif
 } poll_obj_t;
 
 STATIC void poll_map_add(mp_map_t *poll_map, const mp_obj_t *obj, mp_uint_t obj_len, mp_uint_t flags, bool or_flags) {
@@ -62,6 +82,17 @@ STATIC void poll_map_add(mp_map_t *poll_map, const mp_obj_t *obj, mp_uint_t obj_
             poll_obj->ioctl = stream_p->ioctl;
             poll_obj->flags = flags;
             poll_obj->flags_ret = 0;
+            int errcode;
+            if (stream_p->ioctl(obj[i], MP_STREAM_POLL_NOTIFY, 0, &errcode) != MP_STREAM_ERROR) {
+                poll_obj->kind = POLL_KIND_NOTIFY;
+            } else {
+                poll_obj->kind = POLL_KIND_IOCTL;
+            }
+            #if MICROPY_PY_USELECT_SELECT
+            if (stream_p->ioctl(obj[i], MP_STREAM_GET_FILENO, 0, &errcode) != MP_STREAM_ERROR) {
+                poll_obj->kind = POLL_KIND_FD;
+            }
+            #endif
             elem->value = poll_obj;
         } else {
             // object exists; update its flags
@@ -74,43 +105,194 @@ STATIC void poll_map_add(mp_map_t *poll_map, const mp_obj_t *obj, mp_uint_t obj_
     }
 }
 
-// poll each object in the map
-STATIC mp_uint_t poll_map_poll(mp_map_t *poll_map, mp_uint_t *rwx_num) {
+// Set an object's returned flags, counting it if it's ready
+STATIC mp_uint_t poll_obj_set_ret(poll_obj_t *poll_obj, mp_uint_t ret, mp_uint_t *rwx_num) {
+    poll_obj->flags_ret = ret;
+    if (ret == 0) {
+        return 0;
+    }
+    if (rwx_num != NULL) {
+        if (ret & MP_STREAM_POLL_RD) {
+            rwx_num[0] += 1;
+        }
+        if (ret & MP_STREAM_POLL_WR) {
+            rwx_num[1] += 1;
+        }
+        if ((ret & ~(MP_STREAM_POLL_RD | MP_STREAM_POLL_WR)) != 0) {
+            rwx_num[2] += 1;
+        }
+    }
+    return 1;
+}
+
+STATIC mp_uint_t poll_obj_ioctl(poll_obj_t *poll_obj, mp_uint_t *rwx_num) {
+    int errcode;
+    mp_int_t ret = poll_obj->ioctl(poll_obj->obj, MP_STREAM_POLL, poll_obj->flags, &errcode);
+    if (ret == -1) {
+        // error doing ioctl
+        mp_raise_OSError(errcode);
+    }
+    return poll_obj_set_ret(poll_obj, ret, rwx_num);
+}
+
+// Poll each object in the map.  Objects with a native fd are all checked by
+// one select() call, which sleeps for up to wait_ms (-1 for no limit) if
+// none is ready; *slept tells whether it did.
+STATIC mp_uint_t poll_map_poll(mp_map_t *poll_map, mp_uint_t *rwx_num, mp_int_t wait_ms, bool *slept) {
     mp_uint_t n_ready = 0;
+    #if MICROPY_PY_USELECT_SELECT
+    fd_set rfds, wfds, efds;
+    int max_fd = -1;
+    FD_ZERO(&rfds);
+    FD_ZERO(&wfds);
+    FD_ZERO(&efds);
+    #endif
+    (void)wait_ms;
+    *slept = false;
+
     for (mp_uint_t i = 0; i < poll_map->alloc; ++i) {
         if (!MP_MAP_SLOT_IS_FILLED(poll_map, i)) {
             continue;
         }
-
         poll_obj_t *poll_obj = (poll_obj_t*)poll_map->table[i].value;
-        int errcode;
-        mp_int_t ret = poll_obj->ioctl(poll_obj->obj, MP_STREAM_POLL, poll_obj->flags, &errcode);
-        poll_obj->flags_ret = ret;
-
-        if (ret == -1) {
-            // error doing ioctl
-            mp_raise_OSError(errcode);
+        #if MICROPY_PY_USELECT_SELECT
+        if (poll_obj->kind == POLL_KIND_FD) {
+            // the fd is fetched on every pass, as the object may have been
+            // closed, and its fd reused, since it was registered
+            int errcode;
+            mp_int_t fd = poll_obj->ioctl(poll_obj->obj, MP_STREAM_GET_FILENO, 0, &errcode);
+            poll_obj->fd = fd;
+            poll_obj->flags_ret = 0;
+            if (fd < 0 || fd >= FD_SETSIZE) {
+                // let the object's own poll report what's wrong
+                n_ready += poll_obj_ioctl(poll_obj, rwx_num);
+                continue;
+            }
+            if (poll_obj->flags & MP_STREAM_POLL_RD) {
+                FD_SET(fd, &rfds);
+            }
+            if (poll_obj->flags & MP_STREAM_POLL_WR) {
+                FD_SET(fd, &wfds);
+            }
+            if (poll_obj->flags & MP_STREAM_POLL_HUP) {
+                FD_SET(fd, &efds);
+            }
+            if (fd > max_fd) {
+                max_fd = fd;
+            }
+            continue;
         }
+        #endif
+        n_ready += poll_obj_ioctl(poll_obj, rwx_num);
+    }
 
-        if (ret != 0) {
-            // object is ready
-            n_ready += 1;
-            if (rwx_num != NULL) {
-                if (ret & MP_STREAM_POLL_RD) {
-                    rwx_num[0] += 1;
-                }
-                if (ret & MP_STREAM_POLL_WR) {
-                    rwx_num[1] += 1;
-                }
-                if ((ret & ~(MP_STREAM_POLL_RD | MP_STREAM_POLL_WR)) != 0) {
-                    rwx_num[2] += 1;
-                }
+    #if MICROPY_PY_USELECT_SELECT
+    if (max_fd >= 0) {
+        struct timeval tv = { .tv_sec = 0, .tv_usec = 0 };
+        struct timeval *ptv = &tv;
+        bool block = (n_ready == 0 && wait_ms != 0);
+        if (block) {
+            if (wait_ms < 0) {
+                ptv = NULL;
+            } else {
+                tv.tv_sec = wait_ms / 1000;
+                tv.tv_usec = (wait_ms % 1000) * 1000;
+            }
+            MP_THREAD_GIL_EXIT();
+        }
+        *slept = block;
+        int r = select(max_fd + 1, &rfds, &wfds, &efds, ptv);
+        if (block) {
+            MP_THREAD_GIL_ENTER();
+        }
+        if (r < 0) {
+            // fall back to the objects' own polls to find the culprit
+            max_fd = -1;
+        }
+        for (mp_uint_t i = 0; i < poll_map->alloc; ++i) {
+            if (!MP_MAP_SLOT_IS_FILLED(poll_map, i)) {
+                continue;
+            }
+            poll_obj_t *poll_obj = (poll_obj_t*)poll_map->table[i].value;
+            if (poll_obj->kind != POLL_KIND_FD || poll_obj->fd < 0 || poll_obj->fd >= FD_SETSIZE) {
+                continue;
+            }
+            if (max_fd < 0) {
+                n_ready += poll_obj_ioctl(poll_obj, rwx_num);
+                continue;
+            }
+            mp_uint_t ret = 0;
+            if (FD_ISSET(poll_obj->fd, &rfds)) {
+                ret |= MP_STREAM_POLL_RD;
+            }
+            if (FD_ISSET(poll_obj->fd, &wfds)) {
+                ret |= MP_STREAM_POLL_WR;
+            }
+            if (FD_ISSET(poll_obj->fd, &efds)) {
+                ret |= MP_STREAM_POLL_HUP;
             }
+            n_ready += poll_obj_set_ret(poll_obj, ret, rwx_num);
         }
     }
+    #endif
+
     return n_ready;
 }
 
+// Poll the objects in the map until one is ready or timeout ms (-1 for no
+// limit) have passed.  Rather than waking every tick, a pass sleeps in
+// select() when there are objects with an fd, or in MICROPY_PY_USELECT_WAIT
+// when all the others can notify the poll.  Objects which can do neither
+// still get polled every tick.
+STATIC mp_uint_t poll_map_wait(mp_map_t *poll_map, mp_uint_t *rwx_num, int64_t timeout) {
+    size_t n_kind[3] = {0, 0, 0};
+    for (mp_uint_t i = 0; i < poll_map->alloc; ++i) {
+        if (MP_MAP_SLOT_IS_FILLED(poll_map, i)) {
+            n_kind[((poll_obj_t*)poll_map->table[i].value)->kind] += 1;
+        }
+    }
+
+    int64_t start_tick = mp_hal_ticks_ms();
+    for (;;) {
+        // how long this pass may sleep for
+        mp_int_t wait_ms = MICROPY_PY_USELECT_MAX_WAIT_MS;
+        if (timeout != -1) {
+            int64_t left = timeout - (int64_t)(mp_hal_ticks_ms() - start_tick);
+            if (left < 0) {
+                left = 0;
+            }
+            if (left < wait_ms) {
+                wait_ms = left;
+            }
+        }
+        if (n_kind[POLL_KIND_IOCTL] > 0) {
+            // nothing will wake us for these, so check them again soon
+            wait_ms = wait_ms > 0 ? 1 : 0;
+        } else if (n_kind[POLL_KIND_NOTIFY] > 0 && n_kind[POLL_KIND_FD] > 0 && wait_ms > 10) {
+            // a notification can't interrupt select(), so keep its sleeps short
+            wait_ms = 10;
+        }
+
+        if (rwx_num != NULL) {
+            rwx_num[0] = rwx_num[1] = rwx_num[2] = 0;
+        }
+        bool slept;
+        mp_uint_t n_ready = poll_map_poll(poll_map, rwx_num, wait_ms, &slept);
+        if (n_ready > 0 || (timeout != -1 && mp_hal_ticks_ms() - start_tick >= timeout)) {
+            return n_ready;
+        }
+        if (slept) {
+            // select() did the waiting
+            POLL_HANDLE_PENDING();
+        } else if (n_kind[POLL_KIND_IOCTL] > 0 || n_kind[POLL_KIND_FD] > 0) {
+            MICROPY_EVENT_POLL_HOOK
+        } else {
+            MICROPY_PY_USELECT_WAIT(wait_ms);
+            POLL_HANDLE_PENDING();
+        }
+    }
+}
+
 /// \function select(rlist, wlist, xlist[, timeout])
 STATIC mp_obj_t select_select(uint n_args, const mp_obj_t *args) {
     // get array data from tuple/list arguments
@@ -142,39 +324,30 @@ STATIC mp_obj_t select_select(uint n_args, const mp_obj_t *args) {
     poll_map_add(&poll_map, w_array, rwx_len[1], MP_STREAM_POLL_WR, true);
     poll_map_add(&poll_map, x_array, rwx_len[2], MP_STREAM_POLL_ERR | MP_STREAM_POLL_HUP, true);
 
-    int64_t start_tick = mp_hal_ticks_ms();
+    poll_map_wait(&poll_map, rwx_len, timeout);
+    // one or more objects are ready, or we had a timeout
+    mp_obj_t list_array[3];
+    list_array[0] = mp_obj_new_list(rwx_len[0], NULL);
+    list_array[1] = mp_obj_new_list(rwx_len[1], NULL);
+    list_array[2] = mp_obj_new_list(rwx_len[2], NULL);
     rwx_len[0] = rwx_len[1] = rwx_len[2] = 0;
-    for (;;) {
-        // poll the objects
-        mp_uint_t n_ready = poll_map_poll(&poll_map, rwx_len);
-
-        if (n_ready > 0 || (timeout != -1 && mp_hal_ticks_ms() - start_tick >= timeout)) {
-            // one or more objects are ready, or we had a timeout
-            mp_obj_t list_array[3];
-            list_array[0] = mp_obj_new_list(rwx_len[0], NULL);
-            list_array[1] = mp_obj_new_list(rwx_len[1], NULL);
-            list_array[2] = mp_obj_new_list(rwx_len[2], NULL);
-            rwx_len[0] = rwx_len[1] = rwx_len[2] = 0;
-            for (mp_uint_t i = 0; i < poll_map.alloc; ++i) {
-                if (!MP_MAP_SLOT_IS_FILLED(&poll_map, i)) {
-                    continue;
-                }
-                poll_obj_t *poll_obj = (poll_obj_t*)poll_map.table[i].value;
-                if (poll_obj->flags_ret & MP_STREAM_POLL_RD) {
-                    ((mp_obj_list_t*)list_array[0])->items[rwx_len[0]++] = poll_obj->obj;
-                }
-                if (poll_obj->flags_ret & MP_STREAM_POLL_WR) {
-                    ((mp_obj_list_t*)list_array[1])->items[rwx_len[1]++] = poll_obj->obj;
-                }
-                if ((poll_obj->flags_ret & ~(MP_STREAM_POLL_RD | MP_STREAM_POLL_WR)) != 0) {
-                    ((mp_obj_list_t*)list_array[2])->items[rwx_len[2]++] = poll_obj->obj;
-                }
-            }
-            mp_map_deinit(&poll_map);
-            return mp_obj_new_tuple(3, list_array);
+    for (mp_uint_t i = 0; i < poll_map.alloc; ++i) {
+        if (!MP_MAP_SLOT_IS_FILLED(&poll_map, i)) {
+            continue;
+        }
+        poll_obj_t *poll_obj = (poll_obj_t*)poll_map.table[i].value;
+        if (poll_obj->flags_ret & MP_STREAM_POLL_RD) {
+            ((mp_obj_list_t*)list_array[0])->items[rwx_len[0]++] = poll_obj->obj;
+        }
+        if (poll_obj->flags_ret & MP_STREAM_POLL_WR) {
+            ((mp_obj_list_t*)list_array[1])->items[rwx_len[1]++] = poll_obj->obj;
+        }
+        if ((poll_obj->flags_ret & ~(MP_STREAM_POLL_RD | MP_STREAM_POLL_WR)) != 0) {
+            ((mp_obj_list_t*)list_array[2])->items[rwx_len[2]++] = poll_obj->obj;
         }
-        MICROPY_EVENT_POLL_HOOK
     }
+    mp_map_deinit(&poll_map);
+    return mp_obj_new_tuple(3, list_array);
 }
 MP_DEFINE_CONST_FUN_OBJ_VAR_BETWEEN(mp_select_select_obj, 3, 4, select_select);
 
@@ -245,18 +418,7 @@ STATIC mp_uint_t poll_poll_internal(uint n_args, const mp_obj_t *args) {
 
     self->flags = flags;
 
-    int64_t start_tick = mp_hal_ticks_ms();
-    mp_uint_t n_ready;
-    for (;;) {
-        // poll the objects
-        n_ready = poll_map_poll(&self->poll_map, NULL);
-        if (n_ready > 0 || (timeout != -1 && mp_hal_ticks_ms() - start_tick >= timeout)) {
-            break;
-        }
-        MICROPY_EVENT_POLL_HOOK
-    }
-
-    return n_ready;
+    return poll_map_wait(&self->poll_map, NULL, timeout);
 }
 
 STATIC mp_obj_t poll_poll(uint n_args, const mp_obj_t *args) {
@@ -93,7 +93,8 @@ STATIC mp_obj_t decompio_make_new(const mp_obj_type_t *type, size_t n_args, size
 header_error:
             mp_raise_ValueError("compression header");
         }
-        dict_sz = 1 << dict_opt;
+        // the header holds the base 2 log of the window size minus 8
+        dict_sz = 256 << dict_opt;
     } else {
         dict_sz = 1 << -dict_opt;
     }
@@ -180,11 +181,14 @@ STATIC mp_obj_t mod_uzlib_decompress(size_t n_args, const mp_obj_t *args) {
         if (st == TINF_DONE) {
             break;
         }
+        // grow the buffer geometrically, so large outputs aren't copied over
+        // and over again
         size_t offset = decomp->dest - dest_buf;
-        dest_buf = m_renew(byte, dest_buf, dest_buf_size, dest_buf_size + 256);
-        dest_buf_size += 256;
+        size_t grow = (dest_buf_size / 2 + 255) & ~255;
+        dest_buf = m_renew(byte, dest_buf, dest_buf_size, dest_buf_size + grow);
+        dest_buf_size += grow;
         decomp->dest = dest_buf + offset;
-        decomp->destSize = 256;
+        decomp->destSize = grow;
     }
 
     mp_uint_t final_sz = decomp->dest - dest_buf;
@@ -199,10 +203,236 @@ error:
 }
 STATIC MP_DEFINE_CONST_FUN_OBJ_VAR_BETWEEN(mod_uzlib_decompress_obj, 1, 3, mod_uzlib_decompress);
 
+#if MICROPY_PY_UZLIB_COMPRESS
+
+typedef struct _mp_obj_compio_t {
+    mp_obj_base_t base;
+    mp_obj_t dest_stream; // MP_OBJ_NULL for compressobj(), which collects the output in out
+    vstr_t out;
+    UZLIB_COMP comp;
+    bool finished;
+} mp_obj_compio_t;
+
+STATIC void write_dest(UZLIB_COMP *comp, const unsigned char *buf, unsigned int len) {
+    byte *p = (void*)comp;
+    p -= offsetof(mp_obj_compio_t, comp);
+    mp_obj_compio_t *self = (mp_obj_compio_t*)p;
+
+    if (self->dest_stream == MP_OBJ_NULL) {
+        vstr_add_strn(&self->out, (const char*)buf, len);
+        return;
+    }
+    int err;
+    mp_stream_write_exactly(self->dest_stream, buf, len, &err);
+    if (err != 0) {
+        mp_raise_OSError(err);
+    }
+}
+
+// Set up self for compressing with the level and wbits arguments, as for
+// zlib: wbits is negative for raw deflate, 16 more for gzip, and the window is
+// no bigger than needed for size_hint bytes of data (if it isn't 0).
+STATIC void compio_init(mp_obj_compio_t *self, mp_int_t level, mp_int_t wbits, size_t size_hint) {
+    int checksum_type = TINF_CHKSUM_ADLER;
+    if (wbits < 0) {
+        checksum_type = TINF_CHKSUM_NONE;
+        wbits = -wbits;
+    } else if (wbits >= 16) {
+        checksum_type = TINF_CHKSUM_CRC;
+        wbits -= 16;
+    }
+    if (level == -1) {
+        level = 6;
+    }
+    if (level < 1 || level > 9) {
+        mp_raise_ValueError("bad level");
+    }
+    if (wbits < UZLIB_COMP_MIN_WBITS || wbits > UZLIB_COMP_MAX_WBITS) {
+        mp_raise_ValueError("bad wbits");
+    }
+    if (size_hint != 0) {
+        while (wbits > UZLIB_COMP_MIN_WBITS && ((size_t)1 << (wbits - 1)) >= size_hint) {
+            wbits--;
+        }
+    }
+    // one hash entry per 2 window positions is enough for the chains to be short
+    int hash_bits = wbits - 1;
+    uzlib_compress_init(&self->comp, wbits, m_new(byte, 2 << wbits),
+        m_new(uint16_t, 1 << hash_bits), hash_bits, m_new(uint16_t, 1 << wbits), level);
+    self->comp.writeDest = write_dest;
+    self->finished = false;
+    uzlib_compress_header(&self->comp, checksum_type);
+}
+
+STATIC void compio_finish(mp_obj_compio_t *self) {
+    if (self->finished) {
+        return;
+    }
+    uzlib_compress_finish(&self->comp);
+    self->finished = true;
+    // the buffers aren't needed any more
+    UZLIB_COMP *comp = &self->comp;
+    m_del(byte, comp->window, 2 * comp->window_size);
+    m_del(uint16_t, comp->head, 1 << comp->hash_bits);
+    m_del(uint16_t, comp->prev, comp->window_size);
+    comp->window = NULL;
+    comp->head = NULL;
+    comp->prev = NULL;
+}
+
+enum { ARG_level, ARG_wbits };
+STATIC const mp_arg_t compio_allowed_args[] = {
+    { MP_QSTR_level, MP_ARG_INT, {.u_int = -1} },
+    { MP_QSTR_wbits, MP_ARG_INT, {.u_int = MICROPY_PY_UZLIB_COMPRESS_WBITS} },
+};
+
+STATIC mp_obj_t compio_make_new(const mp_obj_type_t *type, size_t n_args, size_t n_kw, const mp_obj_t *args) {
+    mp_arg_check_num(n_args, n_kw, 1, 3, true);
+    mp_arg_val_t vals[MP_ARRAY_SIZE(compio_allowed_args)];
+    mp_map_t kw_args;
+    mp_map_init_fixed_table(&kw_args, n_kw, args + n_args);
+    mp_arg_parse_all(n_args - 1, args + 1, &kw_args, MP_ARRAY_SIZE(compio_allowed_args), compio_allowed_args, vals);
+
+    mp_get_stream_raise(args[0], MP_STREAM_OP_WRITE);
+    mp_obj_compio_t *o = m_new_obj(mp_obj_compio_t);
+    o->base.type = type;
+    o->dest_stream = args[0];
+    compio_init(o, vals[ARG_level].u_int, vals[ARG_wbits].u_int, 0);
+    return MP_OBJ_FROM_PTR(o);
+}
+
+STATIC mp_uint_t compio_write(mp_obj_t o_in, const void *buf, mp_uint_t size, int *errcode) {
+    mp_obj_compio_t *o = MP_OBJ_TO_PTR(o_in);
+    if (o->finished) {
+        *errcode = MP_EINVAL;
+        return MP_STREAM_ERROR;
+    }
+    uzlib_compress(&o->comp, buf, size);
+    return size;
+}
+
+STATIC mp_uint_t compio_ioctl(mp_obj_t o_in, mp_uint_t request, uintptr_t arg, int *errcode) {
+    mp_obj_compio_t *o = MP_OBJ_TO_PTR(o_in);
+    (void)arg;
+    if (request == MP_STREAM_CLOSE) {
+        // finish the compressed stream, but leave the underlying one open
+        compio_finish(o);
+        return 0;
+    }
+    *errcode = MP_EINVAL;
+    return MP_STREAM_ERROR;
+}
+
+STATIC mp_obj_t compio___exit__(size_t n_args, const mp_obj_t *args) {
+    (void)n_args;
+    compio_finish(MP_OBJ_TO_PTR(args[0]));
+    return mp_const_none;
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_VAR_BETWEEN(compio___exit___obj, 4, 4, compio___exit__);
+
+// Return the output collected so far by a compressobj()
+STATIC mp_obj_t compio_take_output(mp_obj_compio_t *self) {
+    mp_obj_t res = mp_obj_new_bytes((const byte*)self->out.buf, self->out.len);
+    self->out.len = 0;
+    return res;
+}
+
+STATIC mp_obj_t compio_compress(mp_obj_t self_in, mp_obj_t data_in) {
+    mp_obj_compio_t *self = MP_OBJ_TO_PTR(self_in);
+    mp_buffer_info_t bufinfo;
+    mp_get_buffer_raise(data_in, &bufinfo, MP_BUFFER_READ);
+    if (self->finished) {
+        mp_raise_ValueError(NULL);
+    }
+    uzlib_compress(&self->comp, bufinfo.buf, bufinfo.len);
+    return compio_take_output(self);
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_2(compio_compress_obj, compio_compress);
+
+STATIC mp_obj_t compio_flush(mp_obj_t self_in) {
+    mp_obj_compio_t *self = MP_OBJ_TO_PTR(self_in);
+    compio_finish(self);
+    return compio_take_output(self);
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_1(compio_flush_obj, compio_flush);
+
+STATIC const mp_rom_map_elem_t compio_locals_dict_table[] = {
+    { MP_ROM_QSTR(MP_QSTR_write), MP_ROM_PTR(&mp_stream_write_obj) },
+    { MP_ROM_QSTR(MP_QSTR_close), MP_ROM_PTR(&mp_stream_close_obj) },
+    { MP_ROM_QSTR(MP_QSTR___enter__), MP_ROM_PTR(&mp_identity_obj) },
+    { MP_ROM_QSTR(MP_QSTR___exit__), MP_ROM_PTR(&compio___exit___obj) },
+};
+
+STATIC MP_DEFINE_CONST_DICT(compio_locals_dict, compio_locals_dict_table);
+
+STATIC const mp_stream_p_t compio_stream_p = {
+    .write = compio_write,
+    .ioctl = compio_ioctl,
+};
+
+STATIC const mp_obj_type_t compio_type = {
+    { &mp_type_type },
+    .name = MP_QSTR_CompIO,
+    .make_new = compio_make_new,
+    .protocol = &compio_stream_p,
+    .locals_dict = (void*)&compio_locals_dict,
+};
+
+STATIC const mp_rom_map_elem_t compressobj_locals_dict_table[] = {
+    { MP_ROM_QSTR(MP_QSTR_compress), MP_ROM_PTR(&compio_compress_obj) },
+    { MP_ROM_QSTR(MP_QSTR_flush), MP_ROM_PTR(&compio_flush_obj) },
+};
+
+STATIC MP_DEFINE_CONST_DICT(compressobj_locals_dict, compressobj_locals_dict_table);
+
+STATIC const mp_obj_type_t compressobj_type = {
+    { &mp_type_type },
+    .name = MP_QSTR_Compress,
+    .locals_dict = (void*)&compressobj_locals_dict,
+};
+
+STATIC mp_obj_t mod_uzlib_compressobj(size_t n_args, const mp_obj_t *pos_args, mp_map_t *kw_args) {
+    mp_arg_val_t vals[MP_ARRAY_SIZE(compio_allowed_args)];
+    mp_arg_parse_all(n_args, pos_args, kw_args, MP_ARRAY_SIZE(compio_allowed_args), compio_allowed_args, vals);
+    mp_obj_compio_t *o = m_new_obj(mp_obj_compio_t);
+    o->base.type = &compressobj_type;
+    o->dest_stream = MP_OBJ_NULL;
+    vstr_init(&o->out, 64);
+    compio_init(o, vals[ARG_level].u_int, vals[ARG_wbits].u_int, 0);
+    return MP_OBJ_FROM_PTR(o);
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_KW(mod_uzlib_compressobj_obj, 0, mod_uzlib_compressobj);
+
+STATIC mp_obj_t mod_uzlib_compress(size_t n_args, const mp_obj_t *pos_args, mp_map_t *kw_args) {
+    mp_arg_val_t vals[MP_ARRAY_SIZE(compio_allowed_args)];
+    mp_arg_parse_all(n_args - 1, pos_args + 1, kw_args, MP_ARRAY_SIZE(compio_allowed_args), compio_allowed_args, vals);
+    mp_buffer_info_t bufinfo;
+    mp_get_buffer_raise(pos_args[0], &bufinfo, MP_BUFFER_READ);
+
+    mp_obj_compio_t *o = m_new_obj(mp_obj_compio_t);
+    o->dest_stream = MP_OBJ_NULL;
+    // fixed codes rarely do better than half the size
+    vstr_init(&o->out, bufinfo.len / 2 + 16);
+    compio_init(o, vals[ARG_level].u_int, vals[ARG_wbits].u_int, bufinfo.len + 1);
+    uzlib_compress(&o->comp, bufinfo.buf, bufinfo.len);
+    compio_finish(o);
+    mp_obj_t res = mp_obj_new_str_from_vstr(&mp_type_bytes, &o->out);
+    m_del_obj(mp_obj_compio_t, o);
+    return res;
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_KW(mod_uzlib_compress_obj, 1, mod_uzlib_compress);
+
+#endif // MICROPY_PY_UZLIB_COMPRESS
+
 STATIC const mp_rom_map_elem_t mp_module_uzlib_globals_table[] = {
     { MP_ROM_QSTR(MP_QSTR___name__), MP_ROM_QSTR(MP_QSTR_uzlib) },
     { MP_ROM_QSTR(MP_QSTR_decompress), MP_ROM_PTR(&mod_uzlib_decompress_obj) },
     { MP_ROM_QSTR(MP_QSTR_DecompIO), MP_ROM_PTR(&decompio_type) },
+    #if MICROPY_PY_UZLIB_COMPRESS
+    { MP_ROM_QSTR(MP_QSTR_compress), MP_ROM_PTR(&mod_uzlib_compress_obj) },
+    { MP_ROM_QSTR(MP_QSTR_compressobj), MP_ROM_PTR(&mod_uzlib_compressobj_obj) },
+    { MP_ROM_QSTR(MP_QSTR_CompIO), MP_ROM_PTR(&compio_type) },
+    #endif
 };
 
 STATIC MP_DEFINE_CONST_DICT(mp_module_uzlib_globals, mp_module_uzlib_globals_table);
@@ -220,5 +450,8 @@ const mp_obj_module_t mp_module_uzlib = {
 #include "uzlib/tinfgzip.c"
 #include "uzlib/adler32.c"
 #include "uzlib/crc32.c"
+#if MICROPY_PY_UZLIB_COMPRESS
+#include "uzlib/tdeflate.c"
+#endif
 
 #endif // MICROPY_PY_UZLIB
@@ -0,0 +1,773 @@
+/*
+ * This file is part of the MicroPython project, http://micropython.org/
+ *
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2018 the MicroPython project contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <limits.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "py/binary.h"
+#include "py/objarray.h"
+#include "py/runtime.h"
+
+#if MICROPY_PY_VECTOR
+
+// The vector module does element-wise arithmetic and reductions directly on
+// the memory of array, bytearray, bytes and memoryview objects.
+//
+// Elements are loaded in chunks of VECTOR_CHUNK into a local array of either
+// vector_int_t or mp_float_t, worked on there and stored back converted to
+// the typecode of the output.  The float type is used as soon as one of the
+// buffers has a float typecode or one of the scalar arguments is a float.
+// Processing a chunk at a time keeps the typecode dispatch out of the inner
+// loops and makes it safe for the output to be one of the inputs.
+//
+// Integer results are stored modulo the width of the output typecode, like
+// the array module does, float results saturate to its range.  The integer
+// reductions are exact: they fall back to arbitrary precision once the 64-bit
+// accumulator can't hold the result.
+//
+// Buffers of at least MICROPY_PY_VECTOR_GIL_RELEASE_LEN elements are worked
+// on with the GIL released, so other threads can run in the meantime.  This
+// is only done when no other thread can resize one of the buffers, which
+// would move or free its memory: bytes and read-only memoryviews (of bytes)
+// can't be resized, and neither can an output array created by the call.
+//
+// 'Q' elements, and 'L' ones if long has 64 bits, from 2**63 up load as
+// negative numbers.  That doesn't matter for the wrapping arithmetic, which
+// gives the same bits either way, but comparisons and the exact reductions
+// have to tell them apart.
+
+#define VECTOR_CHUNK (32)
+
+typedef long long vector_int_t;
+
+typedef struct _vector_buf_t {
+    byte *buf;
+    size_t len; // in elements
+    size_t itemsize;
+    char typecode;
+    bool is_mutable; // another thread can resize it
+} vector_buf_t;
+
+typedef union _vector_chunk_t {
+    vector_int_t i[VECTOR_CHUNK];
+    mp_float_t f[VECTOR_CHUNK];
+} vector_chunk_t;
+
+enum {
+    VECTOR_OP_ADD,
+    VECTOR_OP_MUL,
+    VECTOR_OP_SCALE,
+    VECTOR_OP_CLIP,
+    VECTOR_OP_CAST,
+};
+
+STATIC bool vector_is_float_typecode(char typecode) {
+    return typecode == 'f' || typecode == 'd';
+}
+
+// Elements which may not fit in vector_int_t.
+STATIC bool vector_is_uint64(const vector_buf_t *v) {
+    return (v->typecode == 'Q' || v->typecode == 'L') && v->itemsize == sizeof(vector_int_t);
+}
+
+STATIC void vector_get_buf(mp_obj_t obj, vector_buf_t *v, mp_uint_t flags) {
+    mp_buffer_info_t bufinfo;
+    mp_get_buffer_raise(obj, &bufinfo, flags);
+    switch (bufinfo.typecode) {
+        case BYTEARRAY_TYPECODE:
+        case 'b': case 'B': case 'h': case 'H': case 'i': case 'I':
+        case 'l': case 'L': case 'q': case 'Q': case 'f': case 'd':
+            break;
+        default:
+            mp_raise_ValueError("unsupported typecode");
+    }
+    v->buf = bufinfo.buf;
+    v->itemsize = mp_binary_get_size('@', bufinfo.typecode, NULL);
+    v->len = bufinfo.len / v->itemsize;
+    v->typecode = bufinfo.typecode;
+    v->is_mutable = !MP_OBJ_IS_TYPE(obj, &mp_type_bytes);
+    #if MICROPY_PY_BUILTINS_MEMORYVIEW
+    if (MP_OBJ_IS_TYPE(obj, &mp_type_memoryview)) {
+        // bit 7 of the typecode tells that the memoryview is writable
+        v->is_mutable = (((mp_obj_array_t*)MP_OBJ_TO_PTR(obj))->typecode & 0x80) != 0;
+    }
+    #endif
+}
+
+// Get the output buffer: out_in if given, else a new array like a.
+STATIC mp_obj_t vector_get_out(mp_obj_t out_in, const vector_buf_t *a, size_t len, char typecode, vector_buf_t *out) {
+    bool is_new = out_in == mp_const_none;
+    if (is_new) {
+        out_in = mp_obj_new_array(typecode, len);
+    }
+    vector_get_buf(out_in, out, MP_BUFFER_WRITE);
+    if (is_new) {
+        // no other thread has a reference to it yet
+        out->is_mutable = false;
+    }
+    if (out->len != len) {
+        mp_raise_ValueError("length mismatch");
+    }
+    // the output may be an input, but not overlap one partially
+    if (a != NULL && out->buf != a->buf
+        && out->buf < a->buf + a->len * a->itemsize && a->buf < out->buf + out->len * out->itemsize) {
+        mp_raise_ValueError("overlapping buffers");
+    }
+    return out_in;
+}
+
+#define VECTOR_LOAD(type) { \
+        const type *p = (const type*)v->buf + start; \
+        for (size_t k = 0; k < n; ++k) { \
+            dst[k] = p[k]; \
+        } \
+        break; \
+    }
+
+STATIC void vector_load_int(const vector_buf_t *v, size_t start, size_t n, vector_int_t *dst) {
+    switch (v->typecode) {
+        case 'b': VECTOR_LOAD(int8_t)
+        case BYTEARRAY_TYPECODE:
+        case 'B': VECTOR_LOAD(uint8_t)
+        case 'h': VECTOR_LOAD(int16_t)
+        case 'H': VECTOR_LOAD(uint16_t)
+        case 'i': VECTOR_LOAD(int)
+        case 'I': VECTOR_LOAD(unsigned int)
+        case 'l': VECTOR_LOAD(long)
+        case 'L': VECTOR_LOAD(unsigned long)
+        case 'q': VECTOR_LOAD(long long)
+        default: VECTOR_LOAD(unsigned long long)
+    }
+}
+
+STATIC void vector_load_float(const vector_buf_t *v, size_t start, size_t n, mp_float_t *dst) {
+    switch (v->typecode) {
+        case 'b': VECTOR_LOAD(int8_t)
+        case BYTEARRAY_TYPECODE:
+        case 'B': VECTOR_LOAD(uint8_t)
+        case 'h': VECTOR_LOAD(int16_t)
+        case 'H': VECTOR_LOAD(uint16_t)
+        case 'i': VECTOR_LOAD(int)
+        case 'I': VECTOR_LOAD(unsigned int)
+        case 'l': VECTOR_LOAD(long)
+        case 'L': VECTOR_LOAD(unsigned long)
+        case 'q': VECTOR_LOAD(long long)
+        case 'Q': VECTOR_LOAD(unsigned long long)
+        case 'f': VECTOR_LOAD(float)
+        default: VECTOR_LOAD(double)
+    }
+}
+
+#undef VECTOR_LOAD
+
+#define VECTOR_STORE(type, conv) { \
+        type *p = (type*)v->buf + start; \
+        for (size_t k = 0; k < n; ++k) { \
+            p[k] = conv(src[k]); \
+        } \
+        break; \
+    }
+
+STATIC void vector_store_int(vector_buf_t *v, size_t start, size_t n, const vector_int_t *src) {
+    #define CONV(x) (x)
+    switch (v->typecode) {
+        case 'b': VECTOR_STORE(int8_t, CONV)
+        case BYTEARRAY_TYPECODE:
+        case 'B': VECTOR_STORE(uint8_t, CONV)
+        case 'h': VECTOR_STORE(int16_t, CONV)
+        case 'H': VECTOR_STORE(uint16_t, CONV)
+        case 'i': VECTOR_STORE(int, CONV)
+        case 'I': VECTOR_STORE(unsigned int, CONV)
+        case 'l': VECTOR_STORE(long, CONV)
+        case 'L': VECTOR_STORE(unsigned long, CONV)
+        case 'q': VECTOR_STORE(long long, CONV)
+        default: VECTOR_STORE(unsigned long long, CONV)
+    }
+    #undef CONV
+}
+
+// Converting a float that is out of range of an integer type is undefined,
+// so saturate to the range of the type (and map NaN to 0).  The limits are
+// powers of two or one less, so comparing with them as floats is exact enough:
+// anything below the rounded-up maximum converts without overflow.
+#define VECTOR_STORE_SAT(type, lo, hi) { \
+        type *p = (type*)v->buf + start; \
+        for (size_t k = 0; k < n; ++k) { \
+            mp_float_t f = src[k]; \
+            p[k] = f != f ? 0 : f <= (mp_float_t)(lo) ? (lo) : f >= (mp_float_t)(hi) ? (hi) : (type)f; \
+        } \
+        break; \
+    }
+
+STATIC void vector_store_float(vector_buf_t *v, size_t start, size_t n, const mp_float_t *src) {
+    #define CONV(x) (x)
+    switch (v->typecode) {
+        case 'b': VECTOR_STORE_SAT(int8_t, INT8_MIN, INT8_MAX)
+        case BYTEARRAY_TYPECODE:
+        case 'B': VECTOR_STORE_SAT(uint8_t, 0, UINT8_MAX)
+        case 'h': VECTOR_STORE_SAT(int16_t, INT16_MIN, INT16_MAX)
+        case 'H': VECTOR_STORE_SAT(uint16_t, 0, UINT16_MAX)
+        case 'i': VECTOR_STORE_SAT(int, INT_MIN, INT_MAX)
+        case 'I': VECTOR_STORE_SAT(unsigned int, 0, UINT_MAX)
+        case 'l': VECTOR_STORE_SAT(long, LONG_MIN, LONG_MAX)
+        case 'L': VECTOR_STORE_SAT(unsigned long, 0, ULONG_MAX)
+        case 'q': VECTOR_STORE_SAT(long long, LLONG_MIN, LLONG_MAX)
+        case 'Q': VECTOR_STORE_SAT(unsigned long long, 0, ULLONG_MAX)
+        case 'f': VECTOR_STORE(float, CONV)
+        default: VECTOR_STORE(double, CONV)
+    }
+    #undef CONV
+}
+
+#undef VECTOR_STORE_SAT
+#undef VECTOR_STORE
+
+STATIC bool vector_gil_exit(size_t len, bool is_mutable) {
+    #if MICROPY_PY_THREAD_GIL
+    if (len >= MICROPY_PY_VECTOR_GIL_RELEASE_LEN && !is_mutable) {
+        MP_THREAD_GIL_EXIT();
+        return true;
+    }
+    #else
+    (void)len;
+    (void)is_mutable;
+    #endif
+    return false;
+}
+
+STATIC void vector_gil_enter(bool released) {
+    #if MICROPY_PY_THREAD_GIL
+    if (released) {
+        MP_THREAD_GIL_ENTER();
+    }
+    #else
+    (void)released;
+    #endif
+}
+
+/******************************************************************************/
+// element-wise operations
+
+typedef struct _vector_map_t {
+    vector_buf_t a;
+    vector_buf_t b; // only used if b_len != 0
+    vector_buf_t out;
+    size_t b_len;
+    bool is_float;
+    bool a_uint64; // a has elements which load as negative from 2**63 up
+    // the scalar arguments, in both domains
+    vector_int_t ki[2];
+    mp_float_t kf[2];
+} vector_map_t;
+
+// Work out the domain of the operation and convert the scalar arguments.
+STATIC void vector_map_scalars(vector_map_t *m, size_t n_args, const mp_obj_t *args) {
+    for (size_t i = 0; i < n_args; ++i) {
+        if (mp_obj_is_float(args[i])) {
+            m->is_float = true;
+        }
+    }
+    for (size_t i = 0; i < n_args; ++i) {
+        if (m->is_float) {
+            m->kf[i] = mp_obj_get_float(args[i]);
+        } else {
+            m->ki[i] = mp_obj_get_int(args[i]);
+        }
+    }
+}
+
+STATIC void vector_map_kernel(vector_map_t *m, int op) {
+    vector_chunk_t ca, cb;
+    for (size_t start = 0; start < m->a.len; start += VECTOR_CHUNK) {
+        size_t n = MIN(VECTOR_CHUNK, m->a.len - start);
+        if (m->is_float) {
+            mp_float_t *x = ca.f;
+            mp_float_t *y = cb.f;
+            vector_load_float(&m->a, start, n, x);
+            if (m->b_len != 0) {
+                vector_load_float(&m->b, start, n, y);
+            } else if (op == VECTOR_OP_ADD || op == VECTOR_OP_MUL) {
+                for (size_t k = 0; k < n; ++k) {
+                    y[k] = m->kf[0];
+                }
+            }
+            switch (op) {
+                case VECTOR_OP_ADD:
+                    for (size_t k = 0; k < n; ++k) {
+                        x[k] += y[k];
+                    }
+                    break;
+                case VECTOR_OP_MUL:
+                    for (size_t k = 0; k < n; ++k) {
+                        x[k] *= y[k];
+                    }
+                    break;
+                case VECTOR_OP_SCALE:
+                    for (size_t k = 0; k < n; ++k) {
+                        x[k] = x[k] * m->kf[0] + m->kf[1];
+                    }
+                    break;
+                case VECTOR_OP_CLIP:
+                    for (size_t k = 0; k < n; ++k) {
+                        x[k] = x[k] < m->kf[0] ? m->kf[0] : x[k] > m->kf[1] ? m->kf[1] : x[k];
+                    }
+                    break;
+            }
+            vector_store_float(&m->out, start, n, x);
+        } else {
+            vector_int_t *x = ca.i;
+            vector_int_t *y = cb.i;
+            vector_load_int(&m->a, start, n, x);
+            if (m->b_len != 0) {
+                vector_load_int(&m->b, start, n, y);
+            } else if (op == VECTOR_OP_ADD || op == VECTOR_OP_MUL) {
+                for (size_t k = 0; k < n; ++k) {
+                    y[k] = m->ki[0];
+                }
+            }
+            // add and multiply as unsigned to wrap around on overflow
+            switch (op) {
+                case VECTOR_OP_ADD:
+                    for (size_t k = 0; k < n; ++k) {
+                        x[k] = (unsigned long long)x[k] + (unsigned long long)y[k];
+                    }
+                    break;
+                case VECTOR_OP_MUL:
+                    for (size_t k = 0; k < n; ++k) {
+                        x[k] = (unsigned long long)x[k] * (unsigned long long)y[k];
+                    }
+                    break;
+                case VECTOR_OP_SCALE:
+                    for (size_t k = 0; k < n; ++k) {
+                        x[k] = (unsigned long long)x[k] * (unsigned long long)m->ki[0] + (unsigned long long)m->ki[1];
+                    }
+                    break;
+                case VECTOR_OP_CLIP:
+                    // an element of 2**63 or more is above any limit
+                    for (size_t k = 0; k < n; ++k) {
+                        x[k] = m->a_uint64 && x[k] < 0 ? m->ki[1]
+                            : x[k] < m->ki[0] ? m->ki[0] : x[k] > m->ki[1] ? m->ki[1] : x[k];
+                    }
+                    break;
+            }
+            vector_store_int(&m->out, start, n, x);
+        }
+    }
+}
+
+// Run op over a with the given scalar arguments, or the array b if b_in
+// isn't MP_OBJ_NULL, into out_in (None for a new array).
+STATIC mp_obj_t vector_map(int op, mp_obj_t a_in, mp_obj_t b_in, size_t n_args, const mp_obj_t *args, mp_obj_t out_in, char out_typecode) {
+    vector_map_t m;
+    vector_get_buf(a_in, &m.a, MP_BUFFER_READ);
+    m.is_float = vector_is_float_typecode(m.a.typecode);
+    m.a_uint64 = vector_is_uint64(&m.a);
+    m.b_len = 0;
+    if (b_in != MP_OBJ_NULL) {
+        if (MP_OBJ_IS_INT(b_in) || mp_obj_is_float(b_in)) {
+            n_args = 1;
+            args = &b_in;
+        } else {
+            vector_get_buf(b_in, &m.b, MP_BUFFER_READ);
+            if (m.b.len != m.a.len) {
+                mp_raise_ValueError("length mismatch");
+            }
+            m.b_len = m.b.len;
+            m.is_float |= vector_is_float_typecode(m.b.typecode);
+            n_args = 0;
+        }
+    }
+    if (out_typecode == 0) {
+        out_typecode = m.a.typecode;
+    }
+    out_in = vector_get_out(out_in, &m.a, m.a.len, out_typecode, &m.out);
+    if (m.b_len != 0 && m.out.buf != m.b.buf
+        && m.out.buf < m.b.buf + m.b.len * m.b.itemsize && m.b.buf < m.out.buf + m.out.len * m.out.itemsize) {
+        mp_raise_ValueError("overlapping buffers");
+    }
+    m.is_float |= vector_is_float_typecode(m.out.typecode);
+    vector_map_scalars(&m, n_args, args);
+
+    bool released = vector_gil_exit(m.a.len, m.a.is_mutable || (m.b_len != 0 && m.b.is_mutable) || m.out.is_mutable);
+    vector_map_kernel(&m, op);
+    vector_gil_enter(released);
+
+    return out_in;
+}
+
+STATIC mp_obj_t vector_add(size_t n_args, const mp_obj_t *args) {
+    return vector_map(VECTOR_OP_ADD, args[0], args[1], 0, NULL, n_args > 2 ? args[2] : mp_const_none, 0);
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_VAR_BETWEEN(vector_add_obj, 2, 3, vector_add);
+
+STATIC mp_obj_t vector_mul(size_t n_args, const mp_obj_t *args) {
+    return vector_map(VECTOR_OP_MUL, args[0], args[1], 0, NULL, n_args > 2 ? args[2] : mp_const_none, 0);
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_VAR_BETWEEN(vector_mul_obj, 2, 3, vector_mul);
+
+STATIC mp_obj_t vector_scale(size_t n_args, const mp_obj_t *args) {
+    mp_obj_t k[2] = {args[1], n_args > 2 ? args[2] : MP_OBJ_NEW_SMALL_INT(0)};
+    return vector_map(VECTOR_OP_SCALE, args[0], MP_OBJ_NULL, 2, k, n_args > 3 ? args[3] : mp_const_none, 0);
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_VAR_BETWEEN(vector_scale_obj, 2, 4, vector_scale);
+
+STATIC mp_obj_t vector_clip(size_t n_args, const mp_obj_t *args) {
+    return vector_map(VECTOR_OP_CLIP, args[0], MP_OBJ_NULL, 2, args + 1, n_args > 3 ? args[3] : mp_const_none, 0);
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_VAR_BETWEEN(vector_clip_obj, 3, 4, vector_clip);
+
+STATIC mp_obj_t vector_cast(mp_obj_t a_in, mp_obj_t dest_in) {
+    if (MP_OBJ_IS_STR(dest_in)) {
+        size_t len;
+        const char *typecode = mp_obj_str_get_data(dest_in, &len);
+        if (len != 1) {
+            mp_raise_ValueError("unsupported typecode");
+        }
+        return vector_map(VECTOR_OP_CAST, a_in, MP_OBJ_NULL, 0, NULL, mp_const_none, *typecode);
+    }
+    return vector_map(VECTOR_OP_CAST, a_in, MP_OBJ_NULL, 0, NULL, dest_in, 0);
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_2(vector_cast_obj, vector_cast);
+
+/******************************************************************************/
+// reductions
+
+enum {
+    VECTOR_RED_SUM,
+    VECTOR_RED_MIN,
+    VECTOR_RED_MAX,
+    VECTOR_RED_DOT,
+};
+
+STATIC bool vector_int_fits(const vector_buf_t *v, const vector_int_t *x, size_t n) {
+    if (vector_is_uint64(v)) {
+        for (size_t k = 0; k < n; ++k) {
+            if (x[k] < 0) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+// Integer reduction with Python ints, for when the result or one of the
+// elements doesn't fit in vector_int_t.  This runs with the GIL held, so it
+// gets the buffers again in case they changed while it was released.
+STATIC mp_obj_t vector_reduce_big(int op, mp_obj_t a_in, mp_obj_t b_in) {
+    vector_buf_t a, b;
+    vector_get_buf(a_in, &a, MP_BUFFER_READ);
+    if (op == VECTOR_RED_DOT) {
+        vector_get_buf(b_in, &b, MP_BUFFER_READ);
+        if (b.len != a.len) {
+            mp_raise_ValueError("length mismatch");
+        }
+    } else if (a.len == 0) {
+        mp_raise_ValueError("empty sequence");
+    }
+    mp_obj_t acc = op == VECTOR_RED_SUM || op == VECTOR_RED_DOT ? MP_OBJ_NEW_SMALL_INT(0)
+        : mp_binary_get_val_array(a.typecode, a.buf, 0);
+    for (size_t i = 0; i < a.len; ++i) {
+        mp_obj_t x = mp_binary_get_val_array(a.typecode, a.buf, i);
+        switch (op) {
+            case VECTOR_RED_SUM:
+                acc = mp_binary_op(MP_BINARY_OP_ADD, acc, x);
+                break;
+            case VECTOR_RED_MIN:
+                if (mp_binary_op(MP_BINARY_OP_LESS, x, acc) == mp_const_true) {
+                    acc = x;
+                }
+                break;
+            case VECTOR_RED_MAX:
+                if (mp_binary_op(MP_BINARY_OP_MORE, x, acc) == mp_const_true) {
+                    acc = x;
+                }
+                break;
+            default:
+                x = mp_binary_op(MP_BINARY_OP_MULTIPLY, x, mp_binary_get_val_array(b.typecode, b.buf, i));
+                acc = mp_binary_op(MP_BINARY_OP_ADD, acc, x);
+                break;
+        }
+    }
+    return acc;
+}
+
+STATIC mp_obj_t vector_reduce(int op, mp_obj_t a_in, mp_obj_t b_in) {
+    vector_buf_t a, b;
+    vector_get_buf(a_in, &a, MP_BUFFER_READ);
+    bool is_float = vector_is_float_typecode(a.typecode);
+    if (op == VECTOR_RED_DOT) {
+        vector_get_buf(b_in, &b, MP_BUFFER_READ);
+        if (b.len != a.len) {
+            mp_raise_ValueError("length mismatch");
+        }
+        is_float |= vector_is_float_typecode(b.typecode);
+    } else if (a.len == 0 && op != VECTOR_RED_SUM) {
+        mp_raise_ValueError("empty sequence");
+    }
+
+    vector_chunk_t ca, cb;
+    vector_int_t acc_i = 0;
+    mp_float_t acc_f = 0;
+    bool overflow = false;
+    bool released = vector_gil_exit(a.len, a.is_mutable || (op == VECTOR_RED_DOT && b.is_mutable));
+    for (size_t start = 0; start < a.len && !overflow; start += VECTOR_CHUNK) {
+        size_t n = MIN(VECTOR_CHUNK, a.len - start);
+        if (is_float) {
+            mp_float_t *x = ca.f;
+            vector_load_float(&a, start, n, x);
+            if (start == 0 && op != VECTOR_RED_SUM && op != VECTOR_RED_DOT) {
+                acc_f = x[0];
+            }
+            switch (op) {
+                case VECTOR_RED_SUM:
+                    for (size_t k = 0; k < n; ++k) {
+                        acc_f += x[k];
+                    }
+                    break;
+                case VECTOR_RED_MIN:
+                    for (size_t k = 0; k < n; ++k) {
+                        acc_f = x[k] < acc_f ? x[k] : acc_f;
+                    }
+                    break;
+                case VECTOR_RED_MAX:
+                    for (size_t k = 0; k < n; ++k) {
+                        acc_f = x[k] > acc_f ? x[k] : acc_f;
+                    }
+                    break;
+                default: {
+                    mp_float_t *y = cb.f;
+                    vector_load_float(&b, start, n, y);
+                    for (size_t k = 0; k < n; ++k) {
+                        acc_f += x[k] * y[k];
+                    }
+                    break;
+                }
+            }
+        } else {
+            vector_int_t *x = ca.i;
+            vector_load_int(&a, start, n, x);
+            if (!vector_int_fits(&a, x, n)) {
+                overflow = true;
+                break;
+            }
+            if (start == 0 && op != VECTOR_RED_SUM && op != VECTOR_RED_DOT) {
+                acc_i = x[0];
+            }
+            switch (op) {
+                case VECTOR_RED_SUM:
+                    for (size_t k = 0; k < n; ++k) {
+                        overflow |= __builtin_add_overflow(acc_i, x[k], &acc_i);
+                    }
+                    break;
+                case VECTOR_RED_MIN:
+                    for (size_t k = 0; k < n; ++k) {
+                        acc_i = x[k] < acc_i ? x[k] : acc_i;
+                    }
+                    break;
+                case VECTOR_RED_MAX:
+                    for (size_t k = 0; k < n; ++k) {
+                        acc_i = x[k] > acc_i ? x[k] : acc_i;
+                    }
+                    break;
+                default: {
+                    vector_int_t *y = cb.i;
+                    vector_load_int(&b, start, n, y);
+                    if (!vector_int_fits(&b, y, n)) {
+                        overflow = true;
+                        break;
+                    }
+                    for (size_t k = 0; k < n; ++k) {
+                        vector_int_t p;
+                        overflow |= __builtin_mul_overflow(x[k], y[k], &p);
+                        overflow |= __builtin_add_overflow(acc_i, p, &acc_i);
+                    }
+                    break;
+                }
+            }
+        }
+    }
+    vector_gil_enter(released);
+
+    if (is_float) {
+        return mp_obj_new_float(acc_f);
+    }
+    if (overflow) {
+        return vector_reduce_big(op, a_in, b_in);
+    }
+    return mp_obj_new_int_from_ll(acc_i);
+}
+
+STATIC mp_obj_t vector_sum(mp_obj_t a_in) {
+    return vector_reduce(VECTOR_RED_SUM, a_in, MP_OBJ_NULL);
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_1(vector_sum_obj, vector_sum);
+
+STATIC mp_obj_t vector_min(mp_obj_t a_in) {
+    return vector_reduce(VECTOR_RED_MIN, a_in, MP_OBJ_NULL);
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_1(vector_min_obj, vector_min);
+
+STATIC mp_obj_t vector_max(mp_obj_t a_in) {
+    return vector_reduce(VECTOR_RED_MAX, a_in, MP_OBJ_NULL);
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_1(vector_max_obj, vector_max);
+
+STATIC mp_obj_t vector_dot(mp_obj_t a_in, mp_obj_t b_in) {
+    return vector_reduce(VECTOR_RED_DOT, a_in, b_in);
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_2(vector_dot_obj, vector_dot);
+
+/******************************************************************************/
+// convolution
+
+// out[i] = sum(a[i - j] * k[j]) for the len(a) + len(k) - 1 outputs.  The
+// kernel is loaded once and a then goes through a window of
+// VECTOR_CHUNK + len(k) - 1 elements, so the temporary memory only depends
+// on the size of the kernel.
+STATIC mp_obj_t vector_convolve(size_t n_args, const mp_obj_t *args) {
+    vector_buf_t a, k, out;
+    vector_get_buf(args[0], &a, MP_BUFFER_READ);
+    vector_get_buf(args[1], &k, MP_BUFFER_READ);
+    if (a.len == 0 || k.len == 0) {
+        mp_raise_ValueError("empty sequence");
+    }
+    size_t out_len = a.len + k.len - 1;
+    mp_obj_t out_in = vector_get_out(n_args > 2 ? args[2] : mp_const_none, NULL, out_len, a.typecode, &out);
+    byte *out_end = out.buf + out.len * out.itemsize;
+    if ((out.buf < a.buf + a.len * a.itemsize && a.buf < out_end)
+        || (out.buf < k.buf + k.len * k.itemsize && k.buf < out_end)) {
+        mp_raise_ValueError("overlapping buffers");
+    }
+    bool is_float = vector_is_float_typecode(a.typecode) || vector_is_float_typecode(k.typecode)
+        || vector_is_float_typecode(out.typecode);
+
+    // the kernel reversed, then the window of a, then a chunk of output
+    size_t win_len = VECTOR_CHUNK + k.len - 1;
+    size_t el_size = is_float ? sizeof(mp_float_t) : sizeof(vector_int_t);
+    size_t tmp_len = (k.len + win_len + VECTOR_CHUNK) * el_size;
+
+    // The work is worth releasing the GIL for even when a can be resized by
+    // another thread, a is then copied after the temporary arrays.  The
+    // kernel is loaded before the GIL is released.
+    size_t work = out_len * k.len;
+    bool copy_a = MICROPY_PY_THREAD_GIL && a.is_mutable && !out.is_mutable
+        && work >= MICROPY_PY_VECTOR_GIL_RELEASE_LEN;
+    size_t a_offset = (tmp_len + sizeof(vector_int_t) - 1) & ~(sizeof(vector_int_t) - 1);
+    if (copy_a) {
+        tmp_len = a_offset + a.len * a.itemsize;
+    }
+    byte *tmp = m_new(byte, tmp_len);
+    if (copy_a) {
+        memcpy(tmp + a_offset, a.buf, a.len * a.itemsize);
+        a.buf = tmp + a_offset;
+        a.is_mutable = false;
+    }
+
+    bool released;
+    if (is_float) {
+        mp_float_t *kr = (mp_float_t*)tmp;
+        mp_float_t *win = kr + k.len;
+        mp_float_t *res = win + win_len;
+        vector_load_float(&k, 0, k.len, win);
+        for (size_t j = 0; j < k.len; ++j) {
+            kr[j] = win[k.len - 1 - j];
+        }
+        released = vector_gil_exit(work, a.is_mutable || out.is_mutable);
+        for (size_t start = 0; start < out_len; start += VECTOR_CHUNK) {
+            size_t n = MIN(VECTOR_CHUNK, out_len - start);
+            // win[w] holds a[start - (k.len - 1) + w], 0 outside of a
+            for (size_t w = 0; w < n + k.len - 1; ++w) {
+                win[w] = 0;
+            }
+            size_t lo = start < k.len - 1 ? k.len - 1 - start : 0;
+            size_t hi = MIN(n + k.len - 1, a.len + k.len - 1 - start);
+            vector_load_float(&a, start + lo - (k.len - 1), hi - lo, win + lo);
+            for (size_t i = 0; i < n; ++i) {
+                mp_float_t acc = 0;
+                for (size_t j = 0; j < k.len; ++j) {
+                    acc += win[i + j] * kr[j];
+                }
+                res[i] = acc;
+            }
+            vector_store_float(&out, start, n, res);
+        }
+    } else {
+        vector_int_t *kr = (vector_int_t*)tmp;
+        vector_int_t *win = kr + k.len;
+        vector_int_t *res = win + win_len;
+        vector_load_int(&k, 0, k.len, win);
+        for (size_t j = 0; j < k.len; ++j) {
+            kr[j] = win[k.len - 1 - j];
+        }
+        released = vector_gil_exit(work, a.is_mutable || out.is_mutable);
+        for (size_t start = 0; start < out_len; start += VECTOR_CHUNK) {
+            size_t n = MIN(VECTOR_CHUNK, out_len - start);
+            for (size_t w = 0; w < n + k.len - 1; ++w) {
+                win[w] = 0;
+            }
+            size_t lo = start < k.len - 1 ? k.len - 1 - start : 0;
+            size_t hi = MIN(n + k.len - 1, a.len + k.len - 1 - start);
+            vector_load_int(&a, start + lo - (k.len - 1), hi - lo, win + lo);
+            for (size_t i = 0; i < n; ++i) {
+                vector_int_t acc = 0;
+                for (size_t j = 0; j < k.len; ++j) {
+                    acc = (unsigned long long)acc + (unsigned long long)win[i + j] * (unsigned long long)kr[j];
+                }
+                res[i] = acc;
+            }
+            vector_store_int(&out, start, n, res);
+        }
+    }
+    vector_gil_enter(released);
+
+    m_del(byte, tmp, tmp_len);
+    return out_in;
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_VAR_BETWEEN(vector_convolve_obj, 2, 3, vector_convolve);
+
+STATIC const mp_rom_map_elem_t vector_module_globals_table[] = {
+    { MP_ROM_QSTR(MP_QSTR___name__), MP_ROM_QSTR(MP_QSTR_vector) },
+    { MP_ROM_QSTR(MP_QSTR_add), MP_ROM_PTR(&vector_add_obj) },
+    { MP_ROM_QSTR(MP_QSTR_mul), MP_ROM_PTR(&vector_mul_obj) },
+    { MP_ROM_QSTR(MP_QSTR_scale), MP_ROM_PTR(&vector_scale_obj) },
+    { MP_ROM_QSTR(MP_QSTR_clip), MP_ROM_PTR(&vector_clip_obj) },
+    { MP_ROM_QSTR(MP_QSTR_cast), MP_ROM_PTR(&vector_cast_obj) },
+    { MP_ROM_QSTR(MP_QSTR_sum), MP_ROM_PTR(&vector_sum_obj) },
+    { MP_ROM_QSTR(MP_QSTR_min), MP_ROM_PTR(&vector_min_obj) },
+    { MP_ROM_QSTR(MP_QSTR_max), MP_ROM_PTR(&vector_max_obj) },
+    { MP_ROM_QSTR(MP_QSTR_dot), MP_ROM_PTR(&vector_dot_obj) },
+    { MP_ROM_QSTR(MP_QSTR_convolve), MP_ROM_PTR(&vector_convolve_obj) },
+};
+
+STATIC MP_DEFINE_CONST_DICT(vector_module_globals, vector_module_globals_table);
+
+const mp_obj_module_t mp_module_vector = {
+    .base = { &mp_type_module },
+    .globals = (mp_obj_dict_t*)&vector_module_globals,
+};
+
+#endif // MICROPY_PY_VECTOR
@@ -0,0 +1,225 @@
+// Copyright 2007-2009 Russ Cox.  All Rights Reserved.
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file.
+
+#include "re1.5.h"
+
+// Pike VM: runs all threads of the program in lock step over the subject, so
+// the time taken is linear in the length of the subject, and it gives the
+// same (leftmost-first) results as the backtracking matchers.  It doesn't
+// allocate or recurse: all state lives in a work area provided by the caller,
+// of re1_5_pikevm_worksize() bytes.
+
+typedef struct {
+	int n;
+	int *pc;		// pc of each thread
+	const char **sub;	// nsubp capture pointers of each thread
+} ThreadList;
+
+typedef struct {
+	int pc;			// pc to follow, or -1 - index of the capture to restore
+	const char *old;	// value to restore
+} Job;
+
+typedef struct {
+	ThreadList list[2];
+	const char **cur;	// captures of the thread being added
+	int *mark;		// generation a pc was last added to a list in
+	Job *stack;
+	int gen;
+} PikeVM;
+
+int
+re1_5_pikevm_worksize(ByteProg *prog, int nsubp)
+{
+	// each instruction is added to a list at most once per step, and pushes
+	// at most 2 jobs when followed
+	return 2 * prog->len * (sizeof(int) + nsubp * sizeof(const char*))
+		+ nsubp * sizeof(const char*)
+		+ prog->bytelen * sizeof(int)
+		+ (2 * prog->len + 1) * sizeof(Job);
+}
+
+// Follow the instructions from pc that don't consume input, adding a thread
+// with the captures sub to l for each consuming (or Match) instruction reached.
+static void
+addthread(PikeVM *vm, ThreadList *l, char *code, int pc0, const char *sp, Subject *input, const char **sub, int nsubp)
+{
+	Job *stack = vm->stack;
+	int sp_job = 0;
+	int off;
+
+	if(inst_is_consumer(code[pc0]) || code[pc0] == Match) {
+		// the common case of a run of consumers needs no following
+		if(vm->mark[pc0] != vm->gen) {
+			vm->mark[pc0] = vm->gen;
+			l->pc[l->n] = pc0;
+			memcpy(l->sub + l->n * nsubp, sub, nsubp * sizeof(const char*));
+			l->n++;
+		}
+		return;
+	}
+	if(sub != vm->cur)
+		memcpy(vm->cur, sub, nsubp * sizeof(const char*));
+	stack[sp_job++].pc = pc0;
+	while(sp_job > 0) {
+		Job *job = &stack[--sp_job];
+		int pc = job->pc;
+		if(pc < 0) {
+			vm->cur[-1 - pc] = job->old;
+			continue;
+		}
+		if(vm->mark[pc] == vm->gen)
+			continue;
+		vm->mark[pc] = vm->gen;
+		switch(code[pc]) {
+		case Jmp:
+			off = (signed char)code[pc + 1];
+			stack[sp_job++].pc = pc + 2 + off;
+			break;
+		case Split:
+			// prefer the next instruction: it's pushed last to be followed first
+			off = (signed char)code[pc + 1];
+			stack[sp_job++].pc = pc + 2 + off;
+			stack[sp_job++].pc = pc + 2;
+			break;
+		case RSplit:
+			off = (signed char)code[pc + 1];
+			stack[sp_job++].pc = pc + 2;
+			stack[sp_job++].pc = pc + 2 + off;
+			break;
+		case Save:
+			off = (unsigned char)code[pc + 1];
+			if(off < nsubp) {
+				stack[sp_job].pc = -1 - off;
+				stack[sp_job++].old = vm->cur[off];
+				vm->cur[off] = sp;
+			}
+			stack[sp_job++].pc = pc + 2;
+			break;
+		case Bol:
+			if(sp == input->begin_line)
+				stack[sp_job++].pc = pc + 1;
+			break;
+		case Eol:
+			if(sp == input->end)
+				stack[sp_job++].pc = pc + 1;
+			break;
+		default:
+			l->pc[l->n] = pc;
+			memcpy(l->sub + l->n * nsubp, vm->cur, nsubp * sizeof(const char*));
+			l->n++;
+			break;
+		}
+	}
+}
+
+// Return the pc after the consuming instruction at pc if it matches at sp,
+// else -1.
+static inline int
+consume(char *code, int pc, const char *sp)
+{
+	switch(code[pc]) {
+	case Char:
+		if(*sp == code[pc + 1])
+			return pc + 2;
+		break;
+	case Any:
+		return pc + 1;
+	case Class:
+	case ClassNot:
+		if(_re1_5_classmatch(code + pc + 1, sp))
+			return pc + 2 + (unsigned char)code[pc + 1] * 2;
+		break;
+	case NamedClass:
+		if(_re1_5_namedclassmatch(code + pc + 1, sp))
+			return pc + 2;
+		break;
+	default:
+		re1_5_fatal("pikevm");
+	}
+	return -1;
+}
+
+int
+re1_5_pikevm(ByteProg *prog, Subject *input, const char **subp, int nsubp, int is_anchored, void *work)
+{
+	PikeVM vm;
+	char *code = prog->insts;
+	char *p = work;
+	int i, matched = 0;
+
+	for(i = 0; i < 2; i++) {
+		vm.list[i].n = 0;
+		vm.list[i].sub = (const char**)p;
+		p += prog->len * nsubp * sizeof(const char*);
+	}
+	vm.cur = (const char**)p;
+	p += nsubp * sizeof(const char*);
+	vm.stack = (Job*)p;
+	p += (2 * prog->len + 1) * sizeof(Job);
+	for(i = 0; i < 2; i++) {
+		vm.list[i].pc = (int*)p;
+		p += prog->len * sizeof(int);
+	}
+	vm.mark = (int*)p;
+	memset(vm.mark, 0, prog->bytelen * sizeof(int));
+	vm.gen = 1;
+
+	// rather than run the ".*?" prefix of the program for a search, start a
+	// thread at the body on each step, with the lowest priority, until there's
+	// a match; if the body begins by consuming, only where that matches
+	int start = NON_ANCHORED_PREFIX;
+	int first = start;
+	while(code[first] == Save)
+		first += 2;
+	if(!inst_is_consumer(code[first]))
+		first = -1;
+
+	ThreadList *clist = &vm.list[0];
+	ThreadList *nlist = &vm.list[1];
+	const char *sp = input->begin;
+	for(;;) {
+		if(clist->n == 0) {
+			if(matched || (is_anchored && sp > input->begin))
+				break;
+			if(first >= 0 && !is_anchored) {
+				while(sp < input->end && consume(code, first, sp) < 0)
+					sp++;
+				if(sp >= input->end)
+					break;
+			}
+			vm.gen++;
+			memset(vm.cur, 0, nsubp * sizeof(const char*));
+			addthread(&vm, clist, code, start, sp, input, vm.cur, nsubp);
+		}
+		vm.gen++;
+		nlist->n = 0;
+		for(i = 0; i < clist->n; i++) {
+			int pc = clist->pc[i];
+			const char **sub = clist->sub + i * nsubp;
+			int next = -1;
+			if(code[pc] == Match) {
+				// threads after this one have a lower priority, so drop them
+				memcpy(subp, sub, nsubp * sizeof(const char*));
+				matched = 1;
+				break;
+			}
+			if(sp < input->end)
+				next = consume(code, pc, sp);
+			if(next >= 0)
+				addthread(&vm, nlist, code, next, sp + 1, input, sub, nsubp);
+		}
+		if(sp >= input->end)
+			break;
+		sp++;
+		if(!matched && !is_anchored && nlist->n > 0 && (first < 0 || (sp < input->end && consume(code, first, sp) >= 0))) {
+			memset(vm.cur, 0, nsubp * sizeof(const char*));
+			addthread(&vm, nlist, code, start, sp, input, vm.cur, nsubp);
+		}
+		ThreadList *t = clist;
+		clist = nlist;
+		nlist = t;
+	}
+	return matched;
+}
@@ -0,0 +1,380 @@
+/*
+ * tdeflate  -  tiny deflate
+ *
+ * LZ77 with hash chains over a sliding window, encoded with the fixed
+ * Huffman codes of DEFLATE (RFC 1951) in a single block.
+ *
+ * This software is provided 'as-is', without any express
+ * or implied warranty.  In no event will the authors be
+ * held liable for any damages arising from the use of
+ * this software.
+ *
+ * Permission is granted to anyone to use this software
+ * for any purpose, including commercial applications,
+ * and to alter it and redistribute it freely, subject to
+ * the following restrictions:
+ *
+ * 1. The origin of this software must not be
+ *    misrepresented; you must not claim that you
+ *    wrote the original software. If you use this
+ *    software in a product, an acknowledgment in
+ *    the product documentation would be appreciated
+ *    but is not required.
+ *
+ * 2. Altered source versions must be plainly marked
+ *    as such, and must not be misrepresented as
+ *    being the original software.
+ *
+ * 3. This notice may not be removed or altered from
+ *    any source distribution.
+ */
+
+#include <string.h>
+#include "tinf.h"
+
+#define MIN_MATCH 3
+#define MAX_MATCH 258
+/* lookahead kept before encoding a position, to find the longest match at it
+   and at the next one */
+#define MIN_LOOKAHEAD (MAX_MATCH + 1)
+/* matches of MIN_MATCH further than this cost more than the literals */
+#define TOO_FAR 4096
+
+/* search effort per level: maximum length of the hash chain followed, length
+   of match good enough to stop, and whether to look for a longer match at
+   the next position before taking one */
+static const struct {
+    unsigned short max_chain;
+    unsigned short nice_len;
+    char lazy;
+} comp_levels[9] = {
+    {4, 16, 0}, {8, 32, 0}, {16, 32, 0},
+    {16, 64, 1}, {32, 128, 1}, {128, 128, 1},
+    {256, 258, 1}, {1024, 258, 1}, {4096, 258, 1},
+};
+
+static const unsigned char rev4[16] = {
+    0x0, 0x8, 0x4, 0xc, 0x2, 0xa, 0x6, 0xe,
+    0x1, 0x9, 0x5, 0xd, 0x3, 0xb, 0x7, 0xf,
+};
+
+/* ----------------------- *
+ * -- output of bits     -- *
+ * ----------------------- */
+
+static void outbuf_flush(UZLIB_COMP *c)
+{
+    if (c->outlen > 0) {
+        c->writeDest(c, c->outbuf, c->outlen);
+        c->outlen = 0;
+    }
+}
+
+static void put_byte(UZLIB_COMP *c, unsigned char b)
+{
+    c->outbuf[c->outlen++] = b;
+    if (c->outlen == UZLIB_COMP_OUTBUF_SIZE) {
+        outbuf_flush(c);
+    }
+}
+
+/* bits go out starting from the least significant one */
+static void put_bits(UZLIB_COMP *c, unsigned int bits, unsigned int n)
+{
+    c->bitbuf |= bits << c->bitcount;
+    c->bitcount += n;
+    while (c->bitcount >= 8) {
+        put_byte(c, c->bitbuf);
+        c->bitbuf >>= 8;
+        c->bitcount -= 8;
+    }
+}
+
+/* Huffman codes go out starting from the most significant bit */
+static void put_code(UZLIB_COMP *c, unsigned int code, unsigned int n)
+{
+    unsigned int rev = rev4[code & 15] << 12 | rev4[(code >> 4) & 15] << 8
+        | rev4[(code >> 8) & 15] << 4 | rev4[code >> 12];
+    put_bits(c, rev >> (16 - n), n);
+}
+
+static void put_literal(UZLIB_COMP *c, unsigned int sym)
+{
+    if (sym < 144) {
+        put_code(c, 0x30 + sym, 8);
+    } else if (sym < 256) {
+        put_code(c, 0x190 + sym - 144, 9);
+    } else if (sym < 280) {
+        put_code(c, sym - 256, 7);
+    } else {
+        put_code(c, 0xc0 + sym - 280, 8);
+    }
+}
+
+static unsigned int log2_floor(unsigned int x)
+{
+    unsigned int n = 0;
+    while (x >>= 1) {
+        n++;
+    }
+    return n;
+}
+
+static void put_match(UZLIB_COMP *c, unsigned int len, unsigned int dist)
+{
+    /* length codes 257..284 have 4 codes per number of extra bits e, each
+       covering 1 << e lengths, after 8 codes without extra bits */
+    unsigned int l = len - MIN_MATCH;
+    if (l < 8) {
+        put_literal(c, 257 + l);
+    } else if (len == MAX_MATCH) {
+        put_literal(c, 285);
+    } else {
+        unsigned int e = log2_floor(l) - 2;
+        put_literal(c, 257 + 4 * e + 4 + ((l >> e) & 3));
+        put_bits(c, l & ((1 << e) - 1), e);
+    }
+
+    /* distance codes, likewise with 2 codes per number of extra bits */
+    unsigned int d = dist - 1;
+    if (d < 4) {
+        put_code(c, d, 5);
+    } else {
+        unsigned int e = log2_floor(d) - 1;
+        put_code(c, 2 * e + 2 + ((d >> e) & 1), 5);
+        put_bits(c, d & ((1 << e) - 1), e);
+    }
+}
+
+/* ----------------------- *
+ * -- LZ77 match search -- *
+ * ----------------------- */
+
+static inline unsigned int hash3(UZLIB_COMP *c, unsigned int pos)
+{
+    const unsigned char *p = c->window + pos;
+    uint32_t v = (uint32_t)p[0] << 16 | p[1] << 8 | p[2];
+    return (v * 2654435761u) >> (32 - c->hash_bits);
+}
+
+static inline void insert(UZLIB_COMP *c, unsigned int pos, unsigned int h)
+{
+    c->prev[pos & (c->window_size - 1)] = c->head[h];
+    c->head[h] = pos;
+}
+
+/* Find the longest match of at most max_len bytes at pos with the positions
+   on the hash chain from cur, returning its length (0 if under MIN_MATCH) */
+static unsigned int longest_match(UZLIB_COMP *c, unsigned int pos, unsigned int cur,
+    unsigned int max_len, unsigned int *dist)
+{
+    const unsigned char *win = c->window;
+    const unsigned char *p = win + pos;
+    unsigned int limit = pos > c->window_size ? pos - c->window_size : 0;
+    unsigned int chain = c->max_chain;
+    unsigned int best = MIN_MATCH - 1;
+
+    if (max_len > MAX_MATCH) {
+        max_len = MAX_MATCH;
+    }
+    while (cur > limit && chain-- > 0) {
+        const unsigned char *q = win + cur;
+        /* check the byte that would make a longer match first */
+        if (q[best] == p[best] && q[0] == p[0] && q[1] == p[1]) {
+            unsigned int len = 2;
+            while (len < max_len && q[len] == p[len]) {
+                len++;
+            }
+            if (len > best) {
+                best = len;
+                *dist = pos - cur;
+                if (len >= c->nice_len || len == max_len) {
+                    break;
+                }
+            }
+        }
+        cur = c->prev[cur & (c->window_size - 1)];
+    }
+    if (best == MIN_MATCH && *dist > TOO_FAR) {
+        return 0;
+    }
+    return best >= MIN_MATCH ? best : 0;
+}
+
+/* Move the second half of the window to the first one */
+static void slide(UZLIB_COMP *c)
+{
+    unsigned int w = c->window_size;
+    unsigned int i;
+
+    memcpy(c->window, c->window + w, w);
+    c->fill -= w;
+    c->pos -= w;
+    for (i = 0; i < (1u << c->hash_bits); i++) {
+        c->head[i] = c->head[i] >= w ? c->head[i] - w : 0;
+    }
+    for (i = 0; i < w; i++) {
+        c->prev[i] = c->prev[i] >= w ? c->prev[i] - w : 0;
+    }
+}
+
+/* Encode the window up to where there's less than MIN_LOOKAHEAD left, or to
+   its end if finishing */
+static void deflate_window(UZLIB_COMP *c, int finish)
+{
+    unsigned int len = 0, dist = 0;
+    int have_match = 0;
+
+    while (c->pos < c->fill) {
+        unsigned int avail = c->fill - c->pos;
+        if (avail < MIN_LOOKAHEAD && !finish) {
+            break;
+        }
+        if (avail < MIN_MATCH) {
+            put_literal(c, c->window[c->pos++]);
+            continue;
+        }
+
+        unsigned int h = hash3(c, c->pos);
+        if (!have_match) {
+            len = longest_match(c, c->pos, c->head[h], avail, &dist);
+        }
+        have_match = 0;
+        insert(c, c->pos, h);
+
+        if (len > 0 && c->lazy && len < c->nice_len && avail > MIN_MATCH) {
+            /* a longer match at the next position is worth a literal */
+            unsigned int dist1 = 0;
+            unsigned int len1 = longest_match(c, c->pos + 1, c->head[hash3(c, c->pos + 1)], avail - 1, &dist1);
+            if (len1 > len) {
+                put_literal(c, c->window[c->pos++]);
+                len = len1;
+                dist = dist1;
+                have_match = 1;
+                continue;
+            }
+        }
+
+        if (len > 0) {
+            put_match(c, len, dist);
+            /* hash the rest of the match, for later matches */
+            unsigned int end = c->pos + len;
+            for (c->pos++; c->pos < end; c->pos++) {
+                if (c->fill - c->pos >= MIN_MATCH) {
+                    insert(c, c->pos, hash3(c, c->pos));
+                }
+            }
+        } else {
+            put_literal(c, c->window[c->pos++]);
+        }
+    }
+}
+
+/* ----------------------- *
+ * -- API                -- *
+ * ----------------------- */
+
+void uzlib_compress_init(UZLIB_COMP *c, unsigned int wbits, void *window,
+    uint16_t *head, unsigned int hash_bits, uint16_t *prev, int level)
+{
+    c->window = window;
+    c->window_size = 1 << wbits;
+    c->fill = 0;
+    c->pos = 0;
+    c->head = head;
+    c->prev = prev;
+    c->hash_bits = hash_bits;
+    memset(head, 0, sizeof(uint16_t) << hash_bits);
+    memset(prev, 0, sizeof(uint16_t) << wbits);
+    c->max_chain = comp_levels[level - 1].max_chain;
+    c->nice_len = comp_levels[level - 1].nice_len;
+    c->lazy = comp_levels[level - 1].lazy;
+    c->checksum_type = TINF_CHKSUM_NONE;
+    c->in_size = 0;
+    c->bitbuf = 0;
+    c->bitcount = 0;
+    c->outlen = 0;
+}
+
+void uzlib_compress_header(UZLIB_COMP *c, int checksum_type)
+{
+    c->checksum_type = checksum_type;
+    if (checksum_type == TINF_CHKSUM_ADLER) {
+        /* CMF: deflate with the window size, FLG: check bits for it */
+        unsigned int cmf = (log2_floor(c->window_size) - 8) << 4 | 8;
+        unsigned int flg = c->max_chain >= 128 ? 2 << 6 : 0;
+        flg += 31 - (cmf << 8 | flg) % 31;
+        put_byte(c, cmf);
+        put_byte(c, flg);
+        c->checksum = 1;
+    } else if (checksum_type == TINF_CHKSUM_CRC) {
+        /* ID1, ID2, CM = deflate, FLG, MTIME, XFL, OS = unknown */
+        static const unsigned char gzip_header[10] = {0x1f, 0x8b, 8, 0, 0, 0, 0, 0, 0, 0xff};
+        unsigned int i;
+        for (i = 0; i < sizeof(gzip_header); i++) {
+            put_byte(c, gzip_header[i]);
+        }
+        c->checksum = ~0;
+    }
+
+    /* all the data goes in a final block with fixed codes */
+    put_bits(c, 1, 1);
+    put_bits(c, 1, 2);
+}
+
+void uzlib_compress(UZLIB_COMP *c, const void *src, unsigned int len)
+{
+    const unsigned char *s = src;
+
+    switch (c->checksum_type) {
+    case TINF_CHKSUM_ADLER:
+        c->checksum = uzlib_adler32(src, len, c->checksum);
+        break;
+    case TINF_CHKSUM_CRC:
+        c->checksum = uzlib_crc32(src, len, c->checksum);
+        break;
+    }
+    c->in_size += len;
+
+    while (len > 0) {
+        if (c->fill == 2 * c->window_size) {
+            slide(c);
+        }
+        unsigned int n = 2 * c->window_size - c->fill;
+        if (n > len) {
+            n = len;
+        }
+        memcpy(c->window + c->fill, s, n);
+        c->fill += n;
+        s += n;
+        len -= n;
+        deflate_window(c, 0);
+    }
+}
+
+void uzlib_compress_finish(UZLIB_COMP *c)
+{
+    unsigned int i;
+
+    deflate_window(c, 1);
+    /* end of block, then pad to a whole byte */
+    put_literal(c, 256);
+    if (c->bitcount > 0) {
+        put_bits(c, 0, 8 - c->bitcount);
+    }
+
+    if (c->checksum_type == TINF_CHKSUM_ADLER) {
+        for (i = 0; i < 4; i++) {
+            put_byte(c, c->checksum >> (24 - 8 * i));
+        }
+    } else if (c->checksum_type == TINF_CHKSUM_CRC) {
+        uint32_t crc = ~c->checksum;
+        for (i = 0; i < 4; i++) {
+            put_byte(c, crc >> (8 * i));
+        }
+        for (i = 0; i < 4; i++) {
+            put_byte(c, c->in_size >> (8 * i));
+        }
+    }
+    outbuf_flush(c);
+}
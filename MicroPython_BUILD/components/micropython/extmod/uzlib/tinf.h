@@ -41,9 +41,18 @@ extern "C" {
 
 /* data structures */
 
+/* number of bits decoded at once with a lookup table, longer codes are
+   decoded bit by bit */
+#ifndef TINF_FAST_BITS
+#define TINF_FAST_BITS 9
+#endif
+
 typedef struct {
    unsigned short table[16];  /* table of code length counts */
    unsigned short trans[288]; /* code -> symbol translation table */
+   /* next TINF_FAST_BITS bits of input -> code length << 12 | symbol,
+      0 for the prefixes of longer codes */
+   unsigned short fast[1 << TINF_FAST_BITS];
 } TINF_TREE;
 
 struct TINF_DATA;
@@ -101,7 +110,54 @@ int TINFCC uzlib_gzip_parse_header(TINF_DATA *d);
 
 /* Compression API */
 
-void TINFCC uzlib_compress(void *data, const uint8_t *src, unsigned slen);
+/* smallest and largest window, as log2 of its size */
+#define UZLIB_COMP_MIN_WBITS 9
+#define UZLIB_COMP_MAX_WBITS 15
+
+#define UZLIB_COMP_OUTBUF_SIZE 64
+
+struct uzlib_comp;
+typedef struct uzlib_comp {
+    /* Called with each chunk of compressed output */
+    void (*writeDest)(struct uzlib_comp *c, const unsigned char *buf, unsigned int len);
+
+    /* Sliding window of 2 * window_size bytes: history, then lookahead */
+    unsigned char *window;
+    unsigned int window_size;
+    unsigned int fill;
+    unsigned int pos;
+
+    /* Hash chains: the most recent position of each hash of 3 bytes, and
+       the position before it with the same hash, 0 meaning none */
+    uint16_t *head;
+    uint16_t *prev;
+    unsigned int hash_bits;
+
+    /* Match search effort, see uzlib_compress_init() */
+    unsigned int max_chain;
+    unsigned int nice_len;
+    char lazy;
+
+    char checksum_type;
+    uint32_t checksum;
+    uint32_t in_size;
+
+    uint32_t bitbuf;
+    unsigned int bitcount;
+    unsigned int outlen;
+    unsigned char outbuf[UZLIB_COMP_OUTBUF_SIZE];
+} UZLIB_COMP;
+
+/* window must have 2 << wbits bytes, head 1 << hash_bits entries and prev
+   1 << wbits entries; level is 1 (fastest) to 9 (best compression) */
+void TINFCC uzlib_compress_init(UZLIB_COMP *c, unsigned int wbits, void *window,
+    uint16_t *head, unsigned int hash_bits, uint16_t *prev, int level);
+/* start a raw (TINF_CHKSUM_NONE), zlib (TINF_CHKSUM_ADLER) or gzip
+   (TINF_CHKSUM_CRC) stream */
+void TINFCC uzlib_compress_header(UZLIB_COMP *c, int checksum_type);
+void TINFCC uzlib_compress(UZLIB_COMP *c, const void *src, unsigned int len);
+/* encode the rest of the data and end the stream */
+void TINFCC uzlib_compress_finish(UZLIB_COMP *c);
 
 /* Checksum API */
 
@@ -112,13 +112,40 @@ static void tinf_build_bits_base(unsigned char *bits, unsigned short *base, int
 }
 #endif
 
+/* build the lookup table of a tree from its counts and translation table:
+   the codes are canonical, so they're consecutive numbers for the symbols in
+   the order of trans, and they come in from the most significant bit */
+static void tinf_build_fast(TINF_TREE *t)
+{
+   unsigned int len, i, n = 0, code = 0;
+
+   for (i = 0; i < (1 << TINF_FAST_BITS); ++i) t->fast[i] = 0;
+
+   for (len = 1; len <= TINF_FAST_BITS; ++len)
+   {
+      for (i = 0; i < t->table[len]; ++i, ++n, ++code)
+      {
+         unsigned int rev = 0, c = code, k;
+         for (k = 0; k < len; ++k, c >>= 1) rev = (rev << 1) | (c & 1);
+
+         /* fill in the entries of all the bits that may follow the code */
+         for (k = rev & ((1 << len) - 1); k < (1 << TINF_FAST_BITS); k += 1 << len)
+         {
+            t->fast[k] = len << 12 | t->trans[n];
+         }
+      }
+      code <<= 1;
+   }
+}
+
 /* build the fixed huffman trees */
 static void tinf_build_fixed_trees(TINF_TREE *lt, TINF_TREE *dt)
 {
    int i;
 
-   /* build fixed length tree */
-   for (i = 0; i < 7; ++i) lt->table[i] = 0;
+   /* build fixed length tree, clear all the counts as tinf_build_fast()
+      reads them up to TINF_FAST_BITS, whatever the previous block left */
+   for (i = 0; i < 16; ++i) lt->table[i] = 0;
 
    lt->table[7] = 24;
    lt->table[8] = 152;
@@ -130,11 +157,14 @@ static void tinf_build_fixed_trees(TINF_TREE *lt, TINF_TREE *dt)
    for (i = 0; i < 112; ++i) lt->trans[24 + 144 + 8 + i] = 144 + i;
 
    /* build fixed distance tree */
-   for (i = 0; i < 5; ++i) dt->table[i] = 0;
+   for (i = 0; i < 16; ++i) dt->table[i] = 0;
 
    dt->table[5] = 32;
 
    for (i = 0; i < 32; ++i) dt->trans[i] = i;
+
+   tinf_build_fast(lt);
+   tinf_build_fast(dt);
 }
 
 /* given an array of code lengths, build a tree */
@@ -163,6 +193,8 @@ static void tinf_build_tree(TINF_TREE *t, const unsigned char *lengths, unsigned
    {
       if (lengths[i]) t->trans[offs[lengths[i]]++] = i;
    }
+
+   tinf_build_fast(t);
 }
 
 /* ---------------------- *
@@ -197,22 +229,29 @@ uint32_t tinf_get_be_uint32(TINF_DATA *d)
     return val;
 }
 
+/* The bits not used yet of the bytes read from the source are kept in tag,
+   from its least significant bit, with zeros above them.  A byte is only read
+   when the bits in tag aren't enough for what is decoded, so less than 8 bits
+   are left afterwards and nothing is read beyond the end of the compressed
+   data. */
+
 /* get one bit from source stream */
 static int tinf_getbit(TINF_DATA *d)
 {
    unsigned int bit;
 
    /* check if tag is empty */
-   if (!d->bitcount--)
+   if (!d->bitcount)
    {
       /* load next tag */
       d->tag = uzlib_get_byte(d);
-      d->bitcount = 7;
+      d->bitcount = 8;
    }
 
    /* shift bit out of tag */
    bit = d->tag & 0x01;
    d->tag >>= 1;
+   d->bitcount--;
 
    return bit;
 }
@@ -220,18 +259,18 @@ static int tinf_getbit(TINF_DATA *d)
 /* read a num bit value from a stream and add base */
 static unsigned int tinf_read_bits(TINF_DATA *d, int num, int base)
 {
-   unsigned int val = 0;
+   unsigned int val;
 
-   /* read num bits */
-   if (num)
+   while (d->bitcount < (unsigned int)num)
    {
-      unsigned int limit = 1 << (num);
-      unsigned int mask;
-
-      for (mask = 1; mask < limit; mask *= 2)
-         if (tinf_getbit(d)) val += mask;
+      d->tag |= (unsigned int)uzlib_get_byte(d) << d->bitcount;
+      d->bitcount += 8;
    }
 
+   val = d->tag & ((1u << num) - 1);
+   d->tag >>= num;
+   d->bitcount -= num;
+
    return val + base;
 }
 
@@ -240,6 +279,27 @@ static int tinf_decode_symbol(TINF_DATA *d, TINF_TREE *t)
 {
    int sum = 0, cur = 0, len = 0;
 
+   /* look the code up with the bits there are, reading more only if it's
+      longer than those */
+   for (;;)
+   {
+      unsigned int e = t->fast[d->tag & ((1 << TINF_FAST_BITS) - 1)];
+      unsigned int elen = e >> 12;
+
+      if (elen != 0 && elen <= d->bitcount)
+      {
+         d->tag >>= elen;
+         d->bitcount -= elen;
+         return e & 0xfff;
+      }
+      if (d->bitcount >= TINF_FAST_BITS) break;
+
+      d->tag |= (unsigned int)uzlib_get_byte(d) << d->bitcount;
+      d->bitcount += 8;
+   }
+
+   /* the code is longer than the lookup table, walk the tree */
+
    /* get more bits while code value is above sum */
    do {
 
@@ -373,17 +433,24 @@ static int tinf_inflate_block_data(TINF_DATA *d, TINF_TREE *lt, TINF_TREE *dt)
         }
     }
 
-    /* copy next byte from dict substring */
+    /* copy as much of the dict substring as fits in one go, the caller
+       counts one byte of it */
+    unsigned int n = d->curlen < d->destSize ? d->curlen : d->destSize;
+    d->curlen -= n;
+    d->destSize -= n - 1;
     if (d->dict_ring) {
-        TINF_PUT(d, d->dict_ring[d->lzOff]);
-        if ((unsigned)++d->lzOff == d->dict_size) {
-            d->lzOff = 0;
+        while (n--) {
+            TINF_PUT(d, d->dict_ring[d->lzOff]);
+            if ((unsigned)++d->lzOff == d->dict_size) {
+                d->lzOff = 0;
+            }
         }
     } else {
-        d->dest[0] = d->dest[d->lzOff];
-        d->dest++;
+        while (n--) {
+            d->dest[0] = d->dest[d->lzOff];
+            d->dest++;
+        }
     }
-    d->curlen--;
     return TINF_OK;
 }
 
@@ -406,6 +473,7 @@ static int tinf_inflate_uncompressed_block(TINF_DATA *d)
 
         /* make sure we start next block on a byte boundary */
         d->bitcount = 0;
+        d->tag = 0;
     }
 
     if (--d->curlen == 0) {
@@ -438,6 +506,7 @@ void uzlib_init(void)
 /* initialize decompression structure */
 void uzlib_uncompress_init(TINF_DATA *d, void *dict, unsigned int dictLen)
 {
+   d->tag = 0;
    d->bitcount = 0;
    d->bfinal = 0;
    d->btype = -1;
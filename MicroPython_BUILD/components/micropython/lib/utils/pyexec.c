@@ -521,6 +521,9 @@ int pyexec_frozen_module(const char *name) {
 
         #if MICROPY_MODULE_FROZEN_MPY
         case MP_FROZEN_MPY:
+            #if MICROPY_MODULE_FROZEN_MPY_ROM_GLOBALS
+            mp_frozen_mpy_store_rom_globals(frozen_data, mp_globals_get());
+            #endif
             return parse_compile_execute(frozen_data, MP_PARSE_FILE_INPUT, EXEC_FLAG_SOURCE_IS_RAW_CODE);
         #endif
 
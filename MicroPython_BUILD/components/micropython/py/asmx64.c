@@ -361,13 +361,15 @@ void asm_x64_mov_i64_to_r64_optimised(asm_x64_t *as, int64_t src_i64, int dest_r
     }
 }
 
-// src_i64 is stored as a full word in the code, and aligned to machine-word boundary
-void asm_x64_mov_i64_to_r64_aligned(asm_x64_t *as, int64_t src_i64, int dest_r64) {
+// src_i64 is stored as a full word in the code, and aligned to machine-word boundary;
+// returns the offset of that word in the code
+size_t asm_x64_mov_i64_to_r64_aligned(asm_x64_t *as, int64_t src_i64, int dest_r64) {
     // mov instruction uses 2 bytes for the instruction, before the i64
     while (((as->base.code_offset + 2) & (WORD_SIZE - 1)) != 0) {
         asm_x64_nop(as);
     }
     asm_x64_mov_i64_to_r64(as, src_i64, dest_r64);
+    return as->base.code_offset - WORD_SIZE;
 }
 
 void asm_x64_and_r64_r64(asm_x64_t *as, int dest_r64, int src_r64) {
@@ -529,15 +531,17 @@ void asm_x64_entry(asm_x64_t *as, int num_locals) {
     assert(num_locals >= 0);
     asm_x64_push_r64(as, ASM_X64_REG_RBP);
     asm_x64_mov_r64_r64(as, ASM_X64_REG_RBP, ASM_X64_REG_RSP);
-    num_locals |= 1; // make it odd so stack is aligned on 16 byte boundary
+    num_locals += num_locals & 1; // make it even so stack is aligned on 16 byte boundary
     asm_x64_sub_r64_i32(as, ASM_X64_REG_RSP, num_locals * WORD_SIZE);
     asm_x64_push_r64(as, ASM_X64_REG_RBX);
     asm_x64_push_r64(as, ASM_X64_REG_R12);
     asm_x64_push_r64(as, ASM_X64_REG_R13);
+    asm_x64_push_r64(as, ASM_X64_REG_R14);
     as->num_locals = num_locals;
 }
 
 void asm_x64_exit(asm_x64_t *as) {
+    asm_x64_pop_r64(as, ASM_X64_REG_R14);
     asm_x64_pop_r64(as, ASM_X64_REG_R13);
     asm_x64_pop_r64(as, ASM_X64_REG_R12);
     asm_x64_pop_r64(as, ASM_X64_REG_RBX);
@@ -627,4 +631,11 @@ void asm_x64_call_ind(asm_x64_t *as, void *ptr, int temp_r64) {
     */
 }
 
+// calls the function at index fun_id of the table of pointers held in table_r64
+void asm_x64_call_ind_table(asm_x64_t *as, int table_r64, size_t fun_id, int temp_r64) {
+    assert(temp_r64 < 8);
+    asm_x64_mov_mem64_to_r64(as, table_r64, fun_id * WORD_SIZE, temp_r64);
+    asm_x64_write_byte_2(as, OPCODE_CALL_RM32, MODRM_R64(2) | MODRM_RM_REG | MODRM_RM_R64(temp_r64));
+}
+
 #endif // MICROPY_EMIT_X64
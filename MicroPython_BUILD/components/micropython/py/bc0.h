@@ -59,6 +59,11 @@
 #define MP_BC_DELETE_NAME        (0x2a) // qstr
 #define MP_BC_DELETE_GLOBAL      (0x2b) // qstr
 
+// Superinstructions, emitted with MICROPY_OPT_BYTECODE_SUPERINSTRUCTIONS
+#define MP_BC_LOAD_FAST_ATTR     (0x2c) // qstr, byte local
+#define MP_BC_LOAD_FAST_METHOD   (0x2d) // qstr, byte local
+#define MP_BC_BINARY_OP_FAST_SMALL_INT (0x2e) // byte local, byte op, byte signed small int
+
 #define MP_BC_DUP_TOP            (0x30)
 #define MP_BC_DUP_TOP_TWO        (0x31)
 #define MP_BC_POP_TOP            (0x32)
@@ -70,6 +75,8 @@
 #define MP_BC_POP_JUMP_IF_FALSE  (0x37) // rel byte code offset, 16-bit signed, in excess
 #define MP_BC_JUMP_IF_TRUE_OR_POP    (0x38) // rel byte code offset, 16-bit signed, in excess
 #define MP_BC_JUMP_IF_FALSE_OR_POP   (0x39) // rel byte code offset, 16-bit signed, in excess
+#define MP_BC_POP_JUMP_IF_TRUE_COMPARE  (0x3a) // rel byte code offset, 16-bit signed, in excess; byte op
+#define MP_BC_POP_JUMP_IF_FALSE_COMPARE (0x3b) // rel byte code offset, 16-bit signed, in excess; byte op
 #define MP_BC_SETUP_WITH         (0x3d) // rel byte code offset, 16-bit unsigned
 #define MP_BC_WITH_CLEANUP       (0x3e)
 #define MP_BC_SETUP_EXCEPT       (0x3f) // rel byte code offset, 16-bit unsigned
@@ -93,6 +93,9 @@ extern const mp_obj_module_t mp_module_cmath;
 extern const mp_obj_module_t mp_module_micropython;
 extern const mp_obj_module_t mp_module_ustruct;
 extern const mp_obj_module_t mp_module_sys;
+#if MICROPY_PY_THREAD_WORKERS
+mp_obj_t mp_module_sys_state_attr(qstr attr);
+#endif
 extern const mp_obj_module_t mp_module_gc;
 extern const mp_obj_module_t mp_module_thread;
 
@@ -116,6 +119,7 @@ extern const mp_obj_module_t mp_module_lwip;
 extern const mp_obj_module_t mp_module_websocket;
 extern const mp_obj_module_t mp_module_webrepl;
 extern const mp_obj_module_t mp_module_framebuf;
+extern const mp_obj_module_t mp_module_vector;
 extern const mp_obj_module_t mp_module_btree;
 
 extern const char MICROPY_PY_BUILTINS_HELP_TEXT[];
@@ -206,6 +206,12 @@ STATIC void do_load(mp_obj_t module_obj, vstr_t *file) {
     // its data) in the list of frozen files, execute it.
     #if MICROPY_MODULE_FROZEN_MPY
     if (frozen_type == MP_FROZEN_MPY) {
+        #if MICROPY_MODULE_FROZEN_MPY_ROM_GLOBALS
+        mp_obj_module_t *module = MP_OBJ_TO_PTR(module_obj);
+        if (!mp_frozen_mpy_use_rom_globals(modref, &module->globals)) {
+            return;
+        }
+        #endif
         do_execute_raw_code(module_obj, modref);
         return;
     }
@@ -78,7 +78,30 @@ typedef enum {
 
 #endif
 
-#if MICROPY_EMIT_NATIVE
+#if MICROPY_EMIT_NATIVE && MICROPY_DYNAMIC_COMPILER
+// the native emitter is selected at runtime, by mp_dynamic_compiler.native_arch
+#include "py/persistentcode.h"
+
+typedef struct _native_emitter_t {
+    emit_t *(*emit_new)(mp_obj_t *error_slot, mp_uint_t max_num_labels);
+    const emit_method_table_t *emit_method_table;
+    void (*emit_free)(emit_t *emit);
+} native_emitter_t;
+
+STATIC const native_emitter_t native_emitter_table[] = {
+    [MP_NATIVE_ARCH_NONE] = { NULL, NULL, NULL },
+    #if MICROPY_EMIT_X64
+    [MP_NATIVE_ARCH_X64] = { emit_native_x64_new, &emit_native_x64_method_table, emit_native_x64_free },
+    #endif
+    #if MICROPY_EMIT_XTENSAWIN
+    [MP_NATIVE_ARCH_XTENSAWIN] = { emit_native_xtensawin_new, &emit_native_xtensawin_method_table, emit_native_xtensawin_free },
+    #endif
+};
+
+#define NATIVE_EMITTER(f) (native_emitter_table[mp_dynamic_compiler.native_arch].emit_##f)
+#define NATIVE_EMITTER_TABLE NATIVE_EMITTER(method_table)
+
+#elif MICROPY_EMIT_NATIVE
 // define a macro to access external native emitter
 #if MICROPY_EMIT_X64
 #define NATIVE_EMITTER(f) emit_native_x64_##f
@@ -90,9 +113,12 @@ typedef enum {
 #define NATIVE_EMITTER(f) emit_native_arm_##f
 #elif MICROPY_EMIT_XTENSA
 #define NATIVE_EMITTER(f) emit_native_xtensa_##f
+#elif MICROPY_EMIT_XTENSAWIN
+#define NATIVE_EMITTER(f) emit_native_xtensawin_##f
 #else
 #error "unknown native emitter"
 #endif
+#define NATIVE_EMITTER_TABLE &NATIVE_EMITTER(method_table)
 #endif
 
 #if MICROPY_EMIT_INLINE_ASM
@@ -773,6 +799,12 @@ STATIC bool compile_built_in_decorator(compiler_t *comp, int name_len, mp_parse_
     qstr attr = MP_PARSE_NODE_LEAF_ARG(name_nodes[1]);
     if (attr == MP_QSTR_bytecode) {
         *emit_options = MP_EMIT_OPT_BYTECODE;
+#if MICROPY_EMIT_NATIVE && MICROPY_DYNAMIC_COMPILER
+    } else if ((attr == MP_QSTR_native || attr == MP_QSTR_viper)
+        && (mp_dynamic_compiler.native_arch >= MP_ARRAY_SIZE(native_emitter_table)
+        || native_emitter_table[mp_dynamic_compiler.native_arch].emit_new == NULL)) {
+        compile_syntax_error(comp, name_nodes[1], "native code emission not enabled");
+#endif
 #if MICROPY_EMIT_NATIVE
     } else if (attr == MP_QSTR_native) {
         *emit_options = MP_EMIT_OPT_NATIVE_PYTHON;
@@ -3254,7 +3286,11 @@ STATIC void compile_scope_inline_asm(compiler_t *comp, scope_t *scope, pass_kind
             void *f = mp_asm_base_get_code((mp_asm_base_t*)comp->emit_inline_asm);
             mp_emit_glue_assign_native(comp->scope_cur->raw_code, MP_CODE_NATIVE_ASM,
                 f, mp_asm_base_get_code_size((mp_asm_base_t*)comp->emit_inline_asm),
-                NULL, comp->scope_cur->num_pos_args, 0, type_sig);
+                NULL,
+                #if MICROPY_PERSISTENT_CODE_SAVE
+                0, NULL,
+                #endif
+                comp->scope_cur->num_pos_args, 0, type_sig);
         }
     }
 
@@ -3435,7 +3471,7 @@ mp_raw_code_t *mp_compile_to_raw_code(mp_parse_tree_t *parse_tree, qstr source_f
                     if (emit_native == NULL) {
                         emit_native = NATIVE_EMITTER(new)(&comp->compile_error, max_num_labels);
                     }
-                    comp->emit_method_table = &NATIVE_EMITTER(method_table);
+                    comp->emit_method_table = NATIVE_EMITTER_TABLE;
                     comp->emit = emit_native;
                     EMIT_ARG(set_native_type, MP_EMIT_NATIVE_TYPE_ENABLE, s->emit_options == MP_EMIT_OPT_VIPER, 0);
                     break;
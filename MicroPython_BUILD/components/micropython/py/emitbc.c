@@ -39,6 +39,20 @@
 #define BYTES_FOR_INT ((BYTES_PER_WORD * 8 + 6) / 7)
 #define DUMMY_DATA_SIZE (BYTES_FOR_INT)
 
+// Kinds of the instructions that the peephole optimiser can fuse with the
+// instructions that follow them into a superinstruction
+enum {
+    PEEP_LOAD_FAST = 1,
+    PEEP_LOAD_SMALL_INT,
+    PEEP_COMPARE,
+};
+
+typedef struct _emit_peep_t {
+    byte kind;
+    size_t offset;
+    mp_int_t arg;
+} emit_peep_t;
+
 struct _emit_t {
     // Accessed as mp_obj_t, so must be aligned as such, and we rely on the
     // memory allocator returning a suitably aligned pointer.
@@ -64,6 +78,13 @@ struct _emit_t {
     size_t bytecode_size;
     byte *code_base; // stores both byte code and code info
 
+    // The last fusable instructions, which end at peep_end.  They can only be
+    // fused if nothing else was emitted after them, and no label nor source
+    // line was assigned in between.
+    size_t peep_end;
+    size_t peep_len;
+    emit_peep_t peep[2];
+
     #if MICROPY_PERSISTENT_CODE
     uint16_t ct_cur_obj;
     uint16_t ct_num_obj;
@@ -278,6 +299,56 @@ STATIC void emit_write_bytecode_byte_raw_code(emit_t *emit, byte b, mp_raw_code_
     #endif
 }
 
+// Record the instruction just emitted at the given offset as one that can be
+// fused with the instructions that follow it.
+STATIC void emit_bc_peep_record(emit_t *emit, size_t offset, byte kind, mp_int_t arg) {
+    if (!MICROPY_OPT_BYTECODE_SUPERINSTRUCTIONS_DYNAMIC) {
+        return;
+    }
+    if (emit->peep_end != offset) {
+        // other instructions were emitted in between
+        emit->peep_len = 0;
+    } else if (emit->peep_len == MP_ARRAY_SIZE(emit->peep)) {
+        emit->peep[0] = emit->peep[1];
+        emit->peep_len = 1;
+    }
+    emit_peep_t *p = &emit->peep[emit->peep_len++];
+    p->kind = kind;
+    p->offset = offset;
+    p->arg = arg;
+    emit->peep_end = emit->bytecode_offset;
+}
+
+// Return the n-th last instruction before the current position if it is of
+// the given kind and can be fused, else NULL.
+STATIC emit_peep_t *emit_bc_peep_match(emit_t *emit, size_t n, byte kind) {
+    if (!MICROPY_OPT_BYTECODE_SUPERINSTRUCTIONS_DYNAMIC
+        || emit->peep_end != emit->bytecode_offset || emit->peep_len < n) {
+        return NULL;
+    }
+    emit_peep_t *p = &emit->peep[emit->peep_len - n];
+    return p->kind == kind ? p : NULL;
+}
+
+// Remove the given recorded instruction and the ones after it from the
+// bytecode, so that a superinstruction can be written in their place.  As the
+// same decisions are made in each pass the label offsets stay consistent.
+STATIC void emit_bc_peep_rewind(emit_t *emit, emit_peep_t *p) {
+    emit->bytecode_offset = p->offset;
+    emit->peep_len = 0;
+}
+
+// Return the number of a local loaded just before, to be fused with a
+// LOAD_ATTR or LOAD_METHOD, or -1 if there is none.
+STATIC int emit_bc_peep_load_fast(emit_t *emit) {
+    emit_peep_t *p = emit_bc_peep_match(emit, 1, PEEP_LOAD_FAST);
+    if (p == NULL || p->arg > 255) {
+        return -1;
+    }
+    emit_bc_peep_rewind(emit, p);
+    return p->arg;
+}
+
 // unsigned labels are relative to ip following this instruction, stored as 16 bits
 STATIC void emit_write_bytecode_byte_unsigned_label(emit_t *emit, byte b1, mp_uint_t label) {
     mp_uint_t bytecode_offset;
@@ -321,6 +392,7 @@ void mp_emit_bc_start_pass(emit_t *emit, pass_kind_t pass, scope_t *scope) {
     #endif
     emit->bytecode_offset = 0;
     emit->code_info_offset = 0;
+    emit->peep_len = 0;
 
     // Write local state size and exception stack size.
     {
@@ -481,6 +553,8 @@ void mp_emit_bc_set_source_line(emit_t *emit, mp_uint_t source_line) {
         emit_write_code_info_bytes_lines(emit, bytes_to_skip, lines_to_skip);
         emit->last_source_line_offset = emit->bytecode_offset;
         emit->last_source_line = source_line;
+        // a superinstruction can't span two lines
+        emit->peep_len = 0;
     }
 #else
     (void)emit;
@@ -493,6 +567,8 @@ void mp_emit_bc_label_assign(emit_t *emit, mp_uint_t l) {
     if (emit->pass == MP_PASS_SCOPE) {
         return;
     }
+    // instructions can't be fused across a jump target
+    emit->peep_len = 0;
     assert(l < emit->max_num_labels);
     if (emit->pass < MP_PASS_EMIT) {
         // assign label offset
@@ -534,11 +610,13 @@ void mp_emit_bc_load_const_tok(emit_t *emit, mp_token_kind_t tok) {
 
 void mp_emit_bc_load_const_small_int(emit_t *emit, mp_int_t arg) {
     emit_bc_pre(emit, 1);
+    size_t offset = emit->bytecode_offset;
     if (-16 <= arg && arg <= 47) {
         emit_write_bytecode_byte(emit, MP_BC_LOAD_CONST_SMALL_INT_MULTI + 16 + arg);
     } else {
         emit_write_bytecode_byte_int(emit, MP_BC_LOAD_CONST_SMALL_INT, arg);
     }
+    emit_bc_peep_record(emit, offset, PEEP_LOAD_SMALL_INT, arg);
 }
 
 void mp_emit_bc_load_const_str(emit_t *emit, qstr qst) {
@@ -559,11 +637,13 @@ void mp_emit_bc_load_null(emit_t *emit) {
 void mp_emit_bc_load_fast(emit_t *emit, qstr qst, mp_uint_t local_num) {
     (void)qst;
     emit_bc_pre(emit, 1);
+    size_t offset = emit->bytecode_offset;
     if (local_num <= 15) {
         emit_write_bytecode_byte(emit, MP_BC_LOAD_FAST_MULTI + local_num);
     } else {
         emit_write_bytecode_byte_uint(emit, MP_BC_LOAD_FAST_N, local_num);
     }
+    emit_bc_peep_record(emit, offset, PEEP_LOAD_FAST, local_num);
 }
 
 void mp_emit_bc_load_deref(emit_t *emit, qstr qst, mp_uint_t local_num) {
@@ -592,7 +672,13 @@ void mp_emit_bc_load_global(emit_t *emit, qstr qst) {
 
 void mp_emit_bc_load_attr(emit_t *emit, qstr qst) {
     emit_bc_pre(emit, 0);
-    emit_write_bytecode_byte_qstr(emit, MP_BC_LOAD_ATTR, qst);
+    int local_num = emit_bc_peep_load_fast(emit);
+    if (local_num >= 0) {
+        emit_write_bytecode_byte_qstr(emit, MP_BC_LOAD_FAST_ATTR, qst);
+        emit_write_bytecode_byte(emit, local_num);
+    } else {
+        emit_write_bytecode_byte_qstr(emit, MP_BC_LOAD_ATTR, qst);
+    }
     if (MICROPY_OPT_CACHE_MAP_LOOKUP_IN_BYTECODE_DYNAMIC) {
         emit_write_bytecode_byte(emit, 0);
     }
@@ -600,7 +686,16 @@ void mp_emit_bc_load_attr(emit_t *emit, qstr qst) {
 
 void mp_emit_bc_load_method(emit_t *emit, qstr qst, bool is_super) {
     emit_bc_pre(emit, 1 - 2 * is_super);
-    emit_write_bytecode_byte_qstr(emit, is_super ? MP_BC_LOAD_SUPER_METHOD : MP_BC_LOAD_METHOD, qst);
+    int local_num = is_super ? -1 : emit_bc_peep_load_fast(emit);
+    if (local_num >= 0) {
+        emit_write_bytecode_byte_qstr(emit, MP_BC_LOAD_FAST_METHOD, qst);
+        emit_write_bytecode_byte(emit, local_num);
+    } else {
+        emit_write_bytecode_byte_qstr(emit, is_super ? MP_BC_LOAD_SUPER_METHOD : MP_BC_LOAD_METHOD, qst);
+    }
+    if (MICROPY_OPT_CACHE_MAP_LOOKUP_IN_BYTECODE_DYNAMIC && !is_super) {
+        emit_write_bytecode_byte(emit, 0);
+    }
 }
 
 void mp_emit_bc_load_build_class(emit_t *emit) {
@@ -716,7 +811,14 @@ void mp_emit_bc_jump(emit_t *emit, mp_uint_t label) {
 
 void mp_emit_bc_pop_jump_if(emit_t *emit, bool cond, mp_uint_t label) {
     emit_bc_pre(emit, -1);
-    if (cond) {
+    emit_peep_t *p = emit_bc_peep_match(emit, 1, PEEP_COMPARE);
+    if (p != NULL) {
+        // fuse with the comparison before it
+        emit_bc_peep_rewind(emit, p);
+        emit_write_bytecode_byte_signed_label(emit,
+            cond ? MP_BC_POP_JUMP_IF_TRUE_COMPARE : MP_BC_POP_JUMP_IF_FALSE_COMPARE, label);
+        emit_write_bytecode_byte(emit, p->arg);
+    } else if (cond) {
         emit_write_bytecode_byte_signed_label(emit, MP_BC_POP_JUMP_IF_TRUE, label);
     } else {
         emit_write_bytecode_byte_signed_label(emit, MP_BC_POP_JUMP_IF_FALSE, label);
@@ -820,7 +922,24 @@ void mp_emit_bc_binary_op(emit_t *emit, mp_binary_op_t op) {
         op = MP_BINARY_OP_IS;
     }
     emit_bc_pre(emit, -1);
-    emit_write_bytecode_byte(emit, MP_BC_BINARY_OP_MULTI + op);
+    emit_peep_t *p_int = emit_bc_peep_match(emit, 1, PEEP_LOAD_SMALL_INT);
+    emit_peep_t *p_fast = emit_bc_peep_match(emit, 2, PEEP_LOAD_FAST);
+    if (p_int != NULL && p_fast != NULL && p_fast->arg <= 255
+        && -128 <= p_int->arg && p_int->arg <= 127) {
+        // fuse with the loads of its operands, a local and a small int
+        emit_bc_peep_rewind(emit, p_fast);
+        byte *c = emit_get_cur_to_write_bytecode(emit, 4);
+        c[0] = MP_BC_BINARY_OP_FAST_SMALL_INT;
+        c[1] = p_fast->arg;
+        c[2] = op;
+        c[3] = p_int->arg;
+    } else {
+        size_t offset = emit->bytecode_offset;
+        emit_write_bytecode_byte(emit, MP_BC_BINARY_OP_MULTI + op);
+        if (op <= MP_BINARY_OP_IS && !invert) {
+            emit_bc_peep_record(emit, offset, PEEP_COMPARE, op);
+        }
+    }
     if (invert) {
         emit_bc_pre(emit, 0);
         emit_write_bytecode_byte(emit, MP_BC_UNARY_OP_MULTI + MP_UNARY_OP_NOT);
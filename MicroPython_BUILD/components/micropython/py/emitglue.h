@@ -39,6 +39,33 @@ typedef enum {
     MP_CODE_NATIVE_ASM,
 } mp_raw_code_kind_t;
 
+// Kinds of machine word in native code whose value depends on the firmware
+// it runs on; these are recorded when the code is saved to a .mpy file and
+// filled in by the loader, see mp_native_reloc_value
+typedef enum {
+    MP_NATIVE_RELOC_FUN_TABLE,  // address of mp_fun_table
+    MP_NATIVE_RELOC_CONST,      // one of mp_native_const_t
+    MP_NATIVE_RELOC_QSTR,       // a qstr
+    MP_NATIVE_RELOC_QSTR_OBJ,   // a qstr as an object
+    MP_NATIVE_RELOC_OBJ,        // a constant object
+    MP_NATIVE_RELOC_RAW_CODE,   // a child raw code
+} mp_native_reloc_kind_t;
+
+typedef enum {
+    MP_NATIVE_CONST_NONE,
+    MP_NATIVE_CONST_FALSE,
+    MP_NATIVE_CONST_TRUE,
+    MP_NATIVE_CONST_ELLIPSIS,
+} mp_native_const_t;
+
+#if MICROPY_PERSISTENT_CODE_SAVE
+typedef struct _mp_native_reloc_t {
+    uint32_t offset; // of the word within fun_data
+    uint8_t kind; // of type mp_native_reloc_kind_t
+    mp_uint_t arg; // the value of the word is mp_native_reloc_value(kind, arg)
+} mp_native_reloc_t;
+#endif
+
 typedef struct _mp_raw_code_t {
     mp_uint_t kind : 3; // of type mp_raw_code_kind_t
     mp_uint_t scope_flags : 7;
@@ -57,6 +84,11 @@ typedef struct _mp_raw_code_t {
             void *fun_data;
             const mp_uint_t *const_table;
             mp_uint_t type_sig; // for viper, compressed as 2-bit types; ret is MSB, then arg0, arg1, etc
+            #if MICROPY_PERSISTENT_CODE_SAVE
+            uint32_t fun_data_len; // machine code only, excluding any prelude
+            uint16_t n_reloc;
+            mp_native_reloc_t *relocs;
+            #endif
         } u_native;
     } data;
 } mp_raw_code_t;
@@ -72,7 +104,13 @@ void mp_emit_glue_assign_bytecode(mp_raw_code_t *rc, const byte *code,
     uint16_t n_obj, uint16_t n_raw_code,
     #endif
     mp_uint_t scope_flags);
-void mp_emit_glue_assign_native(mp_raw_code_t *rc, mp_raw_code_kind_t kind, void *fun_data, mp_uint_t fun_len, const mp_uint_t *const_table, mp_uint_t n_pos_args, mp_uint_t scope_flags, mp_uint_t type_sig);
+void mp_emit_glue_assign_native(mp_raw_code_t *rc, mp_raw_code_kind_t kind, void *fun_data, mp_uint_t fun_len, const mp_uint_t *const_table,
+    #if MICROPY_PERSISTENT_CODE_SAVE
+    uint16_t n_reloc, mp_native_reloc_t *relocs,
+    #endif
+    mp_uint_t n_pos_args, mp_uint_t scope_flags, mp_uint_t type_sig);
+mp_uint_t *mp_emit_glue_new_native_const_table(size_t n_arg_names, const byte *prelude, size_t prelude_len);
+mp_uint_t mp_native_reloc_value(mp_native_reloc_kind_t kind, mp_uint_t arg);
 
 mp_obj_t mp_make_function_from_raw_code(const mp_raw_code_t *rc, mp_obj_t def_args, mp_obj_t def_kw_args);
 mp_obj_t mp_make_closure_from_raw_code(const mp_raw_code_t *rc, mp_uint_t n_closed_over, const mp_obj_t *args);
@@ -94,6 +94,108 @@ STATIC const mp_raw_code_t *mp_find_frozen_mpy(const char *str, size_t len) {
     return NULL;
 }
 
+#if MICROPY_MODULE_FROZEN_MPY_ROM_GLOBALS
+
+#include "py/mpstate.h"
+#include "py/gc.h"
+
+extern const mp_frozen_mpy_globals_t mp_frozen_mpy_globals[];
+
+STATIC size_t mp_frozen_mpy_num(void) {
+    size_t n = 0;
+    for (const char *name = mp_frozen_mpy_names; *name != 0; name += strlen(name) + 1) {
+        n++;
+    }
+    return n;
+}
+
+STATIC const mp_frozen_mpy_globals_t *mp_find_frozen_mpy_globals(const mp_raw_code_t *rc) {
+    for (size_t i = 0, n = mp_frozen_mpy_num(); i < n; i++) {
+        if (mp_frozen_mpy_content[i] == rc) {
+            return mp_frozen_mpy_globals[i].dict == NULL ? NULL : &mp_frozen_mpy_globals[i];
+        }
+    }
+    return NULL;
+}
+
+// Put the globals dict of a frozen module back to its initial state in ROM
+STATIC mp_obj_dict_t *mp_frozen_mpy_globals_init(const mp_frozen_mpy_globals_t *g) {
+    mp_obj_dict_t *dict = g->dict;
+    dict->base.type = &mp_type_dict;
+    dict->map.all_keys_are_qstrs = 1;
+    dict->map.is_fixed = 1;
+    dict->map.is_ordered = 1;
+    dict->map.is_copy_on_write = 1;
+    dict->map.used = g->n;
+    dict->map.alloc = g->n;
+    dict->map.table = (mp_map_elem_t*)(mp_rom_map_elem_t*)g->table;
+    return dict;
+}
+
+// Called by mp_init, so that no dict refers to the heap of a previous session
+void mp_frozen_mpy_globals_reset(void) {
+    for (size_t i = 0, n = mp_frozen_mpy_num(); i < n; i++) {
+        if (mp_frozen_mpy_globals[i].dict != NULL) {
+            mp_frozen_mpy_globals_init(&mp_frozen_mpy_globals[i]);
+        }
+    }
+}
+
+// Called by the GC: once copied to the heap, the table of a dict is only
+// referenced from its header in RAM
+void mp_frozen_mpy_globals_gc(void) {
+    for (size_t i = 0, n = mp_frozen_mpy_num(); i < n; i++) {
+        if (mp_frozen_mpy_globals[i].dict != NULL) {
+            gc_collect_root((void**)&mp_frozen_mpy_globals[i].dict->map.table, 1);
+        }
+    }
+}
+
+// If the frozen module has its globals in ROM then make *globals point to
+// them, keeping the entries that the importer already stored (eg __name__).
+// Returns whether the (remaining) module code must still be executed.
+bool mp_frozen_mpy_use_rom_globals(const mp_raw_code_t *rc, mp_obj_dict_t **globals) {
+    const mp_frozen_mpy_globals_t *g = mp_find_frozen_mpy_globals(rc);
+    if (g == NULL) {
+        return true;
+    }
+    if (!MP_STATE_IS_MAIN()) {
+        // the dicts in RAM belong to the main interpreter, a worker gets
+        // a copy of the ROM globals on its own heap
+        mp_frozen_mpy_store_rom_globals(rc, *globals);
+        return g->has_code;
+    }
+    mp_map_t *old_map = &(*globals)->map;
+    mp_obj_dict_t *dict = mp_frozen_mpy_globals_init(g);
+    for (size_t i = 0; i < old_map->alloc; i++) {
+        if (MP_MAP_SLOT_IS_FILLED(old_map, i)) {
+            mp_map_elem_t *elem = mp_map_lookup(&dict->map, old_map->table[i].key, MP_MAP_LOOKUP);
+            if (elem == NULL || elem->value != old_map->table[i].value) {
+                mp_obj_dict_store(MP_OBJ_FROM_PTR(dict), old_map->table[i].key, old_map->table[i].value);
+            }
+        }
+    }
+    *globals = dict;
+    return g->has_code;
+}
+
+// Store the ROM globals of a frozen module into the given dict, for when it
+// is executed in an existing context instead of being imported
+void mp_frozen_mpy_store_rom_globals(const mp_raw_code_t *rc, mp_obj_dict_t *globals) {
+    const mp_frozen_mpy_globals_t *g = mp_find_frozen_mpy_globals(rc);
+    if (g == NULL) {
+        return;
+    }
+    const mp_map_elem_t *table = (const mp_map_elem_t*)(const mp_rom_map_elem_t*)g->table;
+    for (size_t i = 0; i < g->n; i++) {
+        if (table[i].key != MP_OBJ_NEW_QSTR(MP_QSTR___name__)) {
+            mp_obj_dict_store(MP_OBJ_FROM_PTR(globals), table[i].key, table[i].value);
+        }
+    }
+}
+
+#endif
+
 #endif
 
 #if MICROPY_MODULE_FROZEN
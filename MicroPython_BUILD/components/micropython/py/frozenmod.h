@@ -27,6 +27,7 @@
 #define MICROPY_INCLUDED_PY_FROZENMOD_H
 
 #include "py/lexer.h"
+#include "py/emitglue.h"
 
 enum {
     MP_FROZEN_NONE,
@@ -38,4 +39,21 @@ int mp_find_frozen_module(const char *str, size_t len, void **data);
 const char *mp_find_frozen_str(const char *str, size_t *len);
 mp_import_stat_t mp_frozen_stat(const char *str);
 
+#if MICROPY_MODULE_FROZEN_MPY_ROM_GLOBALS
+// The globals of a frozen module as built by mpy-tool.py --rom-globals.  The
+// dict header is in RAM so that the dict can be copied to the heap when it is
+// first modified; the entries of the initial table are in ROM.
+typedef struct _mp_frozen_mpy_globals_t {
+    mp_obj_dict_t *dict;
+    const mp_rom_map_elem_t *table;
+    uint16_t n;
+    bool has_code; // whether the module code still needs to run on import
+} mp_frozen_mpy_globals_t;
+
+void mp_frozen_mpy_globals_reset(void);
+void mp_frozen_mpy_globals_gc(void);
+bool mp_frozen_mpy_use_rom_globals(const mp_raw_code_t *rc, mp_obj_dict_t **globals);
+void mp_frozen_mpy_store_rom_globals(const mp_raw_code_t *rc, mp_obj_dict_t *globals);
+#endif
+
 #endif // MICROPY_INCLUDED_PY_FROZENMOD_H
@@ -30,6 +30,7 @@
 
 #include "py/gc.h"
 #include "py/runtime.h"
+#include "py/frozenmod.h"
 
 #if MICROPY_ENABLE_GC
 
@@ -82,6 +83,16 @@
 #define ATB_MARK_TO_HEAD(block) do { MP_STATE_MEM(gc_alloc_table_start)[(block) / BLOCKS_PER_ATB] &= (~(AT_TAIL << BLOCK_SHIFT(block))); } while (0)
 
 #define BLOCK_FROM_PTR(ptr) (((byte*)(ptr) - MP_STATE_MEM(gc_pool_start)) / BYTES_PER_BLOCK)
+#define TOTAL_BLOCKS() (MP_STATE_MEM(gc_alloc_table_byte_len) * BLOCKS_PER_ATB)
+
+#if MICROPY_GC_INCREMENTAL_SWEEP
+// Between a collection and the end of its sweep, live objects in the unswept
+// part of the heap still carry the mark, so a used block may be a head or a mark.
+#define ATB_KIND_IS_HEAD(kind) ((kind) == AT_HEAD || (kind) == AT_MARK)
+#define GC_SWEEP_PENDING() (MP_STATE_MEM(gc_sweep_block) < TOTAL_BLOCKS())
+#else
+#define ATB_KIND_IS_HEAD(kind) ((kind) == AT_HEAD)
+#endif
 #define PTR_FROM_BLOCK(block) (((block) * BYTES_PER_BLOCK + (uintptr_t)MP_STATE_MEM(gc_pool_start)))
 #define ATB_FROM_BLOCK(bl) ((bl) / BLOCKS_PER_ATB)
 
@@ -104,6 +115,42 @@
 #define GC_EXIT()
 #endif
 
+// gc_first_fit_block[c] is a block such that no run of c + 1 free blocks starts
+// before it (the last class uses this bound for all larger runs too).  Taking
+// blocks can only raise these hints, whereas freeing blocks must lower them.
+#define GC_SIZE_CLASS(n_blocks) (((n_blocks) < MICROPY_GC_ALLOC_SIZE_CLASSES ? (n_blocks) : MICROPY_GC_ALLOC_SIZE_CLASSES) - 1)
+
+// a word of the alloc table has no free blocks if all its bit pairs are nonzero
+#define ATB_WORD_LOW_BITS ((mp_uint_t)-1 / 3)
+#define ATB_WORD_IS_FULL(w) ((((w) | ((w) >> 1)) & ATB_WORD_LOW_BITS) == ATB_WORD_LOW_BITS)
+
+STATIC void gc_first_fit_reset(void) {
+    for (size_t c = 0; c < MICROPY_GC_ALLOC_SIZE_CLASSES; c++) {
+        MP_STATE_MEM(gc_first_fit_block)[c] = 0;
+    }
+}
+
+// Called when block and possibly the ones after it have become free.  A run
+// of c + 1 free blocks that includes them starts at most c blocks earlier.
+STATIC void gc_first_fit_freed(size_t block) {
+    for (size_t c = 0; c < MICROPY_GC_ALLOC_SIZE_CLASSES; c++) {
+        size_t bl = block > c ? block - c : 0;
+        if (bl < MP_STATE_MEM(gc_first_fit_block)[c]) {
+            MP_STATE_MEM(gc_first_fit_block)[c] = bl;
+        }
+    }
+}
+
+// Called when it is known that no run of n_blocks free blocks starts before
+// block, in which case no larger run does either.
+STATIC void gc_first_fit_raise(size_t n_blocks, size_t block) {
+    for (size_t c = n_blocks - 1; c < MICROPY_GC_ALLOC_SIZE_CLASSES; c++) {
+        if (block > MP_STATE_MEM(gc_first_fit_block)[c]) {
+            MP_STATE_MEM(gc_first_fit_block)[c] = block;
+        }
+    }
+}
+
 // TODO waste less memory; currently requires that all entries in alloc_table have a corresponding block in pool
 void gc_init(void *start, void *end) {
     // align end pointer on block boundary
@@ -145,8 +192,15 @@ void gc_init(void *start, void *end) {
     memset(MP_STATE_MEM(gc_finaliser_table_start), 0, gc_finaliser_table_byte_len);
 #endif
 
-    // set last free ATB index to start of heap
-    MP_STATE_MEM(gc_last_free_atb_index) = 0;
+    // all free runs start at the beginning of the heap
+    gc_first_fit_reset();
+
+    #if MICROPY_GC_INCREMENTAL_SWEEP
+    // nothing to sweep yet
+    MP_STATE_MEM(gc_sweep_block) = TOTAL_BLOCKS();
+    MP_STATE_MEM(gc_sweep_blocks_per_alloc) = MICROPY_GC_SWEEP_BLOCKS_PER_ALLOC;
+    MP_STATE_MEM(gc_sweep_free_tail) = 0;
+    #endif
 
     // unlock the GC
     MP_STATE_MEM(gc_lock_depth) = 0;
@@ -195,6 +249,13 @@ bool gc_is_locked(void) {
         && ptr < (void*)MP_STATE_MEM(gc_pool_end)        /* must be below end of pool */ \
     )
 
+// ptr should be of type void*
+#if defined(MP_PLAT_GC_MARK_EXEC)
+#define MARK_EXEC(ptr) MP_PLAT_GC_MARK_EXEC(ptr)
+#else
+#define MARK_EXEC(ptr)
+#endif
+
 #ifndef TRACE_MARK
 #if DEBUG_PRINT
 #define TRACE_MARK(block, ptr) DEBUG_printf("gc_mark(%p)\n", ptr)
@@ -234,6 +295,8 @@ STATIC void gc_mark_subtree(size_t block) {
                         MP_STATE_MEM(gc_stack_overflow) = 1;
                     }
                 }
+            } else {
+                MARK_EXEC(ptr);
             }
         }
 
@@ -261,13 +324,12 @@ STATIC void gc_deal_with_stack_overflow(void) {
     }
 }
 
-STATIC void gc_sweep(void) {
-    #if MICROPY_PY_GC_COLLECT_RETVAL
-    MP_STATE_MEM(gc_collected) = 0;
-    #endif
+// Sweep the blocks from start_block up to (not including) end_block.  The
+// free_tail argument tells whether start_block continues a chain whose head
+// was freed, and the same state is returned for the block at end_block.
+STATIC int gc_sweep_range(size_t start_block, size_t end_block, int free_tail) {
     // free unmarked heads and their tails
-    int free_tail = 0;
-    for (size_t block = 0; block < MP_STATE_MEM(gc_alloc_table_byte_len) * BLOCKS_PER_ATB; block++) {
+    for (size_t block = start_block; block < end_block; block++) {
         switch (ATB_GET_KIND(block)) {
             case AT_HEAD:
 #if MICROPY_ENABLE_FINALISER
@@ -314,10 +376,69 @@ STATIC void gc_sweep(void) {
                 break;
         }
     }
+    return free_tail;
+}
+
+#if MICROPY_GC_INCREMENTAL_SWEEP
+
+// Sweep the next n_blocks of the pending sweep, or all of it if n_blocks is 0.
+// Must be called with the GC entered and not locked.
+STATIC void gc_sweep_run(size_t n_blocks) {
+    size_t start_block = MP_STATE_MEM(gc_sweep_block);
+    size_t end_block = TOTAL_BLOCKS();
+    if (n_blocks != 0 && end_block - start_block > n_blocks) {
+        end_block = start_block + n_blocks;
+    }
+
+    // finalisers may run, so prevent them from allocating while we sweep
+    MP_STATE_MEM(gc_lock_depth)++;
+    MP_STATE_MEM(gc_sweep_free_tail) = gc_sweep_range(start_block, end_block, MP_STATE_MEM(gc_sweep_free_tail));
+    MP_STATE_MEM(gc_sweep_block) = end_block;
+    MP_STATE_MEM(gc_lock_depth)--;
+
+    // blocks may have been freed in front of the allocation search points
+    gc_first_fit_freed(start_block);
+}
+
+// Called when blocks start_block..end_block (inclusive) have been turned from
+// free into a used chain.  If part of the chain lies in the unswept area then
+// the pending sweep must keep it: a new head there is marked (it is turned
+// back into a plain head when swept), and a chain that runs from the swept
+// into the unswept area clears the free_tail state so its tails are kept.
+STATIC void gc_sweep_keep(size_t start_block, size_t end_block) {
+    if (end_block >= MP_STATE_MEM(gc_sweep_block)) {
+        if (start_block >= MP_STATE_MEM(gc_sweep_block)) {
+            ATB_HEAD_TO_MARK(start_block);
+        } else {
+            MP_STATE_MEM(gc_sweep_free_tail) = 0;
+        }
+    }
+}
+
+bool gc_sweep_incremental(size_t n_blocks) {
+    GC_ENTER();
+    if (GC_SWEEP_PENDING() && MP_STATE_MEM(gc_lock_depth) == 0) {
+        gc_sweep_run(n_blocks);
+    }
+    bool pending = GC_SWEEP_PENDING();
+    GC_EXIT();
+    return pending;
+}
+
+bool gc_sweep_pending(void) {
+    return GC_SWEEP_PENDING();
 }
 
+#endif // MICROPY_GC_INCREMENTAL_SWEEP
+
 void gc_collect_start(void) {
     GC_ENTER();
+    #if MICROPY_GC_INCREMENTAL_SWEEP
+    // the mark bits of the previous collection must all be cleared first
+    if (GC_SWEEP_PENDING()) {
+        gc_sweep_run(0);
+    }
+    #endif
     MP_STATE_MEM(gc_lock_depth)++;
     #if MICROPY_GC_ALLOC_THRESHOLD
     MP_STATE_MEM(gc_alloc_amount) = 0;
@@ -327,9 +448,17 @@ void gc_collect_start(void) {
     // Trace root pointers.  This relies on the root pointers being organised
     // correctly in the mp_state_ctx structure.  We scan nlr_top, dict_locals,
     // dict_globals, then the root pointer section of mp_state_vm.
-    void **ptrs = (void**)(void*)&mp_state_ctx;
+    void **ptrs = (void**)(void*)&MP_STATE_CTX;
     gc_collect_root(ptrs, offsetof(mp_state_ctx_t, vm.qstr_last_chunk) / sizeof(void*));
 
+    #if MICROPY_MODULE_FROZEN_MPY_ROM_GLOBALS
+    // Trace the globals of frozen modules, whose dicts are not on the heap.
+    // Only the main interpreter uses them.
+    if (MP_STATE_IS_MAIN()) {
+        mp_frozen_mpy_globals_gc();
+    }
+    #endif
+
     #if MICROPY_ENABLE_PYSTACK
     // Trace root pointers from the Python stack.
     ptrs = (void**)(void*)MP_STATE_THREAD(pystack_start);
@@ -348,20 +477,49 @@ void gc_collect_root(void **ptrs, size_t len) {
                 ATB_HEAD_TO_MARK(block);
                 gc_mark_subtree(block);
             }
+        } else {
+            MARK_EXEC(ptr);
         }
     }
 }
 
 void gc_collect_end(void) {
     gc_deal_with_stack_overflow();
-    gc_sweep();
-    MP_STATE_MEM(gc_last_free_atb_index) = 0;
+    #if defined(MP_PLAT_GC_MARK_EXEC)
+    // the executable memory reached so far can reach more of the heap and of
+    // itself; then what is left unmarked is garbage
+    while (MP_PLAT_GC_TRACE_EXEC()) {
+        gc_deal_with_stack_overflow();
+    }
+    MP_PLAT_GC_SWEEP_EXEC();
+    #endif
+    #if MICROPY_PY_GC_COLLECT_RETVAL
+    MP_STATE_MEM(gc_collected) = 0;
+    #endif
+    gc_first_fit_reset();
+    #if MICROPY_GC_INCREMENTAL_SWEEP
+    // leave the sweep to the following allocations
+    MP_STATE_MEM(gc_sweep_block) = 0;
+    MP_STATE_MEM(gc_sweep_free_tail) = 0;
+    MP_STATE_MEM(gc_lock_depth)--;
+    if (MP_STATE_MEM(gc_sweep_blocks_per_alloc) == 0) {
+        gc_sweep_run(0);
+    }
+    #else
+    gc_sweep_range(0, TOTAL_BLOCKS(), 0);
     MP_STATE_MEM(gc_lock_depth)--;
+    #endif
     GC_EXIT();
 }
 
 void gc_info(gc_info_t *info) {
     GC_ENTER();
+    #if MICROPY_GC_INCREMENTAL_SWEEP
+    // finish any pending sweep so the numbers are accurate
+    if (GC_SWEEP_PENDING() && MP_STATE_MEM(gc_lock_depth) == 0) {
+        gc_sweep_run(0);
+    }
+    #endif
     info->total = MP_STATE_MEM(gc_pool_end) - MP_STATE_MEM(gc_pool_start);
     info->used = 0;
     info->free = 0;
@@ -455,17 +613,49 @@ void *gc_alloc(size_t n_bytes, bool has_finaliser) {
     }
     #endif
 
+    #if MICROPY_GC_INCREMENTAL_SWEEP
+    // do our share of the pending sweep
+    if (GC_SWEEP_PENDING()) {
+        gc_sweep_run(MP_STATE_MEM(gc_sweep_blocks_per_alloc));
+    }
+    #endif
+
     for (;;) {
 
         // look for a run of n_blocks available blocks
-        for (i = MP_STATE_MEM(gc_last_free_atb_index); i < MP_STATE_MEM(gc_alloc_table_byte_len); i++) {
-            byte a = MP_STATE_MEM(gc_alloc_table_start)[i];
+        n_free = 0;
+        byte *atb = MP_STATE_MEM(gc_alloc_table_start);
+        size_t atb_len = MP_STATE_MEM(gc_alloc_table_byte_len);
+        for (i = MP_STATE_MEM(gc_first_fit_block)[GC_SIZE_CLASS(n_blocks)] / BLOCKS_PER_ATB; i < atb_len; i++) {
+            // skip over a whole word of the table if all its blocks are in use
+            if (((uintptr_t)&atb[i] & (sizeof(mp_uint_t) - 1)) == 0 && i + sizeof(mp_uint_t) <= atb_len) {
+                // memcpy keeps the aliasing rules and compiles to an aligned load
+                mp_uint_t w;
+                memcpy(&w, &atb[i], sizeof(w));
+                if (ATB_WORD_IS_FULL(w)) {
+                    n_free = 0;
+                    i += sizeof(mp_uint_t) - 1;
+                    continue;
+                }
+            }
+            byte a = atb[i];
             if (ATB_0_IS_FREE(a)) { if (++n_free >= n_blocks) { i = i * BLOCKS_PER_ATB + 0; goto found; } } else { n_free = 0; }
             if (ATB_1_IS_FREE(a)) { if (++n_free >= n_blocks) { i = i * BLOCKS_PER_ATB + 1; goto found; } } else { n_free = 0; }
             if (ATB_2_IS_FREE(a)) { if (++n_free >= n_blocks) { i = i * BLOCKS_PER_ATB + 2; goto found; } } else { n_free = 0; }
             if (ATB_3_IS_FREE(a)) { if (++n_free >= n_blocks) { i = i * BLOCKS_PER_ATB + 3; goto found; } } else { n_free = 0; }
         }
 
+        // there is no room for n_blocks (or more) until some blocks are freed
+        gc_first_fit_raise(n_blocks, TOTAL_BLOCKS());
+
+        #if MICROPY_GC_INCREMENTAL_SWEEP
+        // the rest of the pending sweep may free enough blocks
+        if (GC_SWEEP_PENDING()) {
+            gc_sweep_run(0);
+            continue;
+        }
+        #endif
+
         GC_EXIT();
         // nothing found!
         if (collected) {
@@ -483,14 +673,11 @@ found:
     end_block = i;
     start_block = i - n_free + 1;
 
-    // Set last free ATB index to block after last block we found, for start of
-    // next scan.  To reduce fragmentation, we only do this if we were looking
-    // for a single free block, which guarantees that there are no free blocks
-    // before this one.  Also, whenever we free or shink a block we must check
-    // if this index needs adjusting (see gc_realloc and gc_free).
-    if (n_free == 1) {
-        MP_STATE_MEM(gc_last_free_atb_index) = (i + 1) / BLOCKS_PER_ATB;
-    }
+    // This was the first fit for n_blocks, so once it is taken there is no run
+    // of n_blocks or more free blocks before the block after it.  Whenever we
+    // free or shrink a block the hints are lowered again (see gc_realloc and
+    // gc_free).
+    gc_first_fit_raise(n_blocks, end_block + 1);
 
     // mark first block as used head
     ATB_FREE_TO_HEAD(start_block);
@@ -501,6 +688,10 @@ found:
         ATB_FREE_TO_TAIL(bl);
     }
 
+    #if MICROPY_GC_INCREMENTAL_SWEEP
+    gc_sweep_keep(start_block, end_block);
+    #endif
+
     // get pointer to first block
     // we must create this pointer before unlocking the GC so a collection can find it
     void *ret_ptr = (void*)(MP_STATE_MEM(gc_pool_start) + start_block * BYTES_PER_BLOCK);
@@ -572,16 +763,14 @@ void gc_free(void *ptr) {
         // get the GC block number corresponding to this pointer
         assert(VERIFY_PTR(ptr));
         size_t block = BLOCK_FROM_PTR(ptr);
-        assert(ATB_GET_KIND(block) == AT_HEAD);
+        assert(ATB_KIND_IS_HEAD(ATB_GET_KIND(block)));
 
         #if MICROPY_ENABLE_FINALISER
         FTB_CLEAR(block);
         #endif
 
-        // set the last_free pointer to this block if it's earlier in the heap
-        if (block / BLOCKS_PER_ATB < MP_STATE_MEM(gc_last_free_atb_index)) {
-            MP_STATE_MEM(gc_last_free_atb_index) = block / BLOCKS_PER_ATB;
-        }
+        // lower the first-fit hints if this block is earlier in the heap
+        gc_first_fit_freed(block);
 
         // free head and all of its tail blocks
         do {
@@ -601,7 +790,7 @@ size_t gc_nbytes(const void *ptr) {
     GC_ENTER();
     if (VERIFY_PTR(ptr)) {
         size_t block = BLOCK_FROM_PTR(ptr);
-        if (ATB_GET_KIND(block) == AT_HEAD) {
+        if (ATB_KIND_IS_HEAD(ATB_GET_KIND(block))) {
             // work out number of consecutive blocks in the chain starting with this on
             size_t n_blocks = 0;
             do {
@@ -670,7 +859,7 @@ void *gc_realloc(void *ptr_in, size_t n_bytes, bool allow_move) {
     // get the GC block number corresponding to this pointer
     assert(VERIFY_PTR(ptr));
     size_t block = BLOCK_FROM_PTR(ptr);
-    assert(ATB_GET_KIND(block) == AT_HEAD);
+    assert(ATB_KIND_IS_HEAD(ATB_GET_KIND(block)));
 
     // compute number of new blocks that are requested
     size_t new_blocks = (n_bytes + BYTES_PER_BLOCK - 1) / BYTES_PER_BLOCK;
@@ -714,10 +903,8 @@ void *gc_realloc(void *ptr_in, size_t n_bytes, bool allow_move) {
             ATB_ANY_TO_FREE(bl);
         }
 
-        // set the last_free pointer to end of this block if it's earlier in the heap
-        if ((block + new_blocks) / BLOCKS_PER_ATB < MP_STATE_MEM(gc_last_free_atb_index)) {
-            MP_STATE_MEM(gc_last_free_atb_index) = (block + new_blocks) / BLOCKS_PER_ATB;
-        }
+        // lower the first-fit hints if the freed tail is earlier in the heap
+        gc_first_fit_freed(block + new_blocks);
 
         GC_EXIT();
 
@@ -736,6 +923,10 @@ void *gc_realloc(void *ptr_in, size_t n_bytes, bool allow_move) {
             ATB_FREE_TO_TAIL(bl);
         }
 
+        #if MICROPY_GC_INCREMENTAL_SWEEP
+        gc_sweep_keep(block, block + new_blocks - 1);
+        #endif
+
         GC_EXIT();
 
         #if MICROPY_GC_CONSERVATIVE_CLEAR
@@ -45,6 +45,14 @@ void gc_collect_start(void);
 void gc_collect_root(void **ptrs, size_t len);
 void gc_collect_end(void);
 
+#if MICROPY_GC_INCREMENTAL_SWEEP
+// Do up to n_blocks of the sweep left pending by the last collection (all of
+// it if n_blocks is 0).  Returns true if there is still sweeping to do.
+bool gc_sweep_incremental(size_t n_blocks);
+// Returns true if the last collection is not fully swept yet.
+bool gc_sweep_pending(void);
+#endif
+
 void *gc_alloc(size_t n_bytes, bool has_finaliser);
 void gc_free(void *ptr); // does not call finaliser
 size_t gc_nbytes(const void *ptr);
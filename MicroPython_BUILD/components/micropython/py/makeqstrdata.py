@@ -59,6 +59,27 @@ def compute_hash(qstr, bytes_hash):
     # Make sure that valid hash is never zero, zero means "hash not computed"
     return (hash & ((1 << (8 * bytes_hash)) - 1)) or 1
 
+# this must match QSTR_INDEX_SLOT in qstr.c
+def index_slot(qhash, qlen):
+    return (((qhash ^ (qlen << 8)) * 0x9e3779b1) & 0xffffffff) >> 16
+
+# build an open-addressed hash index (linear probing, at most half full) for a
+# constant qstr pool; each slot holds 1 + the position of a qstr in the pool,
+# or 0 if it is empty
+def make_index(cfg_bytes_hash, qstrs, first=0):
+    size = 4
+    while size < 2 * len(qstrs):
+        size *= 2
+    assert first + len(qstrs) < 0x10000
+    slots = [0] * size
+    for i, qstr in enumerate(qstrs):
+        qbytes = bytes_cons(qstr, 'utf8')
+        s = index_slot(compute_hash(qbytes, cfg_bytes_hash), len(qbytes)) & (size - 1)
+        while slots[s]:
+            s = (s + 1) & (size - 1)
+        slots[s] = first + i + 1
+    return slots
+
 def qstr_escape(qst):
     def esc_char(m):
         c = ord(m.group(0))
@@ -154,10 +175,19 @@ def print_qstr_data(qcfgs, qstrs):
     print('QDEF(MP_QSTR_NULL, (const byte*)"%s%s" "")' % ('\\x00' * cfg_bytes_hash, '\\x00' * cfg_bytes_len))
 
     # go through each qstr and print it out
-    for order, ident, qstr in sorted(qstrs.values(), key=lambda x: x[0]):
+    sorted_qstrs = sorted(qstrs.values(), key=lambda x: x[0])
+    for order, ident, qstr in sorted_qstrs:
         qbytes = make_bytes(cfg_bytes_len, cfg_bytes_hash, qstr)
         print('QDEF(MP_QSTR_%s, %s)' % (ident, qbytes))
 
+    # print the hash index of the pool, skipping the NULL qstr
+    slots = make_index(cfg_bytes_hash, [qstr for _, _, qstr in sorted_qstrs], 1)
+    print('')
+    print('#ifdef QINDEX')
+    for i in range(0, len(slots), 16):
+        print('QINDEX(%s)' % ', '.join(str(x) for x in slots[i:i + 16]))
+    print('#endif')
+
 def do_work(infiles):
     qcfgs, qstrs = parse_input_headers(infiles)
     print_qstr_data(qcfgs, qstrs)
@@ -76,18 +76,102 @@ STATIC size_t get_hash_alloc_greater_or_equal_to(size_t x) {
 /******************************************************************************/
 /* map                                                                        */
 
+// A map that is not fixed keeps its entries in insertion order in the dense
+// array map->table[0..alloc).  Small maps are searched linearly and stay
+// packed: removing an entry moves the following ones down.  Maps with more
+// than MAP_LINEAR_MAX entries are compact hash tables: deleted entries leave
+// a hole (key MP_OBJ_SENTINEL) and new ones are appended, and the table is
+// followed in the same allocation by a hash index.  Each index slot holds
+// 1 + the position of an entry, or 0 if it is empty, in 1, 2 or 4 bytes
+// depending on alloc.  Slots are never emptied, a slot of a deleted entry
+// just continues the probe sequence; the holes are dropped on resize.
+#define MAP_LINEAR_MAX (8)
+#define MAP_IS_INDEXED(alloc) ((alloc) > MAP_LINEAR_MAX)
+
+typedef struct _mp_map_index_t {
+    size_t filled; // number of entries used, including deleted ones
+    size_t bits; // the index has 1 << bits slots
+    byte slots[];
+} mp_map_index_t;
+
+#define MAP_INDEX(map) ((mp_map_index_t*)&(map)->table[(map)->alloc])
+
+// similar keys have similar hashes so they are spread out with a
+// multiplicative (Fibonacci) hash, taking the top bits of the product
+#define MAP_INDEX_SLOT(hash, bits) (((uint32_t)(hash) * 0x9e3779b1u) >> (32 - (bits)))
+
+STATIC size_t mp_map_index_bits(size_t alloc) {
+    // keep the index at most 2/3 full
+    size_t bits = 2;
+    while (((size_t)1 << bits) < alloc + alloc / 2 + 1) {
+        bits += 1;
+    }
+    return bits;
+}
+
+STATIC inline size_t mp_map_index_width(size_t alloc) {
+    return alloc < 0xff ? 1 : alloc < 0xffff ? 2 : 4;
+}
+
+STATIC size_t mp_map_table_size(size_t alloc) {
+    size_t n = alloc * sizeof(mp_map_elem_t);
+    if (MAP_IS_INDEXED(alloc)) {
+        n += sizeof(mp_map_index_t) + (mp_map_index_width(alloc) << mp_map_index_bits(alloc));
+    }
+    return n;
+}
+
+STATIC inline size_t mp_map_index_get(const byte *slots, size_t width, size_t i) {
+    if (width == 1) {
+        return slots[i];
+    } else if (width == 2) {
+        return ((const uint16_t*)slots)[i];
+    } else {
+        return ((const uint32_t*)slots)[i];
+    }
+}
+
+STATIC inline void mp_map_index_set(byte *slots, size_t width, size_t i, size_t val) {
+    if (width == 1) {
+        slots[i] = val;
+    } else if (width == 2) {
+        ((uint16_t*)slots)[i] = val;
+    } else {
+        ((uint32_t*)slots)[i] = val;
+    }
+}
+
+STATIC mp_uint_t mp_map_hash(mp_obj_t key) {
+    // fast path for common case of qstr
+    if (MP_OBJ_IS_QSTR(key)) {
+        return qstr_hash(MP_OBJ_QSTR_VALUE(key));
+    } else {
+        return MP_OBJ_SMALL_INT_VALUE(mp_unary_op(MP_UNARY_OP_HASH, key));
+    }
+}
+
+// Allocate an empty table for alloc entries, with its index if it needs one.
+STATIC mp_map_elem_t *mp_map_table_new(size_t alloc) {
+    mp_map_elem_t *table = (mp_map_elem_t*)m_new0(byte, mp_map_table_size(alloc));
+    if (MAP_IS_INDEXED(alloc)) {
+        ((mp_map_index_t*)&table[alloc])->bits = mp_map_index_bits(alloc);
+    }
+    return table;
+}
+
 void mp_map_init(mp_map_t *map, size_t n) {
     if (n == 0) {
         map->alloc = 0;
         map->table = NULL;
     } else {
         map->alloc = n;
-        map->table = m_new0(mp_map_elem_t, map->alloc);
+        map->table = mp_map_table_new(map->alloc);
     }
     map->used = 0;
     map->all_keys_are_qstrs = 1;
     map->is_fixed = 0;
     map->is_ordered = 0;
+    map->is_copy_on_write = 0;
 }
 
 void mp_map_init_fixed_table(mp_map_t *map, size_t n, const mp_obj_t *table) {
@@ -96,45 +180,87 @@ void mp_map_init_fixed_table(mp_map_t *map, size_t n, const mp_obj_t *table) {
     map->all_keys_are_qstrs = 1;
     map->is_fixed = 1;
     map->is_ordered = 1;
+    map->is_copy_on_write = 0;
     map->table = (mp_map_elem_t*)table;
 }
 
+void mp_map_init_copy(mp_map_t *map, const mp_map_t *src) {
+    if (src->is_fixed) {
+        // a fixed table has no index, so build a new table from its entries
+        mp_map_init(map, src->used);
+        for (size_t i = 0; i < src->used; i++) {
+            mp_map_lookup(map, src->table[i].key, MP_MAP_LOOKUP_ADD_IF_NOT_FOUND)->value = src->table[i].value;
+        }
+    } else {
+        size_t n = mp_map_table_size(src->alloc);
+        map->table = (mp_map_elem_t*)m_new(byte, n);
+        memcpy(map->table, src->table, n);
+        map->alloc = src->alloc;
+        map->used = src->used;
+        map->all_keys_are_qstrs = src->all_keys_are_qstrs;
+        map->is_fixed = 0;
+        map->is_copy_on_write = 0;
+    }
+    map->is_ordered = src->is_ordered;
+}
+
 // Differentiate from mp_map_clear() - semantics is different
 void mp_map_deinit(mp_map_t *map) {
     if (!map->is_fixed) {
-        m_del(mp_map_elem_t, map->table, map->alloc);
+        m_del(byte, map->table, mp_map_table_size(map->alloc));
     }
     map->used = map->alloc = 0;
 }
 
 void mp_map_clear(mp_map_t *map) {
     if (!map->is_fixed) {
-        m_del(mp_map_elem_t, map->table, map->alloc);
+        m_del(byte, map->table, mp_map_table_size(map->alloc));
     }
     map->alloc = 0;
     map->used = 0;
     map->all_keys_are_qstrs = 1;
     map->is_fixed = 0;
+    map->is_copy_on_write = 0;
     map->table = NULL;
 }
 
-STATIC void mp_map_rehash(mp_map_t *map) {
+// Move the entries of the map to a new table of new_alloc entries, dropping
+// the holes left by deleted entries and rebuilding the index.
+STATIC void mp_map_resize(mp_map_t *map, size_t new_alloc) {
     size_t old_alloc = map->alloc;
-    size_t new_alloc = get_hash_alloc_greater_or_equal_to(map->alloc + 1);
-    DEBUG_printf("mp_map_rehash(%p): " UINT_FMT " -> " UINT_FMT "\n", map, old_alloc, new_alloc);
+    size_t old_filled = MAP_IS_INDEXED(old_alloc) ? MAP_INDEX(map)->filled : map->used;
+    DEBUG_printf("mp_map_resize(%p): " UINT_FMT " -> " UINT_FMT "\n", map, old_alloc, new_alloc);
     mp_map_elem_t *old_table = map->table;
-    mp_map_elem_t *new_table = m_new0(mp_map_elem_t, new_alloc);
+    mp_map_elem_t *new_table = mp_map_table_new(new_alloc);
+    size_t n = 0;
+    bool all_keys_are_qstrs = true;
+    for (size_t i = 0; i < old_filled; i++) {
+        if (MP_MAP_SLOT_IS_FILLED(map, i)) {
+            new_table[n++] = old_table[i];
+            if (!MP_OBJ_IS_QSTR(old_table[i].key)) {
+                all_keys_are_qstrs = false;
+            }
+        }
+    }
+    if (MAP_IS_INDEXED(new_alloc)) {
+        mp_map_index_t *idx = (mp_map_index_t*)&new_table[new_alloc];
+        size_t width = mp_map_index_width(new_alloc);
+        size_t mask = ((size_t)1 << idx->bits) - 1;
+        idx->filled = n;
+        for (size_t i = 0; i < n; i++) {
+            // hashing may raise, but the map is not modified until all is done
+            size_t s = MAP_INDEX_SLOT(mp_map_hash(new_table[i].key), idx->bits);
+            while (mp_map_index_get(idx->slots, width, s) != 0) {
+                s = (s + 1) & mask;
+            }
+            mp_map_index_set(idx->slots, width, s, i + 1);
+        }
+    }
     // If we reach this point, table resizing succeeded, now we can edit the old map.
     map->alloc = new_alloc;
-    map->used = 0;
-    map->all_keys_are_qstrs = 1;
+    map->all_keys_are_qstrs = all_keys_are_qstrs;
     map->table = new_table;
-    for (size_t i = 0; i < old_alloc; i++) {
-        if (old_table[i].key != MP_OBJ_NULL && old_table[i].key != MP_OBJ_SENTINEL) {
-            mp_map_lookup(map, old_table[i].key, MP_MAP_LOOKUP_ADD_IF_NOT_FOUND)->value = old_table[i].value;
-        }
-    }
-    m_del(mp_map_elem_t, old_table, old_alloc);
+    m_del(byte, old_table, mp_map_table_size(old_alloc));
 }
 
 // MP_MAP_LOOKUP behaviour:
@@ -144,6 +270,14 @@ STATIC void mp_map_rehash(mp_map_t *map) {
 // MP_MAP_LOOKUP_REMOVE_IF_FOUND behaviour:
 //  - returns NULL if not found, else the slot if was found in with key null and value non-null
 mp_map_elem_t *mp_map_lookup(mp_map_t *map, mp_obj_t index, mp_map_lookup_kind_t lookup_kind) {
+    // A copy-on-write map is a fixed array until it is first modified
+    if (MP_UNLIKELY(map->is_copy_on_write) && lookup_kind != MP_MAP_LOOKUP) {
+        mp_map_t copy;
+        mp_map_init_copy(&copy, map);
+        copy.is_ordered = 0;
+        *map = copy;
+    }
+
     // If the map is a fixed array then we must only be called for a lookup
     assert(!map->is_fixed || lookup_kind == MP_MAP_LOOKUP);
 
@@ -166,11 +300,10 @@ mp_map_elem_t *mp_map_lookup(mp_map_t *map, mp_obj_t index, mp_map_lookup_kind_t
         }
     }
 
-    // if the map is an ordered array then we must do a brute force linear search
-    if (map->is_ordered) {
+    // if the map is a fixed or small array then we must do a brute force linear search
+    if (map->is_fixed || !MAP_IS_INDEXED(map->alloc)) {
         for (mp_map_elem_t *elem = &map->table[0], *top = &map->table[map->used]; elem < top; elem++) {
             if (elem->key == index || (!compare_only_ptrs && mp_obj_equal(elem->key, index))) {
-                #if MICROPY_PY_COLLECTIONS_ORDEREDDICT
                 if (MP_UNLIKELY(lookup_kind == MP_MAP_LOOKUP_REMOVE_IF_FOUND)) {
                     // remove the found element by moving the rest of the array down
                     mp_obj_t value = elem->value;
@@ -181,116 +314,72 @@ mp_map_elem_t *mp_map_lookup(mp_map_t *map, mp_obj_t index, mp_map_lookup_kind_t
                     elem->key = MP_OBJ_NULL;
                     elem->value = value;
                 }
-                #endif
                 return elem;
             }
         }
-        #if MICROPY_PY_COLLECTIONS_ORDEREDDICT
+        if (!map->is_fixed && !MP_OBJ_IS_QSTR(index)) {
+            // the search didn't need the hash, but an unhashable key must
+            // raise TypeError here as it does with a hash table
+            mp_map_hash(index);
+        }
         if (MP_LIKELY(lookup_kind != MP_MAP_LOOKUP_ADD_IF_NOT_FOUND)) {
             return NULL;
         }
         if (map->used == map->alloc) {
-            // TODO: Alloc policy
-            map->alloc += 4;
-            map->table = m_renew(mp_map_elem_t, map->table, map->used, map->alloc);
-            mp_seq_clear(map->table, map->used, map->alloc, sizeof(*map->table));
+            // grow by about 1.5 times, which may turn the map into a hash table
+            mp_map_resize(map, map->alloc + map->alloc / 2 + 2);
         }
-        mp_map_elem_t *elem = map->table + map->used++;
-        elem->key = index;
-        if (!MP_OBJ_IS_QSTR(index)) {
-            map->all_keys_are_qstrs = 0;
-        }
-        return elem;
-        #else
-        return NULL;
-        #endif
-    }
-
-    // map is a hash table (not an ordered array), so do a hash lookup
-
-    if (map->alloc == 0) {
-        if (lookup_kind == MP_MAP_LOOKUP_ADD_IF_NOT_FOUND) {
-            mp_map_rehash(map);
-        } else {
-            return NULL;
+        if (!MAP_IS_INDEXED(map->alloc)) {
+            mp_map_elem_t *elem = map->table + map->used++;
+            elem->key = index;
+            elem->value = MP_OBJ_NULL;
+            if (!MP_OBJ_IS_QSTR(index)) {
+                map->all_keys_are_qstrs = 0;
+            }
+            return elem;
         }
     }
 
-    // get hash of index, with fast path for common case of qstr
-    mp_uint_t hash;
-    if (MP_OBJ_IS_QSTR(index)) {
-        hash = qstr_hash(MP_OBJ_QSTR_VALUE(index));
-    } else {
-        hash = MP_OBJ_SMALL_INT_VALUE(mp_unary_op(MP_UNARY_OP_HASH, index));
-    }
-
-    size_t pos = hash % map->alloc;
-    size_t start_pos = pos;
-    mp_map_elem_t *avail_slot = NULL;
-    for (;;) {
-        mp_map_elem_t *slot = &map->table[pos];
-        if (slot->key == MP_OBJ_NULL) {
-            // found NULL slot, so index is not in table
-            if (lookup_kind == MP_MAP_LOOKUP_ADD_IF_NOT_FOUND) {
-                map->used += 1;
-                if (avail_slot == NULL) {
-                    avail_slot = slot;
-                }
-                avail_slot->key = index;
-                avail_slot->value = MP_OBJ_NULL;
-                if (!MP_OBJ_IS_QSTR(index)) {
-                    map->all_keys_are_qstrs = 0;
-                }
-                return avail_slot;
-            } else {
+    // map is a hash table (not a small array), so do a hash lookup
+
+    mp_uint_t hash = mp_map_hash(index);
+    mp_map_index_t *idx = MAP_INDEX(map);
+    size_t width = mp_map_index_width(map->alloc);
+    size_t mask = ((size_t)1 << idx->bits) - 1;
+    for (size_t s = MAP_INDEX_SLOT(hash, idx->bits);; s = (s + 1) & mask) {
+        size_t pos = mp_map_index_get(idx->slots, width, s);
+        if (pos == 0) {
+            // found empty slot, so index is not in table
+            if (lookup_kind != MP_MAP_LOOKUP_ADD_IF_NOT_FOUND) {
                 return NULL;
             }
-        } else if (slot->key == MP_OBJ_SENTINEL) {
-            // found deleted slot, remember for later
-            if (avail_slot == NULL) {
-                avail_slot = slot;
+            if (idx->filled == map->alloc) {
+                // not enough room in table, resize it (dropping any holes)
+                // and restart the search, the map may be small again
+                mp_map_resize(map, map->used + map->used / 2 + 2);
+                return mp_map_lookup(map, index, lookup_kind);
+            }
+            mp_map_index_set(idx->slots, width, s, idx->filled + 1);
+            mp_map_elem_t *elem = &map->table[idx->filled++];
+            map->used += 1;
+            elem->key = index;
+            elem->value = MP_OBJ_NULL;
+            if (!MP_OBJ_IS_QSTR(index)) {
+                map->all_keys_are_qstrs = 0;
             }
-        } else if (slot->key == index || (!compare_only_ptrs && mp_obj_equal(slot->key, index))) {
+            return elem;
+        }
+        mp_map_elem_t *elem = &map->table[pos - 1];
+        if (elem->key == index || (!compare_only_ptrs && elem->key != MP_OBJ_SENTINEL && mp_obj_equal(elem->key, index))) {
             // found index
             // Note: CPython does not replace the index; try x={True:'true'};x[1]='one';x
             if (lookup_kind == MP_MAP_LOOKUP_REMOVE_IF_FOUND) {
-                // delete element in this slot
+                // delete the entry, leaving a hole; its index slot stays in use
                 map->used--;
-                if (map->table[(pos + 1) % map->alloc].key == MP_OBJ_NULL) {
-                    // optimisation if next slot is empty
-                    slot->key = MP_OBJ_NULL;
-                } else {
-                    slot->key = MP_OBJ_SENTINEL;
-                }
-                // keep slot->value so that caller can access it if needed
-            }
-            return slot;
-        }
-
-        // not yet found, keep searching in this table
-        pos = (pos + 1) % map->alloc;
-
-        if (pos == start_pos) {
-            // search got back to starting position, so index is not in table
-            if (lookup_kind == MP_MAP_LOOKUP_ADD_IF_NOT_FOUND) {
-                if (avail_slot != NULL) {
-                    // there was an available slot, so use that
-                    map->used++;
-                    avail_slot->key = index;
-                    avail_slot->value = MP_OBJ_NULL;
-                    if (!MP_OBJ_IS_QSTR(index)) {
-                        map->all_keys_are_qstrs = 0;
-                    }
-                    return avail_slot;
-                } else {
-                    // not enough room in table, rehash it
-                    mp_map_rehash(map);
-                    // restart the search for the new element
-                    start_pos = pos = hash % map->alloc;
-                }
-            } else {
-                return NULL;
+                elem->key = MP_OBJ_SENTINEL;
+                // keep elem->value so that caller can access it if needed
             }
+            return elem;
         }
     }
 }
@@ -27,9 +27,67 @@
 #include "py/mpstate.h"
 #include "py/obj.h"
 #include "py/gc.h"
+#include "py/runtime.h"
+#if MICROPY_GC_INCREMENTAL_SWEEP
+#include "py/mphal.h"
+#endif
 
 #if MICROPY_PY_GC && MICROPY_ENABLE_GC
 
+#if MICROPY_GC_INCREMENTAL_SWEEP
+
+// Number of blocks swept between checks of the time budget
+#define GC_SWEEP_CHUNK (1024)
+
+// collect([budget_us]): run a garbage collection
+// With a budget, a new collection is only started if the previous one has
+// been fully swept, and sweeping stops once the budget (in microseconds) is
+// used up; the remaining sweep is then done by the following allocations or
+// calls to collect(budget_us).  Returns True once the sweep is complete.
+STATIC mp_obj_t py_gc_collect(size_t n_args, const mp_obj_t *args) {
+    if (n_args == 0) {
+        gc_collect();
+        gc_sweep_incremental(0);
+    } else {
+        mp_int_t budget = mp_obj_get_int(args[0]);
+        if (budget < 0) {
+            mp_raise_ValueError(NULL);
+        }
+        mp_uint_t start = mp_hal_ticks_us();
+        if (!gc_sweep_pending()) {
+            gc_collect();
+        }
+        bool pending;
+        do {
+            pending = gc_sweep_incremental(GC_SWEEP_CHUNK);
+        } while (pending && mp_hal_ticks_us() - start < (mp_uint_t)budget);
+        return mp_obj_new_bool(!pending);
+    }
+#if MICROPY_PY_GC_COLLECT_RETVAL
+    return MP_OBJ_NEW_SMALL_INT(MP_STATE_MEM(gc_collected));
+#else
+    return mp_const_none;
+#endif
+}
+MP_DEFINE_CONST_FUN_OBJ_VAR_BETWEEN(gc_collect_obj, 0, 1, py_gc_collect);
+
+// sweep_step([blocks]): get or set the number of heap blocks swept per
+// allocation after a collection; 0 sweeps the whole heap in the collection.
+STATIC mp_obj_t gc_sweep_step(size_t n_args, const mp_obj_t *args) {
+    if (n_args == 0) {
+        return mp_obj_new_int(MP_STATE_MEM(gc_sweep_blocks_per_alloc));
+    }
+    mp_int_t val = mp_obj_get_int(args[0]);
+    if (val < 0) {
+        mp_raise_ValueError(NULL);
+    }
+    MP_STATE_MEM(gc_sweep_blocks_per_alloc) = val;
+    return mp_const_none;
+}
+MP_DEFINE_CONST_FUN_OBJ_VAR_BETWEEN(gc_sweep_step_obj, 0, 1, gc_sweep_step);
+
+#else
+
 // collect(): run a garbage collection
 STATIC mp_obj_t py_gc_collect(void) {
     gc_collect();
@@ -41,6 +99,8 @@ STATIC mp_obj_t py_gc_collect(void) {
 }
 MP_DEFINE_CONST_FUN_OBJ_0(gc_collect_obj, py_gc_collect);
 
+#endif
+
 // disable(): disable the garbage collector
 STATIC mp_obj_t gc_disable(void) {
     MP_STATE_MEM(gc_auto_collect_enabled) = 0;
@@ -106,6 +166,9 @@ STATIC const mp_rom_map_elem_t mp_module_gc_globals_table[] = {
     #if MICROPY_GC_ALLOC_THRESHOLD
     { MP_ROM_QSTR(MP_QSTR_threshold), MP_ROM_PTR(&gc_threshold_obj) },
     #endif
+    #if MICROPY_GC_INCREMENTAL_SWEEP
+    { MP_ROM_QSTR(MP_QSTR_sweep_step), MP_ROM_PTR(&gc_sweep_step_obj) },
+    #endif
 };
 
 STATIC MP_DEFINE_CONST_DICT(mp_module_gc_globals, mp_module_gc_globals_table);
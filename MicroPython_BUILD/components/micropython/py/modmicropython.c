@@ -98,6 +98,12 @@ STATIC mp_obj_t mp_micropython_qstr_info(size_t n_args, const mp_obj_t *args) {
     qstr_pool_info(&n_pool, &n_qstr, &n_str_data_bytes, &n_total_bytes);
     mp_printf(&mp_plat_print, "qstr pool: n_pool=%u, n_qstr=%u, n_str_data_bytes=%u, n_total_bytes=%u\n",
         n_pool, n_qstr, n_str_data_bytes, n_total_bytes);
+    #if MICROPY_QSTR_INDEX
+    size_t n_lookup, n_probe, n_index_bytes;
+    qstr_index_info(&n_lookup, &n_probe, &n_index_bytes);
+    mp_printf(&mp_plat_print, "qstr index: n_lookup=%u, n_probe=%u, n_index_bytes=%u\n",
+        n_lookup, n_probe, n_index_bytes);
+    #endif
     if (n_args == 1) {
         // arg given means dump qstr data
         qstr_dump_data();
@@ -82,15 +82,63 @@ STATIC mp_uint_t get_fmt_num(const char **p) {
     return val;
 }
 
-STATIC size_t calc_size_items(const char *fmt, size_t *total_sz) {
+// A format string is compiled once into a Struct object, which holds the
+// byte order and a list of (count, type) codes along with the total size and
+// number of items, so that packing and unpacking don't parse the format.
+typedef struct _struct_code_t {
+    mp_uint_t cnt;
+    char type;
+} struct_code_t;
+
+typedef struct _mp_obj_struct_t {
+    mp_obj_base_t base;
+    mp_obj_t fmt;
+    size_t size;
+    size_t num_items;
+    size_t n_codes;
+    char fmt_type;
+    struct_code_t codes[];
+} mp_obj_struct_t;
+
+typedef struct _mp_obj_struct_iter_t {
+    mp_obj_base_t base;
+    mp_fun_1_t iternext;
+    mp_obj_struct_t *st;
+    mp_obj_t buf;
+    size_t offset;
+} mp_obj_struct_iter_t;
+
+STATIC const mp_obj_type_t struct_type_Struct;
+
+STATIC mp_obj_struct_t *struct_compile(mp_obj_t fmt_in) {
+    const char *fmt = mp_obj_str_get_str(fmt_in);
     char fmt_type = get_fmt_type(&fmt);
+
+    size_t n_codes = 0;
+    for (const char *f = fmt; *f; f++) {
+        if (!unichar_isdigit(*f)) {
+            n_codes++;
+        }
+    }
+
+    mp_obj_struct_t *self = m_new_obj_var(mp_obj_struct_t, struct_code_t, n_codes);
+    self->base.type = &struct_type_Struct;
+    self->fmt = fmt_in;
+    self->n_codes = n_codes;
+    self->fmt_type = fmt_type;
     size_t total_cnt = 0;
-    size_t size;
-    for (size = 0; *fmt; fmt++) {
+    size_t size = 0;
+    for (struct_code_t *code = self->codes; *fmt; fmt++, code++) {
         mp_uint_t cnt = 1;
         if (unichar_isdigit(*fmt)) {
             cnt = get_fmt_num(&fmt);
+            if (*fmt == '\0') {
+                // a count must be followed by a type
+                mp_raise_ValueError("bad format");
+            }
         }
+        code->cnt = cnt;
+        code->type = *fmt;
 
         if (*fmt == 's') {
             total_cnt += 1;
@@ -106,91 +154,159 @@ STATIC size_t calc_size_items(const char *fmt, size_t *total_sz) {
             }
         }
     }
-    *total_sz = size;
-    return total_cnt;
+    self->size = size;
+    self->num_items = total_cnt;
+    return self;
 }
 
-STATIC mp_obj_t struct_calcsize(mp_obj_t fmt_in) {
-    const char *fmt = mp_obj_str_get_str(fmt_in);
-    size_t size;
-    calc_size_items(fmt, &size);
-    return MP_OBJ_NEW_SMALL_INT(size);
+// Get the compiled form of the given format string, or Struct object.  Format
+// strings are kept in a small cache, most recently compiled first; the cache
+// keeps them alive, so the same string object is found by identity.
+STATIC mp_obj_struct_t *struct_get(mp_obj_t fmt_in) {
+    if (MP_OBJ_IS_TYPE(fmt_in, &struct_type_Struct)) {
+        return MP_OBJ_TO_PTR(fmt_in);
+    }
+    #if MICROPY_PY_STRUCT_CACHE_SIZE
+    if (MP_OBJ_IS_STR(fmt_in)) {
+        mp_obj_t *cache = MP_STATE_VM(struct_cache);
+        for (size_t i = 0; i < MICROPY_PY_STRUCT_CACHE_SIZE && cache[i] != MP_OBJ_NULL; i++) {
+            mp_obj_struct_t *st = MP_OBJ_TO_PTR(cache[i]);
+            if (st->fmt == fmt_in || mp_obj_str_equal(st->fmt, fmt_in)) {
+                return st;
+            }
+        }
+        mp_obj_struct_t *st = struct_compile(fmt_in);
+        memmove(cache + 1, cache, (MICROPY_PY_STRUCT_CACHE_SIZE - 1) * sizeof(mp_obj_t));
+        cache[0] = MP_OBJ_FROM_PTR(st);
+        return st;
+    }
+    #endif
+    return struct_compile(fmt_in);
 }
-MP_DEFINE_CONST_FUN_OBJ_1(struct_calcsize_obj, struct_calcsize);
 
-STATIC mp_obj_t struct_unpack_from(size_t n_args, const mp_obj_t *args) {
-    // unpack requires that the buffer be exactly the right size.
-    // unpack_from requires that the buffer be "big enough".
-    // Since we implement unpack and unpack_from using the same function
-    // we relax the "exact" requirement, and only implement "big enough".
-    const char *fmt = mp_obj_str_get_str(args[0]);
-    size_t total_sz;
-    size_t num_items = calc_size_items(fmt, &total_sz);
-    char fmt_type = get_fmt_type(&fmt);
-    mp_obj_tuple_t *res = MP_OBJ_TO_PTR(mp_obj_new_tuple(num_items, NULL));
+// Get the buffer of buf_in and check that it holds self->size bytes from offset_in
+// (if given), returning a pointer to the data.
+STATIC byte *struct_get_buf(const mp_obj_struct_t *self, mp_obj_t buf_in, mp_obj_t offset_in, mp_uint_t flags) {
     mp_buffer_info_t bufinfo;
-    mp_get_buffer_raise(args[1], &bufinfo, MP_BUFFER_READ);
+    mp_get_buffer_raise(buf_in, &bufinfo, flags);
     byte *p = bufinfo.buf;
-    byte *end_p = &p[bufinfo.len];
     mp_int_t offset = 0;
-
-    if (n_args > 2) {
-        // offset arg provided
-        offset = mp_obj_get_int(args[2]);
+    if (offset_in != MP_OBJ_NULL) {
+        offset = mp_obj_get_int(offset_in);
         if (offset < 0) {
             // negative offsets are relative to the end of the buffer
-            offset = bufinfo.len + offset;
+            offset = (mp_int_t)bufinfo.len + offset;
             if (offset < 0) {
                 mp_raise_ValueError("buffer too small");
             }
         }
-        p += offset;
     }
-
-    // Check that the input buffer is big enough to unpack all the values
-    if (p + total_sz > end_p) {
+    if ((size_t)offset > bufinfo.len || bufinfo.len - offset < self->size) {
         mp_raise_ValueError("buffer too small");
     }
+    return p + offset;
+}
 
-    for (size_t i = 0; i < num_items;) {
-        mp_uint_t cnt = 1;
-        if (unichar_isdigit(*fmt)) {
-            cnt = get_fmt_num(&fmt);
-        }
-        mp_obj_t item;
-        if (*fmt == 's') {
-            item = mp_obj_new_bytes(p, cnt);
+// Unpack the values at p into the num_items entries of items.
+STATIC void struct_unpack_internal(const mp_obj_struct_t *self, byte *p, mp_obj_t *items) {
+    char fmt_type = self->fmt_type;
+    for (const struct_code_t *code = self->codes; code < self->codes + self->n_codes; code++) {
+        mp_uint_t cnt = code->cnt;
+        char type = code->type;
+        if (type == 's') {
+            *items++ = mp_obj_new_bytes(p, cnt);
             p += cnt;
-            res->items[i++] = item;
         } else {
             while (cnt--) {
-                item = mp_binary_get_val(fmt_type, *fmt, &p);
-                res->items[i++] = item;
+                *items++ = mp_binary_get_val(fmt_type, type, &p);
             }
         }
-        fmt++;
     }
-    return MP_OBJ_FROM_PTR(res);
 }
-MP_DEFINE_CONST_FUN_OBJ_VAR_BETWEEN(struct_unpack_from_obj, 2, 3, struct_unpack_from);
 
-// This function assumes there is enough room in p to store all the values
-STATIC void struct_pack_into_internal(mp_obj_t fmt_in, byte *p, size_t n_args, const mp_obj_t *args) {
-    const char *fmt = mp_obj_str_get_str(fmt_in);
-    char fmt_type = get_fmt_type(&fmt);
+STATIC mp_obj_t struct_calcsize(mp_obj_t fmt_in) {
+    return MP_OBJ_NEW_SMALL_INT(struct_get(fmt_in)->size);
+}
+MP_DEFINE_CONST_FUN_OBJ_1(struct_calcsize_obj, struct_calcsize);
 
-    size_t i;
-    for (i = 0; i < n_args;) {
-        mp_uint_t cnt = 1;
-        if (*fmt == '\0') {
-            // more arguments given than used by format string; CPython raises struct.error here
-            break;
+// The following functions take either a format string or a Struct as their
+// first argument, so they serve both as functions of the module and methods
+// of Struct.
+
+STATIC mp_obj_t struct_unpack_from(size_t n_args, const mp_obj_t *args) {
+    // unpack requires that the buffer be exactly the right size.
+    // unpack_from requires that the buffer be "big enough".
+    // Since we implement unpack and unpack_from using the same function
+    // we relax the "exact" requirement, and only implement "big enough".
+    mp_obj_struct_t *self = struct_get(args[0]);
+    byte *p = struct_get_buf(self, args[1], n_args > 2 ? args[2] : MP_OBJ_NULL, MP_BUFFER_READ);
+
+    if (n_args > 3 && args[3] != mp_const_none) {
+        // unpack into the given list or array, which must be the right length
+        mp_obj_t out = args[3];
+        if (mp_obj_get_int(mp_obj_len(out)) != (mp_int_t)self->num_items) {
+            mp_raise_ValueError("wrong number of items");
         }
-        if (unichar_isdigit(*fmt)) {
-            cnt = get_fmt_num(&fmt);
+        if (MP_OBJ_IS_TYPE(out, &mp_type_list)) {
+            size_t len;
+            mp_obj_t *items;
+            mp_obj_list_get(out, &len, &items);
+            struct_unpack_internal(self, p, items);
+        } else {
+            mp_obj_t *items = m_new(mp_obj_t, self->num_items);
+            struct_unpack_internal(self, p, items);
+            for (size_t i = 0; i < self->num_items; i++) {
+                mp_obj_subscr(out, MP_OBJ_NEW_SMALL_INT(i), items[i]);
+            }
+            m_del(mp_obj_t, items, self->num_items);
         }
+        return out;
+    }
 
-        if (*fmt == 's') {
+    mp_obj_tuple_t *res = MP_OBJ_TO_PTR(mp_obj_new_tuple(self->num_items, NULL));
+    struct_unpack_internal(self, p, res->items);
+    return MP_OBJ_FROM_PTR(res);
+}
+MP_DEFINE_CONST_FUN_OBJ_VAR_BETWEEN(struct_unpack_from_obj, 2, 4, struct_unpack_from);
+
+STATIC mp_obj_t struct_iter_unpack_iternext(mp_obj_t self_in) {
+    mp_obj_struct_iter_t *self = MP_OBJ_TO_PTR(self_in);
+    // get the buffer each time, in case it moved
+    mp_buffer_info_t bufinfo;
+    mp_get_buffer_raise(self->buf, &bufinfo, MP_BUFFER_READ);
+    if (bufinfo.len < self->offset + self->st->size) {
+        return MP_OBJ_STOP_ITERATION;
+    }
+    mp_obj_tuple_t *res = MP_OBJ_TO_PTR(mp_obj_new_tuple(self->st->num_items, NULL));
+    struct_unpack_internal(self->st, (byte*)bufinfo.buf + self->offset, res->items);
+    self->offset += self->st->size;
+    return MP_OBJ_FROM_PTR(res);
+}
+
+STATIC mp_obj_t struct_iter_unpack(mp_obj_t fmt_in, mp_obj_t buf_in) {
+    mp_obj_struct_t *st = struct_get(fmt_in);
+    mp_buffer_info_t bufinfo;
+    mp_get_buffer_raise(buf_in, &bufinfo, MP_BUFFER_READ);
+    if (st->size == 0 || bufinfo.len % st->size != 0) {
+        mp_raise_ValueError("buffer size not a multiple of struct size");
+    }
+    mp_obj_struct_iter_t *o = m_new_obj(mp_obj_struct_iter_t);
+    o->base.type = &mp_type_polymorph_iter;
+    o->iternext = struct_iter_unpack_iternext;
+    o->st = st;
+    o->buf = buf_in;
+    o->offset = 0;
+    return MP_OBJ_FROM_PTR(o);
+}
+MP_DEFINE_CONST_FUN_OBJ_2(struct_iter_unpack_obj, struct_iter_unpack);
+
+// This function assumes there is enough room in p to store all the values
+STATIC void struct_pack_into_internal(const mp_obj_struct_t *self, byte *p, size_t n_args, const mp_obj_t *args) {
+    size_t i = 0;
+    // if more arguments are given than used by format string CPython raises struct.error
+    for (const struct_code_t *code = self->codes; code < self->codes + self->n_codes && i < n_args; code++) {
+        mp_uint_t cnt = code->cnt;
+        if (code->type == 's') {
             mp_buffer_info_t bufinfo;
             mp_get_buffer_raise(args[i++], &bufinfo, MP_BUFFER_READ);
             mp_uint_t to_copy = cnt;
@@ -203,51 +319,87 @@ STATIC void struct_pack_into_internal(mp_obj_t fmt_in, byte *p, size_t n_args, c
         } else {
             // If we run out of args then we just finish; CPython would raise struct.error
             while (cnt-- && i < n_args) {
-                mp_binary_set_val(fmt_type, *fmt, args[i++], &p);
+                mp_binary_set_val(self->fmt_type, code->type, args[i++], &p);
             }
         }
-        fmt++;
     }
 }
 
 STATIC mp_obj_t struct_pack(size_t n_args, const mp_obj_t *args) {
     // TODO: "The arguments must match the values required by the format exactly."
-    mp_int_t size = MP_OBJ_SMALL_INT_VALUE(struct_calcsize(args[0]));
+    mp_obj_struct_t *self = struct_get(args[0]);
     vstr_t vstr;
-    vstr_init_len(&vstr, size);
+    vstr_init_len(&vstr, self->size);
     byte *p = (byte*)vstr.buf;
-    memset(p, 0, size);
-    struct_pack_into_internal(args[0], p, n_args - 1, &args[1]);
+    memset(p, 0, self->size);
+    struct_pack_into_internal(self, p, n_args - 1, &args[1]);
     return mp_obj_new_str_from_vstr(&mp_type_bytes, &vstr);
 }
 MP_DEFINE_CONST_FUN_OBJ_VAR_BETWEEN(struct_pack_obj, 1, MP_OBJ_FUN_ARGS_MAX, struct_pack);
 
 STATIC mp_obj_t struct_pack_into(size_t n_args, const mp_obj_t *args) {
-    mp_buffer_info_t bufinfo;
-    mp_get_buffer_raise(args[1], &bufinfo, MP_BUFFER_WRITE);
-    mp_int_t offset = mp_obj_get_int(args[2]);
-    if (offset < 0) {
-        // negative offsets are relative to the end of the buffer
-        offset = (mp_int_t)bufinfo.len + offset;
-        if (offset < 0) {
-            mp_raise_ValueError("buffer too small");
-        }
-    }
-    byte *p = (byte *)bufinfo.buf;
-    byte *end_p = &p[bufinfo.len];
-    p += offset;
-
-    // Check that the output buffer is big enough to hold all the values
-    mp_int_t sz = MP_OBJ_SMALL_INT_VALUE(struct_calcsize(args[0]));
-    if (p + sz > end_p) {
-        mp_raise_ValueError("buffer too small");
-    }
-
-    struct_pack_into_internal(args[0], p, n_args - 3, &args[3]);
+    mp_obj_struct_t *self = struct_get(args[0]);
+    byte *p = struct_get_buf(self, args[1], args[2], MP_BUFFER_WRITE);
+    struct_pack_into_internal(self, p, n_args - 3, &args[3]);
     return mp_const_none;
 }
 MP_DEFINE_CONST_FUN_OBJ_VAR_BETWEEN(struct_pack_into_obj, 3, MP_OBJ_FUN_ARGS_MAX, struct_pack_into);
 
+/******************************************************************************/
+// Struct class
+
+STATIC mp_obj_t struct_make_new(const mp_obj_type_t *type, size_t n_args, size_t n_kw, const mp_obj_t *args) {
+    (void)type;
+    mp_arg_check_num(n_args, n_kw, 1, 1, false);
+    return MP_OBJ_FROM_PTR(struct_get(args[0]));
+}
+
+STATIC void struct_print(const mp_print_t *print, mp_obj_t self_in, mp_print_kind_t kind) {
+    (void)kind;
+    mp_obj_struct_t *self = MP_OBJ_TO_PTR(self_in);
+    mp_print_str(print, "Struct(");
+    mp_obj_print_helper(print, self->fmt, PRINT_REPR);
+    mp_print_str(print, ")");
+}
+
+STATIC const mp_rom_map_elem_t struct_locals_dict_table[] = {
+    { MP_ROM_QSTR(MP_QSTR_pack), MP_ROM_PTR(&struct_pack_obj) },
+    { MP_ROM_QSTR(MP_QSTR_pack_into), MP_ROM_PTR(&struct_pack_into_obj) },
+    { MP_ROM_QSTR(MP_QSTR_unpack), MP_ROM_PTR(&struct_unpack_from_obj) },
+    { MP_ROM_QSTR(MP_QSTR_unpack_from), MP_ROM_PTR(&struct_unpack_from_obj) },
+    { MP_ROM_QSTR(MP_QSTR_iter_unpack), MP_ROM_PTR(&struct_iter_unpack_obj) },
+};
+
+STATIC MP_DEFINE_CONST_DICT(struct_locals_dict, struct_locals_dict_table);
+
+STATIC void struct_attr(mp_obj_t self_in, qstr attr, mp_obj_t *dest) {
+    if (dest[0] != MP_OBJ_NULL) {
+        // not load attribute
+        return;
+    }
+    mp_obj_struct_t *self = MP_OBJ_TO_PTR(self_in);
+    if (attr == MP_QSTR_size) {
+        dest[0] = MP_OBJ_NEW_SMALL_INT(self->size);
+    } else if (attr == MP_QSTR_format) {
+        dest[0] = self->fmt;
+    } else {
+        // a type with an attr handler must look up its methods itself
+        mp_map_elem_t *elem = mp_map_lookup((mp_map_t*)&struct_locals_dict.map, MP_OBJ_NEW_QSTR(attr), MP_MAP_LOOKUP);
+        if (elem != NULL) {
+            mp_convert_member_lookup(self_in, &struct_type_Struct, elem->value, dest);
+        }
+    }
+}
+
+STATIC const mp_obj_type_t struct_type_Struct = {
+    { &mp_type_type },
+    .name = MP_QSTR_Struct,
+    .print = struct_print,
+    .make_new = struct_make_new,
+    .attr = struct_attr,
+    .locals_dict = (mp_obj_dict_t*)&struct_locals_dict,
+};
+
 STATIC const mp_rom_map_elem_t mp_module_struct_globals_table[] = {
     { MP_ROM_QSTR(MP_QSTR___name__), MP_ROM_QSTR(MP_QSTR_ustruct) },
     { MP_ROM_QSTR(MP_QSTR_calcsize), MP_ROM_PTR(&struct_calcsize_obj) },
@@ -255,6 +407,8 @@ STATIC const mp_rom_map_elem_t mp_module_struct_globals_table[] = {
     { MP_ROM_QSTR(MP_QSTR_pack_into), MP_ROM_PTR(&struct_pack_into_obj) },
     { MP_ROM_QSTR(MP_QSTR_unpack), MP_ROM_PTR(&struct_unpack_from_obj) },
     { MP_ROM_QSTR(MP_QSTR_unpack_from), MP_ROM_PTR(&struct_unpack_from_obj) },
+    { MP_ROM_QSTR(MP_QSTR_iter_unpack), MP_ROM_PTR(&struct_iter_unpack_obj) },
+    { MP_ROM_QSTR(MP_QSTR_Struct), MP_ROM_PTR(&struct_type_Struct) },
 };
 
 STATIC MP_DEFINE_CONST_DICT(mp_module_struct_globals, mp_module_struct_globals_table);
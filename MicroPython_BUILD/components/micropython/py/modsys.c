@@ -162,8 +162,10 @@ MP_DEFINE_CONST_FUN_OBJ_0(mp_sys_mpycore_obj, mp_sys_mpycore);
 STATIC const mp_rom_map_elem_t mp_module_sys_globals_table[] = {
     { MP_ROM_QSTR(MP_QSTR___name__), MP_ROM_QSTR(MP_QSTR_sys) },
 
+    #if !MICROPY_PY_THREAD_WORKERS
     { MP_ROM_QSTR(MP_QSTR_path), MP_ROM_PTR(&MP_STATE_VM(mp_sys_path_obj)) },
     { MP_ROM_QSTR(MP_QSTR_argv), MP_ROM_PTR(&MP_STATE_VM(mp_sys_argv_obj)) },
+    #endif
     { MP_ROM_QSTR(MP_QSTR_version), MP_ROM_PTR(&version_obj) },
     { MP_ROM_QSTR(MP_QSTR_version_info), MP_ROM_PTR(&mp_sys_version_info_obj) },
     { MP_ROM_QSTR(MP_QSTR_implementation), MP_ROM_PTR(&mp_sys_implementation_obj) },
@@ -200,7 +202,7 @@ STATIC const mp_rom_map_elem_t mp_module_sys_globals_table[] = {
     { MP_ROM_QSTR(MP_QSTR_stderr), MP_ROM_PTR(&mp_sys_stderr_obj) },
     #endif
 
-    #if MICROPY_PY_SYS_MODULES
+    #if MICROPY_PY_SYS_MODULES && !MICROPY_PY_THREAD_WORKERS
     { MP_ROM_QSTR(MP_QSTR_modules), MP_ROM_PTR(&MP_STATE_VM(mp_loaded_modules_dict)) },
     #endif
     #if MICROPY_PY_SYS_EXC_INFO
@@ -219,6 +221,25 @@ STATIC const mp_rom_map_elem_t mp_module_sys_globals_table[] = {
 
 STATIC MP_DEFINE_CONST_DICT(mp_module_sys_globals, mp_module_sys_globals_table);
 
+#if MICROPY_PY_THREAD_WORKERS
+// With worker interpreters these are not constant, they belong to the
+// interpreter the caller runs in.  Returns MP_OBJ_NULL for other attributes.
+mp_obj_t mp_module_sys_state_attr(qstr attr) {
+    switch (attr) {
+        case MP_QSTR_path:
+            return mp_sys_path;
+        case MP_QSTR_argv:
+            return mp_sys_argv;
+        #if MICROPY_PY_SYS_MODULES
+        case MP_QSTR_modules:
+            return MP_OBJ_FROM_PTR(&MP_STATE_VM(mp_loaded_modules_dict));
+        #endif
+        default:
+            return MP_OBJ_NULL;
+    }
+}
+#endif
+
 const mp_obj_module_t mp_module_sys = {
     .base = { &mp_type_module },
     .globals = (mp_obj_dict_t*)&mp_module_sys_globals,
@@ -421,6 +421,13 @@ STATIC MP_DEFINE_CONST_FUN_OBJ_0(mod_thread_getSelfname_obj, mod_thread_getSelfn
 extern TaskHandle_t TelnetTaskHandle;
 extern TaskHandle_t FtpTaskHandle;
 
+// With the adaptive GIL the tuples also hold the GIL held and waiting time in us
+#if MICROPY_PY_THREAD_GIL_ADAPTIVE
+#define THREAD_INFO_LEN 8
+#else
+#define THREAD_INFO_LEN 6
+#endif
+
 //-----------------------------------------------------------------------
 STATIC mp_obj_t mod_thread_list(mp_uint_t n_args, const mp_obj_t *args) {
 	int prn = 1, n = 0;
@@ -435,20 +442,27 @@ STATIC mp_obj_t mod_thread_list(mp_uint_t n_args, const mp_obj_t *args) {
 	threadlistitem_t *thr = NULL;
 	if (prn) {
 		for (n=0; n<num; n++) {
-			thr = list.threads + (sizeof(threadlistitem_t) * n);
+			thr = list.threads + n;
 			char th_type[8] = {'\0'};
 			char th_state[16] = {'\0'};
 			if (thr->type == THREAD_TYPE_MAIN) sprintf(th_type, "MAIN");
 			else if (thr->type == THREAD_TYPE_PYTHON) sprintf(th_type, "PYTHON");
 			else if (thr->type == THREAD_TYPE_SERVICE) sprintf(th_type, "SERVICE");
+			else if (thr->type == THREAD_TYPE_WORKER) sprintf(th_type, "WORKER");
 			else sprintf(th_type, "Unknown");
 			if (thr->suspended) sprintf(th_state, "suspended");
 			else if (thr->waiting) sprintf(th_state, "waiting");
 			else sprintf(th_state, "running");
 
+			#if MICROPY_PY_THREAD_GIL_ADAPTIVE
+			mp_printf(&mp_plat_print, "ID=%u, Name: %s, State: %s, Stack=%d, MaxUsed=%d, Type: %s, GIL held=%u ms, waited=%u ms\n",
+					thr->id, thr->name, th_state, thr->stack_len,
+					thr->stack_max, th_type, (uint32_t)(thr->gil_held_us / 1000), (uint32_t)(thr->gil_wait_us / 1000));
+			#else
 			mp_printf(&mp_plat_print, "ID=%u, Name: %s, State: %s, Stack=%d, MaxUsed=%d, Type: %s\n",
 					thr->id, thr->name, th_state, thr->stack_len,
 					thr->stack_max, th_type);
+			#endif
 		}
 		free(list.threads);
 		#ifdef CONFIG_MICROPY_USE_TELNET
@@ -474,10 +488,10 @@ STATIC mp_obj_t mod_thread_list(mp_uint_t n_args, const mp_obj_t *args) {
 		#ifdef CONFIG_MICROPY_USE_FTPSERVER
 		if (FtpTaskHandle) services++;
 		#endif
-		mp_obj_t thr_info[6];
+		mp_obj_t thr_info[THREAD_INFO_LEN];
 		mp_obj_t tuple[num+services];
 		for (n=0; n<num; n++) {
-			thr = list.threads + (sizeof(threadlistitem_t) * n);
+			thr = list.threads + n;
 			thr_info[0] = mp_obj_new_int(thr->id);
 			thr_info[1] = mp_obj_new_int(thr->type);
 			thr_info[2] = mp_obj_new_str(thr->name, strlen(thr->name));
@@ -486,7 +500,11 @@ STATIC mp_obj_t mod_thread_list(mp_uint_t n_args, const mp_obj_t *args) {
 			else thr_info[3] = mp_obj_new_int(0);
 			thr_info[4] = mp_obj_new_int(thr->stack_len);
 			thr_info[5] = mp_obj_new_int(thr->stack_max);
-			tuple[n] = mp_obj_new_tuple(6, thr_info);
+			#if MICROPY_PY_THREAD_GIL_ADAPTIVE
+			thr_info[6] = mp_obj_new_int_from_ull(thr->gil_held_us);
+			thr_info[7] = mp_obj_new_int_from_ull(thr->gil_wait_us);
+			#endif
+			tuple[n] = mp_obj_new_tuple(THREAD_INFO_LEN, thr_info);
 		}
 		free(list.threads);
 		#ifdef CONFIG_MICROPY_USE_TELNET
@@ -497,7 +515,11 @@ STATIC mp_obj_t mod_thread_list(mp_uint_t n_args, const mp_obj_t *args) {
 			thr_info[3] = mp_obj_new_int(0);
 			thr_info[4] = mp_obj_new_int(TELNET_STACK_LEN);
 			thr_info[5] = mp_obj_new_int(TELNET_STACK_LEN - uxTaskGetStackHighWaterMark(TelnetTaskHandle));
-			tuple[n] = mp_obj_new_tuple(6, thr_info);
+			#if MICROPY_PY_THREAD_GIL_ADAPTIVE
+			thr_info[6] = MP_OBJ_NEW_SMALL_INT(0);
+			thr_info[7] = MP_OBJ_NEW_SMALL_INT(0);
+			#endif
+			tuple[n] = mp_obj_new_tuple(THREAD_INFO_LEN, thr_info);
 			n++;
 		}
 		#endif
@@ -509,7 +531,11 @@ STATIC mp_obj_t mod_thread_list(mp_uint_t n_args, const mp_obj_t *args) {
 			thr_info[3] = mp_obj_new_int(0);
 			thr_info[4] = mp_obj_new_int(FTP_STACK_LEN);
 			thr_info[5] = mp_obj_new_int(FTP_STACK_LEN - uxTaskGetStackHighWaterMark(FtpTaskHandle));
-			tuple[n] = mp_obj_new_tuple(6, thr_info);
+			#if MICROPY_PY_THREAD_GIL_ADAPTIVE
+			thr_info[6] = MP_OBJ_NEW_SMALL_INT(0);
+			thr_info[7] = MP_OBJ_NEW_SMALL_INT(0);
+			#endif
+			tuple[n] = mp_obj_new_tuple(THREAD_INFO_LEN, thr_info);
 			n++;
 		}
 		#endif
@@ -574,6 +600,458 @@ STATIC mp_obj_t mod_thread_unlock()
 }
 STATIC MP_DEFINE_CONST_FUN_OBJ_0(mod_thread_unlock_obj, mod_thread_unlock);
 
+#if MICROPY_PY_THREAD_GIL_ADAPTIVE
+// Get or set the time in microseconds a thread may hold the GIL
+// while other threads wait for it
+//-----------------------------------------------------------------------------
+STATIC mp_obj_t mod_thread_switchinterval(size_t n_args, const mp_obj_t *args)
+{
+    int32_t interval = -1;
+    if (n_args > 0) {
+        interval = mp_obj_get_int(args[0]);
+        if (interval < 0) {
+            mp_raise_ValueError("invalid interval");
+        }
+    }
+    return mp_obj_new_int_from_uint(mp_thread_gil_switchinterval(interval));
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_VAR_BETWEEN(mod_thread_switchinterval_obj, 0, 1, mod_thread_switchinterval);
+#endif
+
+
+/****************************************************************/
+// Queue objects, passing objects between threads by reference
+
+#define THREAD_QUEUE_SIZE		16	// default maxsize of a Queue, and size of the mailboxes
+
+// The queued objects are kept in a ring on the GC heap, so they stay alive
+// while in flight and are handed over without being copied.  The ring is
+// updated in a critical section; the counting semaphores only block and
+// wake the readers and writers, which wait with the GIL released.
+typedef struct _mp_obj_thread_queue_t {
+    mp_obj_base_t base;
+    mp_obj_t *items;
+    uint16_t size;
+    uint16_t first;
+    uint16_t count;
+    portMUX_TYPE mux;
+    SemaphoreHandle_t filled;       // counts the queued objects
+    SemaphoreHandle_t empty;        // counts the free slots
+    StaticSemaphore_t filled_buf;
+    StaticSemaphore_t empty_buf;
+} mp_obj_thread_queue_t;
+
+const mp_obj_type_t mp_type_thread_queue;
+
+//----------------------------------------------------------
+STATIC mp_obj_thread_queue_t *thread_queue_new(size_t size)
+{
+    if ((size < 1) || (size > 0xFFFF)) {
+        mp_raise_ValueError("invalid queue size");
+    }
+    mp_obj_thread_queue_t *self = m_new_obj(mp_obj_thread_queue_t);
+    self->base.type = &mp_type_thread_queue;
+    self->items = m_new0(mp_obj_t, size);
+    self->size = size;
+    self->first = 0;
+    self->count = 0;
+    self->mux = (portMUX_TYPE)portMUX_INITIALIZER_UNLOCKED;
+    self->filled = xSemaphoreCreateCountingStatic(size, 0, &self->filled_buf);
+    self->empty = xSemaphoreCreateCountingStatic(size, size, &self->empty_buf);
+    return self;
+}
+
+// Timeout in ms (-1: wait forever) to RTOS ticks
+//------------------------------------------------------
+STATIC TickType_t thread_queue_ticks(mp_int_t timeout)
+{
+    if (timeout < 0) return portMAX_DELAY;
+    if (timeout == 0) return 0;
+    TickType_t ticks = timeout / portTICK_PERIOD_MS;
+    return (ticks > 0) ? ticks : 1;
+}
+
+//----------------------------------------------------------------------
+STATIC bool thread_queue_take(SemaphoreHandle_t sem, TickType_t ticks)
+{
+    if (xSemaphoreTake(sem, 0) == pdTRUE) return true;
+    if (ticks == 0) return false;
+
+    bool res;
+    if (mp_thread_setblocked()) {
+        MP_THREAD_GIL_EXIT();
+        res = (xSemaphoreTake(sem, ticks) == pdTRUE);
+        MP_THREAD_GIL_ENTER();
+        mp_thread_setnotblocked();
+    }
+    else {
+        MP_THREAD_GIL_EXIT();
+        res = (xSemaphoreTake(sem, ticks) == pdTRUE);
+        MP_THREAD_GIL_ENTER();
+    }
+    return res;
+}
+
+//----------------------------------------------------------------------------------------------------------
+STATIC mp_obj_t thread_queue_make_new(const mp_obj_type_t *type, size_t n_args, size_t n_kw, const mp_obj_t *args)
+{
+    enum { ARG_maxsize };
+    static const mp_arg_t allowed_args[] = {
+        { MP_QSTR_maxsize, MP_ARG_INT, { .u_int = THREAD_QUEUE_SIZE } },
+    };
+    mp_arg_val_t vals[MP_ARRAY_SIZE(allowed_args)];
+    mp_arg_parse_all_kw_array(n_args, n_kw, args, MP_ARRAY_SIZE(allowed_args), allowed_args, vals);
+
+    return MP_OBJ_FROM_PTR(thread_queue_new(vals[ARG_maxsize].u_int));
+}
+
+//-----------------------------------------------------------------------------------------------
+STATIC mp_obj_t thread_queue_put(size_t n_args, const mp_obj_t *pos_args, mp_map_t *kw_args)
+{
+    enum { ARG_item, ARG_timeout };
+    static const mp_arg_t allowed_args[] = {
+        { MP_QSTR_item,    MP_ARG_REQUIRED | MP_ARG_OBJ, { .u_obj = mp_const_none } },
+        { MP_QSTR_timeout,                   MP_ARG_INT, { .u_int = -1 } },
+    };
+    mp_obj_thread_queue_t *self = MP_OBJ_TO_PTR(pos_args[0]);
+    mp_arg_val_t args[MP_ARRAY_SIZE(allowed_args)];
+    mp_arg_parse_all(n_args - 1, pos_args + 1, kw_args, MP_ARRAY_SIZE(allowed_args), allowed_args, args);
+
+    if (!thread_queue_take(self->empty, thread_queue_ticks(args[ARG_timeout].u_int))) return mp_const_false;
+
+    portENTER_CRITICAL(&self->mux);
+    self->items[(self->first + self->count) % self->size] = args[ARG_item].u_obj;
+    self->count++;
+    portEXIT_CRITICAL(&self->mux);
+    xSemaphoreGive(self->filled);
+    return mp_const_true;
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_KW(thread_queue_put_obj, 1, thread_queue_put);
+
+//-----------------------------------------------------------------------------------------------
+STATIC mp_obj_t thread_queue_get(size_t n_args, const mp_obj_t *pos_args, mp_map_t *kw_args)
+{
+    enum { ARG_timeout };
+    static const mp_arg_t allowed_args[] = {
+        { MP_QSTR_timeout, MP_ARG_INT, { .u_int = -1 } },
+    };
+    mp_obj_thread_queue_t *self = MP_OBJ_TO_PTR(pos_args[0]);
+    mp_arg_val_t args[MP_ARRAY_SIZE(allowed_args)];
+    mp_arg_parse_all(n_args - 1, pos_args + 1, kw_args, MP_ARRAY_SIZE(allowed_args), allowed_args, args);
+
+    if (!thread_queue_take(self->filled, thread_queue_ticks(args[ARG_timeout].u_int))) return mp_const_none;
+
+    portENTER_CRITICAL(&self->mux);
+    mp_obj_t item = self->items[self->first];
+    self->items[self->first] = MP_OBJ_NULL;
+    self->first = (self->first + 1) % self->size;
+    self->count--;
+    portEXIT_CRITICAL(&self->mux);
+    xSemaphoreGive(self->empty);
+    return item;
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_KW(thread_queue_get_obj, 1, thread_queue_get);
+
+//---------------------------------------------------
+STATIC mp_obj_t thread_queue_qsize(mp_obj_t self_in)
+{
+    mp_obj_thread_queue_t *self = MP_OBJ_TO_PTR(self_in);
+    return MP_OBJ_NEW_SMALL_INT(self->count);
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_1(thread_queue_qsize_obj, thread_queue_qsize);
+
+//---------------------------------------------------
+STATIC mp_obj_t thread_queue_empty(mp_obj_t self_in)
+{
+    mp_obj_thread_queue_t *self = MP_OBJ_TO_PTR(self_in);
+    return mp_obj_new_bool(self->count == 0);
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_1(thread_queue_empty_obj, thread_queue_empty);
+
+//--------------------------------------------------
+STATIC mp_obj_t thread_queue_full(mp_obj_t self_in)
+{
+    mp_obj_thread_queue_t *self = MP_OBJ_TO_PTR(self_in);
+    return mp_obj_new_bool(self->count == self->size);
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_1(thread_queue_full_obj, thread_queue_full);
+
+//-------------------------------------------------------------------------------------------
+STATIC void thread_queue_print(const mp_print_t *print, mp_obj_t self_in, mp_print_kind_t kind)
+{
+    mp_obj_thread_queue_t *self = MP_OBJ_TO_PTR(self_in);
+    mp_printf(print, "Queue(maxsize=%u, qsize=%u)", self->size, self->count);
+}
+
+//================================================================
+STATIC const mp_rom_map_elem_t thread_queue_locals_dict_table[] = {
+    { MP_ROM_QSTR(MP_QSTR_put),					MP_ROM_PTR(&thread_queue_put_obj) },
+    { MP_ROM_QSTR(MP_QSTR_get),					MP_ROM_PTR(&thread_queue_get_obj) },
+    { MP_ROM_QSTR(MP_QSTR_qsize),				MP_ROM_PTR(&thread_queue_qsize_obj) },
+    { MP_ROM_QSTR(MP_QSTR_empty),				MP_ROM_PTR(&thread_queue_empty_obj) },
+    { MP_ROM_QSTR(MP_QSTR_full),				MP_ROM_PTR(&thread_queue_full_obj) },
+};
+STATIC MP_DEFINE_CONST_DICT(thread_queue_locals_dict, thread_queue_locals_dict_table);
+
+//=========================================
+const mp_obj_type_t mp_type_thread_queue = {
+    { &mp_type_type },
+    .name = MP_QSTR_Queue,
+    .print = thread_queue_print,
+    .make_new = thread_queue_make_new,
+    .locals_dict = (mp_obj_dict_t*)&thread_queue_locals_dict,
+};
+
+// Return the mailbox Queue of the given thread (default: the calling one),
+// it is created on first use.  Returns None if there is no such thread.
+//---------------------------------------------------------------------------
+STATIC mp_obj_t mod_thread_mailbox(size_t n_args, const mp_obj_t *args) {
+	uintptr_t thr_id = 0;
+    if (n_args > 0) thr_id = mp_obj_get_int(args[0]);
+
+	// the GIL is held, so no other thread can create it meanwhile
+	void *mailbox = mp_thread_getmailbox((void *)thr_id);
+	if (mailbox == NULL) {
+		mailbox = thread_queue_new(THREAD_QUEUE_SIZE);
+		if (!mp_thread_setmailbox((void *)thr_id, mailbox)) return mp_const_none;
+	}
+	return MP_OBJ_FROM_PTR(mailbox);
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_VAR_BETWEEN(mod_thread_mailbox_obj, 0, 1, mod_thread_mailbox);
+
+#if MICROPY_PY_THREAD_WORKERS
+/****************************************************************/
+// Channel objects, exchanging messages with a worker interpreter
+
+// A worker runs on its own heap, so messages are copied into malloc'ed
+// buffers by the sender and out of them by the receiver.  The parent's end
+// holds a reference to the worker, which is dropped when it is closed or
+// collected; the worker's end lives on the worker's heap.
+typedef struct _mp_obj_worker_channel_t {
+    mp_obj_base_t base;
+    mp_worker_t *worker;            // NULL when closed
+    QueueHandle_t tx;
+    QueueHandle_t rx;
+    bool parent;
+} mp_obj_worker_channel_t;
+
+const mp_obj_type_t mp_type_worker_channel;
+
+//--------------------------------------------------------------------------------------------
+STATIC void worker_channel_init(mp_obj_worker_channel_t *self, mp_worker_t *worker, bool parent)
+{
+    self->base.type = &mp_type_worker_channel;
+    self->worker = worker;
+    self->tx = (parent) ? worker->inbox : worker->outbox;
+    self->rx = (parent) ? worker->outbox : worker->inbox;
+    self->parent = parent;
+}
+
+//--------------------------------------------------------------------------
+STATIC mp_worker_t *worker_channel_get(mp_obj_worker_channel_t *self)
+{
+    if (self->worker == NULL) {
+        mp_raise_ValueError("channel closed");
+    }
+    return self->worker;
+}
+
+// The other end is still there to send or receive messages
+//--------------------------------------------------------------
+STATIC bool worker_channel_peer(mp_obj_worker_channel_t *self)
+{
+    return (self->parent) ? self->worker->running : self->worker->linked;
+}
+
+// Send to or receive from a worker queue, waiting with the GIL released
+//-----------------------------------------------------------------------------------------------------
+STATIC bool worker_queue_wait(QueueHandle_t queue, mp_worker_msg_t *msg, TickType_t ticks, bool send)
+{
+    if (send) {
+        if (xQueueSend(queue, msg, 0) == pdTRUE) return true;
+    }
+    else if (xQueueReceive(queue, msg, 0) == pdTRUE) return true;
+    if (ticks == 0) return false;
+
+    bool blocked = mp_thread_setblocked();
+    MP_THREAD_GIL_EXIT();
+    BaseType_t res;
+    if (send) res = xQueueSend(queue, msg, ticks);
+    else res = xQueueReceive(queue, msg, ticks);
+    MP_THREAD_GIL_ENTER();
+    if (blocked) mp_thread_setnotblocked();
+    return (res == pdTRUE);
+}
+
+//--------------------------------------------------------------------------
+STATIC mp_obj_t worker_channel_send(size_t n_args, const mp_obj_t *args)
+{
+    mp_obj_worker_channel_t *self = MP_OBJ_TO_PTR(args[0]);
+    worker_channel_get(self);
+    mp_buffer_info_t bufinfo;
+    mp_get_buffer_raise(args[1], &bufinfo, MP_BUFFER_READ);
+    mp_int_t timeout = -1;
+    if (n_args > 2) timeout = mp_obj_get_int(args[2]);
+
+    if (!worker_channel_peer(self)) return mp_const_false;
+
+    mp_worker_msg_t msg;
+    // never send a NULL data, it tells the other end has gone
+    msg.data = malloc((bufinfo.len > 0) ? bufinfo.len : 1);
+    if (msg.data == NULL) {
+        m_malloc_fail(bufinfo.len);
+    }
+    memcpy(msg.data, bufinfo.buf, bufinfo.len);
+    msg.len = bufinfo.len;
+    if (!worker_queue_wait(self->tx, &msg, thread_queue_ticks(timeout), true)) {
+        free(msg.data);
+        return mp_const_false;
+    }
+    return mp_const_true;
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_VAR_BETWEEN(worker_channel_send_obj, 2, 3, worker_channel_send);
+
+// Returns the received bytes, or None on timeout or if the other end has gone
+//--------------------------------------------------------------------------
+STATIC mp_obj_t worker_channel_recv(size_t n_args, const mp_obj_t *args)
+{
+    mp_obj_worker_channel_t *self = MP_OBJ_TO_PTR(args[0]);
+    worker_channel_get(self);
+    mp_int_t timeout = -1;
+    if (n_args > 1) timeout = mp_obj_get_int(args[1]);
+
+    mp_worker_msg_t msg;
+    if (xQueueReceive(self->rx, &msg, 0) != pdTRUE) {
+        // the other end sends a NULL message when it goes, but it may have
+        // found the queue full, so check before waiting for it
+        if (!worker_channel_peer(self)) return mp_const_none;
+        if (!worker_queue_wait(self->rx, &msg, thread_queue_ticks(timeout), false)) return mp_const_none;
+    }
+    if (msg.data == NULL) return mp_const_none;
+
+    mp_obj_t res = mp_const_none;
+    nlr_buf_t nlr;
+    if (nlr_push(&nlr) == 0) {
+        res = mp_obj_new_bytes(msg.data, msg.len);
+        nlr_pop();
+    }
+    else {
+        free(msg.data);
+        nlr_jump(nlr.ret_val);
+    }
+    free(msg.data);
+    return res;
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_VAR_BETWEEN(worker_channel_recv_obj, 1, 2, worker_channel_recv);
+
+//-----------------------------------------------------------
+STATIC mp_obj_t worker_channel_running(mp_obj_t self_in)
+{
+    mp_obj_worker_channel_t *self = MP_OBJ_TO_PTR(self_in);
+    if (self->worker == NULL) return mp_const_false;
+    return mp_obj_new_bool(worker_channel_peer(self));
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_1(worker_channel_running_obj, worker_channel_running);
+
+// Raise KeyboardInterrupt in the worker
+//-------------------------------------------------------------
+STATIC mp_obj_t worker_channel_interrupt(mp_obj_t self_in)
+{
+    mp_obj_worker_channel_t *self = MP_OBJ_TO_PTR(self_in);
+    mp_worker_t *worker = worker_channel_get(self);
+    if (!self->parent) {
+        mp_raise_ValueError("only the parent can interrupt");
+    }
+    return mp_obj_new_bool(mp_thread_worker_interrupt(worker));
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_1(worker_channel_interrupt_obj, worker_channel_interrupt);
+
+// Closing the parent's end doesn't stop the worker, it only can't exchange
+// messages any more
+//---------------------------------------------------------
+STATIC mp_obj_t worker_channel_close(mp_obj_t self_in)
+{
+    mp_obj_worker_channel_t *self = MP_OBJ_TO_PTR(self_in);
+    if ((self->worker != NULL) && (self->parent)) {
+        mp_thread_worker_release(self->worker);
+    }
+    self->worker = NULL;
+    return mp_const_none;
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_1(worker_channel_close_obj, worker_channel_close);
+
+//---------------------------------------------------------------------------------------------
+STATIC void worker_channel_print(const mp_print_t *print, mp_obj_t self_in, mp_print_kind_t kind)
+{
+    mp_obj_worker_channel_t *self = MP_OBJ_TO_PTR(self_in);
+    if (self->worker == NULL) mp_printf(print, "Channel(closed)");
+    else mp_printf(print, "Channel(%s, core=%d, running=%s)", (self->parent) ? "worker" : "parent",
+            self->worker->core, (worker_channel_peer(self)) ? "True" : "False");
+}
+
+//=================================================================
+STATIC const mp_rom_map_elem_t worker_channel_locals_dict_table[] = {
+    { MP_ROM_QSTR(MP_QSTR_send),				MP_ROM_PTR(&worker_channel_send_obj) },
+    { MP_ROM_QSTR(MP_QSTR_recv),				MP_ROM_PTR(&worker_channel_recv_obj) },
+    { MP_ROM_QSTR(MP_QSTR_running),				MP_ROM_PTR(&worker_channel_running_obj) },
+    { MP_ROM_QSTR(MP_QSTR_interrupt),			MP_ROM_PTR(&worker_channel_interrupt_obj) },
+    { MP_ROM_QSTR(MP_QSTR_close),				MP_ROM_PTR(&worker_channel_close_obj) },
+    { MP_ROM_QSTR(MP_QSTR___del__),				MP_ROM_PTR(&worker_channel_close_obj) },
+};
+STATIC MP_DEFINE_CONST_DICT(worker_channel_locals_dict, worker_channel_locals_dict_table);
+
+//============================================
+const mp_obj_type_t mp_type_worker_channel = {
+    { &mp_type_type },
+    .name = MP_QSTR_Channel,
+    .print = worker_channel_print,
+    .locals_dict = (mp_obj_dict_t*)&worker_channel_locals_dict,
+};
+
+// Start a worker interpreter running the source code on the other core,
+// returns the Channel to exchange messages with it
+//-----------------------------------------------------------------------------------------------
+STATIC mp_obj_t mod_thread_start_worker(size_t n_args, const mp_obj_t *pos_args, mp_map_t *kw_args)
+{
+    enum { ARG_name, ARG_source, ARG_heapsize, ARG_stacksize };
+    static const mp_arg_t allowed_args[] = {
+        { MP_QSTR_name,      MP_ARG_REQUIRED | MP_ARG_OBJ, { .u_obj = mp_const_none } },
+        { MP_QSTR_source,    MP_ARG_REQUIRED | MP_ARG_OBJ, { .u_obj = mp_const_none } },
+        { MP_QSTR_heapsize,  MP_ARG_KW_ONLY  | MP_ARG_INT, { .u_int = 0 } },
+        { MP_QSTR_stacksize, MP_ARG_KW_ONLY  | MP_ARG_INT, { .u_int = 0 } },
+    };
+    mp_arg_val_t args[MP_ARRAY_SIZE(allowed_args)];
+    mp_arg_parse_all(n_args, pos_args, kw_args, MP_ARRAY_SIZE(allowed_args), allowed_args, args);
+
+    const char *name = mp_obj_str_get_str(args[ARG_name].u_obj);
+    mp_buffer_info_t bufinfo;
+    mp_get_buffer_raise(args[ARG_source].u_obj, &bufinfo, MP_BUFFER_READ);
+    if ((args[ARG_heapsize].u_int < 0) || (args[ARG_stacksize].u_int < 0)) {
+        mp_raise_ValueError("invalid size");
+    }
+
+    // allocate the channel first, the worker can't be left without one
+    mp_obj_worker_channel_t *channel = m_new_obj_with_finaliser(mp_obj_worker_channel_t);
+    channel->base.type = &mp_type_worker_channel;
+    channel->worker = NULL;
+    mp_worker_t *worker = mp_thread_worker_start(name, bufinfo.buf, bufinfo.len,
+            args[ARG_heapsize].u_int, args[ARG_stacksize].u_int);
+    worker_channel_init(channel, worker, true);
+    return MP_OBJ_FROM_PTR(channel);
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_KW(mod_thread_start_worker_obj, 2, mod_thread_start_worker);
+
+// The Channel to the parent, in a worker.  None in the main interpreter
+//--------------------------------------------
+STATIC mp_obj_t mod_thread_parent(void) {
+    mp_worker_t *worker = mp_thread_worker_self();
+    if (worker == NULL) return mp_const_none;
+    mp_obj_worker_channel_t *channel = m_new_obj(mp_obj_worker_channel_t);
+    worker_channel_init(channel, worker, false);
+    return MP_OBJ_FROM_PTR(channel);
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_0(mod_thread_parent_obj, mod_thread_parent);
+#endif // MICROPY_PY_THREAD_WORKERS
 
 //=================================================================
 STATIC const mp_rom_map_elem_t mp_module_thread_globals_table[] = {
@@ -591,6 +1069,12 @@ STATIC const mp_rom_map_elem_t mp_module_thread_globals_table[] = {
     { MP_ROM_QSTR(MP_QSTR_replAcceptMsg),		MP_ROM_PTR(&mod_thread_replAcceptMsg_obj) },
     { MP_ROM_QSTR(MP_QSTR_sendmsg),				MP_ROM_PTR(&mod_thread_sendmsg_obj) },
     { MP_ROM_QSTR(MP_QSTR_getmsg),				MP_ROM_PTR(&mod_thread_getmsg_obj) },
+    { MP_ROM_QSTR(MP_QSTR_mailbox),				MP_ROM_PTR(&mod_thread_mailbox_obj) },
+    { MP_ROM_QSTR(MP_QSTR_Queue),				MP_ROM_PTR(&mp_type_thread_queue) },
+    #if MICROPY_PY_THREAD_WORKERS
+    { MP_ROM_QSTR(MP_QSTR_start_worker),		MP_ROM_PTR(&mod_thread_start_worker_obj) },
+    { MP_ROM_QSTR(MP_QSTR_parent),				MP_ROM_PTR(&mod_thread_parent_obj) },
+    #endif
     { MP_ROM_QSTR(MP_QSTR_list),				MP_ROM_PTR(&mod_thread_list_obj) },
     { MP_ROM_QSTR(MP_QSTR_getThreadName),		MP_ROM_PTR(&mod_thread_getname_obj) },
     { MP_ROM_QSTR(MP_QSTR_getSelfName),			MP_ROM_PTR(&mod_thread_getSelfname_obj) },
@@ -598,6 +1082,9 @@ STATIC const mp_rom_map_elem_t mp_module_thread_globals_table[] = {
     { MP_ROM_QSTR(MP_QSTR_wait),				MP_ROM_PTR(&mod_thread_waitnotify_obj) },
     { MP_ROM_QSTR(MP_QSTR_lock),				MP_ROM_PTR(&mod_thread_lock_obj) },
     { MP_ROM_QSTR(MP_QSTR_unlock),				MP_ROM_PTR(&mod_thread_unlock_obj) },
+    #if MICROPY_PY_THREAD_GIL_ADAPTIVE
+    { MP_ROM_QSTR(MP_QSTR_switchinterval),		MP_ROM_PTR(&mod_thread_switchinterval_obj) },
+    #endif
 
 	// Constants
 	{ MP_ROM_QSTR(MP_QSTR_PAUSE),				MP_ROM_INT(THREAD_NOTIFY_PAUSE) },
@@ -122,6 +122,27 @@
 #define MICROPY_GC_ALLOC_THRESHOLD (1)
 #endif
 
+// Whether the sweep phase of a collection is spread over the following
+// allocations instead of being done in one go, configurable by gc.sweep_step().
+// The pause of a collection is then proportional to the live data only.
+#ifndef MICROPY_GC_INCREMENTAL_SWEEP
+#define MICROPY_GC_INCREMENTAL_SWEEP (0)
+#endif
+
+// Default number of blocks swept per allocation with incremental sweeping
+#ifndef MICROPY_GC_SWEEP_BLOCKS_PER_ALLOC
+#define MICROPY_GC_SWEEP_BLOCKS_PER_ALLOC (256)
+#endif
+
+// Number of allocation size classes (in blocks) for which the GC remembers
+// where the first free run of that size may be.  Allocations of n blocks use
+// class n, the last class is shared by all larger allocations.  With a single
+// class only the position of the first free block is remembered; more classes
+// avoid rescanning the fragmented start of the heap for larger allocations.
+#ifndef MICROPY_GC_ALLOC_SIZE_CLASSES
+#define MICROPY_GC_ALLOC_SIZE_CLASSES (1)
+#endif
+
 // Number of bytes to allocate initially when creating new chunks to store
 // interned string data.  Smaller numbers lead to more chunks being needed
 // and more wastage at the end of the chunk.  Larger numbers lead to wasted
@@ -210,6 +231,13 @@
 #define MICROPY_QSTR_BYTES_IN_HASH (2)
 #endif
 
+// Whether to look up qstrs through hash indexes instead of searching the pools
+// linearly.  The indexes of the constant pools are generated at build time,
+// the one of the pools allocated at runtime costs 4-8 bytes of heap per qstr.
+#ifndef MICROPY_QSTR_INDEX
+#define MICROPY_QSTR_INDEX (0)
+#endif
+
 // Avoid using C stack when making Python function calls. C stack still
 // may be used if there's no free heap.
 #ifndef MICROPY_STACKLESS
@@ -292,13 +320,25 @@
 #define MICROPY_EMIT_XTENSA (0)
 #endif
 
+// Whether to emit Xtensa-Windowed native code
+#ifndef MICROPY_EMIT_XTENSAWIN
+#define MICROPY_EMIT_XTENSAWIN (0)
+#endif
+
 // Whether to enable the Xtensa inline assembler
 #ifndef MICROPY_EMIT_INLINE_XTENSA
 #define MICROPY_EMIT_INLINE_XTENSA (0)
 #endif
 
 // Convenience definition for whether any native emitter is enabled
-#define MICROPY_EMIT_NATIVE (MICROPY_EMIT_X64 || MICROPY_EMIT_X86 || MICROPY_EMIT_THUMB || MICROPY_EMIT_ARM || MICROPY_EMIT_XTENSA)
+#define MICROPY_EMIT_NATIVE (MICROPY_EMIT_X64 || MICROPY_EMIT_X86 || MICROPY_EMIT_THUMB || MICROPY_EMIT_ARM || MICROPY_EMIT_XTENSA || MICROPY_EMIT_XTENSAWIN)
+
+// Whether the prelude and argument names of native functions are copied out
+// of the executable memory, for ports where that memory can only be accessed
+// with word loads (eg the IRAM of the esp32)
+#ifndef MICROPY_EMIT_NATIVE_PRELUDE_SEPARATE
+#define MICROPY_EMIT_NATIVE_PRELUDE_SEPARATE (MICROPY_EMIT_XTENSAWIN)
+#endif
 
 // Convenience definition for whether any inline assembler emitter is enabled
 #define MICROPY_EMIT_INLINE_ASM (MICROPY_EMIT_INLINE_THUMB || MICROPY_EMIT_INLINE_XTENSA)
@@ -320,9 +360,11 @@
 #if MICROPY_DYNAMIC_COMPILER
 #define MICROPY_OPT_CACHE_MAP_LOOKUP_IN_BYTECODE_DYNAMIC (mp_dynamic_compiler.opt_cache_map_lookup_in_bytecode)
 #define MICROPY_PY_BUILTINS_STR_UNICODE_DYNAMIC (mp_dynamic_compiler.py_builtins_str_unicode)
+#define MICROPY_OPT_BYTECODE_SUPERINSTRUCTIONS_DYNAMIC (mp_dynamic_compiler.opt_bytecode_superinstructions)
 #else
 #define MICROPY_OPT_CACHE_MAP_LOOKUP_IN_BYTECODE_DYNAMIC MICROPY_OPT_CACHE_MAP_LOOKUP_IN_BYTECODE
 #define MICROPY_PY_BUILTINS_STR_UNICODE_DYNAMIC MICROPY_PY_BUILTINS_STR_UNICODE
+#define MICROPY_OPT_BYTECODE_SUPERINSTRUCTIONS_DYNAMIC MICROPY_OPT_BYTECODE_SUPERINSTRUCTIONS
 #endif
 
 // Whether to enable constant folding; eg 1+2 rewritten as 3
@@ -396,12 +438,49 @@
 #define MICROPY_OPT_CACHE_MAP_LOOKUP_IN_BYTECODE (0)
 #endif
 
+// Whether the bytecode emitter fuses common sequences of opcodes into
+// superinstructions: LOAD_FAST followed by LOAD_ATTR or LOAD_METHOD, LOAD_FAST
+// and a small int followed by a binary op, and a comparison followed by a
+// conditional jump.  Fewer opcodes are dispatched for about the same bytecode
+// size, at the cost of a bit of extra code ROM for the VM.
+#ifndef MICROPY_OPT_BYTECODE_SUPERINSTRUCTIONS
+#define MICROPY_OPT_BYTECODE_SUPERINSTRUCTIONS (0)
+#endif
+
+// Whether the VM handles binary ops on two small ints, and arithmetic and
+// ordering ops on floats mixed with small ints, inline instead of going
+// through mp_binary_op and the type's binary_op slot.
+#ifndef MICROPY_OPT_VM_BINARY_OP_FAST_PATH
+#define MICROPY_OPT_VM_BINARY_OP_FAST_PATH (0)
+#endif
+
+// Whether a float just created by a binary op in the VM, and consumed as the
+// right operand of the binary op that immediately follows it, is overwritten
+// with the result of that op instead of allocating a new float.  This halves
+// the float allocations of expressions like "acc += a * b".  Only useful with
+// boxed floats and requires MICROPY_OPT_VM_BINARY_OP_FAST_PATH.
+#ifndef MICROPY_OPT_VM_FLOAT_TEMP_REUSE
+#define MICROPY_OPT_VM_FLOAT_TEMP_REUSE (0)
+#endif
+
 // Whether to use fast versions of bitwise operations (and, or, xor) when the
 // arguments are both positive.  Increases Thumb2 code size by about 250 bytes.
 #ifndef MICROPY_OPT_MPZ_BITWISE
 #define MICROPY_OPT_MPZ_BITWISE (0)
 #endif
 
+// Whether to multiply large mpz ints with the Karatsuba algorithm instead of
+// the schoolbook one, and convert them to strings by divide and conquer.
+#ifndef MICROPY_OPT_MPZ_KARATSUBA
+#define MICROPY_OPT_MPZ_KARATSUBA (0)
+#endif
+
+// Whether pow(a, b, m) uses Montgomery multiplication when m is odd, instead
+// of a long division after each multiplication.
+#ifndef MICROPY_OPT_MPZ_MONTGOMERY
+#define MICROPY_OPT_MPZ_MONTGOMERY (0)
+#endif
+
 /*****************************************************************************/
 /* Python internal features                                                  */
 
@@ -637,6 +716,13 @@ typedef double mp_float_t;
 #define MICROPY_MODULE_FROZEN_MPY (0)
 #endif
 
+// Whether frozen .mpy modules may have their globals dict, functions and
+// constants evaluated at build time and placed in ROM (mpy-tool.py --rom-globals).
+// The globals dict is copied to the heap the first time it is modified.
+#ifndef MICROPY_MODULE_FROZEN_MPY_ROM_GLOBALS
+#define MICROPY_MODULE_FROZEN_MPY_ROM_GLOBALS (0)
+#endif
+
 // Convenience macro for whether frozen modules are supported
 #ifndef MICROPY_MODULE_FROZEN
 #define MICROPY_MODULE_FROZEN (MICROPY_MODULE_FROZEN_STR || MICROPY_MODULE_FROZEN_MPY)
@@ -1012,6 +1098,12 @@ typedef double mp_float_t;
 #define MICROPY_PY_STRUCT (1)
 #endif
 
+// Number of compiled format strings that "ustruct" functions keep, so they
+// don't parse the same format on every call (0 to disable)
+#ifndef MICROPY_PY_STRUCT_CACHE_SIZE
+#define MICROPY_PY_STRUCT_CACHE_SIZE (4)
+#endif
+
 // Whether to provide "sys" module
 #ifndef MICROPY_PY_SYS
 #define MICROPY_PY_SYS (1)
@@ -1069,6 +1161,28 @@ typedef double mp_float_t;
 #define MICROPY_PY_USELECT (0)
 #endif
 
+// Whether uselect waits on streams with a native fd (MP_STREAM_GET_FILENO)
+// with one select() call, sleeping in it, instead of polling each in turn
+#ifndef MICROPY_PY_USELECT_SELECT
+#define MICROPY_PY_USELECT_SELECT (0)
+#endif
+
+// Header declaring select() and fd_set for MICROPY_PY_USELECT_SELECT
+#ifndef MICROPY_PY_USELECT_SELECT_H
+#define MICROPY_PY_USELECT_SELECT_H <sys/select.h>
+#endif
+
+// Longest a blocked poll sleeps (ms) before handling pending events
+#ifndef MICROPY_PY_USELECT_MAX_WAIT_MS
+#define MICROPY_PY_USELECT_MAX_WAIT_MS (100)
+#endif
+
+// Sleep for up to ms, or until a stream which supports MP_STREAM_POLL_NOTIFY
+// signals it may be ready; the default runs the event hook once
+#ifndef MICROPY_PY_USELECT_WAIT
+#define MICROPY_PY_USELECT_WAIT(ms) MICROPY_EVENT_POLL_HOOK
+#endif
+
 // Whether to provide "utime" module functions implementation
 // in terms of mp_hal_* functions.
 #ifndef MICROPY_PY_UTIME_MP_HAL
@@ -1102,6 +1216,27 @@ typedef double mp_float_t;
 #define MICROPY_PY_THREAD_GIL_VM_DIVISOR (32)
 #endif
 
+// Whether the VM hands the GIL over only when another thread waits for it,
+// and the holder had it for its time slice, instead of releasing it on every
+// divisor count.  The port must then provide mp_thread_gil_enter(),
+// mp_thread_gil_exit() and mp_thread_gil_switch(), which keep gil_waiting.
+#ifndef MICROPY_PY_THREAD_GIL_ADAPTIVE
+#define MICROPY_PY_THREAD_GIL_ADAPTIVE (0)
+#endif
+
+// Default time slice of the GIL holder in microseconds, when adaptive
+#ifndef MICROPY_PY_THREAD_GIL_SWITCH_US
+#define MICROPY_PY_THREAD_GIL_SWITCH_US (1000)
+#endif
+
+// Whether to support worker interpreters, each with its own state, heap and
+// GIL, so that they run in parallel with the main one.  The port must then
+// provide mp_thread_get_ctx(), returning the state of the interpreter the
+// caller belongs to.
+#ifndef MICROPY_PY_THREAD_WORKERS
+#define MICROPY_PY_THREAD_WORKERS (0)
+#endif
+
 // Extended modules
 
 #ifndef MICROPY_PY_UCTYPES
@@ -1112,14 +1247,51 @@ typedef double mp_float_t;
 #define MICROPY_PY_UZLIB (0)
 #endif
 
+// Whether "uzlib" can compress as well, with compress, compressobj and CompIO
+#ifndef MICROPY_PY_UZLIB_COMPRESS
+#define MICROPY_PY_UZLIB_COMPRESS (0)
+#endif
+
+// Default log2 of the window size of uzlib compression, which needs 5 times
+// that many bytes of memory
+#ifndef MICROPY_PY_UZLIB_COMPRESS_WBITS
+#define MICROPY_PY_UZLIB_COMPRESS_WBITS (12)
+#endif
+
 #ifndef MICROPY_PY_UJSON
 #define MICROPY_PY_UJSON (0)
 #endif
 
+// Size of the blocks that ujson.load and ujson.iterparse read the stream in,
+// and that ujson.dump and ujson.dumps assemble their output in
+#ifndef MICROPY_PY_UJSON_BUF_SIZE
+#define MICROPY_PY_UJSON_BUF_SIZE (128)
+#endif
+
+// Whether to provide ujson.iterparse, and how deep it lets containers nest
+#ifndef MICROPY_PY_UJSON_ITERPARSE
+#define MICROPY_PY_UJSON_ITERPARSE (0)
+#endif
+#ifndef MICROPY_PY_UJSON_ITERPARSE_MAX_DEPTH
+#define MICROPY_PY_UJSON_ITERPARSE_MAX_DEPTH (64)
+#endif
+
 #ifndef MICROPY_PY_URE
 #define MICROPY_PY_URE (0)
 #endif
 
+// Number of compiled patterns that "ure" functions keep, so they don't
+// compile the same pattern on every call (0 to disable)
+#ifndef MICROPY_PY_URE_CACHE_SIZE
+#define MICROPY_PY_URE_CACHE_SIZE (4)
+#endif
+
+// Whether "ure" matches with a Pike VM, which takes time linear in the length
+// of the subject and a bounded amount of memory, instead of by backtracking
+#ifndef MICROPY_PY_URE_PIKEVM
+#define MICROPY_PY_URE_PIKEVM (0)
+#endif
+
 #ifndef MICROPY_PY_UHEAPQ
 #define MICROPY_PY_UHEAPQ (0)
 #endif
@@ -1133,6 +1305,26 @@ typedef double mp_float_t;
 #define MICROPY_PY_UHASHLIB (0)
 #endif
 
+#ifndef MICROPY_PY_UHASHLIB_MD5
+#define MICROPY_PY_UHASHLIB_MD5 (0)
+#endif
+
+// Needs mbedtls, unless MICROPY_PY_UHASHLIB_MBEDTLS is set it's the only
+// algorithm taken from there
+#ifndef MICROPY_PY_UHASHLIB_SHA1
+#define MICROPY_PY_UHASHLIB_SHA1 (0)
+#endif
+
+#ifndef MICROPY_PY_UHASHLIB_SHA512
+#define MICROPY_PY_UHASHLIB_SHA512 (0)
+#endif
+
+// Whether to use mbedtls (which may be hardware accelerated) for all of the
+// hash algorithms, rather than the software ones in extmod/crypto-algorithms
+#ifndef MICROPY_PY_UHASHLIB_MBEDTLS
+#define MICROPY_PY_UHASHLIB_MBEDTLS (0)
+#endif
+
 #ifndef MICROPY_PY_UBINASCII
 #define MICROPY_PY_UBINASCII (0)
 #endif
@@ -1182,6 +1374,17 @@ typedef double mp_float_t;
 #define MICROPY_PY_FRAMEBUF (0)
 #endif
 
+// Whether to provide the "vector" module, for element-wise arithmetic on
+// array, bytearray and memoryview objects (needs array and float support)
+#ifndef MICROPY_PY_VECTOR
+#define MICROPY_PY_VECTOR (0)
+#endif
+
+// Number of elements from which vector functions release the GIL
+#ifndef MICROPY_PY_VECTOR_GIL_RELEASE_LEN
+#define MICROPY_PY_VECTOR_GIL_RELEASE_LEN (1024)
+#endif
+
 #ifndef MICROPY_PY_BTREE
 #define MICROPY_PY_BTREE (0)
 #endif
@@ -1300,6 +1503,21 @@ typedef double mp_float_t;
 #define MP_PLAT_FREE_EXEC(ptr, size) m_del(byte, ptr, size)
 #endif
 
+// A port whose MP_PLAT_COMMIT_EXEC copies the code out of the heap can have
+// the GC manage that memory by defining all of these:
+//  - MP_PLAT_GC_MARK_EXEC(ptr) is given each traced word that isn't a heap
+//    pointer, and marks the code that it points into;
+//  - MP_PLAT_GC_TRACE_EXEC() traces the words of the code marked since it
+//    was last called with gc_collect_root, returning false if there was none;
+//  - MP_PLAT_GC_SWEEP_EXEC() frees the code that wasn't marked and clears the
+//    marks of the rest.
+
+// Attribute for the machine code of frozen native functions, which has to be
+// put somewhere it can be executed from
+#ifndef MP_PLAT_FROZEN_EXEC_ATTR
+#define MP_PLAT_FROZEN_EXEC_ATTR
+#endif
+
 // This macro is used to do all output (except when MICROPY_PY_IO is defined)
 #ifndef MP_PLAT_PRINT_STRN
 #define MP_PLAT_PRINT_STRN(str, len) mp_hal_stdout_tx_strn_cooked(str, len)
@@ -47,6 +47,8 @@ typedef struct mp_dynamic_compiler_t {
     uint8_t small_int_bits; // must be <= host small_int_bits
     bool opt_cache_map_lookup_in_bytecode;
     bool py_builtins_str_unicode;
+    bool opt_bytecode_superinstructions;
+    uint8_t native_arch; // architecture to emit native code for, MP_NATIVE_ARCH_xxx
 } mp_dynamic_compiler_t;
 extern mp_dynamic_compiler_t mp_dynamic_compiler;
 #endif
@@ -93,12 +95,27 @@ typedef struct _mp_state_mem_t {
     size_t gc_alloc_threshold;
     #endif
 
-    size_t gc_last_free_atb_index;
+    // For each allocation size class, the block below which there is no
+    // run of free blocks large enough for that class (see gc_alloc)
+    size_t gc_first_fit_block[MICROPY_GC_ALLOC_SIZE_CLASSES];
+
+    #if MICROPY_GC_INCREMENTAL_SWEEP
+    // Blocks from gc_sweep_block to the end of the heap have not been swept
+    // yet since the last collection; equal to the number of blocks when done.
+    size_t gc_sweep_block;
+    size_t gc_sweep_blocks_per_alloc;
+    int gc_sweep_free_tail;
+    #endif
 
     #if MICROPY_PY_GC_COLLECT_RETVAL
     size_t gc_collected;
     #endif
 
+    #if defined(MP_PLAT_GC_MARK_EXEC)
+    // the executable memory managed by the GC, for use by the port
+    void *gc_exec_list;
+    #endif
+
     #if MICROPY_PY_THREAD
     // This is a global mutex used to make the GC thread-safe.
     mp_thread_mutex_t gc_mutex;
@@ -116,6 +133,11 @@ typedef struct _mp_state_vm_t {
 
     qstr_pool_t *last_pool;
 
+    #if MICROPY_QSTR_INDEX
+    // hash index of the qstrs in the pools allocated at runtime
+    uint16_t *qstr_index;
+    #endif
+
     // non-heap memory for creating an exception if we can't allocate RAM
     mp_obj_exception_t mp_emergency_exception_obj;
 
@@ -164,6 +186,16 @@ typedef struct _mp_state_vm_t {
     mp_obj_dict_t *mp_module_builtins_override_dict;
     #endif
 
+    #if MICROPY_PY_STRUCT && MICROPY_PY_STRUCT_CACHE_SIZE
+    // compiled ustruct format strings, most recently compiled first
+    mp_obj_t struct_cache[MICROPY_PY_STRUCT_CACHE_SIZE];
+    #endif
+
+    #if MICROPY_PY_URE && MICROPY_PY_URE_CACHE_SIZE
+    // compiled ure patterns, most recently used first
+    mp_obj_t ure_cache[MICROPY_PY_URE_CACHE_SIZE];
+    #endif
+
     // include any root pointers defined by a port
     MICROPY_PORT_ROOT_POINTERS
 
@@ -197,6 +229,14 @@ typedef struct _mp_state_vm_t {
     size_t qstr_last_alloc;
     size_t qstr_last_used;
 
+    #if MICROPY_QSTR_INDEX
+    size_t qstr_index_mask;
+    #if MICROPY_PY_MICROPYTHON_MEM_INFO
+    size_t qstr_index_n_lookup;
+    size_t qstr_index_n_probe;
+    #endif
+    #endif
+
     #if MICROPY_PY_THREAD
     // This is a global mutex used to make qstr interning thread-safe.
     mp_thread_mutex_t qstr_mutex;
@@ -215,6 +255,12 @@ typedef struct _mp_state_vm_t {
     // This is a global mutex used to make the VM/runtime thread-safe.
     mp_thread_mutex_t gil_mutex;
     volatile int16_t thread_lock;
+    #if MICROPY_PY_THREAD_GIL_ADAPTIVE
+    volatile uint16_t gil_waiting;  // threads blocked waiting for the GIL
+    volatile uint16_t gil_handoffs; // counts the acquisitions after a wait
+    uint32_t gil_switch_us;         // time slice of the GIL holder
+    uint32_t gil_taken_us;          // when the holder took the GIL
+    #endif
     #endif
 } mp_state_vm_t;
 
@@ -252,8 +298,16 @@ typedef struct _mp_state_ctx_t {
 
 extern mp_state_ctx_t mp_state_ctx;
 
-#define MP_STATE_VM(x) (mp_state_ctx.vm.x)
-#define MP_STATE_MEM(x) (mp_state_ctx.mem.x)
+#if MICROPY_PY_THREAD_WORKERS
+#define MP_STATE_CTX (*mp_thread_get_ctx())
+#define MP_STATE_IS_MAIN() (mp_thread_get_ctx() == &mp_state_ctx)
+#else
+#define MP_STATE_CTX mp_state_ctx
+#define MP_STATE_IS_MAIN() (1)
+#endif
+
+#define MP_STATE_VM(x) (MP_STATE_CTX.vm.x)
+#define MP_STATE_MEM(x) (MP_STATE_CTX.mem.x)
 
 #if MICROPY_PY_THREAD
 extern mp_state_thread_t *mp_thread_get_state(void);
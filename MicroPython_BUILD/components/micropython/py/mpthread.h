@@ -52,8 +52,17 @@ void mp_thread_mutex_unlock(mp_thread_mutex_t *mutex);
 
 #if MICROPY_PY_THREAD && MICROPY_PY_THREAD_GIL
 #include "py/mpstate.h"
+#if MICROPY_PY_THREAD_GIL_ADAPTIVE
+void mp_thread_gil_enter(void);
+void mp_thread_gil_exit(void);
+// Hand the GIL over to a waiting thread, if the holder's time slice is over
+void mp_thread_gil_switch(void);
+#define MP_THREAD_GIL_ENTER() mp_thread_gil_enter()
+#define MP_THREAD_GIL_EXIT() mp_thread_gil_exit()
+#else
 #define MP_THREAD_GIL_ENTER() mp_thread_mutex_lock(&MP_STATE_VM(gil_mutex), 1)
 #define MP_THREAD_GIL_EXIT() mp_thread_mutex_unlock(&MP_STATE_VM(gil_mutex))
+#endif
 #else
 #define MP_THREAD_GIL_ENTER()
 #define MP_THREAD_GIL_EXIT()
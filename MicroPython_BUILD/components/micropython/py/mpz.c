@@ -37,6 +37,18 @@
 #define DIG_MSB  (MPZ_LONG_1 << (DIG_SIZE - 1))
 #define DIG_BASE (MPZ_LONG_1 << DIG_SIZE)
 
+// Operands with at least this many digits are multiplied with the Karatsuba
+// algorithm (must be at least 4)
+#ifndef MPZ_KARATSUBA_THRESHOLD
+#define MPZ_KARATSUBA_THRESHOLD (32)
+#endif
+
+// Integers with at least this many digits are converted to strings by
+// splitting them in halves (must be at least 2)
+#ifndef MPZ_STR_DC_THRESHOLD
+#define MPZ_STR_DC_THRESHOLD (32)
+#endif
+
 /*
  mpz is an arbitrary precision integer type with a public API.
 
@@ -421,35 +433,244 @@ STATIC size_t mpn_mul_dig_add_dig(mpz_dig_t *idig, size_t ilen, mpz_dig_t dmul,
 }
 
 /* computes i = j * k
-   returns number of digits in i
-   assumes enough memory in i; assumes i is zeroed; assumes normalised j, k
+   writes all jlen + klen digits of i (so i is not normalised)
+   assumes i is zeroed; j, k need not be normalised
    can have j, k point to same memory
 */
-STATIC size_t mpn_mul(mpz_dig_t *idig, mpz_dig_t *jdig, size_t jlen, mpz_dig_t *kdig, size_t klen) {
-    mpz_dig_t *oidig = idig;
-    size_t ilen = 0;
-
+STATIC void mpn_mul_basecase(mpz_dig_t *idig, const mpz_dig_t *jdig, size_t jlen, const mpz_dig_t *kdig, size_t klen) {
     for (; klen > 0; --klen, ++idig, ++kdig) {
+        if (*kdig == 0) {
+            continue;
+        }
+
         mpz_dig_t *id = idig;
         mpz_dbl_dig_t carry = 0;
 
         size_t jl = jlen;
-        for (mpz_dig_t *jd = jdig; jl > 0; --jl, ++jd, ++id) {
+        for (const mpz_dig_t *jd = jdig; jl > 0; --jl, ++jd, ++id) {
             carry += (mpz_dbl_dig_t)*id + (mpz_dbl_dig_t)*jd * (mpz_dbl_dig_t)*kdig; // will never overflow so long as DIG_SIZE <= 8*sizeof(mpz_dbl_dig_t)/2
             *id = carry & DIG_MASK;
             carry >>= DIG_SIZE;
         }
 
-        if (carry != 0) {
-            *id++ = carry;
+        *id = carry;
+    }
+}
+
+#if MICROPY_OPT_MPZ_KARATSUBA
+
+/* computes i = j + k, for jlen >= klen
+   writes jlen digits of i and returns the carry out of the top one
+   can have i, j, k pointing to same memory
+*/
+STATIC mpz_dig_t mpn_add_n(mpz_dig_t *idig, const mpz_dig_t *jdig, size_t jlen, const mpz_dig_t *kdig, size_t klen) {
+    mpz_dbl_dig_t carry = 0;
+
+    jlen -= klen;
+
+    for (; klen > 0; --klen, ++idig, ++jdig, ++kdig) {
+        carry += (mpz_dbl_dig_t)*jdig + (mpz_dbl_dig_t)*kdig;
+        *idig = carry & DIG_MASK;
+        carry >>= DIG_SIZE;
+    }
+
+    for (; jlen > 0; --jlen, ++idig, ++jdig) {
+        carry += *jdig;
+        *idig = carry & DIG_MASK;
+        carry >>= DIG_SIZE;
+    }
+
+    return carry;
+}
+
+/* computes i += j over the ilen digits of i, for ilen >= jlen
+   assumes the result fits in ilen digits
+*/
+STATIC void mpn_add_inpl_n(mpz_dig_t *idig, size_t ilen, const mpz_dig_t *jdig, size_t jlen) {
+    mpz_dbl_dig_t carry = mpn_add_n(idig, idig, jlen, jdig, jlen);
+    for (idig += jlen, ilen -= jlen; carry != 0 && ilen > 0; --ilen, ++idig) {
+        carry += *idig;
+        *idig = carry & DIG_MASK;
+        carry >>= DIG_SIZE;
+    }
+}
+
+/* computes i -= j over the ilen digits of i, for ilen >= jlen
+   assumes i >= j
+*/
+STATIC void mpn_sub_inpl_n(mpz_dig_t *idig, size_t ilen, const mpz_dig_t *jdig, size_t jlen) {
+    mpz_dbl_dig_signed_t borrow = 0;
+
+    ilen -= jlen;
+
+    for (; jlen > 0; --jlen, ++idig, ++jdig) {
+        borrow += (mpz_dbl_dig_t)*idig - (mpz_dbl_dig_t)*jdig;
+        *idig = borrow & DIG_MASK;
+        borrow >>= DIG_SIZE;
+    }
+
+    for (; borrow != 0 && ilen > 0; --ilen, ++idig) {
+        borrow += *idig;
+        *idig = borrow & DIG_MASK;
+        borrow >>= DIG_SIZE;
+    }
+}
+
+/* returns the number of scratch digits that mpn_mul_karatsuba needs for n digit operands */
+STATIC size_t mpn_mul_karatsuba_scratch(size_t n) {
+    size_t len = 0;
+    while (n >= MPZ_KARATSUBA_THRESHOLD) {
+        n = n - n / 2 + 1;
+        len += 2 * n + 2 * n;
+    }
+    return len;
+}
+
+/* computes i = j * k, where j and k both have n digits
+   writes all 2n digits of i; uses the Karatsuba algorithm above the threshold
+   scratch must have mpn_mul_karatsuba_scratch(n) digits
+   can have j, k point to same memory
+*/
+STATIC void mpn_mul_karatsuba(mpz_dig_t *idig, const mpz_dig_t *jdig, const mpz_dig_t *kdig, size_t n, mpz_dig_t *scratch) {
+    if (n < MPZ_KARATSUBA_THRESHOLD) {
+        memset(idig, 0, 2 * n * sizeof(mpz_dig_t));
+        mpn_mul_basecase(idig, jdig, n, kdig, n);
+        return;
+    }
+
+    // split j = j1 * B^m + j0 and k = k1 * B^m + k0, with j1, k1 of h >= m digits
+    size_t m = n / 2;
+    size_t h = n - m;
+
+    // the low part of i is j0 * k0, and the high part j1 * k1
+    mpn_mul_karatsuba(idig, jdig, kdig, m, scratch);
+    mpn_mul_karatsuba(idig + 2 * m, jdig + m, kdig + m, h, scratch);
+
+    // the middle term j0 * k1 + j1 * k0 is (j0 + j1) * (k0 + k1) - j0 * k0 - j1 * k1,
+    // which has at most 2h + 1 digits
+    mpz_dig_t *jsum = scratch;
+    mpz_dig_t *ksum = jsum + h + 1;
+    mpz_dig_t *mid = ksum + h + 1;
+    jsum[h] = mpn_add_n(jsum, jdig + m, h, jdig, m);
+    ksum[h] = mpn_add_n(ksum, kdig + m, h, kdig, m);
+    mpn_mul_karatsuba(mid, jsum, ksum, h + 1, mid + 2 * (h + 1));
+    mpn_sub_inpl_n(mid, 2 * h + 2, idig, 2 * m);
+    mpn_sub_inpl_n(mid, 2 * h + 2, idig + 2 * m, 2 * h);
+    mpn_add_inpl_n(idig + m, 2 * n - m, mid, 2 * h + 1);
+}
+
+#endif
+
+/* computes i = j * k
+   returns number of digits in i
+   assumes enough memory in i; assumes i is zeroed; assumes normalised j, k
+   can have j, k point to same memory
+*/
+STATIC size_t mpn_mul(mpz_dig_t *idig, mpz_dig_t *jdig, size_t jlen, mpz_dig_t *kdig, size_t klen) {
+    #if MICROPY_OPT_MPZ_KARATSUBA
+    if (jlen >= MPZ_KARATSUBA_THRESHOLD && klen >= MPZ_KARATSUBA_THRESHOLD) {
+        if (jlen < klen) {
+            mpz_dig_t *dig = jdig; jdig = kdig; kdig = dig;
+            size_t len = jlen; jlen = klen; klen = len;
         }
 
-        ilen = id - oidig;
+        // multiply k by j in slices of klen digits, the last one zero padded
+        size_t scratch_len = mpn_mul_karatsuba_scratch(klen);
+        mpz_dig_t *scratch = m_new(mpz_dig_t, scratch_len + 3 * klen);
+        mpz_dig_t *prod = scratch + scratch_len;
+        mpz_dig_t *slice = prod + 2 * klen;
+        for (size_t done = 0; done < jlen; done += klen) {
+            size_t len = jlen - done;
+            const mpz_dig_t *jd = jdig + done;
+            if (len < klen) {
+                memcpy(slice, jd, len * sizeof(mpz_dig_t));
+                memset(slice + len, 0, (klen - len) * sizeof(mpz_dig_t));
+                jd = slice;
+            } else {
+                len = klen;
+            }
+            mpn_mul_karatsuba(prod, jd, kdig, klen, scratch);
+            mpn_add_inpl_n(idig + done, jlen + klen - done, prod, len + klen);
+        }
+        m_del(mpz_dig_t, scratch, scratch_len + 3 * klen);
+
+        return mpn_remove_trailing_zeros(idig, idig + jlen + klen);
     }
+    #endif
 
-    return ilen;
+    mpn_mul_basecase(idig, jdig, jlen, kdig, klen);
+    return mpn_remove_trailing_zeros(idig, idig + jlen + klen);
+}
+
+#if MICROPY_OPT_MPZ_MONTGOMERY
+
+/* returns -m^-1 mod DIG_BASE
+   assumes m is odd
+*/
+STATIC mpz_dig_t mpn_mont_inverse(mpz_dig_t m) {
+    // Newton's iteration, each step doubles the number of correct low bits,
+    // and m * m == 1 mod 8 gives the first 3
+    mpz_dbl_dig_t inv = m;
+    for (int bits = 3; bits < DIG_SIZE; bits *= 2) {
+        inv = (inv * (2 - ((m * inv) & DIG_MASK))) & DIG_MASK;
+    }
+    return (DIG_BASE - inv) & DIG_MASK;
 }
 
+/* computes i = j * k * B^-n mod m, the Montgomery product
+   j, k, m and i all have n digits; assumes j, k < m, m odd, minv = -m^-1 mod B
+   t must have 2n + 1 digits, plus the scratch for multiplying n digits
+   can have i, j, k point to same memory
+*/
+STATIC void mpn_mont_mul(mpz_dig_t *idig, const mpz_dig_t *jdig, const mpz_dig_t *kdig, const mpz_dig_t *mdig, size_t n, mpz_dig_t minv, mpz_dig_t *t) {
+    t[2 * n] = 0;
+    #if MICROPY_OPT_MPZ_KARATSUBA
+    mpn_mul_karatsuba(t, jdig, kdig, n, t + 2 * n + 1);
+    #else
+    memset(t, 0, 2 * n * sizeof(mpz_dig_t));
+    mpn_mul_basecase(t, jdig, n, kdig, n);
+    #endif
+
+    // add multiples of m to clear the low n digits of t, then divide by B^n
+    for (size_t i = 0; i < n; ++i) {
+        mpz_dbl_dig_t u = ((mpz_dbl_dig_t)t[i] * minv) & DIG_MASK;
+        mpz_dbl_dig_t carry = 0;
+        mpz_dig_t *td = t + i;
+        for (size_t j = 0; j < n; ++j, ++td) {
+            carry += (mpz_dbl_dig_t)*td + u * (mpz_dbl_dig_t)mdig[j];
+            *td = carry & DIG_MASK;
+            carry >>= DIG_SIZE;
+        }
+        for (; carry != 0; ++td) {
+            carry += *td;
+            *td = carry & DIG_MASK;
+            carry >>= DIG_SIZE;
+        }
+    }
+
+    // the result is below 2m, so at most one subtraction brings it below m
+    mpz_dig_t *res = t + n;
+    bool ge = res[n] != 0;
+    if (!ge) {
+        size_t j = n;
+        while (j > 0 && res[j - 1] == mdig[j - 1]) {
+            --j;
+        }
+        ge = j == 0 || res[j - 1] > mdig[j - 1];
+    }
+    if (ge) {
+        mpz_dbl_dig_signed_t borrow = 0;
+        for (size_t j = 0; j < n; ++j) {
+            borrow += (mpz_dbl_dig_t)res[j] - (mpz_dbl_dig_t)mdig[j];
+            res[j] = borrow & DIG_MASK;
+            borrow >>= DIG_SIZE;
+        }
+    }
+    memcpy(idig, res, n * sizeof(mpz_dig_t));
+}
+
+#endif
+
 /* natural_div - quo * den + new_num = old_num (ie num is replaced with rem)
    assumes den != 0
    assumes num_dig has enough memory to be extended by 1 digit
@@ -1360,6 +1581,89 @@ void mpz_pow_inpl(mpz_t *dest, const mpz_t *lhs, const mpz_t *rhs) {
     mpz_free(n);
 }
 
+#if MICROPY_OPT_MPZ_MONTGOMERY
+/* computes dest = (lhs ** rhs) % mod with Montgomery multiplication
+   assumes rhs > 0, mod > 0 is odd and has at least 2 digits
+   can have dest, lhs, rhs the same; mod can't be the same as dest
+*/
+STATIC void mpz_pow3_montgomery(mpz_t *dest, const mpz_t *lhs, const mpz_t *rhs, const mpz_t *mod) {
+    size_t n = mod->len;
+    mpz_dig_t minv = mpn_mont_inverse(mod->dig[0]);
+
+    // the exponent is scanned from the top in windows of w bits, using a
+    // table of x^0 .. x^(2^w - 1)
+    size_t nbits = (rhs->len - 1) * DIG_SIZE;
+    for (mpz_dig_t d = rhs->dig[rhs->len - 1]; d != 0; d >>= 1) {
+        ++nbits;
+    }
+    size_t w = nbits <= 24 ? 1 : nbits <= 128 ? 3 : 4;
+
+    size_t t_len = 2 * n + 1;
+    #if MICROPY_OPT_MPZ_KARATSUBA
+    t_len += mpn_mul_karatsuba_scratch(n);
+    #endif
+    size_t tbl_len = ((size_t)1 << w) * n;
+    size_t alloc = t_len + tbl_len + n;
+    mpz_dig_t *t = m_new(mpz_dig_t, alloc);
+    mpz_dig_t *tbl = t + t_len;
+    mpz_dig_t *acc = tbl + tbl_len;
+
+    // the table is in Montgomery form, x * B^n mod m
+    mpz_t x; mpz_init_zero(&x);
+    mpz_t quo; mpz_init_zero(&quo);
+    mpz_set_from_int(&x, 1);
+    for (size_t i = 0; i < 2; ++i) {
+        if (i == 1) {
+            mpz_set(&x, lhs);
+        }
+        mpz_shl_inpl(&x, &x, n * DIG_SIZE);
+        mpz_divmod_inpl(&quo, &x, &x, mod);
+        memset(tbl + i * n, 0, n * sizeof(mpz_dig_t));
+        memcpy(tbl + i * n, x.dig, x.len * sizeof(mpz_dig_t));
+    }
+    mpz_deinit(&quo);
+    mpz_deinit(&x);
+    for (size_t i = 2; i < ((size_t)1 << w); ++i) {
+        mpn_mont_mul(tbl + i * n, tbl + (i - 1) * n, tbl + n, mod->dig, n, minv, t);
+    }
+
+    // the top window holds the top bit of rhs, so acc starts from its entry
+    bool started = false;
+    for (size_t pos = (nbits + w - 1) / w * w; pos > 0; pos -= w) {
+        size_t win = 0;
+        for (size_t bit = pos; bit > pos - w; --bit) {
+            win <<= 1;
+            if (bit <= nbits) {
+                win |= (rhs->dig[(bit - 1) / DIG_SIZE] >> ((bit - 1) % DIG_SIZE)) & 1;
+            }
+        }
+        if (!started) {
+            memcpy(acc, tbl + win * n, n * sizeof(mpz_dig_t));
+            started = true;
+            continue;
+        }
+        for (size_t i = 0; i < w; ++i) {
+            mpn_mont_mul(acc, acc, acc, mod->dig, n, minv, t);
+        }
+        if (win != 0) {
+            mpn_mont_mul(acc, acc, tbl + win * n, mod->dig, n, minv, t);
+        }
+    }
+
+    // multiply by 1 to take acc out of Montgomery form
+    memset(tbl, 0, n * sizeof(mpz_dig_t));
+    tbl[0] = 1;
+    mpn_mont_mul(acc, acc, tbl, mod->dig, n, minv, t);
+
+    mpz_need_dig(dest, n);
+    memcpy(dest->dig, acc, n * sizeof(mpz_dig_t));
+    dest->len = mpn_remove_trailing_zeros(dest->dig, dest->dig + n);
+    dest->neg = 0;
+
+    m_del(mpz_dig_t, t, alloc);
+}
+#endif
+
 /* computes dest = (lhs ** rhs) % mod
    can have dest, lhs, rhs the same; mod can't be the same as dest
 */
@@ -1375,6 +1679,13 @@ void mpz_pow3_inpl(mpz_t *dest, const mpz_t *lhs, const mpz_t *rhs, const mpz_t
         return;
     }
 
+    #if MICROPY_OPT_MPZ_MONTGOMERY
+    if (mod->len >= 2 && mod->neg == 0 && (mod->dig[0] & 1) != 0) {
+        mpz_pow3_montgomery(dest, lhs, rhs, mod);
+        return;
+    }
+    #endif
+
     mpz_t *x = mpz_clone(lhs);
     mpz_t *n = mpz_clone(rhs);
     mpz_t quo; mpz_init_zero(&quo);
@@ -1689,6 +2000,75 @@ char *mpz_as_str(const mpz_t *i, unsigned int base) {
 }
 #endif
 
+/* writes the digits of i in the given base to str, least significant first
+   at least nchars of them, padded with '0'; i is destroyed
+   returns the end of the written chars
+   assumes big is base ** big_n, the largest power of base that fits in a digit
+*/
+STATIC char *mpn_as_str(mpz_dig_t *idig, size_t ilen, unsigned int base, char base_char,
+    mpz_dig_t big, size_t big_n, size_t nchars, char *str) {
+    char *s = str;
+
+    // each pass divides i by big, and gives big_n chars from the remainder
+    while (ilen > 0) {
+        mpz_dig_t *d = idig + ilen;
+        mpz_dbl_dig_t a = 0;
+        while (--d >= idig) {
+            a = (a << DIG_SIZE) | *d;
+            *d = a / big;
+            a %= big;
+        }
+        if (idig[ilen - 1] == 0) {
+            --ilen;
+        }
+
+        for (size_t n = big_n; n > 0 && (ilen > 0 || a != 0); --n) {
+            char c = '0' + a % base;
+            if (c > '9') {
+                c += base_char - '9' - 1;
+            }
+            *s++ = c;
+            a /= base;
+        }
+    }
+
+    while ((size_t)(s - str) < nchars) {
+        *s++ = '0';
+    }
+
+    return s;
+}
+
+#if MICROPY_OPT_MPZ_KARATSUBA
+/* like mpn_as_str but for a large i, which is split in two halves by
+   dividing by one of the powers pows[j] = big ** (2 ** j) and the halves
+   converted recursively
+   can destroy i
+*/
+STATIC char *mpz_as_str_dc(mpz_t *i, unsigned int base, char base_char, mpz_dig_t big, size_t big_n,
+    const mpz_t *pows, size_t n_pows, size_t nchars, char *str) {
+    size_t j = n_pows;
+    while (j > 0 && 2 * pows[j - 1].len > i->len) {
+        --j;
+    }
+    if (i->len < MPZ_STR_DC_THRESHOLD || j == 0) {
+        return mpn_as_str(i->dig, i->len, base, base_char, big, big_n, nchars, str);
+    }
+    --j;
+
+    // the remainder gives exactly the low big_n * 2 ** j chars
+    mpz_t quo; mpz_init_zero(&quo);
+    mpz_t rem; mpz_init_zero(&rem);
+    mpz_divmod_inpl(&quo, &rem, i, &pows[j]);
+    size_t low_n = big_n << j;
+    char *s = mpz_as_str_dc(&rem, base, base_char, big, big_n, pows, j, low_n, str);
+    mpz_deinit(&rem);
+    s = mpz_as_str_dc(&quo, base, base_char, big, big_n, pows, j + 1, nchars > low_n ? nchars - low_n : 0, s);
+    mpz_deinit(&quo);
+    return s;
+}
+#endif
+
 // assumes enough space in str as calculated by mp_int_format_size
 // base must be between 2 and 32 inclusive
 // returns length of string, not including null byte
@@ -1709,48 +2089,57 @@ size_t mpz_as_str_inpl(const mpz_t *i, unsigned int base, const char *prefix, ch
         return s - str;
     }
 
-    // make a copy of mpz digits, so we can do the div/mod calculation
-    mpz_dig_t *dig = m_new(mpz_dig_t, ilen);
-    memcpy(dig, i->dig, ilen * sizeof(mpz_dig_t));
-
-    // convert
-    char *last_comma = str;
-    bool done;
-    do {
-        mpz_dig_t *d = dig + ilen;
-        mpz_dbl_dig_t a = 0;
-
-        // compute next remainder
-        while (--d >= dig) {
-            a = (a << DIG_SIZE) | *d;
-            *d = a / base;
-            a %= base;
+    // the largest power of the base that fits in a digit
+    mpz_dig_t big = base;
+    size_t big_n = 1;
+    while ((mpz_dbl_dig_t)big * base <= DIG_MASK) {
+        big *= base;
+        ++big_n;
+    }
+
+    // convert, least significant char first
+    #if MICROPY_OPT_MPZ_KARATSUBA
+    if (ilen >= MPZ_STR_DC_THRESHOLD) {
+        // the powers big ** (2 ** j) up to about the square root of i
+        size_t n_pows = 0;
+        mpz_t pows[8 * sizeof(size_t)];
+        mpz_init_from_int(&pows[0], big);
+        while (2 * pows[n_pows].len <= ilen) {
+            mpz_init_zero(&pows[n_pows + 1]);
+            mpz_mul_inpl(&pows[n_pows + 1], &pows[n_pows], &pows[n_pows]);
+            ++n_pows;
         }
-
-        // convert to character
-        a += '0';
-        if (a > '9') {
-            a += base_char - '9' - 1;
+        ++n_pows;
+
+        mpz_t z; mpz_init_zero(&z);
+        mpz_abs_inpl(&z, i);
+        s = mpz_as_str_dc(&z, base, base_char, big, big_n, pows, n_pows, 0, s);
+        mpz_deinit(&z);
+        for (size_t j = 0; j < n_pows; ++j) {
+            mpz_deinit(&pows[j]);
         }
-        *s++ = a;
-
-        // check if number is zero
-        done = true;
-        for (d = dig; d < dig + ilen; ++d) {
-            if (*d != 0) {
-                done = false;
-                break;
+    } else
+    #endif
+    {
+        // make a copy of mpz digits, so we can do the div/mod calculation
+        mpz_dig_t *dig = m_new(mpz_dig_t, ilen);
+        memcpy(dig, i->dig, ilen * sizeof(mpz_dig_t));
+        s = mpn_as_str(dig, ilen, base, base_char, big, big_n, 0, s);
+        // free the copy of the digits array
+        m_del(mpz_dig_t, dig, ilen);
+    }
+
+    if (comma) {
+        // spread the chars out from the end to put a comma between each group of 3
+        size_t n = s - str;
+        s += (n - 1) / 3;
+        for (char *d = s; n > 0; --n) {
+            *--d = str[n - 1];
+            if (n % 3 == 1 && n > 1) {
+                *--d = comma;
             }
         }
-        if (comma && (s - last_comma) == 3) {
-            *s++ = comma;
-            last_comma = s;
-        }
     }
-    while (!done);
-
-    // free the copy of the digits array
-    m_del(mpz_dig_t, dig, ilen);
 
     if (prefix) {
         const char *p = &prefix[strlen(prefix)];
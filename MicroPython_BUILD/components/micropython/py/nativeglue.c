@@ -155,7 +155,11 @@ void *const mp_fun_table[MP_F_NUMBER_OF] = {
     mp_call_method_n_kw_var,
     mp_native_getiter,
     mp_native_iternext,
+#if MICROPY_NLR_SETJMP
+    nlr_push_tail, // the setjmp is done by the native code, via MP_F_SETJMP
+#else
     nlr_push,
+#endif
     nlr_pop,
     mp_native_raise,
     mp_import_name,
@@ -173,6 +177,11 @@ void *const mp_fun_table[MP_F_NUMBER_OF] = {
     mp_setup_code_state,
     mp_small_int_floor_divide,
     mp_small_int_modulo,
+#if MICROPY_NLR_SETJMP
+    setjmp,
+#else
+    NULL,
+#endif
 };
 
 /*
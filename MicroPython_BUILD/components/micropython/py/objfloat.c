@@ -208,6 +208,17 @@ mp_float_t mp_obj_float_get(mp_obj_t self_in) {
     return self->value;
 }
 
+#if MICROPY_OPT_VM_FLOAT_TEMP_REUSE
+// Floats are immutable, so this may only be used by the VM on a float it has
+// just created and that nothing else can refer to yet.
+mp_obj_t mp_obj_float_reuse(mp_obj_t self_in, mp_float_t value) {
+    assert(mp_obj_is_float(self_in));
+    mp_obj_float_t *self = MP_OBJ_TO_PTR(self_in);
+    self->value = value;
+    return self_in;
+}
+#endif
+
 #endif
 
 STATIC void mp_obj_float_divmod(mp_float_t *x, mp_float_t *y) {
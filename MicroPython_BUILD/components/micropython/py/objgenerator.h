@@ -29,6 +29,13 @@
 #include "py/obj.h"
 #include "py/runtime.h"
 
+typedef struct _mp_obj_gen_wrap_t {
+    mp_obj_base_t base;
+    mp_obj_t *fun;
+} mp_obj_gen_wrap_t;
+
+extern const mp_obj_type_t mp_type_gen_wrap;
+
 mp_vm_return_kind_t mp_obj_gen_resume(mp_obj_t self_in, mp_obj_t send_val, mp_obj_t throw_val, mp_obj_t *ret_val);
 
 #endif // MICROPY_INCLUDED_PY_OBJGENERATOR_H
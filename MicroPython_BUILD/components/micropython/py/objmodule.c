@@ -62,10 +62,15 @@ STATIC void module_attr(mp_obj_t self_in, qstr attr, mp_obj_t *dest) {
         if (elem != NULL) {
             dest[0] = elem->value;
         }
+        #if MICROPY_PY_THREAD_WORKERS && MICROPY_PY_SYS
+        else if (self == &mp_module_sys) {
+            dest[0] = mp_module_sys_state_attr(attr);
+        }
+        #endif
     } else {
         // delete/store attribute
         mp_obj_dict_t *dict = self->globals;
-        if (dict->map.is_fixed) {
+        if (dict->map.is_fixed && !dict->map.is_copy_on_write) {
             #if MICROPY_CAN_OVERRIDE_BUILTINS
             if (dict == &mp_module_builtins_globals) {
                 if (MP_STATE_VM(mp_module_builtins_override_dict) == NULL) {
@@ -217,6 +222,9 @@ STATIC const mp_rom_map_elem_t mp_builtin_module_table[] = {
 #if MICROPY_PY_FRAMEBUF
     { MP_ROM_QSTR(MP_QSTR_framebuf), MP_ROM_PTR(&mp_module_framebuf) },
 #endif
+#if MICROPY_PY_VECTOR
+    { MP_ROM_QSTR(MP_QSTR_vector), MP_ROM_PTR(&mp_module_vector) },
+#endif
 #if MICROPY_PY_BTREE
     { MP_ROM_QSTR(MP_QSTR_btree), MP_ROM_PTR(&mp_module_btree) },
 #endif
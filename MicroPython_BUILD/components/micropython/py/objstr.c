@@ -87,11 +87,19 @@ void mp_str_print_json(const mp_print_t *print, const byte *str_data, size_t str
     // if we are given a valid utf8-encoded string, we will print it in a JSON-conforming way
     mp_print_str(print, "\"");
     for (const byte *s = str_data, *top = str_data + str_len; s < top; s++) {
+        // print runs of normal and utf-8 encoded chars in one go
+        const byte *run = s;
+        while (s < top && *s >= 32 && *s != '"' && *s != '\\') {
+            ++s;
+        }
+        if (s > run) {
+            print->print_strn(print->data, (const char*)run, s - run);
+        }
+        if (s == top) {
+            break;
+        }
         if (*s == '"' || *s == '\\') {
             mp_printf(print, "\\%c", *s);
-        } else if (*s >= 32) {
-            // this will handle normal and utf-8 encoded chars
-            mp_printf(print, "%c", *s);
         } else if (*s == '\n') {
             mp_print_str(print, "\\n");
         } else if (*s == '\r') {
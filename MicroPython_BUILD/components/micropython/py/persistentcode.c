@@ -53,6 +53,28 @@
     | ((MICROPY_PY_BUILTINS_STR_UNICODE_DYNAMIC) << 1) \
     )
 
+// Bits 2 to 5 of the feature flags hold the architecture of any native
+// machine code in the file, which also fixes the nlr_buf_t layout it uses.
+// If this is not MP_NATIVE_ARCH_NONE then each raw code starts with its kind.
+#define MPY_FEATURE_ENCODE_ARCH(arch) ((arch) << 2)
+#define MPY_FEATURE_DECODE_ARCH(feat) (((feat) >> 2) & 0xf)
+#define MPY_FEATURE_DECODE_FLAGS(feat) ((feat) & 3)
+
+// Bit 6 is set if the bytecode may contain superinstructions.  The VM can run
+// bytecode without them even if it supports them, so it's not a config match.
+#define MPY_FEATURE_SUPERINSTRUCTIONS (0x40)
+// MPY_NATIVE_LOAD says whether native code for that arch can be loaded.
+#if MICROPY_EMIT_X64 && !MICROPY_NLR_SETJMP
+#define MPY_FEATURE_ARCH (MP_NATIVE_ARCH_X64)
+#define MPY_NATIVE_LOAD (1)
+#elif MICROPY_EMIT_XTENSAWIN && MICROPY_NLR_SETJMP
+#define MPY_FEATURE_ARCH (MP_NATIVE_ARCH_XTENSAWIN)
+#define MPY_NATIVE_LOAD (1)
+#else
+#define MPY_FEATURE_ARCH (MP_NATIVE_ARCH_NONE)
+#define MPY_NATIVE_LOAD (0)
+#endif
+
 #if MICROPY_PERSISTENT_CODE_LOAD || (MICROPY_PERSISTENT_CODE_SAVE && !MICROPY_DYNAMIC_COMPILER)
 // The bytecode will depend on the number of bits in a small-int, and
 // this function computes that (could make it a fixed constant, but it
@@ -164,7 +186,105 @@ STATIC void load_bytecode_qstrs(mp_reader_t *reader, byte *ip, byte *ip_top) {
     }
 }
 
-STATIC mp_raw_code_t *load_raw_code(mp_reader_t *reader) {
+STATIC mp_raw_code_t *load_raw_code(mp_reader_t *reader, bool has_kind);
+
+#if MPY_NATIVE_LOAD
+STATIC mp_raw_code_t *load_raw_code_native(mp_reader_t *reader, mp_raw_code_kind_t kind) {
+    // load the machine code
+    size_t fun_data_len = read_uint(reader);
+    byte *fun_data;
+    size_t fun_alloc;
+    MP_PLAT_ALLOC_EXEC(fun_data_len, (void**)&fun_data, &fun_alloc);
+    read_bytes(reader, fun_data, fun_data_len);
+
+    const mp_uint_t *const_table = NULL;
+    size_t n_pos_args;
+    mp_uint_t type_sig = 0;
+    if (kind == MP_CODE_NATIVE_PY) {
+        // load the prelude, which is kept out of the machine code in the
+        // constant table, and link global qstr ids into it
+        size_t prelude_len = read_uint(reader);
+        byte *prelude_data = m_new(byte, prelude_len);
+        read_bytes(reader, prelude_data, prelude_len);
+        const byte *ip = prelude_data;
+        const byte *ip2;
+        bytecode_prelude_t prelude;
+        extract_prelude(&ip, &ip2, &prelude);
+        qstr simple_name = load_qstr(reader);
+        qstr source_file = load_qstr(reader);
+        ((byte*)ip2)[0] = simple_name; ((byte*)ip2)[1] = simple_name >> 8;
+        ((byte*)ip2)[2] = source_file; ((byte*)ip2)[3] = source_file >> 8;
+
+        size_t n_arg_names = prelude.n_pos_args + prelude.n_kwonly_args;
+        mp_uint_t *ct = mp_emit_glue_new_native_const_table(n_arg_names, prelude_data, prelude_len);
+        m_del(byte, prelude_data, prelude_len);
+        for (size_t i = 0; i < n_arg_names; ++i) {
+            ct[i] = (mp_uint_t)MP_OBJ_NEW_QSTR(load_qstr(reader));
+        }
+        const_table = ct;
+        n_pos_args = prelude.n_pos_args;
+    } else {
+        n_pos_args = read_uint(reader);
+        type_sig = read_uint(reader);
+    }
+    mp_uint_t scope_flags = read_uint(reader);
+
+    // link the words of the machine code that depend on this firmware
+    size_t n_reloc = read_uint(reader);
+    for (size_t i = 0; i < n_reloc; ++i) {
+        size_t offset = read_uint(reader);
+        mp_native_reloc_kind_t reloc_kind = read_byte(reader);
+        mp_uint_t arg;
+        switch (reloc_kind) {
+            case MP_NATIVE_RELOC_QSTR:
+            case MP_NATIVE_RELOC_QSTR_OBJ:
+                arg = load_qstr(reader);
+                break;
+            case MP_NATIVE_RELOC_OBJ:
+                arg = (mp_uint_t)load_obj(reader);
+                break;
+            case MP_NATIVE_RELOC_RAW_CODE:
+                arg = (mp_uint_t)(uintptr_t)load_raw_code(reader, true);
+                break;
+            default:
+                arg = read_uint(reader);
+                break;
+        }
+        if (offset + sizeof(mp_uint_t) > fun_data_len) {
+            mp_raise_ValueError("incompatible .mpy file");
+        }
+        mp_uint_t val = mp_native_reloc_value(reloc_kind, arg);
+        memcpy(fun_data + offset, &val, sizeof(val));
+    }
+
+    #if defined(MP_PLAT_COMMIT_EXEC)
+    fun_data = MP_PLAT_COMMIT_EXEC(fun_data, fun_data_len);
+    #endif
+
+    // create raw_code and return it
+    mp_raw_code_t *rc = mp_emit_glue_new_raw_code();
+    mp_emit_glue_assign_native(rc, kind, fun_data, fun_data_len, const_table,
+        #if MICROPY_PERSISTENT_CODE_SAVE
+        0, NULL,
+        #endif
+        n_pos_args, scope_flags, type_sig);
+    return rc;
+}
+#endif
+
+STATIC mp_raw_code_t *load_raw_code(mp_reader_t *reader, bool has_kind) {
+    if (has_kind) {
+        mp_raw_code_kind_t kind = read_byte(reader);
+        #if MPY_NATIVE_LOAD
+        if (kind == MP_CODE_NATIVE_PY || kind == MP_CODE_NATIVE_VIPER) {
+            return load_raw_code_native(reader, kind);
+        }
+        #endif
+        if (kind != MP_CODE_BYTECODE) {
+            mp_raise_ValueError("incompatible .mpy file");
+        }
+    }
+
     // load bytecode
     size_t bc_len = read_uint(reader);
     byte *bytecode = m_new(byte, bc_len);
@@ -195,7 +315,7 @@ STATIC mp_raw_code_t *load_raw_code(mp_reader_t *reader) {
         *ct++ = (mp_uint_t)load_obj(reader);
     }
     for (size_t i = 0; i < n_raw_code; ++i) {
-        *ct++ = (mp_uint_t)(uintptr_t)load_raw_code(reader);
+        *ct++ = (mp_uint_t)(uintptr_t)load_raw_code(reader, has_kind);
     }
 
     // create raw_code and return it
@@ -215,13 +335,18 @@ STATIC mp_raw_code_t *load_raw_code(mp_reader_t *reader) {
 mp_raw_code_t *mp_raw_code_load(mp_reader_t *reader) {
     byte header[4];
     read_bytes(reader, header, sizeof(header));
+    int arch = MPY_FEATURE_DECODE_ARCH(header[2]);
     if (header[0] != 'M'
         || header[1] != MPY_VERSION
-        || header[2] != MPY_FEATURE_FLAGS
+        || MPY_FEATURE_DECODE_FLAGS(header[2]) != MPY_FEATURE_FLAGS
+        || ((header[2] & MPY_FEATURE_SUPERINSTRUCTIONS) && !MICROPY_OPT_BYTECODE_SUPERINSTRUCTIONS)
         || header[3] > mp_small_int_bits()) {
         mp_raise_ValueError("incompatible .mpy file");
     }
-    mp_raw_code_t *rc = load_raw_code(reader);
+    if (arch != MP_NATIVE_ARCH_NONE && arch != MPY_FEATURE_ARCH) {
+        mp_raise_ValueError("incompatible .mpy arch");
+    }
+    mp_raw_code_t *rc = load_raw_code(reader, arch != MP_NATIVE_ARCH_NONE);
     reader->close(reader->data);
     return rc;
 }
@@ -320,7 +445,84 @@ STATIC void save_bytecode_qstrs(mp_print_t *print, const byte *ip, const byte *i
     }
 }
 
-STATIC void save_raw_code(mp_print_t *print, mp_raw_code_t *rc) {
+STATIC void save_raw_code(mp_print_t *print, mp_raw_code_t *rc, int arch);
+
+#if MICROPY_EMIT_NATIVE
+STATIC void save_raw_code_native(mp_print_t *print, mp_raw_code_t *rc, int arch) {
+    // save the machine code, with the words to be relocated zeroed so the
+    // output doesn't depend on the memory layout of the compiler
+    size_t word_size = arch == MP_NATIVE_ARCH_X64 ? 8 : 4;
+    size_t fun_data_len = rc->data.u_native.fun_data_len;
+    const mp_native_reloc_t *relocs = rc->data.u_native.relocs;
+    byte *code = m_new(byte, fun_data_len);
+    memcpy(code, rc->data.u_native.fun_data, fun_data_len);
+    for (size_t i = 0; i < rc->data.u_native.n_reloc; ++i) {
+        memset(code + relocs[i].offset, 0, word_size);
+    }
+    mp_print_uint(print, fun_data_len);
+    mp_print_bytes(print, code, fun_data_len);
+    m_del(byte, code, fun_data_len);
+
+    if (rc->kind == MP_CODE_NATIVE_PY) {
+        // the prelude follows the machine code, and the argument names are
+        // at the start of the constant table
+        const byte *prelude_data = (const byte*)rc->data.u_native.fun_data + fun_data_len;
+        const byte *ip = prelude_data;
+        const byte *ip2;
+        bytecode_prelude_t prelude;
+        extract_prelude(&ip, &ip2, &prelude);
+        mp_print_uint(print, ip - prelude_data);
+        mp_print_bytes(print, prelude_data, ip - prelude_data);
+        save_qstr(print, ip2[0] | (ip2[1] << 8)); // simple_name
+        save_qstr(print, ip2[2] | (ip2[3] << 8)); // source_file
+        const mp_uint_t *const_table = rc->data.u_native.const_table;
+        for (uint i = 0; i < prelude.n_pos_args + prelude.n_kwonly_args; ++i) {
+            save_qstr(print, MP_OBJ_QSTR_VALUE((mp_obj_t)const_table[i]));
+        }
+    } else {
+        mp_print_uint(print, rc->n_pos_args);
+        mp_print_uint(print, rc->data.u_native.type_sig);
+    }
+    mp_print_uint(print, rc->scope_flags);
+
+    mp_print_uint(print, rc->data.u_native.n_reloc);
+    for (size_t i = 0; i < rc->data.u_native.n_reloc; ++i) {
+        mp_print_uint(print, relocs[i].offset);
+        mp_print_bytes(print, &relocs[i].kind, 1);
+        switch (relocs[i].kind) {
+            case MP_NATIVE_RELOC_QSTR:
+            case MP_NATIVE_RELOC_QSTR_OBJ:
+                save_qstr(print, relocs[i].arg);
+                break;
+            case MP_NATIVE_RELOC_OBJ:
+                save_obj(print, (mp_obj_t)relocs[i].arg);
+                break;
+            case MP_NATIVE_RELOC_RAW_CODE:
+                save_raw_code(print, (mp_raw_code_t*)(uintptr_t)relocs[i].arg, arch);
+                break;
+            default:
+                mp_print_uint(print, relocs[i].arg);
+                break;
+        }
+    }
+}
+#endif
+
+STATIC void save_raw_code(mp_print_t *print, mp_raw_code_t *rc, int arch) {
+    if (arch != MP_NATIVE_ARCH_NONE) {
+        byte kind = rc->kind;
+        mp_print_bytes(print, &kind, 1);
+    }
+
+    #if MICROPY_EMIT_NATIVE
+    // native code can only be saved if the emitter recorded its relocations
+    if ((rc->kind == MP_CODE_NATIVE_PY || rc->kind == MP_CODE_NATIVE_VIPER)
+        && arch != MP_NATIVE_ARCH_NONE && rc->data.u_native.n_reloc != 0) {
+        save_raw_code_native(print, rc, arch);
+        return;
+    }
+    #endif
+
     if (rc->kind != MP_CODE_BYTECODE) {
         mp_raise_ValueError("can only save bytecode");
     }
@@ -352,7 +554,7 @@ STATIC void save_raw_code(mp_print_t *print, mp_raw_code_t *rc) {
         save_obj(print, (mp_obj_t)*const_table++);
     }
     for (uint i = 0; i < rc->data.u_byte.n_raw_code; ++i) {
-        save_raw_code(print, (mp_raw_code_t*)(uintptr_t)*const_table++);
+        save_raw_code(print, (mp_raw_code_t*)(uintptr_t)*const_table++, arch);
     }
 }
 
@@ -360,9 +562,15 @@ void mp_raw_code_save(mp_raw_code_t *rc, mp_print_t *print) {
     // header contains:
     //  byte  'M'
     //  byte  version
-    //  byte  feature flags
+    //  byte  feature flags, and native arch
     //  byte  number of bits in a small int
-    byte header[4] = {'M', MPY_VERSION, MPY_FEATURE_FLAGS_DYNAMIC,
+    #if MICROPY_DYNAMIC_COMPILER
+    int arch = mp_dynamic_compiler.native_arch;
+    #else
+    int arch = MP_NATIVE_ARCH_NONE;
+    #endif
+    byte header[4] = {'M', MPY_VERSION, MPY_FEATURE_FLAGS_DYNAMIC | MPY_FEATURE_ENCODE_ARCH(arch)
+        | (MICROPY_OPT_BYTECODE_SUPERINSTRUCTIONS_DYNAMIC ? MPY_FEATURE_SUPERINSTRUCTIONS : 0),
         #if MICROPY_DYNAMIC_COMPILER
         mp_dynamic_compiler.small_int_bits,
         #else
@@ -371,7 +579,7 @@ void mp_raw_code_save(mp_raw_code_t *rc, mp_print_t *print) {
     };
     mp_print_bytes(print, header, sizeof(header));
 
-    save_raw_code(print, rc);
+    save_raw_code(print, rc, arch);
 }
 
 // here we define mp_raw_code_save_file depending on the port
@@ -95,6 +95,7 @@ PY_O_BASENAME = \
 	emitnarm.o \
 	asmxtensa.o \
 	emitnxtensa.o \
+	emitnxtensawin.o \
 	emitinlinextensa.o \
 	formatfloat.o \
 	parsenumbase.o \
@@ -191,6 +192,7 @@ PY_O_BASENAME = \
 	../extmod/moduselect.o \
 	../extmod/modwebsocket.o \
 	../extmod/modframebuf.o \
+	../extmod/modvector.o \
 	../extmod/vfs.o \
 	../extmod/vfs_reader.o \
 	../extmod/utime_mphal.o \
@@ -266,6 +268,10 @@ $(PY_BUILD)/emitnxtensa.o: CFLAGS += -DN_XTENSA
 $(PY_BUILD)/emitnxtensa.o: py/emitnative.c
 	$(call compile_c)
 
+$(PY_BUILD)/emitnxtensawin.o: CFLAGS += -DN_XTENSAWIN
+$(PY_BUILD)/emitnxtensawin.o: py/emitnative.c
+	$(call compile_c)
+
 # optimising gc for speed; 5ms down to 4ms on pybv2
 $(PY_BUILD)/gc.o: CFLAGS += $(CSUPEROPT)
 
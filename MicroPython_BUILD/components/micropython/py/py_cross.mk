@@ -190,6 +190,7 @@ PY_O_BASENAME = \
 	../extmod/moduselect.o \
 	../extmod/modwebsocket.o \
 	../extmod/modframebuf.o \
+	../extmod/modvector.o \
 	../extmod/vfs.o \
 	../extmod/vfs_reader.o \
 	../extmod/utime_mphal.o \
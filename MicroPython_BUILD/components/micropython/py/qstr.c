@@ -95,11 +95,43 @@ mp_uint_t qstr_compute_hash(const byte *data, size_t len) {
     return hash;
 }
 
+#if MICROPY_QSTR_INDEX && MICROPY_PY_MICROPYTHON_MEM_INFO
+#define QSTR_INDEX_STAT_INC(x) (MP_STATE_VM(x) += 1)
+#else
+#define QSTR_INDEX_STAT_INC(x) (void)0
+#endif
+
+#if MICROPY_QSTR_INDEX
+
+// this must match index_slot in makeqstrdata.py; similar strings have similar
+// hashes so they are spread out with a multiplicative (Fibonacci) hash
+#define QSTR_INDEX_SLOT(hash, len) ((uint32_t)(((hash) ^ ((len) << 8)) * 0x9e3779b1u) >> 16)
+
+STATIC const uint16_t mp_qstr_const_index_slots[] = {
+#ifndef NO_QSTR
+#define QDEF(id, str)
+#define QINDEX(...) __VA_ARGS__,
+#include "genhdr/qstrdefs.generated.h"
+#undef QINDEX
+#undef QDEF
+#endif
+};
+
+STATIC const qstr_index_t mp_qstr_const_index = {
+    MP_ARRAY_SIZE(mp_qstr_const_index_slots) - 1,
+    mp_qstr_const_index_slots,
+};
+
+#endif
+
 const qstr_pool_t mp_qstr_const_pool = {
     NULL,               // no previous pool
     0,                  // no previous pool
     10,                 // set so that the first dynamically allocated pool is twice this size; must be <= the len (just below)
     MP_QSTRnumber_of,   // corresponds to number of strings in array just below
+    #if MICROPY_QSTR_INDEX
+    &mp_qstr_const_index,
+    #endif
     {
 #ifndef NO_QSTR
 #define QDEF(id, str) str,
@@ -120,6 +152,15 @@ void qstr_init(void) {
     MP_STATE_VM(last_pool) = (qstr_pool_t*)&CONST_POOL; // we won't modify the const_pool since it has no allocated room left
     MP_STATE_VM(qstr_last_chunk) = NULL;
 
+    #if MICROPY_QSTR_INDEX
+    MP_STATE_VM(qstr_index) = NULL;
+    MP_STATE_VM(qstr_index_mask) = 0;
+    #if MICROPY_PY_MICROPYTHON_MEM_INFO
+    MP_STATE_VM(qstr_index_n_lookup) = 0;
+    MP_STATE_VM(qstr_index_n_probe) = 0;
+    #endif
+    #endif
+
     #if MICROPY_PY_THREAD
     mp_thread_mutex_init(&MP_STATE_VM(qstr_mutex));
     #endif
@@ -135,6 +176,79 @@ STATIC const byte *find_qstr(qstr q) {
     return pool->qstrs[q - pool->total_prev_len];
 }
 
+#if MICROPY_QSTR_INDEX
+
+// Look up a string in a hash index.  If pool is given then this is the index
+// of that constant pool, otherwise it is the index of the runtime pools and
+// its slots hold the qstrs themselves.
+STATIC qstr qstr_index_find(const uint16_t *slots, size_t mask, const qstr_pool_t *pool, mp_uint_t str_hash, const char *str, size_t str_len) {
+    for (size_t i = QSTR_INDEX_SLOT(str_hash, str_len) & mask; slots[i] != 0; i = (i + 1) & mask) {
+        QSTR_INDEX_STAT_INC(qstr_index_n_probe);
+        qstr q;
+        const byte *qd;
+        if (pool != NULL) {
+            q = pool->total_prev_len + slots[i] - 1;
+            qd = pool->qstrs[slots[i] - 1];
+        } else {
+            q = slots[i];
+            qd = find_qstr(q);
+        }
+        if (Q_GET_HASH(qd) == str_hash && Q_GET_LENGTH(qd) == str_len && memcmp(Q_GET_DATA(qd), str, str_len) == 0) {
+            return q;
+        }
+    }
+    return 0;
+}
+
+STATIC void qstr_index_insert(uint16_t *slots, size_t mask, qstr q, const byte *qd) {
+    size_t i = QSTR_INDEX_SLOT(Q_GET_HASH(qd), Q_GET_LENGTH(qd)) & mask;
+    while (slots[i] != 0) {
+        i = (i + 1) & mask;
+    }
+    slots[i] = q;
+}
+
+// Add the newly interned q to the index of the runtime pools, rebuilding the
+// index at twice the size when it gets half full.  If there is no memory for
+// it then the index is dropped and these pools are searched linearly until a
+// later rebuild succeeds.  The slots are 16 bits wide, so once the qstr ids
+// outgrow them the index is dropped for good.
+// qstr_mutex must be taken while in this function
+STATIC void qstr_index_add(qstr q, const byte *q_ptr) {
+    size_t n_dyn = QSTR_TOTAL() - (CONST_POOL.total_prev_len + CONST_POOL.len);
+    uint16_t *old = MP_STATE_VM(qstr_index);
+    size_t old_len = old == NULL ? 0 : MP_STATE_VM(qstr_index_mask) + 1;
+    if (q > 0xffff) {
+        MP_STATE_VM(qstr_index) = NULL;
+        MP_STATE_VM(qstr_index_mask) = 0;
+        m_del(uint16_t, old, old_len);
+        return;
+    }
+    if (2 * n_dyn <= old_len) {
+        qstr_index_insert(old, MP_STATE_VM(qstr_index_mask), q, q_ptr);
+        return;
+    }
+
+    size_t len = 32;
+    while (len < 2 * n_dyn) {
+        len *= 2;
+    }
+    uint16_t *slots = m_new_maybe(uint16_t, len);
+    if (slots != NULL) {
+        memset(slots, 0, len * sizeof(uint16_t));
+        for (qstr_pool_t *pool = MP_STATE_VM(last_pool); pool != &CONST_POOL; pool = pool->prev) {
+            for (size_t i = 0; i < pool->len; i++) {
+                qstr_index_insert(slots, len - 1, pool->total_prev_len + i, pool->qstrs[i]);
+            }
+        }
+    }
+    MP_STATE_VM(qstr_index) = slots;
+    MP_STATE_VM(qstr_index_mask) = slots == NULL ? 0 : len - 1;
+    m_del(uint16_t, old, old_len);
+}
+
+#endif // MICROPY_QSTR_INDEX
+
 // qstr_mutex must be taken while in this function
 STATIC qstr qstr_add(const byte *q_ptr) {
     DEBUG_printf("QSTR: add hash=%d len=%d data=%.*s\n", Q_GET_HASH(q_ptr), Q_GET_LENGTH(q_ptr), Q_GET_LENGTH(q_ptr), Q_GET_DATA(q_ptr));
@@ -150,6 +264,9 @@ STATIC qstr qstr_add(const byte *q_ptr) {
         pool->total_prev_len = MP_STATE_VM(last_pool)->total_prev_len + MP_STATE_VM(last_pool)->len;
         pool->alloc = MP_STATE_VM(last_pool)->alloc * 2;
         pool->len = 0;
+        #if MICROPY_QSTR_INDEX
+        pool->index = NULL;
+        #endif
         MP_STATE_VM(last_pool) = pool;
         DEBUG_printf("QSTR: allocate new pool of size %d\n", MP_STATE_VM(last_pool)->alloc);
     }
@@ -158,16 +275,48 @@ STATIC qstr qstr_add(const byte *q_ptr) {
     MP_STATE_VM(last_pool)->qstrs[MP_STATE_VM(last_pool)->len++] = q_ptr;
 
     // return id for the newly-added qstr
-    return MP_STATE_VM(last_pool)->total_prev_len + MP_STATE_VM(last_pool)->len - 1;
+    qstr q = MP_STATE_VM(last_pool)->total_prev_len + MP_STATE_VM(last_pool)->len - 1;
+
+    #if MICROPY_QSTR_INDEX
+    qstr_index_add(q, q_ptr);
+    #endif
+
+    return q;
 }
 
 qstr qstr_find_strn(const char *str, size_t str_len) {
     // work out hash of str
     mp_uint_t str_hash = qstr_compute_hash((const byte*)str, str_len);
 
+    qstr_pool_t *pool = MP_STATE_VM(last_pool);
+
+    #if MICROPY_QSTR_INDEX
+    QSTR_INDEX_STAT_INC(qstr_index_n_lookup);
+    if (MP_STATE_VM(qstr_index) != NULL) {
+        // the runtime pools are all covered by their index
+        qstr q = qstr_index_find(MP_STATE_VM(qstr_index), MP_STATE_VM(qstr_index_mask), NULL, str_hash, str, str_len);
+        if (q != 0) {
+            return q;
+        }
+        while (pool != &CONST_POOL) {
+            pool = pool->prev;
+        }
+    }
+    #endif
+
     // search pools for the data
-    for (qstr_pool_t *pool = MP_STATE_VM(last_pool); pool != NULL; pool = pool->prev) {
+    for (; pool != NULL; pool = pool->prev) {
+        #if MICROPY_QSTR_INDEX
+        if (pool->index != NULL) {
+            qstr q = qstr_index_find(pool->index->slots, pool->index->mask, pool, str_hash, str, str_len);
+            if (q != 0) {
+                return q;
+            }
+            continue;
+        }
+        #endif
         for (const byte **q = pool->qstrs, **q_top = pool->qstrs + pool->len; q < q_top; q++) {
+            QSTR_INDEX_STAT_INC(qstr_index_n_probe);
             if (Q_GET_HASH(*q) == str_hash && Q_GET_LENGTH(*q) == str_len && memcmp(Q_GET_DATA(*q), str, str_len) == 0) {
                 return pool->total_prev_len + (q - pool->qstrs);
             }
@@ -283,6 +432,24 @@ void qstr_pool_info(size_t *n_pool, size_t *n_qstr, size_t *n_str_data_bytes, si
     QSTR_EXIT();
 }
 
+#if MICROPY_QSTR_INDEX
+void qstr_index_info(size_t *n_lookup, size_t *n_probe, size_t *n_index_bytes) {
+    QSTR_ENTER();
+    #if MICROPY_PY_MICROPYTHON_MEM_INFO
+    *n_lookup = MP_STATE_VM(qstr_index_n_lookup);
+    *n_probe = MP_STATE_VM(qstr_index_n_probe);
+    #else
+    *n_lookup = 0;
+    *n_probe = 0;
+    #endif
+    *n_index_bytes = 0;
+    if (MP_STATE_VM(qstr_index) != NULL) {
+        *n_index_bytes = (MP_STATE_VM(qstr_index_mask) + 1) * sizeof(uint16_t);
+    }
+    QSTR_EXIT();
+}
+#endif
+
 #if MICROPY_PY_MICROPYTHON_MEM_INFO
 void qstr_dump_data(void) {
     QSTR_ENTER();
@@ -47,11 +47,23 @@ enum {
 
 typedef size_t qstr;
 
+#if MICROPY_QSTR_INDEX
+// Hash index of a constant qstr pool, generated at build time.  Each slot
+// holds 1 + the position of a qstr in the pool, or 0 if it is empty.
+typedef struct _qstr_index_t {
+    size_t mask;
+    const uint16_t *slots;
+} qstr_index_t;
+#endif
+
 typedef struct _qstr_pool_t {
     struct _qstr_pool_t *prev;
     size_t total_prev_len;
     size_t alloc;
     size_t len;
+    #if MICROPY_QSTR_INDEX
+    const qstr_index_t *index; // NULL for pools allocated on the heap
+    #endif
     const byte *qstrs[];
 } qstr_pool_t;
 
@@ -72,6 +84,9 @@ size_t qstr_len(qstr q);
 const byte *qstr_data(qstr q, size_t *len);
 
 void qstr_pool_info(size_t *n_pool, size_t *n_qstr, size_t *n_str_data_bytes, size_t *n_total_bytes);
+#if MICROPY_QSTR_INDEX
+void qstr_index_info(size_t *n_lookup, size_t *n_probe, size_t *n_index_bytes);
+#endif
 void qstr_dump_data(void);
 
 #endif // MICROPY_INCLUDED_PY_QSTR_H
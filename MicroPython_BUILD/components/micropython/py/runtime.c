@@ -40,6 +40,7 @@
 #include "py/builtin.h"
 #include "py/stackctrl.h"
 #include "py/gc.h"
+#include "py/frozenmod.h"
 
 #if MICROPY_DEBUG_VERBOSE // print debugging info
 #define DEBUG_PRINT (1)
@@ -50,9 +51,14 @@
 #define DEBUG_OP_printf(...) (void)0
 #endif
 
+// The main interpreter's __main__, worker interpreters register their own
 const mp_obj_module_t mp_module___main__ = {
     .base = { &mp_type_module },
+    #if MICROPY_PY_THREAD_WORKERS
+    .globals = (mp_obj_dict_t*)&mp_state_ctx.vm.dict_main,
+    #else
     .globals = (mp_obj_dict_t*)&MP_STATE_VM(dict_main),
+    #endif
 };
 
 void mp_init(void) {
@@ -91,6 +97,13 @@ void mp_init(void) {
     // init global module dict
     mp_obj_dict_init(&MP_STATE_VM(mp_loaded_modules_dict), 3);
 
+    #if MICROPY_MODULE_FROZEN_MPY_ROM_GLOBALS
+    // no frozen module has been imported yet
+    if (MP_STATE_IS_MAIN()) {
+        mp_frozen_mpy_globals_reset();
+    }
+    #endif
+
     // initialise the __main__ module
     mp_obj_dict_init(&MP_STATE_VM(dict_main), 1);
     mp_obj_dict_store(MP_OBJ_FROM_PTR(&MP_STATE_VM(dict_main)), MP_OBJ_NEW_QSTR(MP_QSTR___name__), MP_OBJ_NEW_QSTR(MP_QSTR___main__));
@@ -111,6 +124,15 @@ void mp_init(void) {
     MP_STATE_VM(dupterm_arr_obj) = MP_OBJ_NULL;
     #endif
 
+    #if MICROPY_PY_STRUCT && MICROPY_PY_STRUCT_CACHE_SIZE
+    // start with no compiled ustruct formats
+    memset(MP_STATE_VM(struct_cache), 0, sizeof(MP_STATE_VM(struct_cache)));
+    #endif
+
+    #if MICROPY_PY_URE && MICROPY_PY_URE_CACHE_SIZE
+    memset(MP_STATE_VM(ure_cache), 0, sizeof(MP_STATE_VM(ure_cache)));
+    #endif
+
     #if MICROPY_FSUSERMOUNT
     // zero out the pointers to the user-mounted devices
     memset(MP_STATE_VM(fs_user_mount), 0, sizeof(MP_STATE_VM(fs_user_mount)));
@@ -124,6 +146,11 @@ void mp_init(void) {
 
     #if MICROPY_PY_THREAD_GIL
     mp_thread_mutex_init(&MP_STATE_VM(gil_mutex));
+    #if MICROPY_PY_THREAD_GIL_ADAPTIVE
+    MP_STATE_VM(gil_waiting) = 0;
+    MP_STATE_VM(gil_handoffs) = 0;
+    MP_STATE_VM(gil_switch_us) = MICROPY_PY_THREAD_GIL_SWITCH_US;
+    #endif
     #endif
 
     MP_THREAD_GIL_ENTER();
@@ -191,6 +191,7 @@ typedef enum {
     MP_F_SETUP_CODE_STATE,
     MP_F_SMALL_INT_FLOOR_DIVIDE,
     MP_F_SMALL_INT_MODULO,
+    MP_F_SETJMP, // entry is NULL if not using setjmp, but always present so the indices don't depend on it
     MP_F_NUMBER_OF,
 } mp_fun_kind_t;
 
@@ -34,6 +34,7 @@
 #include "py/emitglue.h"
 #include "py/objtype.h"
 #include "py/runtime.h"
+#include "py/smallint.h"
 #include "py/bc0.h"
 #include "py/bc.h"
 
@@ -87,6 +88,23 @@
 
 #endif
 
+#if MICROPY_OPT_BYTECODE_SUPERINSTRUCTIONS
+// LOAD_FAST_ATTR and LOAD_FAST_METHOD share the code of LOAD_ATTR and
+// LOAD_METHOD, after first pushing the local whose number follows the qstr
+#define DECODE_QSTR_LOAD_FAST(fused_op) \
+    byte opcode = ip[-1]; \
+    DECODE_QSTR; \
+    if (opcode == (fused_op)) { \
+        obj_shared = fastn[-(mp_int_t)*ip++]; \
+        if (obj_shared == MP_OBJ_NULL) { \
+            goto local_name_error; \
+        } \
+        PUSH(obj_shared); \
+    }
+#else
+#define DECODE_QSTR_LOAD_FAST(fused_op) DECODE_QSTR
+#endif
+
 #define PUSH(val) *++sp = (val)
 #define POP() (*sp--)
 #define TOP() (*sp)
@@ -112,6 +130,164 @@
     exc_sp--; /* pop back to previous exception handler */ \
     CLEAR_SYS_EXC_INFO() /* just clear sys.exc_info(), not compliant, but it shouldn't be used in 1st place */
 
+#if MICROPY_OPT_VM_BINARY_OP_FAST_PATH && MICROPY_PY_BUILTINS_FLOAT \
+    && MICROPY_OBJ_REPR != MICROPY_OBJ_REPR_C && MICROPY_OBJ_REPR != MICROPY_OBJ_REPR_D
+#define VM_FLOAT_TEMP_REUSE (MICROPY_OPT_VM_FLOAT_TEMP_REUSE)
+#else
+#define VM_FLOAT_TEMP_REUSE (0)
+#endif
+
+#if MICROPY_OPT_BYTECODE_SUPERINSTRUCTIONS || MICROPY_OPT_VM_BINARY_OP_FAST_PATH
+// Fast path of the VM for a binary op on two small ints.
+// Returns MP_OBJ_NULL if the op is not handled here, if it raises or if the
+// result doesn't fit in a small int, in which case mp_binary_op must be used.
+STATIC inline mp_obj_t vm_small_int_binary_op(mp_binary_op_t op, mp_int_t lhs, mp_int_t rhs) {
+    switch (op) {
+        case MP_BINARY_OP_LESS: return mp_obj_new_bool(lhs < rhs);
+        case MP_BINARY_OP_MORE: return mp_obj_new_bool(lhs > rhs);
+        case MP_BINARY_OP_EQUAL:
+        case MP_BINARY_OP_IS: return mp_obj_new_bool(lhs == rhs);
+        case MP_BINARY_OP_LESS_EQUAL: return mp_obj_new_bool(lhs <= rhs);
+        case MP_BINARY_OP_MORE_EQUAL: return mp_obj_new_bool(lhs >= rhs);
+        case MP_BINARY_OP_NOT_EQUAL: return mp_obj_new_bool(lhs != rhs);
+        case MP_BINARY_OP_OR:
+        case MP_BINARY_OP_INPLACE_OR: return MP_OBJ_NEW_SMALL_INT(lhs | rhs);
+        case MP_BINARY_OP_XOR:
+        case MP_BINARY_OP_INPLACE_XOR: return MP_OBJ_NEW_SMALL_INT(lhs ^ rhs);
+        case MP_BINARY_OP_AND:
+        case MP_BINARY_OP_INPLACE_AND: return MP_OBJ_NEW_SMALL_INT(lhs & rhs);
+        case MP_BINARY_OP_ADD:
+        case MP_BINARY_OP_INPLACE_ADD: lhs += rhs; break;
+        case MP_BINARY_OP_SUBTRACT:
+        case MP_BINARY_OP_INPLACE_SUBTRACT: lhs -= rhs; break;
+        case MP_BINARY_OP_MULTIPLY:
+        case MP_BINARY_OP_INPLACE_MULTIPLY:
+            if (mp_small_int_mul_overflow(lhs, rhs)) {
+                return MP_OBJ_NULL;
+            }
+            return MP_OBJ_NEW_SMALL_INT(lhs * rhs);
+        case MP_BINARY_OP_FLOOR_DIVIDE:
+        case MP_BINARY_OP_INPLACE_FLOOR_DIVIDE:
+            if (rhs == 0) {
+                return MP_OBJ_NULL;
+            }
+            lhs = mp_small_int_floor_divide(lhs, rhs);
+            break;
+        case MP_BINARY_OP_MODULO:
+        case MP_BINARY_OP_INPLACE_MODULO:
+            if (rhs == 0) {
+                return MP_OBJ_NULL;
+            }
+            return MP_OBJ_NEW_SMALL_INT(mp_small_int_modulo(lhs, rhs));
+        case MP_BINARY_OP_RSHIFT:
+        case MP_BINARY_OP_INPLACE_RSHIFT:
+            if (rhs < 0 || rhs >= (mp_int_t)BITS_PER_WORD) {
+                return MP_OBJ_NULL;
+            }
+            return MP_OBJ_NEW_SMALL_INT(lhs >> rhs);
+        default: return MP_OBJ_NULL;
+    }
+    // the sum, difference or floor quotient of two small ints can't overflow
+    // a machine word
+    if (MP_SMALL_INT_FITS(lhs)) {
+        return MP_OBJ_NEW_SMALL_INT(lhs);
+    }
+    return MP_OBJ_NULL;
+}
+#endif
+
+#if MICROPY_OPT_VM_BINARY_OP_FAST_PATH
+// Fast path of BINARY_OP for two small ints, or for a float and a float or
+// small int.  Returns MP_OBJ_NULL if mp_binary_op must be used.  On entry
+// *temp is MP_OBJ_NULL or a float that may be overwritten with a float result;
+// on return it is the float result if there is one, else MP_OBJ_NULL.
+STATIC inline mp_obj_t vm_binary_op_fast(mp_binary_op_t op, mp_obj_t lhs, mp_obj_t rhs, mp_obj_t *temp) {
+    if (MP_OBJ_IS_SMALL_INT(lhs) && MP_OBJ_IS_SMALL_INT(rhs)) {
+        *temp = MP_OBJ_NULL;
+        return vm_small_int_binary_op(op, MP_OBJ_SMALL_INT_VALUE(lhs), MP_OBJ_SMALL_INT_VALUE(rhs));
+    }
+    mp_obj_t res = MP_OBJ_NULL;
+    #if MICROPY_PY_BUILTINS_FLOAT
+    mp_float_t lhs_val, rhs_val;
+    if (mp_obj_is_float(lhs)) {
+        lhs_val = mp_obj_float_get(lhs);
+    } else if (MP_OBJ_IS_SMALL_INT(lhs)) {
+        lhs_val = (mp_float_t)MP_OBJ_SMALL_INT_VALUE(lhs);
+    } else {
+        goto no_float;
+    }
+    if (mp_obj_is_float(rhs)) {
+        rhs_val = mp_obj_float_get(rhs);
+    } else if (MP_OBJ_IS_SMALL_INT(rhs)) {
+        rhs_val = (mp_float_t)MP_OBJ_SMALL_INT_VALUE(rhs);
+    } else {
+        goto no_float;
+    }
+    // equality is left to mp_binary_op, which first compares the objects
+    switch (op) {
+        case MP_BINARY_OP_LESS: res = mp_obj_new_bool(lhs_val < rhs_val); goto no_float;
+        case MP_BINARY_OP_MORE: res = mp_obj_new_bool(lhs_val > rhs_val); goto no_float;
+        case MP_BINARY_OP_LESS_EQUAL: res = mp_obj_new_bool(lhs_val <= rhs_val); goto no_float;
+        case MP_BINARY_OP_MORE_EQUAL: res = mp_obj_new_bool(lhs_val >= rhs_val); goto no_float;
+        case MP_BINARY_OP_ADD:
+        case MP_BINARY_OP_INPLACE_ADD: lhs_val += rhs_val; break;
+        case MP_BINARY_OP_SUBTRACT:
+        case MP_BINARY_OP_INPLACE_SUBTRACT: lhs_val -= rhs_val; break;
+        case MP_BINARY_OP_MULTIPLY:
+        case MP_BINARY_OP_INPLACE_MULTIPLY: lhs_val *= rhs_val; break;
+        case MP_BINARY_OP_TRUE_DIVIDE:
+        case MP_BINARY_OP_INPLACE_TRUE_DIVIDE:
+            if (rhs_val == 0) {
+                goto no_float;
+            }
+            lhs_val /= rhs_val;
+            break;
+        default: goto no_float;
+    }
+    #if VM_FLOAT_TEMP_REUSE
+    if (*temp != MP_OBJ_NULL) {
+        return mp_obj_float_reuse(*temp, lhs_val);
+    }
+    #endif
+    return *temp = mp_obj_new_float(lhs_val);
+no_float:
+    #endif
+    *temp = MP_OBJ_NULL;
+    return res;
+}
+
+#if VM_FLOAT_TEMP_REUSE
+// float_temp_ip is the ip just past the last BINARY_OP that left a float it
+// had created on the stack.  If the BINARY_OP at that ip runs next, its right
+// operand is that float, referenced only by the stack, so it can be reused.
+// When that BINARY_OP goes to mp_binary_op the float may escape, so the ip is
+// forgotten; a comparison or a small int op at that ip never writes to temp.
+#define VM_BINARY_OP(op, lhs, rhs) do { \
+    mp_obj_t temp = float_temp_ip == ip - 1 ? (rhs) : MP_OBJ_NULL; \
+    mp_obj_t res = vm_binary_op_fast((op), (lhs), (rhs), &temp); \
+    if (res == MP_OBJ_NULL) { \
+        float_temp_ip = NULL; \
+        res = mp_binary_op((op), (lhs), (rhs)); \
+    } else if (temp != MP_OBJ_NULL) { \
+        float_temp_ip = ip; \
+    } \
+    SET_TOP(res); \
+} while (0)
+#else
+#define VM_BINARY_OP(op, lhs, rhs) do { \
+    mp_obj_t temp = MP_OBJ_NULL; \
+    mp_obj_t res = vm_binary_op_fast((op), (lhs), (rhs), &temp); \
+    if (res == MP_OBJ_NULL) { \
+        res = mp_binary_op((op), (lhs), (rhs)); \
+    } \
+    SET_TOP(res); \
+} while (0)
+#endif
+
+#else
+#define VM_BINARY_OP(op, lhs, rhs) SET_TOP(mp_binary_op((op), (lhs), (rhs)))
+#endif
+
 // fastn has items in reverse order (fastn[0] is local[0], fastn[-1] is local[1], etc)
 // sp points to bottom of stack which grows up
 // returns:
@@ -182,6 +358,9 @@ outer_dispatch_loop:
             const byte *ip = code_state->ip;
             mp_obj_t *sp = code_state->sp;
             mp_obj_t obj_shared;
+            #if VM_FLOAT_TEMP_REUSE
+            const byte *float_temp_ip = NULL;
+            #endif
             MICROPY_VM_HOOK_INIT
 
             // If we have exception to inject, now that we finish setting up
@@ -328,16 +507,24 @@ dispatch_loop:
                 #endif
 
                 #if !MICROPY_OPT_CACHE_MAP_LOOKUP_IN_BYTECODE
-                ENTRY(MP_BC_LOAD_ATTR): {
+                ENTRY(MP_BC_LOAD_ATTR):
+                #if MICROPY_OPT_BYTECODE_SUPERINSTRUCTIONS
+                ENTRY(MP_BC_LOAD_FAST_ATTR):
+                #endif
+                {
                     MARK_EXC_IP_SELECTIVE();
-                    DECODE_QSTR;
+                    DECODE_QSTR_LOAD_FAST(MP_BC_LOAD_FAST_ATTR);
                     SET_TOP(mp_load_attr(TOP(), qst));
                     DISPATCH();
                 }
                 #else
-                ENTRY(MP_BC_LOAD_ATTR): {
+                ENTRY(MP_BC_LOAD_ATTR):
+                #if MICROPY_OPT_BYTECODE_SUPERINSTRUCTIONS
+                ENTRY(MP_BC_LOAD_FAST_ATTR):
+                #endif
+                {
                     MARK_EXC_IP_SELECTIVE();
-                    DECODE_QSTR;
+                    DECODE_QSTR_LOAD_FAST(MP_BC_LOAD_FAST_ATTR);
                     mp_obj_t top = TOP();
                     if (mp_obj_get_type(top)->attr == mp_obj_instance_attr) {
                         mp_obj_instance_t *self = MP_OBJ_TO_PTR(top);
@@ -365,13 +552,63 @@ dispatch_loop:
                 }
                 #endif
 
-                ENTRY(MP_BC_LOAD_METHOD): {
+                #if !MICROPY_OPT_CACHE_MAP_LOOKUP_IN_BYTECODE
+                ENTRY(MP_BC_LOAD_METHOD):
+                #if MICROPY_OPT_BYTECODE_SUPERINSTRUCTIONS
+                ENTRY(MP_BC_LOAD_FAST_METHOD):
+                #endif
+                {
                     MARK_EXC_IP_SELECTIVE();
-                    DECODE_QSTR;
+                    DECODE_QSTR_LOAD_FAST(MP_BC_LOAD_FAST_METHOD);
                     mp_load_method(*sp, qst, sp);
                     sp += 1;
                     DISPATCH();
                 }
+                #else
+                // The cache byte holds the slot of the method in the locals_dict
+                // of the instance's own class.  The fast path is only taken for
+                // plain bytecode functions that are not shadowed by an instance
+                // member, which is exactly the case where mp_load_method would
+                // return the function bound to self without touching the MRO.
+                ENTRY(MP_BC_LOAD_METHOD):
+                #if MICROPY_OPT_BYTECODE_SUPERINSTRUCTIONS
+                ENTRY(MP_BC_LOAD_FAST_METHOD):
+                #endif
+                {
+                    MARK_EXC_IP_SELECTIVE();
+                    DECODE_QSTR_LOAD_FAST(MP_BC_LOAD_FAST_METHOD);
+                    mp_obj_t top = TOP();
+                    mp_obj_type_t *type = mp_obj_get_type(top);
+                    if (type->attr == mp_obj_instance_attr && type->locals_dict != NULL
+                        && qst != MP_QSTR___class__) {
+                        mp_obj_instance_t *self = MP_OBJ_TO_PTR(top);
+                        mp_map_t *locals_map = &type->locals_dict->map;
+                        mp_uint_t x = *ip;
+                        mp_obj_t key = MP_OBJ_NEW_QSTR(qst);
+                        if (x < locals_map->alloc && locals_map->table[x].key == key
+                            && MP_OBJ_IS_TYPE(locals_map->table[x].value, &mp_type_fun_bc)
+                            && mp_map_lookup(&self->members, key, MP_MAP_LOOKUP) == NULL) {
+                            sp[0] = locals_map->table[x].value;
+                            sp[1] = top;
+                            sp += 1;
+                            ip++;
+                            DISPATCH();
+                        }
+                        mp_load_method(top, qst, sp);
+                        if (sp[1] == top && MP_OBJ_IS_TYPE(sp[0], &mp_type_fun_bc)) {
+                            mp_map_elem_t *elem = mp_map_lookup(locals_map, key, MP_MAP_LOOKUP);
+                            if (elem != NULL && elem->value == sp[0]) {
+                                *(byte*)ip = elem - &locals_map->table[0];
+                            }
+                        }
+                    } else {
+                        mp_load_method(top, qst, sp);
+                    }
+                    sp += 1;
+                    ip++;
+                    DISPATCH();
+                }
+                #endif
 
                 ENTRY(MP_BC_LOAD_SUPER_METHOD): {
                     MARK_EXC_IP_SELECTIVE();
@@ -578,6 +815,31 @@ dispatch_loop:
                     DISPATCH_WITH_PEND_EXC_CHECK();
                 }
 
+                #if MICROPY_OPT_BYTECODE_SUPERINSTRUCTIONS
+                ENTRY(MP_BC_POP_JUMP_IF_TRUE_COMPARE):
+                ENTRY(MP_BC_POP_JUMP_IF_FALSE_COMPARE): {
+                    MARK_EXC_IP_SELECTIVE();
+                    bool jump_if = ip[-1] == MP_BC_POP_JUMP_IF_TRUE_COMPARE;
+                    DECODE_SLABEL;
+                    mp_binary_op_t op = *ip;
+                    mp_obj_t rhs = POP();
+                    mp_obj_t lhs = POP();
+                    mp_obj_t res = MP_OBJ_NULL;
+                    if (MP_OBJ_IS_SMALL_INT(lhs) && MP_OBJ_IS_SMALL_INT(rhs)) {
+                        res = vm_small_int_binary_op(op, MP_OBJ_SMALL_INT_VALUE(lhs), MP_OBJ_SMALL_INT_VALUE(rhs));
+                    }
+                    if (res == MP_OBJ_NULL) {
+                        res = mp_binary_op(op, lhs, rhs);
+                    }
+                    if (mp_obj_is_true(res) == jump_if) {
+                        ip += slab;
+                    } else {
+                        ip += 1;
+                    }
+                    DISPATCH_WITH_PEND_EXC_CHECK();
+                }
+                #endif
+
                 ENTRY(MP_BC_SETUP_WITH): {
                     MARK_EXC_IP_SELECTIVE();
                     // stack: (..., ctx_mgr)
@@ -1234,6 +1496,28 @@ yield:
                     mp_import_all(POP());
                     DISPATCH();
 
+                #if MICROPY_OPT_BYTECODE_SUPERINSTRUCTIONS
+                ENTRY(MP_BC_BINARY_OP_FAST_SMALL_INT): {
+                    MARK_EXC_IP_SELECTIVE();
+                    mp_obj_t lhs = fastn[-(mp_int_t)ip[0]];
+                    mp_binary_op_t op = ip[1];
+                    mp_int_t rhs = (int8_t)ip[2];
+                    ip += 3;
+                    if (lhs == MP_OBJ_NULL) {
+                        goto local_name_error;
+                    }
+                    mp_obj_t res = MP_OBJ_NULL;
+                    if (MP_OBJ_IS_SMALL_INT(lhs)) {
+                        res = vm_small_int_binary_op(op, MP_OBJ_SMALL_INT_VALUE(lhs), rhs);
+                    }
+                    if (res == MP_OBJ_NULL) {
+                        res = mp_binary_op(op, lhs, MP_OBJ_NEW_SMALL_INT(rhs));
+                    }
+                    PUSH(res);
+                    DISPATCH();
+                }
+                #endif
+
 #if MICROPY_OPT_COMPUTED_GOTO
                 ENTRY(MP_BC_LOAD_CONST_SMALL_INT_MULTI):
                     PUSH(MP_OBJ_NEW_SMALL_INT((mp_int_t)ip[-1] - MP_BC_LOAD_CONST_SMALL_INT_MULTI - 16));
@@ -1256,7 +1540,7 @@ yield:
                     MARK_EXC_IP_SELECTIVE();
                     mp_obj_t rhs = POP();
                     mp_obj_t lhs = TOP();
-                    SET_TOP(mp_binary_op(ip[-1] - MP_BC_BINARY_OP_MULTI, lhs, rhs));
+                    VM_BINARY_OP(ip[-1] - MP_BC_BINARY_OP_MULTI, lhs, rhs);
                     DISPATCH();
                 }
 
@@ -1279,7 +1563,7 @@ yield:
                     } else if (ip[-1] < MP_BC_BINARY_OP_MULTI + 36) {
                         mp_obj_t rhs = POP();
                         mp_obj_t lhs = TOP();
-                        SET_TOP(mp_binary_op(ip[-1] - MP_BC_BINARY_OP_MULTI, lhs, rhs));
+                        VM_BINARY_OP(ip[-1] - MP_BC_BINARY_OP_MULTI, lhs, rhs);
                         DISPATCH();
                     } else
 #endif
@@ -1336,8 +1620,15 @@ pending_exception_check:
                     #endif
                     {
                     mp_hal_reset_wdt();// LoBo
+                    #if MICROPY_PY_THREAD_GIL_ADAPTIVE
+                    // nothing to do unless another thread waits for the GIL
+                    if (MP_STATE_VM(gil_waiting) != 0) {
+                        mp_thread_gil_switch();
+                    }
+                    #else
                     MP_THREAD_GIL_EXIT();
                     MP_THREAD_GIL_ENTER();
+                    #endif
                     }
                 }
                 #endif
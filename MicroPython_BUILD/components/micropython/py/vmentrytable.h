@@ -106,6 +106,13 @@ static const void *const entry_table[256] = {
     [MP_BC_IMPORT_NAME] = &&entry_MP_BC_IMPORT_NAME,
     [MP_BC_IMPORT_FROM] = &&entry_MP_BC_IMPORT_FROM,
     [MP_BC_IMPORT_STAR] = &&entry_MP_BC_IMPORT_STAR,
+    #if MICROPY_OPT_BYTECODE_SUPERINSTRUCTIONS
+    [MP_BC_LOAD_FAST_ATTR] = &&entry_MP_BC_LOAD_FAST_ATTR,
+    [MP_BC_LOAD_FAST_METHOD] = &&entry_MP_BC_LOAD_FAST_METHOD,
+    [MP_BC_BINARY_OP_FAST_SMALL_INT] = &&entry_MP_BC_BINARY_OP_FAST_SMALL_INT,
+    [MP_BC_POP_JUMP_IF_TRUE_COMPARE] = &&entry_MP_BC_POP_JUMP_IF_TRUE_COMPARE,
+    [MP_BC_POP_JUMP_IF_FALSE_COMPARE] = &&entry_MP_BC_POP_JUMP_IF_FALSE_COMPARE,
+    #endif
     [MP_BC_LOAD_CONST_SMALL_INT_MULTI ... MP_BC_LOAD_CONST_SMALL_INT_MULTI + 63] = &&entry_MP_BC_LOAD_CONST_SMALL_INT_MULTI,
     [MP_BC_LOAD_FAST_MULTI ... MP_BC_LOAD_FAST_MULTI + 15] = &&entry_MP_BC_LOAD_FAST_MULTI,
     [MP_BC_STORE_FAST_MULTI ... MP_BC_STORE_FAST_MULTI + 15] = &&entry_MP_BC_STORE_FAST_MULTI,
@@ -0,0 +1,56 @@
+# the method lookup cached at a call site must follow changes to the classes
+# and instances it was looked up in
+
+class A:
+    def f(self):
+        return 'A.f'
+
+class B(A):
+    def f(self):
+        return 'B.f'
+
+class C(A):
+    pass
+
+def call(objs):
+    return [o.f() for o in objs]
+
+a, b, c = A(), B(), C()
+
+# one call site, several classes
+print(call([a, b, c, a, b, c]))
+
+# a method replaced in the class after it was cached
+print(call([a, a]))
+A.f = lambda self: 'new A.f'
+print(call([a, c, b]))
+
+# an instance member shadows the method
+a.f = lambda: 'instance f'
+print(call([a, A()]))
+del a.f
+print(call([a]))
+
+# the class dict grows and is rehashed
+for i in range(30):
+    setattr(A, 'g%d' % i, i)
+print(call([a, c]), A.g29)
+
+# the method is removed
+del B.f
+print(call([b]))
+del A.f
+try:
+    call([a])
+except AttributeError:
+    print('AttributeError')
+
+# builtin types at the same site
+class L(list):
+    def append(self, x):
+        super().append(x * 10)
+
+def app(l):
+    l.append(1)
+    return l
+print(app([]), app(L()), app([]), app(L()))
@@ -0,0 +1,45 @@
+# unhashable keys must be rejected when they are inserted, for small dicts
+# which are searched linearly as well as for larger ones
+
+try:
+    {[1]: 2}
+except TypeError:
+    print('TypeError')
+
+d = {1: 1}
+for k in ([1], {}, {1}, bytearray(b'a')):
+    try:
+        d[k] = 2
+    except TypeError:
+        print('TypeError')
+    try:
+        k in d
+    except TypeError:
+        print('TypeError')
+print(d)
+
+# grow a dict past the size where it gets a hash index, after a failed insert
+d = {}
+try:
+    d[[1]] = 1
+except TypeError:
+    print('TypeError')
+for i in range(20):
+    d[i] = i
+print(len(d), d[0], d[19])
+try:
+    d[[1]] = 1
+except TypeError:
+    print('TypeError')
+print(len(d))
+
+# the same for dict.update and dict()
+try:
+    d.update({[1]: 1})
+except TypeError:
+    print('TypeError')
+try:
+    dict([([1], 1)])
+except TypeError:
+    print('TypeError')
+print(len(d))
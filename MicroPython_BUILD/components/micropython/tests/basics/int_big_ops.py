@@ -0,0 +1,46 @@
+# test big-int multiplication, modular pow and str conversion at sizes which
+# use the Karatsuba, Montgomery and divide-and-conquer paths of mpz
+import sys
+if hasattr(sys, 'set_int_max_str_digits'):
+    sys.set_int_max_str_digits(0)
+
+# deterministic pseudo-random numbers of a given bit length
+seed = 12345
+def rand_bits(n):
+    global seed
+    x = 0
+    while n > 0:
+        seed = (seed * 1103515245 + 12345) & 0x7fffffff
+        k = min(n, 16)
+        x = (x << k) | (seed >> (31 - k))
+        n -= k
+    return x | 1
+
+P = 1000000007
+
+# products, including unbalanced ones and negative operands
+for a_bits, b_bits in ((100, 100), (600, 600), (1000, 1000), (2048, 2048), (4000, 3000), (6000, 700), (9000, 9000)):
+    a = rand_bits(a_bits)
+    b = rand_bits(b_bits)
+    for sa, sb in ((1, 1), (-1, 1), (-1, -1)):
+        p = (sa * a) * (sb * b)
+        print(a_bits, b_bits, p % P, len(hex(p)), p // (sb * b) == sa * a)
+    print((a * a) % P, a * a == a ** 2)
+
+# modular pow with odd and even moduli
+for m_bits in (64, 300, 1024, 2048):
+    m = rand_bits(m_bits)
+    for e_bits in (1, 17, 200, 1024):
+        b = rand_bits(m_bits + 5)
+        e = rand_bits(e_bits)
+        print(m_bits, e_bits, pow(b, e, m) % P, pow(b, e, m + 1) % P)
+print(pow(5, 0, 7), pow(7, 3, 1), pow(-3, 5, 1000001))
+
+# str and int conversions of big numbers
+for bits in (64, 500, 3000, 10000, 30000):
+    x = rand_bits(bits)
+    s = str(x)
+    print(bits, len(s), s[:20], s[-20:], int(s) == x, str(-x) == '-' + s)
+    h = hex(x)
+    print(len(h), int(h, 16) == x, int(s[:len(s) // 2]) % P)
+print(str(10 ** 500 - 1) == '9' * 500, str(10 ** 500) == '1' + '0' * 500)
@@ -0,0 +1,58 @@
+# test md5, sha256 and sha512 digests and HMAC against known vectors, with
+# incremental updates across block boundaries
+try:
+    import uhashlib as hashlib
+    hmac_new = hashlib.hmac
+except (ImportError, AttributeError):
+    try:
+        import hashlib, hmac
+        hmac_new = hmac.new
+    except ImportError:
+        print('SKIP')
+        raise SystemExit
+try:
+    import ubinascii as binascii
+except ImportError:
+    import binascii
+
+def hexd(h):
+    return binascii.hexlify(h.digest()).decode()
+
+algos = ('md5', 'sha256', 'sha512')
+msgs = (b'', b'abc', b'a' * 55, b'a' * 56, b'a' * 64, b'a' * 111, b'a' * 112, b'a' * 128,
+    b'abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq')
+
+# one-shot and incremental digests, split at every few bytes
+data = bytes(range(256)) * 3
+for name in algos:
+    cls = getattr(hashlib, name)
+    for m in msgs:
+        print(name, len(m), hexd(cls(m)))
+    for step in (1, 7, 64, 127):
+        h = cls()
+        for i in range(0, len(data), step):
+            h.update(data[i:i + step])
+        print(name, step, hexd(h) == hexd(cls(data)))
+    print(name, hexd(cls(data)))
+
+# RFC 2202 (HMAC-MD5) and RFC 4231 (HMAC-SHA-256/512) test cases 1, 2, 6
+vectors = (
+    (b'\x0b' * 16, b'Hi There'),
+    (b'Jefe', b'what do ya want for nothing?'),
+    (b'\xaa' * 131, b'Test Using Larger Than Block-Size Key - Hash Key First'),
+)
+for name in algos:
+    for key, msg in vectors:
+        print(name, hexd(hmac_new(key, msg, name)))
+        h = hmac_new(key, digestmod=getattr(hashlib, name))
+        for i in range(0, len(msg), 5):
+            h.update(msg[i:i + 5])
+        print(name, hexd(h) == hexd(hmac_new(key, msg, name)))
+
+# unknown digests
+for d in ('sha3', 'nonexistent_digest_name'):
+    try:
+        hmac_new(b'key', b'msg', d)
+        print('no error')
+    except ValueError:
+        print('ValueError')
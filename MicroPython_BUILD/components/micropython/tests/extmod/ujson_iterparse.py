@@ -0,0 +1,50 @@
+# test ujson.iterparse events, including documents larger than the read buffer
+try:
+    import ujson
+    ujson.iterparse
+except (ImportError, AttributeError):
+    print('SKIP')
+    raise SystemExit
+try:
+    import uio as io
+except ImportError:
+    import io
+
+def events(s):
+    return list(ujson.iterparse(io.StringIO(s)))
+
+for ev in events('{"a": [1, 2.5, "x"], "b": {"c": null}, "d": true}'):
+    print(ev)
+print(events('42'))
+print(events('[]'))
+print(events('{}'))
+print(events('[[], {}, [[]]]'))
+
+# rebuild a large document from its events and check it against ujson.load
+doc = '[' + ', '.join('{"id": %d, "name": "%s", "v": [%d, false]}' % (i, 'n' * (i % 50), -i) for i in range(200)) + ']'
+stack = [[]]
+keys = [None]
+for ev, val in ujson.iterparse(io.StringIO(doc)):
+    if ev == 'map_key':
+        keys[-1] = val
+        continue
+    if ev == 'start_map' or ev == 'start_array':
+        stack.append({} if ev == 'start_map' else [])
+        keys.append(None)
+        continue
+    if ev == 'end_map' or ev == 'end_array':
+        val = stack.pop()
+        keys.pop()
+    if isinstance(stack[-1], list):
+        stack[-1].append(val)
+    else:
+        stack[-1][keys[-1]] = val
+print(stack[0][0] == ujson.loads(doc))
+
+# malformed documents raise ValueError when the bad token is reached
+for s in ('[1, 2', '{"a": 1]', '[1}', '{1: 2}', '{"a" 1 2}', ']'):
+    try:
+        events(s)
+        print('no error', s)
+    except ValueError:
+        print('ValueError', s)
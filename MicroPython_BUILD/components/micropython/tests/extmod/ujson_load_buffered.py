@@ -0,0 +1,58 @@
+# test ujson.load and loads on documents whose strings and numbers straddle
+# the blocks the decoder reads, with escapes, deep nesting and number forms
+try:
+    import ujson as json
+except ImportError:
+    try:
+        import json
+    except ImportError:
+        print('SKIP')
+        raise SystemExit
+try:
+    import uio as io
+except ImportError:
+    import io
+
+# summarise a decoded value by its code points, so that the output does not
+# depend on how repr() escapes non-ASCII characters
+def digest(o):
+    if isinstance(o, str):
+        return sum(ord(c) * (i + 1) for i, c in enumerate(o)) + len(o)
+    if isinstance(o, list):
+        return sum(digest(x) * (i + 1) for i, x in enumerate(o)) + 1
+    if isinstance(o, dict):
+        return sum(digest(k) * digest(v) for k, v in o.items()) + 2
+    return int(o * 1000) if isinstance(o, float) else o
+
+def check(s):
+    a = json.loads(s)
+    b = json.load(io.StringIO(s))
+    print(a == b, digest(a))
+
+# strings and numbers at every offset around the block boundaries
+for pad in range(0, 40, 3):
+    check('[' + '"' + 'x' * pad + '", ' * 1 + '"' + 'abc\\n\\u00e9\\"' * 30 + '", 123456789, -1234567890, 1.5e+5]')
+    check('{"' + 'k' * pad + '": [' + ', '.join(str(i * 7919) for i in range(60)) + ']}')
+
+# escapes of every kind
+check('"\\b\\f\\n\\r\\t\\/\\\\\\"\\u0041\\u00e9\\u20ac"')
+
+# numbers
+check('[0, -0, 1, 999999999, 1000000000, -999999999, 12345678901234567890, 1e5, 1E+5, 1e-5, -2.5e3, 0.125]')
+
+# nested deeper than the decoder's fixed stack
+check('[' * 40 + '1' + ']' * 40)
+check('{"a":' * 30 + '{}' + '}' * 30)
+
+# records with repeated keys
+doc = '[' + ', '.join('{"id": %d, "name": "item %d", "tags": ["a", "b"], "ok": true, "none": null}' % (i, i) for i in range(100)) + ']'
+a = json.loads(doc)
+print(len(a), a[0], a[99]['name'], a == json.load(io.StringIO(doc)))
+
+# malformed documents
+for s in ('"abc', '[1,]x', 'tru', '', '{[]: 1}', ']', '"\\u12"'):
+    try:
+        json.loads(s)
+        print('no error', s)
+    except ValueError:
+        print('ValueError')
@@ -0,0 +1,65 @@
+# test compiled struct formats: the Struct type, iter_unpack, unpack_from and
+# the format cache of the module-level functions
+try:
+    import ustruct as struct
+except ImportError:
+    try:
+        import struct
+    except ImportError:
+        print('SKIP')
+        raise SystemExit
+try:
+    struct.Struct
+    struct.iter_unpack
+except AttributeError:
+    print('SKIP')
+    raise SystemExit
+
+fmts = ('<bBhHiIqQ', '>hhlL', '!3sH', '<2i4s', '>5B', '<d', '>fhf', '<10s', '>I2Q')
+vals = (
+    (-1, 255, -300, 60000, -70000, 4000000000, -2 ** 40, 2 ** 63),
+    (1, -1, -2 ** 31, 2 ** 32 - 1),
+    (b'abc', 513),
+    (7, -7, b'wxyz'),
+    (1, 2, 3, 4, 5),
+    (1.5,),
+    (0.25, -2, 8.0),
+    (b'0123456789',),
+    (65537, 1, 2 ** 64 - 1),
+)
+
+for fmt, v in zip(fmts, vals):
+    s = struct.Struct(fmt)
+    b = s.pack(*v)
+    print(fmt, s.size, s.format == fmt, struct.calcsize(fmt), b)
+    print(s.unpack(b), struct.unpack(fmt, b) == s.unpack(b), struct.pack(fmt, *v) == b)
+
+    # unpack_from and pack_into at an offset
+    buf = bytearray(s.size + 6)
+    s.pack_into(buf, 3, *v)
+    print(s.unpack_from(buf, 3) == v, struct.unpack_from(fmt, buf, 3) == v)
+
+    # iter_unpack over a run of records
+    rec = b * 3
+    print([x == v for x in s.iter_unpack(rec)], list(struct.iter_unpack(fmt, rec)) == [v] * 3)
+
+# cycle through more formats than the cache holds, with format strings built
+# at runtime so that they are not interned
+for i in range(3):
+    for n in range(1, 20):
+        fmt = '<' + 'H' * n
+        v = tuple(range(n))
+        assert struct.unpack(fmt, struct.pack(fmt, *v)) == v
+        assert struct.calcsize(fmt) == 2 * n
+print('cache ok')
+
+# buffers of the wrong size (CPython raises struct.error, which is not a
+# ValueError, so only check that something is raised)
+for f in (lambda: struct.Struct('<i').unpack(b'abc'),
+          lambda: list(struct.iter_unpack('<i', b'abcde')),
+          lambda: struct.Struct('<h').unpack_from(b'\x01\x02', 1)):
+    try:
+        f()
+        print('no error')
+    except Exception:
+        print('error')
@@ -0,0 +1,72 @@
+# compress data with several window sizes and levels, in one go and fed
+# incrementally, and decompress it again; the expected output is that of
+# CPython's zlib
+try:
+    import zlib
+except ImportError:
+    try:
+        import uzlib as zlib
+    except ImportError:
+        print('SKIP')
+        raise SystemExit
+if not hasattr(zlib, 'compressobj'):
+    print('SKIP')
+    raise SystemExit
+try:
+    import io
+except ImportError:
+    import uio as io
+try:
+    import binascii
+except ImportError:
+    import ubinascii as binascii
+
+# decompress with reads (or feeds) of n bytes at a time
+if hasattr(zlib, 'DecompIO'):
+    def decompress_incr(data, wbits, n):
+        d = zlib.DecompIO(io.BytesIO(data), wbits)
+        out = b''
+        while True:
+            b = d.read(n)
+            if not b:
+                return out
+            out += b
+else:
+    def decompress_incr(data, wbits, n):
+        d = zlib.decompressobj(wbits)
+        out = b''
+        for i in range(0, len(data), n):
+            out += d.decompress(data[i:i + n])
+        return out + d.flush()
+
+def compress_incr(data, level, wbits, n):
+    c = zlib.compressobj(level=level, wbits=wbits)
+    out = b''
+    for i in range(0, len(data), n):
+        out += c.compress(data[i:i + n])
+    return out + c.flush()
+
+# text with repeats at distances beyond the smaller windows, then bytes
+# with no repeats
+text = b''.join(b'line %d of the test data, ' % (i % 50) for i in range(400))
+seed = 1
+noise = bytearray(2000)
+for i in range(len(noise)):
+    seed = (seed * 1103515245 + 12345) & 0x7fffffff
+    noise[i] = seed >> 16 & 0xff
+data = text + bytes(noise) + text[:3000]
+print(len(data), hex(binascii.crc32(data)))
+
+for wbits in (9, 10, 12, 15, -9, -12, 25, 28):
+    for level in (1, 6, 9):
+        c = zlib.compress(data, level=level, wbits=wbits)
+        print(wbits, level, decompress_incr(c, wbits, 4096) == data)
+
+for wbits in (9, 12, -10, 26):
+    for n in (1, 7, 512, 5000):
+        c = compress_incr(data, 6, wbits, n)
+        print(wbits, n, decompress_incr(c, wbits, n) == data)
+
+# short and empty inputs
+for d in (b'', b'a', b'ab' * 3):
+    print(zlib.decompress(zlib.compress(d)) == d, decompress_incr(compress_incr(d, 6, 9, 1), 9, 1) == d)
@@ -0,0 +1,105 @@
+# decompress deflate streams made of each kind of block: stored, fixed
+# Huffman, dynamic Huffman, dynamic with codes longer than the lookup table
+# bits, and matches across the whole 32k window; the expected data is
+# generated here, the same way as it was before being compressed by CPython
+try:
+    import zlib
+except ImportError:
+    import uzlib as zlib
+try:
+    import binascii
+except ImportError:
+    import ubinascii as binascii
+
+seed = 1
+def rnd():
+    global seed
+    seed = (seed * 1103515245 + 12345) & 0x7fffffff
+    return seed >> 16
+
+def text():
+    words = [b'alpha', b'beta', b'gamma', b'delta', b'epsilon', b'zeta', b'eta', b'theta']
+    return b' '.join(words[rnd() % 8] for _ in range(250))
+
+def skewed():
+    # byte i occurs fib(i) times, which gives Huffman codes up to 15 bits
+    a, b = 1, 1
+    out = []
+    for i in range(16):
+        out += [i] * a
+        a, b = b, a + b
+    for i in range(len(out) - 1, 0, -1):
+        j = rnd() % (i + 1)
+        out[i], out[j] = out[j], out[i]
+    return bytes(out)
+
+def far():
+    blk = bytes(rnd() & 0xff for _ in range(200))
+    return blk + bytes(30000) + blk
+
+plain = {
+    'stored': lambda: text()[:300],
+    'fixed': text,
+    'dynamic': text,
+    'huffman_only': skewed,
+    'far': far,
+}
+
+cases = (
+    ('stored', (
+        b'eAEBLAHT/mV0YSBldGEgYmV0YSBkZWx0YSBkZWx0YSBkZWx0YSBnYW1tYSBkZWx0YSBlcHNp'
+        b'bG9uIGV0YSB6ZXRhIHRoZXRhIGVwc2lsb24gZXBzaWxvbiBiZXRhIHRoZXRhIGJldGEgdGhl'
+        b'dGEgYmV0YSBldGEgZXRhIGdhbW1hIHRoZXRhIHRoZXRhIHRoZXRhIGV0YSB0aGV0YSBiZXRh'
+        b'IGdhbW1hIGFscGhhIGVwc2lsb24gYmV0YSBnYW1tYSBldGEgZGVsdGEgZGVsdGEgZ2FtbWEg'
+        b'emV0YSBiZXRhIGFscGhhIGVwc2lsb24gZXBzaWxvbiB6ZXRhIHRoZXRhIHRoZXRhIGV0YSB6'
+        b'ZXRhIGRlbHRhIGdhbW1hIGdhbW1hIGJldGEgYWxwaGEgZXBzaeZ3bME='
+    )),
+    ('fixed', (
+        b'eAFLLUlUSAXiJBCRkpqDRqYn5ubC2KkFxZk5+Xlg5VUgoiQjFVkYSichpNCZMAwxFSKBTKIp'
+        b'hyhLzCnISEQ1HSKB7mKIaBVcO6pGGF2FzdKqVDRTICQWY5AVYXFyErrpCDsQVkBMrIJbjGoa'
+        b'lIcU2MihnATXhWo6klMhJMQqJKch2YrETEI2HKIHyU3I7k1CF0YKb4RbkATRYwnDmCR0zyFH'
+        b'eBKmBNzrSah2ooUC3EXY0g+S/2FCqMkYKSNgswvJcUhhixzY6HrRYxtBICdeuKMxEw1aOkYN'
+        b'PmQzsCRXZCchBweSN3AkFOToRHIikkakQECK7yp0I1DiBrUkQQ5S1MBGKXfQUjZGxKOXS9ji'
+        b'HTkJYvgYNZnhCi20lI5ZkEBNwWYxqr/hyRkAC7v70g=='
+    )),
+    ('dynamic', (
+        b'eNp1VNEOgzAI/JX9WsnIXKKbyXzi6zeHtseBD2Jt4Tg4rG7tpr9HdnPXmeyjLcu51vXznN+v'
+        b'v7vtZpsUt4+3jCNeno+j+gFacne3Nq9Ti+h+oCVX6+Ex8HxbldSUUNwWMOhUUBZGHzlGCke0'
+        b'njiiHV/QbOyy9KiIDlTdeiqgBllhKQjuMcAJ+QpvQ78HF9hklRKMcHEouOSDXrrEnNQFi52M'
+        b'+lmWNI4x/AhVLiAHvcVmcyyrbTRw4J9lLeY4tg8x5Ko21AtnJHEHBJQTKEIgNMFIeoTQfMNE'
+        b'dmka+d6hyU7C871U6Y4jmCqOY3bVLZp0u+JRJY5193H+Agu7+9I='
+    )),
+    ('huffman_only', (
+        b'eAEFwQFi20AMA8E2saU7Etj9/28zs2BVjaglhN4j9RZxYgUvF0OiVpW361CoH3xdW8cTWTkV'
+        b'E8AWBMU1GdBRtbRgWmukampU8QA7pSK7X12sdq6zquMqxlZFLESbX1Fli5Ct9IKiol8JLHpE'
+        b'iaJA9NWttZGhovC2StIkLqRFZ6kyjRegiFHtRTIwsFgP3vEh1UZt56uS0hqMFvVlC1ZVJkra'
+        b'4CkWqddFxeKxJUEzp0rF+EGKtJpW0SJQV3u1gsHZovKfKwugodECWmOPoqKCmdpgiE4DT5R+'
+        b'oR2XCytHK6pYNaAJSlcbbbzZBYOqlUYVQ+1PmO1OseLKk0ZVV7Uoqwa4CjR2Xa0wqix6KFEZ'
+        b'SpHKyq8gugXVi0ocRRV1FyjtISZUIh5bVeNEvZRZLa4ldqvOjtE35UbPqgUZabW1BqmD6kD0'
+        b'UoATxCig1SArVs6CKz6AjUJadKpU7FXLrnSUACokHtQqUWjHuj5KfMAFqIXVYjyikbGwbVxf'
+        b'GtYIxrv6Yh20PUpTq2tj1KjsvqGzl2PHqlSxC9c1ogS8VaiwYCkinUG6ZezqOKDROBWdrdq6'
+        b'FbLFNmSUqLor8ZWsqtSaqEEP0Y3q+C5KijfotriAxrrEboW2GVDTxV/Uvq1VReXaRlEHhI06'
+        b'PM06zLDWiguoVqdgei0QVNaKXq2iIoBQLYgSrQIAdp3aVJGa6Ptj1NeuShUc3KBIRkDURndw'
+        b'rGusVfFbYIGGMjWgVLSLqbL35sP6am07j4tU1axGrzZPt+MgqXAoNbnWqwV1oeLVLpq+262g'
+        b'sIiC3BwBrwooaZzaHIxzYhBsTC0EU9JuIa6KqtZ6oGoTrWz1DSTIC6kKejlTpdSzGOWJqoDq'
+        b'2HCxti2uPrhI3rRGtoqYieq2XuVGK0YGb0Tt1LWp9daQmMUrKhbTqkIHrEZpBaeFWgtg1a0J'
+        b'beTfVZuoC6Lo9xrEGKu0qsixroakmjhgrVe6eguu1YqzRa7Gtdp4gVKzVMW6ba0pflhUJGLV'
+        b'YhyrJbS+tZXKcmMjIwdlr1JRIiFhdCW2S6XV2sJSn4raVNZWNKvbUDWAKAEsW1DaoOhSkOCJ'
+        b'WgdQLA+oHVab4O1lMm5W+5VjFxBVddV6pxhQX7LtuihthgLqguu2TqlihS+6cVzlfESriEM1'
+        b'V8MfIFSHFw=='
+    )),
+    ('far', (
+        b'eNrt3U0rwwEAwOFNWe2wllYU5uXg4LRmNWFIykviMDMWIWFKq01LZK0c2C72J6mtyEtZa6Sm'
+        b'nMRE20pcSDELMzns4CI72IEv4aTf80WeqHN+siP7mjVkTp4dxUmXOKx+Mk7JW83jLlPQrTOl'
+        b'jYq5m4Xte52hR1V9MNYfz5n1XqUKpz1DDz6htFH70TzTKfs+9cffFj2JSkvXjzFpLcsKob7c'
+        b'5Yg00X0drGvz6W/1G5LN9NG5ROFtPxSX7Fe51ev6ljWbVujN1Cjzv932L6+jYKDp2GLzyK2m'
+        b'mLhIpalfOVPuymR7miXnoNDwPmH314YuVvMCo7HHy5fh5GdYKjLvpCq2ytWuu5FIQAQAAAAA'
+        b'AAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAfyT6T97XX3/4wes='
+    )),
+)
+
+for name, b64 in cases:
+    seed = 1
+    expected = plain[name]()
+    out = zlib.decompress(binascii.a2b_base64(b64))
+    print(name, len(out), out == expected)
@@ -0,0 +1,46 @@
+# decompress a stream where fixed Huffman blocks follow dynamic ones,
+# the fixed trees must not keep code length counts of the dynamic trees
+try:
+    import zlib
+except ImportError:
+    import uzlib as zlib
+try:
+    import binascii
+except ImportError:
+    import ubinascii as binascii
+
+# 1500 bytes of text compressed with a sync flush every 500 bytes
+data = (
+    b'x\x9cdQ\xcbn\x830\x10<\xd3\xaf\x98\x1c\x1a\x81\x80\xa69\xb7\xf4G\xa2\xca'
+    b'\xb2\x8d\x11V\xdd\x05a[\xe9\xe3\xe7\xbb@\xa1\xd0H\xbe\xec\xcc\xce\xee\xec8I'
+    b'\xbc\xfd2"\xa0\x8bA\xd0\xd3]\x9e$\x0b\x12\xbd\xa9QA\xd6Z4\xd6\x053'
+    b'\x88!Rz\xd4\x9dsF\x87\x87\x19+`\xa9\x00\xbf\x05\xaee\x90\x17\xf5\x8a|'
+    b'E\xfa\xce\xff\xd1\xce\xd0\xc8\x96{\xf68m\xcf\xe6\xf5\x96\x90W\xd3\xf6\xb9&\x94'
+    b'\xdbr#\x1c\xfb6\xbem\x83t\xcb>\xff\xdb\x9aqM\xc1R4\xdc?)N'
+    b"'\xa8\xd84f@\x13\x9d+\xd0K\xefa\x03B\x87\xd0\x1ah\xe9\x9c\x92\xfa\r"
+    b"\x92j\xf8\xab\r\xba](2\x1f\x9c\x19\x99\x1bK\x15\x1e\xf7>9'g\xea<"
+    b'\xdf\xa3:\x0e\xdc\x9a*\xce\xe9\x9c\xe1~uJ\xec\xe7\xf6\x1a\xfe\x83\xf2\xe5\xb7\x10'
+    b'Z\xe1P\xe1\xbd\x17|\x8d\xe7\xe3\xd9E\x86\xefI\xb3\x8eW\xd1\x7f\x8e9W8'
+    b'\xcf\xd3\xa6q\x07\x16y\xdd\xfe\x00\x00\x00\xff\xffl\x93M\x0f\x820\x0c\x86\xff\xca'
+    b'N\x84\x19c\x8cW\x13\x13\x83\x1eL\x88\x1e\xc43\x19l\xc4\x892\xb2\r<\xf1'
+    b'\xdf\xed\x8a0?\xb8\x8c\xac\xed\xfa6O_\x04\xef\xcf\xe6.\xc2\x10B*\xbb\xa5'
+    b'\x96\x06\x0f\xb7\xe9A\x84CW\x97\xf0\x9b\xfb\x9a\x01\xa6\x84\xf6sr\xbc\xc41\x1d'
+    b"\xd5'\xe4\xdf0|\x8akU\xd7`,X\xdd\x8f'f\xe4\xdbZ\x0b.r\xf9"
+    b'`V\xbc[t\xf8\xe9F8#\x9d\\5\x95%\x1b\xb2\xa4$\x08<\xb4\x1e<'
+    b'\xd9x!,\xa4\x7f\xb0\x8cU\xf5\x07\xa9L\x0bV\xae\xbd\x98;:4\x8c\\\x99'
+    b'\xd4A\xe2\xd2\xb0\x0c\xe0mwQ\x1a\x9d\xe2x\x1f%\xe9auF\xff\xba\x1a\xae'
+    b'e\x0b\xbfKSIX\x10xh\xb2pP\xb7\xcc\x94\xa0\xeeH\xbap\x9b\xc0}'
+    b"'\xee\xc2\x8a\x10\xe9B\x10\xd5\xc1\xabg7(\x1a\xb3\x7f+U\x85\xd6|2\xf0"
+    b'l\xa1\xf4g\x8e`_pk!+i\xae/\x00\x00\x00\xff\xff\x02\xe9\xd7%\x00'
+    b'\xb8\xb4\x81\xae-\xc9LV(\xcb\xcfLQ@N\r\xa0\x10\xd2\x00\x89jri'
+    b'W#\xb9\x1d9\xe4\xca32sR\x11\xa1\x0f\xb6^\x11\xe2/h\x88\xfb\x06\xc4'
+    b'\x87x\x04\xb9:\xba\xc4\xbb{\xfa\xc4\xbbFx\x86h@\xb2<\xcc\xcf\x89\x95\x1a'
+    b'\x86\x10\x114\xa5~!\xaeA\x10\xb5\xb5\x90\xd0P \xec\x1bj\x02.\x85\xe0\x10'
+    b'\xc7\x10Og\x05XnQ\x00g\x96\xdc\xc4\xec\xd4\xf8\xbc\xd4r\rpN\x84K'
+    b'V\x16\x80\x8aO-\x10\xad\xa3\x00-L\xf3\xe2\x13\x8b\xd2\x8b\x91\xb8\xd9\xe5\xa0\xac'
+    b'\x85\xacMA\x0b\x98T\xc0\xca4\xb9\x80\x01\xe6\xe0\xa0\xa0khl\xa4c\xa6\xa0'
+    b'mdd\xa9c\xa9\x00\x14 \xcd\x15\x00\x00\x00\x00\xff\xff\x03\x00R\xf6\xbdv'
+)
+
+out = zlib.decompress(data)
+print(len(out), hex(binascii.crc32(out)))
@@ -0,0 +1,30 @@
+# unsigned 64-bit elements around 2**63, which don't fit in a signed 64-bit int
+try:
+    import array, vector
+except ImportError:
+    print('SKIP')
+    raise SystemExit
+
+B = 2**63
+
+a = array.array('Q', [2**64 - 50, 5, B, B - 1, B + 1])
+print(vector.clip(a, 0, 100))
+print(vector.clip(a, 10, 20, array.array('b', [0] * 5)))
+print(vector.sum(a) == sum(a), vector.sum(a))
+print(vector.min(a), vector.max(a))
+print(vector.dot(a, a) == sum(x * x for x in a))
+print(vector.cast(a, 'd')[2] == float(B))
+
+# wrapping arithmetic gives the same bits as unsigned arithmetic
+print(vector.add(a, 100))
+print(vector.scale(array.array('Q', [B]), 2, 1))
+
+# 'L' has 64 bits on some ports and 32 bits on others
+top = 2**(8 * len(bytes(array.array('L', [0])))) - 1
+a = array.array('L', [top - 49, 5, (top + 1) // 2])
+print(list(vector.clip(a, 0, 100)) == [100, 5, 100])
+print(vector.sum(a) == sum(a), vector.min(a) == min(a), vector.max(a) == max(a))
+
+# the operand of cast and clip is not an array element
+a = array.array('i', range(-3, 4))
+print(vector.cast(a, 'h'), vector.cast(a, 'f'))
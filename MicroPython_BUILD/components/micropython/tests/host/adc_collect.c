@@ -0,0 +1,195 @@
+// Host tests for the continuous ADC collection buffers in esp32/libs/adc_collect.c.
+// The I2S driver is replaced by blocks of counter samples, and the scheduler
+// by a callback which records the full buffers and can refuse them.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "esp32/libs/adc_filter.c"
+#include "esp32/libs/adc_collect.c"
+
+static int n_failed = 0;
+
+#define CHECK(cond) do { \
+        if (!(cond)) { \
+            printf("%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+            n_failed++; \
+        } \
+    } while (0)
+
+// stand-ins for the scheduler: the full buffers in order, and whether to accept them
+static int sched_full[64];
+static int sched_n = 0;
+static int sched_accept = 1;
+
+static int full_cb(int b, void *arg) {
+    if (!sched_accept) {
+        return 0;
+    }
+    sched_full[sched_n++ % 64] = b;
+    return 1;
+}
+
+static uint16_t buf_mem[2][64];
+static uint32_t sample_seq = 0;
+
+// a block of 'n' samples from the driver, the values count up
+static int feed(adc_collect_t *c, size_t n) {
+    uint16_t in[512];
+    for (size_t i = 0; i < n; i++) {
+        in[i] = sample_seq++ & ADC_FILTER_VALUE_MASK;
+    }
+    return adc_collect_put(c, in, n, full_cb, NULL);
+}
+
+static void start(adc_collect_t *c, int nbuf, size_t len, uint32_t count, uint16_t decimate, int average) {
+    for (int b = 0; b < nbuf; b++) {
+        c->data[b] = buf_mem[b];
+        c->len[b] = len;
+    }
+    c->busy[0] = c->busy[1] = 1;
+    adc_collect_init(c, nbuf, count, decimate, average);
+    sched_n = 0;
+    sched_accept = 1;
+    sample_seq = 0;
+}
+
+// collect(count=N) fills N buffers, alternating, and then stops
+static void test_count(void) {
+    adc_collect_t c;
+    start(&c, 2, 10, 3, 1, 0);
+    CHECK(c.filled == 0 && c.dropped == 0 && !c.stop && !c.busy[0] && !c.busy[1]);
+
+    CHECK(feed(&c, 15) == 0);
+    CHECK(c.filled == 1 && c.pos == 5 && c.busy[0] && !c.busy[1] && c.cur == 1);
+    CHECK(sched_n == 1 && sched_full[0] == 0);
+    CHECK(buf_mem[0][0] == 0 && buf_mem[0][9] == 9);
+
+    // the callback copies buffer 0 while buffer 1 fills
+    adc_collect_release(&c, 0);
+    CHECK(feed(&c, 5) == 0);
+    CHECK(c.filled == 2 && c.cur == 0 && c.busy[1] && sched_full[1] == 1);
+    CHECK(buf_mem[1][0] == 10 && buf_mem[1][9] == 19);
+    adc_collect_release(&c, 1);
+
+    // the third buffer ends the collection, the rest of the block is not used
+    CHECK(feed(&c, 25) == 1);
+    CHECK(c.stop && c.filled == 3 && c.dropped == 0 && sched_n == 3);
+    CHECK(buf_mem[0][0] == 20 && buf_mem[0][9] == 29);
+    CHECK(feed(&c, 10) == 1 && c.filled == 3);
+}
+
+// in continuous collection, samples are dropped while the next buffer is not copied yet
+static void test_dropped(void) {
+    adc_collect_t c;
+    start(&c, 2, 8, 0, 1, 0);
+    CHECK(feed(&c, 16) == 0);
+    CHECK(c.filled == 2 && c.busy[0] && c.busy[1]);
+    CHECK(feed(&c, 7) == 0);
+    CHECK(c.dropped == 7 && c.filled == 2 && c.pos == 0);
+
+    // once copied, filling goes on with buffer 0 from the next sample
+    adc_collect_release(&c, 0);
+    CHECK(feed(&c, 8) == 0);
+    CHECK(c.filled == 3 && c.dropped == 7 && buf_mem[0][0] == 23 && buf_mem[0][7] == 30);
+
+    // a buffer the scheduler can't take is free again and its samples are dropped
+    adc_collect_release(&c, 1);
+    sched_accept = 0;
+    CHECK(feed(&c, 8) == 0);
+    CHECK(c.filled == 4 && c.dropped == 15 && !c.busy[1] && c.cur == 0);
+    CHECK(feed(&c, 3) == 0);
+    CHECK(c.dropped == 18);
+}
+
+// stopcollect() stops at the next block, whatever is in it
+static void test_stop(void) {
+    adc_collect_t c;
+    start(&c, 1, 16, 0, 1, 0);
+    CHECK(feed(&c, 10) == 0 && c.pos == 10);
+    c.stop = 1;
+    CHECK(feed(&c, 10) == 1);
+    CHECK(c.pos == 10 && c.filled == 0 && c.dropped == 0 && sched_n == 0);
+
+    // a new collection starts from a clean state
+    start(&c, 1, 16, 1, 1, 0);
+    CHECK(!c.stop && c.pos == 0 && c.filled == 0);
+    CHECK(feed(&c, 16) == 1 && c.filled == 1);
+}
+
+// a single buffer is reused once copied
+static void test_single_buffer(void) {
+    adc_collect_t c;
+    start(&c, 1, 4, 0, 1, 0);
+    CHECK(feed(&c, 6) == 0);
+    CHECK(c.filled == 1 && c.cur == 0 && c.busy[0] && c.dropped == 2);
+    adc_collect_release(&c, 0);
+    CHECK(feed(&c, 4) == 0 && c.filled == 2 && sched_full[1] == 0 && buf_mem[0][0] == 6);
+}
+
+// decimated and averaged samples, with the decimation windows split across blocks
+static void test_decimate(void) {
+    adc_collect_t c;
+    start(&c, 2, 4, 2, 4, 1);
+    for (int i = 0; i < 7; i++) {
+        feed(&c, 5);
+    }
+    CHECK(c.stop && c.filled == 2 && c.dropped == 0);
+    // averages of 0..3, 4..7, ... rounded
+    CHECK(buf_mem[0][0] == 2 && buf_mem[0][3] == 14 && buf_mem[1][0] == 18 && buf_mem[1][3] == 30);
+
+    start(&c, 1, 3, 1, 3, 0);
+    CHECK(feed(&c, 4) == 0 && c.pos == 1);
+    CHECK(feed(&c, 5) == 1);
+    CHECK(buf_mem[0][0] == 2 && buf_mem[0][1] == 5 && buf_mem[0][2] == 8);
+}
+
+// random block sizes and copy timing: the buffers hold runs of consecutive samples,
+// and every sample is either in a buffer, pending, or counted as dropped
+static void test_random(void) {
+    srand(3);
+    for (int iter = 0; iter < 200; iter++) {
+        adc_collect_t c;
+        int nbuf = 1 + rand() % 2;
+        size_t len = 1 + rand() % 64;
+        start(&c, nbuf, len, 0, 1, 0);
+        uint32_t refused = 0;
+        for (int step = 0; step < 100; step++) {
+            sched_accept = (rand() % 8) != 0;
+            uint32_t filled = c.filled;
+            int cur = c.cur;
+            feed(&c, rand() % 100);
+            if (!sched_accept) {
+                refused += c.filled - filled;
+            }
+            if ((c.filled - filled == 1) && c.busy[cur]) {
+                // the buffer handed over holds consecutive samples
+                for (size_t i = 1; i < len; i++) {
+                    CHECK(c.data[cur][i] == ((c.data[cur][i - 1] + 1) & ADC_FILTER_VALUE_MASK));
+                }
+            }
+            CHECK(sample_seq == c.filled * len + c.pos + c.dropped - refused * len);
+            for (int b = 0; b < nbuf; b++) {
+                if (c.busy[b] && (rand() % 3 == 0)) {
+                    adc_collect_release(&c, b);
+                }
+            }
+        }
+    }
+}
+
+int main(int argc, char **argv) {
+    test_count();
+    test_dropped();
+    test_stop();
+    test_single_buffer();
+    test_decimate();
+    test_random();
+    if (n_failed) {
+        printf("%d checks failed\n", n_failed);
+        return 1;
+    }
+    printf("OK\n");
+    return 0;
+}
@@ -0,0 +1,243 @@
+// Host tests for the UART receive ring buffer and pattern matcher in
+// esp32/uart_ringbuf.h.  Run with the argument "bench" to also measure
+// their throughput.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "esp32/uart_ringbuf.h"
+
+static int n_failed = 0;
+
+#define CHECK(cond) do { \
+        if (!(cond)) { \
+            printf("%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+            n_failed++; \
+        } \
+    } while (0)
+
+static uint8_t ring_mem[256];
+
+static void ring_init(uart_ringbuf_t *r, uint32_t size, uint32_t start) {
+    r->buf = ring_mem;
+    r->size = size;
+    r->head = start;
+    r->tail = start;
+}
+
+static int put_str(uart_ringbuf_t *r, const char *s) {
+    return uart_buf_put(r, (const uint8_t*)s, strlen(s));
+}
+
+static void test_put_get(void) {
+    uart_ringbuf_t r;
+    uint8_t out[64];
+    ring_init(&r, 16, 0);
+    CHECK(uart_buf_get(&r, out, sizeof(out)) == -1);
+    CHECK(put_str(&r, "hello") == 0);
+    CHECK(uart_buf_count(&r) == 5);
+    CHECK(uart_buf_get(&r, out, 2) == 2 && memcmp(out, "he", 2) == 0);
+    CHECK(uart_buf_get(&r, out, sizeof(out)) == 3 && memcmp(out, "llo", 3) == 0);
+
+    // overflow keeps what fits
+    CHECK(put_str(&r, "0123456789abcdefXYZ") == 1);
+    CHECK(uart_buf_count(&r) == 16);
+    CHECK(uart_buf_get(&r, out, sizeof(out)) == 16 && memcmp(out, "0123456789abcdef", 16) == 0);
+
+    uart_buf_clear(&r);
+    put_str(&r, "abc");
+    uart_buf_clear(&r);
+    CHECK(uart_buf_count(&r) == 0);
+}
+
+// the counters run past 2**32 while data is in the buffer
+static void test_counter_wrap(void) {
+    uart_ringbuf_t r;
+    uint8_t in[64], out[64];
+    uint32_t seq_in = 0, seq_out = 0;
+    ring_init(&r, 64, 0xFFFFFF00);
+    srand(1);
+    for (int i = 0; i < 2000; i++) {
+        uint32_t n = rand() % 40;
+        uint32_t room = r.size - uart_buf_count(&r);
+        for (uint32_t k = 0; k < n; k++) in[k] = seq_in + k;
+        CHECK(uart_buf_put(&r, in, n) == (n > room));
+        seq_in += (n > room) ? room : n;
+        int got = uart_buf_get(&r, out, rand() % 40 + 1);
+        for (int k = 0; k < got; k++) {
+            if (out[k] != (uint8_t)seq_out++) {
+                CHECK(!"data out of order");
+                return;
+            }
+        }
+        CHECK(uart_buf_count(&r) == seq_in - seq_out);
+    }
+    CHECK(r.head < 0xFFFFFF00); // really wrapped
+}
+
+static void test_match(void) {
+    uart_ringbuf_t r;
+    uart_matcher_t m;
+    uint8_t out[64];
+
+    // the pattern is split across two reads
+    ring_init(&r, 16, 0);
+    uart_matcher_init(&m, (const uint8_t*)"\r\n", 2);
+    CHECK(uart_buf_match(&r, &m) == -1);
+    put_str(&r, "abc\r");
+    CHECK(uart_buf_match(&r, &m) == -1);
+    put_str(&r, "\ndef");
+    CHECK(uart_buf_match(&r, &m) == 5);
+    CHECK(uart_buf_match(&r, &m) == 5);
+    uart_buf_get(&r, out, 5);
+    CHECK(uart_buf_match(&r, &m) == -1);
+
+    // overlapping prefixes
+    ring_init(&r, 16, 0);
+    uart_matcher_init(&m, (const uint8_t*)"aab", 3);
+    put_str(&r, "aaab");
+    CHECK(uart_buf_match(&r, &m) == 4);
+    ring_init(&r, 16, 0);
+    uart_matcher_init(&m, (const uint8_t*)"aab", 3);
+    for (const char *s = "aaa"; *s; s++) {
+        uart_buf_put(&r, (const uint8_t*)s, 1);
+        CHECK(uart_buf_match(&r, &m) == -1);
+    }
+    put_str(&r, "b");
+    CHECK(uart_buf_match(&r, &m) == 4);
+
+    // the next occurrence is found once the first one is read
+    ring_init(&r, 16, 0);
+    uart_matcher_init(&m, (const uint8_t*)"aab", 3);
+    put_str(&r, "xaabyaab");
+    CHECK(uart_buf_match(&r, &m) == 4);
+    uart_buf_get(&r, out, 4);
+    CHECK(uart_buf_match(&r, &m) == 4);
+
+    // the reader takes part of a partial match
+    ring_init(&r, 16, 0);
+    uart_matcher_init(&m, (const uint8_t*)"aab", 3);
+    put_str(&r, "aa");
+    CHECK(uart_buf_match(&r, &m) == -1);
+    uart_buf_get(&r, out, 1);
+    put_str(&r, "b");
+    CHECK(uart_buf_match(&r, &m) == -1);
+    put_str(&r, "aab");
+    CHECK(uart_buf_match(&r, &m) == 5);
+
+    // the match spans the end of the buffer and the wrap of the counters
+    ring_init(&r, 16, 0xFFFFFFF0 - 14);
+    uart_matcher_init(&m, (const uint8_t*)"\r\n", 2);
+    put_str(&r, "0123456789abcd");
+    uart_buf_get(&r, out, 14);
+    put_str(&r, "xyz\r");
+    CHECK(uart_buf_match(&r, &m) == -1);
+    put_str(&r, "\n");
+    CHECK(uart_buf_match(&r, &m) == 5);
+    ring_init(&r, 16, 0xFFFFFFFE);
+    uart_matcher_init(&m, (const uint8_t*)"aab", 3);
+    put_str(&r, "a");
+    CHECK(uart_buf_match(&r, &m) == -1);
+    put_str(&r, "aab");
+    CHECK(uart_buf_match(&r, &m) == 4);
+    CHECK(r.head == 2);
+}
+
+// naive search of the pattern in the data held by the buffer
+static int naive_match(uart_ringbuf_t *r, const char *pat) {
+    uint8_t data[256];
+    uint32_t n = uart_buf_count(r);
+    size_t len = strlen(pat);
+    for (uint32_t i = 0; i < n; i++) data[i] = r->buf[(r->tail + i) & (r->size - 1)];
+    for (uint32_t i = 0; i + len <= n; i++) {
+        if (memcmp(data + i, pat, len) == 0) return i + len;
+    }
+    return -1;
+}
+
+// random reads and writes of a two letter alphabet against the naive search
+static void test_match_random(void) {
+    static const char *pats[] = {"a", "ab", "aab", "abab", "abaab", "aaaa", "bbab"};
+    uart_ringbuf_t r;
+    uart_matcher_t m;
+    uint8_t in[32], out[32];
+    srand(2);
+    for (int p = 0; p < (int)(sizeof(pats) / sizeof(pats[0])); p++) {
+        ring_init(&r, 32, 0xFFFFFF80);
+        uart_matcher_init(&m, (const uint8_t*)pats[p], strlen(pats[p]));
+        for (int i = 0; i < 5000; i++) {
+            uint32_t n = rand() % 5;
+            for (uint32_t k = 0; k < n; k++) in[k] = 'a' + rand() % 2;
+            uart_buf_put(&r, in, n);
+            int res = uart_buf_match(&r, &m);
+            if (res != naive_match(&r, pats[p])) {
+                printf("pattern %s: match %d, expected %d\n", pats[p], res, naive_match(&r, pats[p]));
+                n_failed++;
+                break;
+            }
+            if ((res > 0) || (rand() % 4 == 0)) {
+                uart_buf_get(&r, out, (res > 0) ? (uint32_t)res : (uint32_t)(rand() % 8));
+            }
+        }
+    }
+}
+
+static double elapsed(struct timespec *t0) {
+    struct timespec t1;
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    return (t1.tv_sec - t0->tv_sec) + (t1.tv_nsec - t0->tv_nsec) * 1e-9;
+}
+
+// Data arrives in chunks of the UART FIFO size (120 bytes), lines of 80
+// bytes end with "\r\n" and are read with readline() as they complete
+static void bench(void) {
+    const uint32_t total = 64 * 1024 * 1024;
+    static uint8_t big[4096];
+    uint8_t chunk[120], line[256];
+    uart_ringbuf_t r;
+    uart_matcher_t m;
+    for (int i = 0; i < 120; i++) chunk[i] = ((i % 80) == 78) ? '\r' : ((i % 80) == 79) ? '\n' : 'a' + (i % 26);
+
+    struct timespec t0;
+    r.buf = big;
+    r.size = sizeof(big);
+    r.head = r.tail = 0;
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    for (uint32_t done = 0; done < total; done += sizeof(chunk)) {
+        uart_buf_put(&r, chunk, sizeof(chunk));
+        uart_buf_get(&r, line, sizeof(line));
+    }
+    double t = elapsed(&t0);
+    printf("put/get:       %7.1f MB/s\n", total / t / 1e6);
+
+    r.head = r.tail = 0;
+    uart_matcher_init(&m, (const uint8_t*)"\r\n", 2);
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    for (uint32_t done = 0; done < total; done += sizeof(chunk)) {
+        uart_buf_put(&r, chunk, sizeof(chunk));
+        int n;
+        while ((n = uart_buf_match(&r, &m)) > 0) {
+            uart_buf_get(&r, line, n);
+        }
+    }
+    t = elapsed(&t0);
+    printf("put/readline:  %7.1f MB/s\n", total / t / 1e6);
+}
+
+int main(int argc, char **argv) {
+    test_put_get();
+    test_counter_wrap();
+    test_match();
+    test_match_random();
+    if (n_failed) {
+        printf("%d checks failed\n", n_failed);
+        return 1;
+    }
+    printf("OK\n");
+    if ((argc > 1) && (strcmp(argv[1], "bench") == 0)) {
+        bench();
+    }
+    return 0;
+}
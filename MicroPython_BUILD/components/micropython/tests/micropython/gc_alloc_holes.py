@@ -0,0 +1,40 @@
+# test that gc_alloc finds the holes left by freed blocks of each size again,
+# and skips over the runs of used blocks to the free space after them
+
+import gc
+try:
+    gc.mem_free
+except AttributeError:
+    print('SKIP')
+    raise SystemExit
+
+def fill(n, size):
+    return [bytearray(bytes([i & 0xff]) * size) for i in range(n)]
+
+def check(l, size):
+    return all(b == bytearray(bytes([i & 0xff]) * size) for i, b in enumerate(l))
+
+for size in (10, 40, 200, 1000):
+    gc.collect()
+    l = fill(100, size)
+    gc.collect()
+    free_full = gc.mem_free()
+    # free every other object, then allocate objects of the same size again
+    for i in range(0, 100, 2):
+        l[i] = None
+    gc.collect()
+    for i in range(0, 100, 2):
+        l[i] = bytearray(bytes([i & 0xff]) * size)
+    gc.collect()
+    # the holes were reused, so hardly any more memory is in use
+    used = free_full - gc.mem_free()
+    print(size, check(l, size), used < 256)
+    l = None
+
+# a large block goes past the runs of small used blocks
+gc.collect()
+small = fill(500, 20)
+big = bytearray(20000)
+big[-1] = 1
+print(check(small, 20), len(big), big[-1])
+
@@ -0,0 +1,45 @@
+# test gc.collect(budget_us) on a heap which is swept incrementally
+
+import gc
+try:
+    gc.sweep_step
+except AttributeError:
+    print('SKIP')
+    raise SystemExit
+
+try:
+    gc.collect(-1)
+except ValueError:
+    print('ValueError')
+
+# with no time, each call sweeps a part of the heap until it is complete
+gc.collect()
+n = 1
+while not gc.collect(0) and n < 100000:
+    n += 1
+print(n > 1, n < 100000)
+
+# a new collection is started once the previous one is complete
+print(gc.collect(0), gc.collect(10000000))
+
+# objects made before the collection and while it is being swept survive it
+live = [bytes([i & 0xff]) * 40 for i in range(300)]
+garbage = [bytearray(40) for i in range(300)]
+garbage = None
+gc.collect(0)
+more = [bytes([i & 0xff]) * 40 for i in range(300)]
+while not gc.collect(0) and len(more) < 100000:
+    more.append(bytearray(40))
+gc.collect()
+print(all(live[i] == more[i] == bytes([i & 0xff]) * 40 for i in range(300)))
+print(all(b == bytearray(40) for b in more[300:]))
+
+# sweep_step
+step = gc.sweep_step()
+gc.sweep_step(0)
+print(gc.sweep_step())
+gc.sweep_step(step)
+try:
+    gc.sweep_step(-1)
+except ValueError:
+    print('ValueError')
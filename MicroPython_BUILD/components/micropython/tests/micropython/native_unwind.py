@@ -0,0 +1,83 @@
+# test return, break and continue out of try/except in native code; the
+# nlr_bufs they leave must be popped, and try/finally or with is rejected
+
+try:
+    exec('@micropython.native\ndef f(): pass')
+except SyntaxError:
+    print('SKIP')
+    raise SystemExit
+
+@micropython.native
+def ret(x):
+    try:
+        try:
+            return 1 / x
+        except KeyError:
+            pass
+    except ZeroDivisionError:
+        return 'div'
+
+@micropython.native
+def loop(n):
+    l = []
+    for i in range(n):
+        try:
+            if i == 1:
+                continue
+            if i == 3:
+                break
+            l.append(i)
+        except ValueError:
+            pass
+    while True:
+        try:
+            try:
+                break
+            except KeyError:
+                pass
+        except ValueError:
+            pass
+    return l
+
+@micropython.native
+def handler():
+    for i in range(3):
+        try:
+            raise ValueError(i)
+        except ValueError as e:
+            pass
+        try:
+            raise KeyError
+        except KeyError:
+            continue
+    return i
+
+print(ret(2), ret(0))
+print(loop(5))
+print(handler())
+
+# an exception raised now must not jump into the frames which have returned
+try:
+    ret(None)
+except TypeError:
+    print('TypeError')
+
+for src in (
+    'def f():\n try:\n  return 1\n finally:\n  pass',
+    'def f():\n while 1:\n  try:\n   break\n  finally:\n   pass',
+    'def f(x):\n with x:\n  return 1',
+    'def f(x):\n for i in x:\n  with x:\n   continue',
+):
+    try:
+        exec('@micropython.native\n' + src)
+    except SyntaxError:
+        print('SyntaxError')
+
+# these don't leave the try part of the block
+@micropython.native
+def fin():
+    try:
+        pass
+    finally:
+        return 2
+print(fin())
@@ -0,0 +1,53 @@
+#!/usr/bin/env python3
+#
+# Build the C unit tests in tests/host with the host compiler and run them.
+# They test port code which doesn't depend on ESP-IDF, and print OK when all
+# their checks pass.  With --bench the tests which have a benchmark run it
+# too and print its results.
+
+import os
+import sys
+import argparse
+import subprocess
+import tempfile
+
+TESTS_DIR = os.path.dirname(os.path.abspath(__file__))
+TOP_DIR = os.path.join(TESTS_DIR, '..')
+
+def main():
+    cmd_parser = argparse.ArgumentParser(description='Run the host C unit tests.')
+    cmd_parser.add_argument('--cc', default=os.getenv('CC', 'cc'), help='C compiler')
+    cmd_parser.add_argument('--bench', action='store_true', help='run the benchmarks too')
+    cmd_parser.add_argument('files', nargs='*', help='tests to run (default all of tests/host)')
+    args = cmd_parser.parse_args()
+
+    test_files = args.files
+    if not test_files:
+        test_dir = os.path.join(TESTS_DIR, 'host')
+        test_files = sorted(os.path.join(test_dir, f) for f in os.listdir(test_dir) if f.endswith('.c'))
+
+    failed = []
+    tmp_dir = tempfile.mkdtemp()
+    for test_file in test_files:
+        exe = os.path.join(tmp_dir, os.path.basename(test_file)[:-2])
+        try:
+            subprocess.check_call([args.cc, '-O2', '-Wall', '-Werror', '-I', TOP_DIR,
+                '-o', exe, test_file])
+            output = subprocess.check_output([exe] + (['bench'] if args.bench else []))
+        except subprocess.CalledProcessError as er:
+            output = er.output or b''
+        if output.startswith(b'OK\n'):
+            print('pass ', test_file)
+            sys.stdout.write(output[3:].decode())
+        else:
+            print('FAIL ', test_file)
+            sys.stdout.write(output.decode())
+            failed.append(test_file)
+
+    if failed:
+        print('%u of %u tests failed' % (len(failed), len(test_files)))
+        sys.exit(1)
+    print('%u tests passed' % len(test_files))
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,133 @@
+#!/usr/bin/env python3
+#
+# Run the test scripts in tests/ on a board, through its raw REPL, or with a
+# MicroPython executable built for the host, and compare their output with
+# the expected one.
+#
+# The expected output of a test is in its .exp file if there is one, else it
+# is the output of the test run by CPython.  A test which prints only SKIP
+# (e.g. because a module is not enabled in the build) is skipped.
+
+import os
+import sys
+import time
+import argparse
+import subprocess
+import tempfile
+
+TESTS_DIR = os.path.dirname(os.path.abspath(__file__))
+TEST_DIRS = ('basics', 'extmod', 'micropython', 'thread', 'esp32')
+
+class RawRepl:
+    def __init__(self, device, baudrate):
+        import serial
+        self.serial = serial.Serial(device, baudrate=baudrate, timeout=1)
+
+    def read_until(self, ending, timeout):
+        data = b''
+        start = time.time()
+        while not data.endswith(ending):
+            c = self.serial.read(1)
+            if c:
+                data += c
+                start = time.time()
+            elif time.time() - start > timeout:
+                raise IOError('timeout waiting for %r' % ending)
+        return data[:-len(ending)]
+
+    def enter(self):
+        # stop any running program and enter the raw REPL
+        self.serial.write(b'\r\x03\x03')
+        time.sleep(0.1)
+        self.serial.reset_input_buffer()
+        self.serial.write(b'\r\x01')
+        self.read_until(b'raw REPL; CTRL-B to exit\r\n>', 5)
+
+    def run(self, script, timeout):
+        self.enter()
+        for i in range(0, len(script), 256):
+            self.serial.write(script[i:i + 256])
+            time.sleep(0.01)
+        self.serial.write(b'\x04')
+        if self.serial.read(2) != b'OK':
+            raise IOError('could not run the test')
+        out = self.read_until(b'\x04', timeout)
+        err = self.read_until(b'\x04', timeout)
+        return (out + err).replace(b'\r\n', b'\n')
+
+    def close(self):
+        self.serial.write(b'\x02')
+        self.serial.close()
+
+def run_micropython(args, repl, test_file):
+    if repl:
+        with open(test_file, 'rb') as f:
+            return repl.run(f.read(), args.timeout)
+    try:
+        return subprocess.check_output([args.micropython, os.path.basename(test_file)],
+            cwd=os.path.dirname(test_file), stderr=subprocess.STDOUT, timeout=args.timeout)
+    except subprocess.CalledProcessError as er:
+        return er.output + b'CRASH'
+    except subprocess.TimeoutExpired:
+        return b'TIMEOUT'
+
+def expected_output(args, test_file):
+    exp_file = test_file + '.exp'
+    if os.path.exists(exp_file):
+        with open(exp_file, 'rb') as f:
+            return f.read()
+    try:
+        return subprocess.check_output([args.cpython, os.path.basename(test_file)],
+            cwd=os.path.dirname(test_file), stderr=subprocess.STDOUT)
+    except subprocess.CalledProcessError:
+        return b'CPYTHON_CRASH'
+
+def main():
+    cmd_parser = argparse.ArgumentParser(description='Run the MicroPython tests.')
+    cmd_parser.add_argument('--device', help='serial port of the board to run the tests on')
+    cmd_parser.add_argument('--baudrate', type=int, default=115200, help='baud rate of the serial port')
+    cmd_parser.add_argument('--micropython', default=os.getenv('MICROPY_MICROPYTHON'),
+        help='MicroPython executable to run the tests with, instead of a board')
+    cmd_parser.add_argument('--cpython', default=os.getenv('MICROPY_CPYTHON3', 'python3'),
+        help='CPython to get the expected output of tests which have no .exp file')
+    cmd_parser.add_argument('--timeout', type=int, default=30, help='time allowed for each test, in seconds')
+    cmd_parser.add_argument('files', nargs='*', help='tests to run (default all of them)')
+    args = cmd_parser.parse_args()
+
+    if not args.device and not args.micropython:
+        cmd_parser.error('either --device or --micropython is needed')
+
+    test_files = [os.path.abspath(f) for f in args.files]
+    if not test_files:
+        for d in TEST_DIRS:
+            test_dir = os.path.join(TESTS_DIR, d)
+            if os.path.isdir(test_dir):
+                test_files += sorted(os.path.join(test_dir, f) for f in os.listdir(test_dir) if f.endswith('.py'))
+
+    repl = RawRepl(args.device, args.baudrate) if args.device else None
+    passed, skipped, failed = 0, 0, []
+    out_dir = tempfile.mkdtemp()
+    for test_file in test_files:
+        output = run_micropython(args, repl, test_file)
+        if output == b'SKIP\n':
+            print('skip ', test_file)
+            skipped += 1
+            continue
+        if output == expected_output(args, test_file):
+            print('pass ', test_file)
+            passed += 1
+        else:
+            print('FAIL ', test_file)
+            failed.append(test_file)
+            with open(os.path.join(out_dir, os.path.basename(test_file) + '.out'), 'wb') as f:
+                f.write(output)
+    if repl:
+        repl.close()
+
+    print('%u tests passed, %u skipped' % (passed, skipped))
+    if failed:
+        print('%u tests failed, output is in %s' % (len(failed), out_dir))
+        sys.exit(1)
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,73 @@
+#!/usr/bin/env python3
+#
+# Compile the scripts in tests/xtensawin with mpy-cross for the windowed
+# Xtensa native emitter and compare the disassembly of the machine code,
+# made by mpy-tool.py, with the golden output in the matching .exp file.
+#
+# The golden files are checked by hand against the Xtensa ISA when they are
+# made, so any change to the emitted code shows up as a diff that can be
+# reviewed.  Run with --update to write the .exp files from the current
+# output.
+
+import os
+import sys
+import argparse
+import subprocess
+import tempfile
+
+TESTS_DIR = os.path.dirname(os.path.abspath(__file__))
+MPY_TOOL = os.path.join(TESTS_DIR, '../tools/mpy-tool.py')
+MPY_CROSS = os.path.join(TESTS_DIR, '../../mpy_cross_build/mpy-cross/mpy-cross')
+
+def disassemble(mpy_cross, test_file, tmp_dir):
+    name = os.path.basename(test_file)
+    mpy_file = os.path.join(tmp_dir, name[:-3] + '.mpy')
+    subprocess.check_call([mpy_cross, '-march=xtensawin', '-X', 'emit=native',
+        '-s', name, '-o', mpy_file, test_file])
+    return subprocess.check_output([sys.executable, MPY_TOOL, '-d', mpy_file])
+
+def main():
+    cmd_parser = argparse.ArgumentParser(description='Check the code of the windowed Xtensa native emitter.')
+    cmd_parser.add_argument('--mpy-cross', default=MPY_CROSS,
+        help='mpy-cross binary to compile the tests with')
+    cmd_parser.add_argument('--update', action='store_true',
+        help='write the output to the .exp files instead of comparing it')
+    cmd_parser.add_argument('files', nargs='*',
+        help='tests to run (default all of tests/xtensawin)')
+    args = cmd_parser.parse_args()
+
+    test_files = args.files
+    if not test_files:
+        test_dir = os.path.join(TESTS_DIR, 'xtensawin')
+        test_files = sorted(os.path.join(test_dir, f) for f in os.listdir(test_dir) if f.endswith('.py'))
+
+    failed = []
+    tmp_dir = tempfile.mkdtemp()
+    for test_file in test_files:
+        output = disassemble(args.mpy_cross, test_file, tmp_dir)
+        exp_file = test_file + '.exp'
+        if args.update:
+            with open(exp_file, 'wb') as f:
+                f.write(output)
+            print('updated', exp_file)
+            continue
+        try:
+            with open(exp_file, 'rb') as f:
+                expected = f.read()
+        except IOError:
+            expected = None
+        if output == expected:
+            print('pass ', test_file)
+        else:
+            print('FAIL ', test_file)
+            failed.append(test_file)
+            with open(os.path.join(tmp_dir, os.path.basename(test_file) + '.out'), 'wb') as f:
+                f.write(output)
+
+    if failed:
+        print('%u of %u tests failed, output is in %s' % (len(failed), len(test_files), tmp_dir))
+        sys.exit(1)
+    print('%u tests passed' % len(test_files))
+
+if __name__ == '__main__':
+    main()
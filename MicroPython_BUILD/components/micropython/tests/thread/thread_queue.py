@@ -0,0 +1,42 @@
+# test _thread.Queue: keyword arguments, timeouts, and objects passed by
+# reference between threads
+
+try:
+    import _thread
+    _thread.Queue
+except (ImportError, AttributeError):
+    print('SKIP')
+    raise SystemExit
+
+q = _thread.Queue()
+print(q)
+q = _thread.Queue(maxsize=2)
+print(q, q.empty(), q.full())
+print(q.put(1), q.put(item=2), q.put(3, timeout=0), q.full())
+print(q.get(), q.get(timeout=0), q.get(timeout=10), q.empty())
+for bad in (0, 0x10000):
+    try:
+        _thread.Queue(bad)
+    except ValueError:
+        print('ValueError')
+
+buf = bytearray(4)
+req = _thread.Queue(1)
+resp = _thread.Queue(maxsize=1)
+
+def worker():
+    while True:
+        b = req.get()
+        if b is None:
+            break
+        b[0] += 1
+        resp.put(b)
+    resp.put('done')
+
+_thread.start_new_thread('qworker', worker, ())
+same = True
+for i in range(100):
+    req.put(buf)
+    same = same and resp.get(timeout=1000) is buf
+req.put(None)
+print(resp.get(timeout=1000), buf[0], same)
@@ -0,0 +1,43 @@
+# test _thread.start_worker: the worker has its own globals and heap, and
+# messages are copied through the channel
+
+try:
+    import _thread
+    _thread.start_worker
+except (ImportError, AttributeError):
+    print('SKIP')
+    raise SystemExit
+import gc
+
+HEAP = 32 * 1024
+src = """
+import _thread, gc
+p = _thread.parent()
+p.send(str('g' in globals()))
+g = 'worker'
+gc.collect()
+p.send(str(gc.mem_free() + gc.mem_alloc()))
+while True:
+    m = p.recv()
+    if m is None or m == b'quit':
+        break
+    p.send(m + b'!')
+"""
+
+g = 'main'
+c = _thread.start_worker('worker', src, heapsize=HEAP)
+print(c.recv(5000))
+heap = int(c.recv(5000))
+print(heap <= HEAP, heap < gc.mem_free() + gc.mem_alloc())
+for m in (b'', b'ping', bytes(range(256))):
+    c.send(m)
+    r = c.recv(5000)
+    print(len(r), r == m + b'!')
+buf = bytearray(b'abc')
+c.send(buf)
+buf[0] = ord('x')
+print(c.recv(5000))
+c.send(b'quit')
+print(c.recv(100))
+c.close()
+print(c.running(), g)
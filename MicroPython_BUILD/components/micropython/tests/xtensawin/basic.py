@@ -0,0 +1,11 @@
+# function entry and exit, calls through mp_fun_table, literal pool
+def f(a, b):
+    x = a + b
+    return x * 2
+
+def g(*args, **kwargs):
+    return (args, kwargs, None, True, False, ...)
+
+x = f(1, 2)
+y = "a string"
+z = 1.5
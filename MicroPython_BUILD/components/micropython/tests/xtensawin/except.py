@@ -0,0 +1,18 @@
+# exception handlers put the nlr_buf_t in the locals, so their address is taken
+def f(x):
+    try:
+        return 1 // x
+    except ZeroDivisionError:
+        return None
+
+# native code can't return out of a finally block, so return after it
+def h(x):
+    try:
+        y = 1 // x
+    finally:
+        x = 0
+    return y
+
+def g(lock):
+    with lock:
+        pass
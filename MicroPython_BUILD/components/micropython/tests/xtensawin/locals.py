@@ -0,0 +1,15 @@
+# enough locals to need l32i/s32i, and a call made with a deep value stack so
+# the address of its arguments is beyond the reach of addi
+def f(a):
+    b0 = b1 = b2 = b3 = b4 = b5 = b6 = b7 = b8 = b9 = a
+    c0 = c1 = c2 = c3 = c4 = c5 = c6 = c7 = c8 = c9 = a
+    d0 = d1 = d2 = d3 = d4 = d5 = d6 = d7 = d8 = d9 = a
+    e0 = e1 = e2 = e3 = e4 = e5 = e6 = e7 = e8 = e9 = a
+    try:
+        a = b0 + c9 + d5 + e9
+    except:
+        pass
+    return [b0, b1, b2, b3, b4, b5, b6, b7, b8, b9,
+        c0, c1, c2, c3, c4, c5, c6, c7, c8, c9,
+        d0, d1, d2, d3, d4, d5, d6, d7, d8, d9,
+        e0, e1, e2, e3, e4, e5, e6, e7, e8, e9, print(a, b0)]
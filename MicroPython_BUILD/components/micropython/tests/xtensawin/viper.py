@@ -0,0 +1,17 @@
+# viper integer arithmetic, comparisons and pointer loads and stores
+@micropython.viper
+def arith(a: int, b: int) -> int:
+    c = a * b - (a << 3) + (b >> 2)
+    c = (c & 0xff) | (c ^ a)
+    if a < b:
+        c += 1
+    return c
+
+@micropython.viper
+def ptrs(buf):
+    p8 = ptr8(buf)
+    p16 = ptr16(buf)
+    p32 = ptr32(buf)
+    p8[1] = p8[0]
+    p16[1] = p16[0]
+    p32[1] = p32[0] + 100000
@@ -61,6 +61,8 @@ class Config:
     MICROPY_LONGINT_IMPL_NONE = 0
     MICROPY_LONGINT_IMPL_LONGLONG = 1
     MICROPY_LONGINT_IMPL_MPZ = 2
+    # set if any of the frozen files uses superinstructions
+    MICROPY_OPT_BYTECODE_SUPERINSTRUCTIONS = False
 config = Config()
 
 MP_OPCODE_BYTE = 0
@@ -68,15 +70,62 @@ MP_OPCODE_QSTR = 1
 MP_OPCODE_VAR_UINT = 2
 MP_OPCODE_OFFSET = 3
 
+MP_NATIVE_ARCH_NONE = 0
+MP_NATIVE_ARCH_XTENSAWIN = 6
+
+MP_CODE_BYTECODE = 2
+MP_CODE_NATIVE_PY = 3
+MP_CODE_NATIVE_VIPER = 4
+
+MP_NATIVE_RELOC_FUN_TABLE = 0
+MP_NATIVE_RELOC_CONST = 1
+MP_NATIVE_RELOC_QSTR = 2
+MP_NATIVE_RELOC_QSTR_OBJ = 3
+MP_NATIVE_RELOC_OBJ = 4
+MP_NATIVE_RELOC_RAW_CODE = 5
+
 # extra bytes:
 MP_BC_MAKE_CLOSURE = 0x62
 MP_BC_MAKE_CLOSURE_DEFARGS = 0x63
 MP_BC_RAISE_VARARGS = 0x5c
+MP_BC_POP_JUMP_IF_TRUE_COMPARE = 0x3a
+MP_BC_POP_JUMP_IF_FALSE_COMPARE = 0x3b
+MP_BC_BINARY_OP_FAST_SMALL_INT = 0x2e
+# extra byte, plus one if caching enabled:
+MP_BC_LOAD_FAST_ATTR = 0x2c
+MP_BC_LOAD_FAST_METHOD = 0x2d
 # extra byte if caching enabled:
-MP_BC_LOAD_NAME = 0x1c
-MP_BC_LOAD_GLOBAL = 0x1d
-MP_BC_LOAD_ATTR = 0x1e
+MP_BC_LOAD_NAME = 0x1b
+MP_BC_LOAD_GLOBAL = 0x1c
+MP_BC_LOAD_ATTR = 0x1d
+MP_BC_LOAD_METHOD = 0x1e
 MP_BC_STORE_ATTR = 0x26
+# used to find the globals that can be built at freeze time:
+MP_BC_LOAD_CONST_FALSE = 0x10
+MP_BC_LOAD_CONST_NONE = 0x11
+MP_BC_LOAD_CONST_TRUE = 0x12
+MP_BC_LOAD_CONST_SMALL_INT = 0x14
+MP_BC_LOAD_CONST_STRING = 0x16
+MP_BC_LOAD_CONST_OBJ = 0x17
+MP_BC_LOAD_NULL = 0x18
+MP_BC_LOAD_BUILD_CLASS = 0x20
+MP_BC_STORE_NAME = 0x24
+MP_BC_STORE_GLOBAL = 0x25
+MP_BC_DELETE_NAME = 0x2a
+MP_BC_DELETE_GLOBAL = 0x2b
+MP_BC_JUMP = 0x35
+MP_BC_SETUP_WITH = 0x3d
+MP_BC_SETUP_EXCEPT = 0x3f
+MP_BC_SETUP_FINALLY = 0x40
+MP_BC_FOR_ITER = 0x43
+MP_BC_BUILD_TUPLE = 0x50
+MP_BC_RETURN_VALUE = 0x5b
+MP_BC_MAKE_FUNCTION = 0x60
+MP_BC_MAKE_FUNCTION_DEFARGS = 0x61
+MP_BC_IMPORT_STAR = 0x6a
+MP_BC_LOAD_CONST_SMALL_INT_MULTI = 0x70
+
+MP_SCOPE_FLAG_GENERATOR = 0x04
 
 def make_opcode_format():
     def OC4(a, b, c, d):
@@ -99,10 +148,10 @@ def make_opcode_format():
     OC4(B, B, V, V), # 0x20-0x23
     OC4(Q, Q, Q, B), # 0x24-0x27
     OC4(V, V, Q, Q), # 0x28-0x2b
-    OC4(U, U, U, U), # 0x2c-0x2f
+    OC4(Q, Q, B, U), # 0x2c-0x2f
     OC4(B, B, B, B), # 0x30-0x33
     OC4(B, O, O, O), # 0x34-0x37
-    OC4(O, O, U, U), # 0x38-0x3b
+    OC4(O, O, O, O), # 0x38-0x3b
     OC4(U, O, B, O), # 0x3c-0x3f
     OC4(O, B, B, O), # 0x40-0x43
     OC4(B, B, O, B), # 0x44-0x47
@@ -166,19 +215,28 @@ def mp_opcode_format(bytecode, ip, opcode_format=make_opcode_format()):
     ip_start = ip
     f = (opcode_format[opcode >> 2] >> (2 * (opcode & 3))) & 3
     if f == MP_OPCODE_QSTR:
+        if opcode == MP_BC_LOAD_FAST_ATTR or opcode == MP_BC_LOAD_FAST_METHOD:
+            ip += 1
+        if config.MICROPY_OPT_CACHE_MAP_LOOKUP_IN_BYTECODE:
+            if (opcode == MP_BC_LOAD_NAME
+                or opcode == MP_BC_LOAD_GLOBAL
+                or opcode == MP_BC_LOAD_ATTR
+                or opcode == MP_BC_LOAD_METHOD
+                or opcode == MP_BC_STORE_ATTR
+                or opcode == MP_BC_LOAD_FAST_ATTR
+                or opcode == MP_BC_LOAD_FAST_METHOD):
+                ip += 1
         ip += 3
     else:
         extra_byte = (
             opcode == MP_BC_RAISE_VARARGS
             or opcode == MP_BC_MAKE_CLOSURE
             or opcode == MP_BC_MAKE_CLOSURE_DEFARGS
-            or config.MICROPY_OPT_CACHE_MAP_LOOKUP_IN_BYTECODE and (
-                opcode == MP_BC_LOAD_NAME
-                or opcode == MP_BC_LOAD_GLOBAL
-                or opcode == MP_BC_LOAD_ATTR
-                or opcode == MP_BC_STORE_ATTR
-            )
+            or opcode == MP_BC_POP_JUMP_IF_TRUE_COMPARE
+            or opcode == MP_BC_POP_JUMP_IF_FALSE_COMPARE
         )
+        if opcode == MP_BC_BINARY_OP_FAST_SMALL_INT:
+            extra_byte = 3
         ip += 1
         if f == MP_OPCODE_VAR_UINT:
             while bytecode[ip] & 0x80 != 0:
@@ -189,6 +247,16 @@ def mp_opcode_format(bytecode, ip, opcode_format=make_opcode_format()):
         ip += extra_byte
     return f, ip - ip_start
 
+def decode_sint(bytecode, ip):
+    num = -1 if bytecode[ip] & 0x40 else 0
+    while True:
+        val = bytecode[ip]
+        ip += 1
+        num = (num << 7) | (val & 0x7f)
+        if not (val & 0x80):
+            break
+    return ip, num
+
 def decode_uint(bytecode, ip):
     unum = 0
     while True:
@@ -216,10 +284,84 @@ def extract_prelude(bytecode):
     # ip2 points to simple_name qstr
     return ip, ip2, (n_state, n_exc_stack, scope_flags, n_pos_args, n_kwonly_args, n_def_pos_args, code_info_size)
 
-class RawCode:
-    # a set of all escaped names, to make sure they are unique
-    escaped_names = set()
+def print_rom_obj(prefix, obj, suffix):
+    # obj is the C expression of an mp_rom_obj_t, or a float constant
+    if isinstance(obj, ConstFloat):
+        print('#if MICROPY_OBJ_REPR == MICROPY_OBJ_REPR_A || MICROPY_OBJ_REPR == MICROPY_OBJ_REPR_B')
+        print('%sMP_ROM_PTR(&%s)%s' % (prefix, obj.obj_name, suffix))
+        print('#elif MICROPY_OBJ_REPR == MICROPY_OBJ_REPR_C')
+        n = struct.unpack('<I', struct.pack('<f', obj))[0]
+        n = ((n & ~0x3) | 2) + 0x80800000
+        print('%s(mp_rom_obj_t)(0x%08x)%s' % (prefix, n, suffix))
+        print('#else')
+        print('#error "MICROPY_OBJ_REPR_D not supported with floats in frozen mpy files"')
+        print('#endif')
+    else:
+        print(prefix + obj + suffix)
+
+def freeze_const_obj(raw_code, obj_name, obj):
+    if obj is Ellipsis:
+        print('#define %s mp_const_ellipsis_obj' % obj_name)
+    elif is_str_type(obj) or is_bytes_type(obj):
+        if is_str_type(obj):
+            obj = bytes_cons(obj, 'utf8')
+            obj_type = 'mp_type_str'
+        else:
+            obj_type = 'mp_type_bytes'
+        print('STATIC const mp_obj_str_t %s = {{&%s}, %u, %u, (const byte*)"%s"};'
+            % (obj_name, obj_type, qstrutil.compute_hash(obj, config.MICROPY_QSTR_BYTES_IN_HASH),
+                len(obj), ''.join(('\\x%02x' % b) for b in obj)))
+    elif is_int_type(obj):
+        if config.MICROPY_LONGINT_IMPL == config.MICROPY_LONGINT_IMPL_NONE:
+            # TODO check if we can actually fit this long-int into a small-int
+            raise FreezeError(raw_code, 'target does not support long int')
+        elif config.MICROPY_LONGINT_IMPL == config.MICROPY_LONGINT_IMPL_LONGLONG:
+            # TODO
+            raise FreezeError(raw_code, 'freezing int to long-long is not implemented')
+        elif config.MICROPY_LONGINT_IMPL == config.MICROPY_LONGINT_IMPL_MPZ:
+            neg = 0
+            if obj < 0:
+                obj = -obj
+                neg = 1
+            bits_per_dig = config.MPZ_DIG_SIZE
+            digs = []
+            z = obj
+            while z:
+                digs.append(z & ((1 << bits_per_dig) - 1))
+                z >>= bits_per_dig
+            ndigs = len(digs)
+            digs = ','.join(('%#x' % d) for d in digs)
+            print('STATIC const mp_obj_int_t %s = {{&mp_type_int}, '
+                '{.neg=%u, .fixed_dig=1, .alloc=%u, .len=%u, .dig=(uint%u_t[]){%s}}};'
+                % (obj_name, neg, ndigs, ndigs, bits_per_dig, digs))
+    elif type(obj) is float:
+        print('#if MICROPY_OBJ_REPR == MICROPY_OBJ_REPR_A || MICROPY_OBJ_REPR == MICROPY_OBJ_REPR_B')
+        print('STATIC const mp_obj_float_t %s = {{&mp_type_float}, %.16g};'
+            % (obj_name, obj))
+        print('#endif')
+    elif type(obj) is complex:
+        print('STATIC const mp_obj_complex_t %s = {{&mp_type_complex}, %.16g, %.16g};'
+            % (obj_name, obj.real, obj.imag))
+    else:
+        raise FreezeError(raw_code, 'freezing of object %r is not implemented' % (obj,))
+
+# a set of all escaped names, to make sure they are unique
+escaped_names = set()
+
+def make_escaped_name(name):
+    escaped_name = name
+    i = 2
+    while escaped_name in escaped_names:
+        escaped_name = name + str(i)
+        i += 1
+    escaped_names.add(escaped_name)
+    return escaped_name
 
+class ConstFloat(float):
+    # a float constant together with the name of its object
+    pass
+
+class RawCode:
     def __init__(self, bytecode, qstrs, objs, raw_codes):
         # set core variables
         self.bytecode = bytecode
@@ -232,10 +374,170 @@ class RawCode:
         self.simple_name = self._unpack_qstr(self.ip2)
         self.source_file = self._unpack_qstr(self.ip2 + 2)
 
+        # set by find_static_globals
+        self.static_globals = []
+        self.static_jumps = {}
+        self.has_code = True
+
     def _unpack_qstr(self, ip):
         qst = self.bytecode[ip] | self.bytecode[ip + 1] << 8
         return global_qstrs[qst]
 
+    def _instructions(self):
+        ip = self.ip
+        while ip < len(self.bytecode):
+            f, sz = mp_opcode_format(self.bytecode, ip)
+            yield ip, f, sz
+            ip += sz
+
+    def _jump_target(self, ip):
+        ofs = self.bytecode[ip + 1] | self.bytecode[ip + 2] << 8
+        if self.bytecode[ip] not in (MP_BC_SETUP_WITH, MP_BC_SETUP_EXCEPT, MP_BC_SETUP_FINALLY, MP_BC_FOR_ITER):
+            ofs -= 0x8000
+        return ip + 3 + ofs
+
+    def _has_native(self):
+        return any(not isinstance(rc, RawCode) or rc._has_native() for rc in self.raw_codes)
+
+    def _names_used(self, opcodes):
+        # the names used by the given opcodes in this scope and all nested ones
+        names = set()
+        for ip, f, sz in self._instructions():
+            if f == MP_OPCODE_QSTR and self.bytecode[ip] in opcodes:
+                names.add(self._unpack_qstr(ip + 1).str)
+        for rc in self.raw_codes:
+            names |= rc._names_used(opcodes)
+        return names
+
+    def _static_op(self, ip, stack):
+        # apply the opcode at ip to the stack if it only builds a value that
+        # can also be built at freeze time, else return False
+        bc = self.bytecode
+        op = bc[ip]
+        if op == MP_BC_LOAD_CONST_FALSE:
+            stack.append(('rom', 'MP_ROM_PTR(&mp_const_false_obj)'))
+        elif op == MP_BC_LOAD_CONST_NONE:
+            stack.append(('rom', 'MP_ROM_PTR(&mp_const_none_obj)'))
+        elif op == MP_BC_LOAD_CONST_TRUE:
+            stack.append(('rom', 'MP_ROM_PTR(&mp_const_true_obj)'))
+        elif op == MP_BC_LOAD_CONST_SMALL_INT:
+            stack.append(('rom', 'MP_ROM_INT(%d)' % decode_sint(bc, ip + 1)[1]))
+        elif MP_BC_LOAD_CONST_SMALL_INT_MULTI <= op < MP_BC_LOAD_CONST_SMALL_INT_MULTI + 64:
+            stack.append(('rom', 'MP_ROM_INT(%d)' % (op - MP_BC_LOAD_CONST_SMALL_INT_MULTI - 16)))
+        elif op == MP_BC_LOAD_CONST_STRING:
+            stack.append(('rom', 'MP_ROM_QSTR(%s)' % self._unpack_qstr(ip + 1).qstr_id))
+        elif op == MP_BC_LOAD_CONST_OBJ:
+            stack.append(('const', decode_uint(bc, ip + 1)[1] - len(self.qstrs)))
+        elif op == MP_BC_LOAD_NULL:
+            stack.append(None)
+        elif op == MP_BC_BUILD_TUPLE:
+            n = decode_uint(bc, ip + 1)[1]
+            if n > len(stack) or None in stack[len(stack) - n:]:
+                return False
+            items = stack[len(stack) - n:]
+            del stack[len(stack) - n:]
+            stack.append(('tuple', items))
+        elif op in (MP_BC_MAKE_FUNCTION, MP_BC_MAKE_FUNCTION_DEFARGS):
+            rc = self.raw_codes[decode_uint(bc, ip + 1)[1] - len(self.qstrs) - len(self.objs)]
+            if op == MP_BC_MAKE_FUNCTION:
+                def_args = []
+            elif len(stack) >= 2 and stack[-1] is None and stack[-2] is not None and stack[-2][0] == 'tuple':
+                # positional default args only
+                def_args = stack[-2][1]
+                del stack[-2:]
+            else:
+                return False
+            stack.append(('fun', rc, def_args))
+        else:
+            return False
+        return True
+
+    def find_static_globals(self):
+        # Find the module-level statements that unconditionally bind a name to
+        # a value which can be built at freeze time: a constant, a tuple of
+        # such values, or a function that has no closed-over variables nor
+        # keyword-only default args.  The values go in a globals dict in ROM
+        # and the statements are jumped over when the module code is run.
+        if self._has_native():
+            return
+        insns = list(self._instructions())
+
+        # instructions that may not run exactly once, in order, can't be moved
+        covered = set()
+        targets = set()
+        for ip, f, sz in insns:
+            if f == MP_OPCODE_OFFSET:
+                target = self._jump_target(ip)
+                targets.add(target)
+                lo, hi = min(ip, target), max(ip + sz, target)
+                covered.update(i for i, _, _ in insns if lo <= i < hi)
+
+        # a name must be bound only by its statement, and not be used before it
+        store_count = {}
+        for ip, f, sz in insns:
+            if self.bytecode[ip] == MP_BC_STORE_NAME:
+                name = self._unpack_qstr(ip + 1).str
+                store_count[name] = store_count.get(name, 0) + 1
+        excluded = set(('__name__',))
+        for rc in self.raw_codes:
+            excluded |= rc._names_used((MP_BC_STORE_GLOBAL, MP_BC_DELETE_GLOBAL))
+        used = set()
+        fixed = covered | targets
+
+        i = 0
+        while i < len(insns):
+            ip, f, sz = insns[i]
+            op = self.bytecode[ip]
+            if op == MP_BC_IMPORT_STAR:
+                # may bind any name
+                break
+            if op in (MP_BC_LOAD_NAME, MP_BC_DELETE_NAME):
+                used.add(self._unpack_qstr(ip + 1).str)
+            elif (op in (MP_BC_MAKE_FUNCTION, MP_BC_MAKE_CLOSURE)
+                and i > 0 and self.bytecode[insns[i - 1][0]] == MP_BC_LOAD_BUILD_CLASS):
+                # a class body, which is run straight away
+                rc = self.raw_codes[decode_uint(self.bytecode, ip + 1)[1] - len(self.qstrs) - len(self.objs)]
+                used |= rc._names_used((MP_BC_LOAD_NAME, MP_BC_DELETE_NAME))
+            if ip not in covered:
+                stack = []
+                j = i
+                while j < len(insns) and (j == i or insns[j][0] not in fixed):
+                    if not self._static_op(insns[j][0], stack):
+                        break
+                    j += 1
+                if (j > i and j < len(insns) and len(stack) == 1 and stack[0] is not None
+                    and self.bytecode[insns[j][0]] == MP_BC_STORE_NAME
+                    and insns[j][0] not in fixed):
+                    name = self._unpack_qstr(insns[j][0] + 1)
+                    if store_count[name.str] == 1 and name.str not in excluded and name.str not in used:
+                        end = insns[j][0] + insns[j][2]
+                        self.static_globals.append((ip, end, name, stack[0]))
+                        i = j + 1
+                        continue
+            i += 1
+
+        # jump over the statements, merging consecutive ones
+        start = None
+        for ip, end, _, _ in self.static_globals:
+            if start is None or self.static_jumps[start] != ip or end - (start + 3) > 0x7fff:
+                start = ip
+            self.static_jumps[start] = end
+
+        # the module code has nothing left to do if it just returns None
+        skipped = set()
+        for start, end in self.static_jumps.items():
+            skipped.update(ip for ip, _, _ in insns if start <= ip < end)
+        remaining = [self.bytecode[ip] for ip, _, _ in insns if ip not in skipped]
+        self.has_code = remaining != [MP_BC_LOAD_CONST_NONE, MP_BC_RETURN_VALUE]
+
+    def const_obj_rom(self, i):
+        obj_name = 'const_obj_%s_%u' % (self.escaped_name, i)
+        if type(self.objs[i]) is float:
+            obj = ConstFloat(self.objs[i])
+            obj.obj_name = obj_name
+            return obj
+        return 'MP_ROM_PTR(&%s)' % obj_name
+
     def dump(self):
         # dump children first
         for rc in self.raw_codes:
@@ -243,14 +545,7 @@ class RawCode:
         # TODO
 
     def freeze(self, parent_name):
-        self.escaped_name = parent_name + self.simple_name.qstr_esc
-
-        # make sure the escaped name is unique
-        i = 2
-        while self.escaped_name in RawCode.escaped_names:
-            self.escaped_name = parent_name + self.simple_name.qstr_esc + str(i)
-            i += 1
-        RawCode.escaped_names.add(self.escaped_name)
+        self.escaped_name = make_escaped_name(parent_name + self.simple_name.qstr_esc)
 
         # emit children first
         for rc in self.raw_codes:
@@ -275,10 +570,19 @@ class RawCode:
         print()
         ip = self.ip
         while ip < len(self.bytecode):
+            if ip in self.static_jumps:
+                # the rest of these statements is never executed
+                end = self.static_jumps[ip]
+                ofs = end - (ip + 3) + 0x8000
+                print('    0x%02x, 0x%02x, 0x%02x, // globals built at freeze time' % (MP_BC_JUMP, ofs & 0xff, ofs >> 8))
+                print('   ', ''.join('0x%02x, ' % b for b in self.bytecode[ip + 3:end]))
+                ip = end
+                continue
             f, sz = mp_opcode_format(self.bytecode, ip)
             if f == 1:
                 qst = self._unpack_qstr(ip + 1).qstr_id
-                print('   ', '0x%02x,' % self.bytecode[ip], qst, '& 0xff,', qst, '>> 8,')
+                print('   ', '0x%02x,' % self.bytecode[ip], qst, '& 0xff,', qst, '>> 8,',
+                    ''.join('0x%02x, ' % self.bytecode[ip + i] for i in range(3, sz)))
             else:
                 print('   ', ''.join('0x%02x, ' % self.bytecode[ip + i] for i in range(sz)))
             ip += sz
@@ -286,51 +590,7 @@ class RawCode:
 
         # generate constant objects
         for i, obj in enumerate(self.objs):
-            obj_name = 'const_obj_%s_%u' % (self.escaped_name, i)
-            if obj is Ellipsis:
-                print('#define %s mp_const_ellipsis_obj' % obj_name)
-            elif is_str_type(obj) or is_bytes_type(obj):
-                if is_str_type(obj):
-                    obj = bytes_cons(obj, 'utf8')
-                    obj_type = 'mp_type_str'
-                else:
-                    obj_type = 'mp_type_bytes'
-                print('STATIC const mp_obj_str_t %s = {{&%s}, %u, %u, (const byte*)"%s"};'
-                    % (obj_name, obj_type, qstrutil.compute_hash(obj, config.MICROPY_QSTR_BYTES_IN_HASH),
-                        len(obj), ''.join(('\\x%02x' % b) for b in obj)))
-            elif is_int_type(obj):
-                if config.MICROPY_LONGINT_IMPL == config.MICROPY_LONGINT_IMPL_NONE:
-                    # TODO check if we can actually fit this long-int into a small-int
-                    raise FreezeError(self, 'target does not support long int')
-                elif config.MICROPY_LONGINT_IMPL == config.MICROPY_LONGINT_IMPL_LONGLONG:
-                    # TODO
-                    raise FreezeError(self, 'freezing int to long-long is not implemented')
-                elif config.MICROPY_LONGINT_IMPL == config.MICROPY_LONGINT_IMPL_MPZ:
-                    neg = 0
-                    if obj < 0:
-                        obj = -obj
-                        neg = 1
-                    bits_per_dig = config.MPZ_DIG_SIZE
-                    digs = []
-                    z = obj
-                    while z:
-                        digs.append(z & ((1 << bits_per_dig) - 1))
-                        z >>= bits_per_dig
-                    ndigs = len(digs)
-                    digs = ','.join(('%#x' % d) for d in digs)
-                    print('STATIC const mp_obj_int_t %s = {{&mp_type_int}, '
-                        '{.neg=%u, .fixed_dig=1, .alloc=%u, .len=%u, .dig=(uint%u_t[]){%s}}};'
-                        % (obj_name, neg, ndigs, ndigs, bits_per_dig, digs))
-            elif type(obj) is float:
-                print('#if MICROPY_OBJ_REPR == MICROPY_OBJ_REPR_A || MICROPY_OBJ_REPR == MICROPY_OBJ_REPR_B')
-                print('STATIC const mp_obj_float_t %s = {{&mp_type_float}, %.16g};'
-                    % (obj_name, obj))
-                print('#endif')
-            elif type(obj) is complex:
-                print('STATIC const mp_obj_complex_t %s = {{&mp_type_complex}, %.16g, %.16g};'
-                    % (obj_name, obj.real, obj.imag))
-            else:
-                raise FreezeError(self, 'freezing of object %r is not implemented' % (obj,))
+            freeze_const_obj(self, 'const_obj_%s_%u' % (self.escaped_name, i), obj)
 
         # generate constant table, if it has any entries
         const_table_len = len(self.qstrs) + len(self.objs) + len(self.raw_codes)
@@ -340,18 +600,7 @@ class RawCode:
             for qst in self.qstrs:
                 print('    MP_ROM_QSTR(%s),' % global_qstrs[qst].qstr_id)
             for i in range(len(self.objs)):
-                if type(self.objs[i]) is float:
-                    print('#if MICROPY_OBJ_REPR == MICROPY_OBJ_REPR_A || MICROPY_OBJ_REPR == MICROPY_OBJ_REPR_B')
-                    print('    MP_ROM_PTR(&const_obj_%s_%u),' % (self.escaped_name, i))
-                    print('#elif MICROPY_OBJ_REPR == MICROPY_OBJ_REPR_C')
-                    n = struct.unpack('<I', struct.pack('<f', self.objs[i]))[0]
-                    n = ((n & ~0x3) | 2) + 0x80800000
-                    print('    (mp_rom_obj_t)(0x%08x),' % (n,))
-                    print('#else')
-                    print('#error "MICROPY_OBJ_REPR_D not supported with floats in frozen mpy files"')
-                    print('#endif')
-                else:
-                    print('    MP_ROM_PTR(&const_obj_%s_%u),' % (self.escaped_name, i))
+                print_rom_obj('    ', self.const_obj_rom(i), ',')
             for rc in self.raw_codes:
                 print('    MP_ROM_PTR(&raw_code_%s),' % rc.escaped_name)
             print('};')
@@ -377,6 +626,370 @@ class RawCode:
         print('    },')
         print('};')
 
+    def _freeze_static_value(self, value):
+        # emit the objects for a value found by find_static_globals and
+        # return its mp_rom_obj_t
+        if value[0] == 'rom':
+            return value[1]
+        elif value[0] == 'const':
+            return self.const_obj_rom(value[1])
+        elif value[0] == 'tuple':
+            if not value[1]:
+                return 'MP_ROM_PTR(&mp_const_empty_tuple_obj)'
+            items = [self._freeze_static_value(v) for v in value[1]]
+            obj_name = 'rom_tuple_%s_%u' % (self.escaped_name, len(self.rom_objs))
+            self.rom_objs.append(obj_name)
+            print('STATIC const mp_rom_obj_tuple_t %s = {{&mp_type_tuple}, %u, {' % (obj_name, len(items)))
+            for item in items:
+                print_rom_obj('    ', item, ',')
+            print('}};')
+            return 'MP_ROM_PTR(&%s)' % obj_name
+        else:
+            rc, def_args = value[1], value[2]
+            def_args = [self._freeze_static_value(v) for v in def_args]
+            obj_name = 'rom_fun_%s' % rc.escaped_name
+            if def_args:
+                print('STATIC const struct {')
+                print('    mp_obj_base_t base;')
+                print('    mp_obj_dict_t *globals;')
+                print('    const byte *bytecode;')
+                print('    const mp_uint_t *const_table;')
+                print('    mp_rom_obj_t extra_args[%u];' % len(def_args))
+                print('} ', end='')
+            else:
+                print('STATIC const mp_obj_fun_bc_t ', end='')
+            print('%s = {{&mp_type_fun_bc}, &rom_globals_%s, bytecode_data_%s, '
+                % (obj_name, self.escaped_name, rc.escaped_name), end='')
+            if len(rc.qstrs) + len(rc.objs) + len(rc.raw_codes):
+                print('(const mp_uint_t*)const_table_data_%s' % rc.escaped_name, end='')
+            else:
+                print('NULL', end='')
+            if def_args:
+                print(', {')
+                for arg in def_args:
+                    print_rom_obj('    ', arg, ',')
+                print('}};')
+            else:
+                print('};')
+            if rc.prelude[2] & MP_SCOPE_FLAG_GENERATOR:
+                print('STATIC const mp_obj_gen_wrap_t rom_gen_%s = {{&mp_type_gen_wrap}, (mp_obj_t*)&%s};'
+                    % (rc.escaped_name, obj_name))
+                obj_name = 'rom_gen_%s' % rc.escaped_name
+            return 'MP_ROM_PTR(&%s)' % obj_name
+
+    def freeze_rom_globals(self, module_name):
+        self.rom_objs = []
+        print()
+        print('// globals of module %s built at freeze time' % module_name.str)
+        print('STATIC mp_obj_dict_t rom_globals_%s;' % self.escaped_name)
+        entries = [('MP_ROM_QSTR(MP_QSTR___name__)', 'MP_ROM_QSTR(%s)' % module_name.qstr_id)]
+        for _, _, name, value in self.static_globals:
+            entries.append(('MP_ROM_QSTR(%s)' % name.qstr_id, self._freeze_static_value(value)))
+        print('STATIC const mp_rom_map_elem_t rom_globals_table_%s[%u] = {' % (self.escaped_name, len(entries)))
+        for key, value in entries:
+            print_rom_obj('    { %s, ' % key, value, ' },')
+        print('};')
+
+def sign_extend(value, bits):
+    if value & (1 << (bits - 1)):
+        value -= 1 << bits
+    return value
+
+XTENSA_BRANCH_NAMES = {
+    0:'bnone', 1:'beq', 2:'blt', 3:'bltu', 4:'ball', 5:'bbc',
+    8:'bany', 9:'bne', 10:'bge', 11:'bgeu', 12:'bnall', 13:'bbs',
+}
+XTENSA_BRANCHZ_NAMES = ('beqz', 'bnez', 'bltz', 'bgez')
+XTENSA_RRR_NAMES = {
+    1:'and', 2:'or', 3:'xor', 8:'add', 9:'addx2', 10:'addx4', 11:'addx8',
+    12:'sub', 13:'subx2', 14:'subx4', 15:'subx8',
+}
+XTENSA_LSAI_NAMES = {
+    0:('l8ui', 1), 1:('l16ui', 2), 2:('l32i', 4), 4:('s8i', 1), 5:('s16i', 2),
+    6:('s32i', 4), 9:('l16si', 2),
+}
+
+def xtensa_decode(code, pc):
+    # Decode the instruction at pc from the fields of the Xtensa ISA, for the
+    # instructions that the native emitters use.  Returns the size of the
+    # instruction, its text and, for l32r, the address of the literal it
+    # loads; or None if the instruction isn't known.
+    op0 = code[pc] & 0xf
+    size = 2 if op0 >= 8 else 3
+    if pc + size > len(code):
+        return None
+    w = code[pc] | code[pc + 1] << 8
+    if size == 3:
+        w |= code[pc + 2] << 16
+    t = w >> 4 & 0xf
+    s = w >> 8 & 0xf
+    r = w >> 12 & 0xf
+    op1 = w >> 16 & 0xf
+    op2 = w >> 20 & 0xf
+    imm8 = w >> 16 & 0xff
+    text = None
+    literal = None
+    if op0 == 0:
+        if op1 == 0 and op2 == 0 and r == 0:
+            m, n = t >> 2, t & 3
+            if m == 2 and n < 2 and s == 0:
+                text = ('ret', 'retw')[n]
+            elif m == 2 and n == 2:
+                text = 'jx a%u' % s
+            elif m == 3:
+                text = 'callx%u a%u' % (n * 4, s)
+        elif op1 == 0 and op2 == 2 and s == t:
+            text = 'mov a%u, a%u' % (r, s)
+        elif op1 == 0 and op2 in XTENSA_RRR_NAMES:
+            text = '%s a%u, a%u, a%u' % (XTENSA_RRR_NAMES[op2], r, s, t)
+        elif op1 == 0 and op2 == 4 and r < 2 and t == 0:
+            text = '%s a%u' % (('ssr', 'ssl')[r], s)
+        elif op1 == 1 and op2 == 10 and t == 0:
+            text = 'sll a%u, a%u' % (r, s)
+        elif op1 == 1 and op2 in (9, 11) and s == 0:
+            text = '%s a%u, a%u' % (('srl', 'sra')[op2 == 11], r, t)
+        elif op1 == 2 and op2 == 8:
+            text = 'mull a%u, a%u, a%u' % (r, s, t)
+    elif op0 == 1:
+        literal = ((pc + 3) & ~3) + ((w >> 8) - 0x10000) * 4
+        text = 'l32r a%u, 0x%04x' % (t, literal)
+    elif op0 == 2:
+        if r in XTENSA_LSAI_NAMES:
+            name, scale = XTENSA_LSAI_NAMES[r]
+            text = '%s a%u, a%u, %u' % (name, t, s, imm8 * scale)
+        elif r == 10:
+            text = 'movi a%u, %d' % (t, sign_extend(s << 8 | imm8, 12))
+        elif r == 12:
+            text = 'addi a%u, a%u, %d' % (t, s, sign_extend(imm8, 8))
+        elif r == 13:
+            text = 'addmi a%u, a%u, %d' % (t, s, sign_extend(imm8, 8) * 256)
+    elif op0 == 5:
+        text = 'call%u 0x%04x' % ((t & 3) * 4, (pc & ~3) + (sign_extend(w >> 6, 18) + 1) * 4)
+    elif op0 == 6:
+        n, m = t & 3, t >> 2
+        if n == 0:
+            text = 'j 0x%04x' % (pc + 4 + sign_extend(w >> 6, 18))
+        elif n == 1:
+            text = '%s a%u, 0x%04x' % (XTENSA_BRANCHZ_NAMES[m], s, pc + 4 + sign_extend(w >> 12, 12))
+        elif n == 3 and m == 0:
+            text = 'entry a%u, %u' % (s, (w >> 12) * 8)
+    elif op0 == 7:
+        if r in XTENSA_BRANCH_NAMES:
+            text = '%s a%u, a%u, 0x%04x' % (XTENSA_BRANCH_NAMES[r], s, t, pc + 4 + sign_extend(imm8, 8))
+    elif op0 == 8 or op0 == 9:
+        text = '%s a%u, a%u, %u' % (('l32i.n', 's32i.n')[op0 == 9], t, s, r * 4)
+    elif op0 == 10:
+        text = 'add.n a%u, a%u, a%u' % (r, s, t)
+    elif op0 == 11:
+        text = 'addi.n a%u, a%u, %d' % (r, s, t or -1)
+    elif op0 == 12:
+        if t & 8 == 0:
+            imm7 = (t & 7) << 4 | r
+            if imm7 >= 96:
+                imm7 -= 128
+            text = 'movi.n a%u, %d' % (s, imm7)
+        else:
+            text = '%s a%u, 0x%04x' % (('beqz.n', 'bnez.n')[t >> 2 & 1], s, pc + 4 + ((t & 3) << 4 | r))
+    elif op0 == 13:
+        if r == 0:
+            text = 'mov.n a%u, a%u' % (t, s)
+        elif r == 15 and s == 0 and t < 2:
+            text = ('ret.n', 'retw.n')[t]
+    if text is None:
+        return None
+    return size, text, literal
+
+class RawCodeNative:
+    def __init__(self, kind, fun_data, prelude, qstrs, scope_flags, n_pos_args, type_sig, relocs, raw_codes):
+        self.kind = kind
+        self.fun_data = fun_data
+        self.prelude = prelude
+        self.qstrs = qstrs
+        self.scope_flags = scope_flags
+        self.n_pos_args = n_pos_args
+        self.type_sig = type_sig
+        self.relocs = relocs
+        self.raw_codes = raw_codes
+        # files are read one at a time, so this is the arch of this one
+        self.arch = config.native_arch
+        self.static_globals = []
+        self.has_code = True
+        if prelude is not None:
+            ip, ip2, _ = extract_prelude(prelude)
+            self.simple_name = global_qstrs[prelude[ip2] | prelude[ip2 + 1] << 8]
+            self.source_file = global_qstrs[prelude[ip2 + 2] | prelude[ip2 + 3] << 8]
+        else:
+            self.simple_name = None
+            self.source_file = '<viper>'
+
+    def _reloc_name(self, kind, arg):
+        if kind == MP_NATIVE_RELOC_FUN_TABLE:
+            return 'mp_fun_table'
+        elif kind == MP_NATIVE_RELOC_CONST:
+            return ('None', 'False', 'True', 'Ellipsis')[arg]
+        elif kind == MP_NATIVE_RELOC_QSTR:
+            return 'qstr %s' % global_qstrs[arg].str
+        elif kind == MP_NATIVE_RELOC_QSTR_OBJ:
+            return 'qstr obj %s' % global_qstrs[arg].str
+        elif kind == MP_NATIVE_RELOC_OBJ:
+            return 'obj %r' % (arg,)
+        else:
+            return 'raw code %s' % arg._dump_name()
+
+    def _dump_name(self):
+        if self.simple_name is None:
+            return '<viper>'
+        return self.simple_name.str
+
+    def _dump_xtensa(self):
+        # the code starts with a jump over the literal pool, whose words are
+        # shown with their relocations so the output doesn't depend on the
+        # firmware the code was compiled for
+        code = self.fun_data
+        relocs = dict((offset, (kind, arg)) for offset, kind, arg in self.relocs)
+        literals = {}
+        pc = 0
+        pool_end = 0
+        while pc < len(code):
+            insn = None
+            if pc >= pool_end:
+                insn = xtensa_decode(code, pc)
+            if insn is not None:
+                size, text, literal = insn
+                if pc == 0 and text.startswith('j '):
+                    pool_end = int(text[2:], 16)
+                if literal in literals:
+                    text += ' ; ' + literals[literal]
+            elif pc % 4 == 0 and pc + 4 <= pool_end:
+                size = 4
+                if pc in relocs:
+                    literals[pc] = self._reloc_name(*relocs[pc])
+                else:
+                    literals[pc] = '0x%08x' % struct.unpack_from('<I', code, pc)[0]
+                text = '.word ' + literals[pc]
+            else:
+                size = 1
+                text = '.byte 0x%02x' % code[pc]
+            print('  %04x: %-12s %s' % (pc, ' '.join('%02x' % b for b in code[pc:pc + size]), text))
+            pc += size
+
+    def dump(self):
+        print('%s code for %s, %u bytes:'
+            % (('native', 'viper')[self.kind == MP_CODE_NATIVE_VIPER], self._dump_name(), len(self.fun_data)))
+        if self.arch == MP_NATIVE_ARCH_XTENSAWIN:
+            self._dump_xtensa()
+        else:
+            for i in range(0, len(self.fun_data), 16):
+                print('  %04x: %s' % (i, ' '.join('%02x' % b for b in self.fun_data[i:i + 16])))
+        for rc in self.raw_codes:
+            rc.dump()
+
+    def _names_used(self, opcodes):
+        return set()
+
+    def find_static_globals(self):
+        pass
+
+    def _reloc_value(self, kind, arg, obj_name):
+        # the C expression of a relocated word, which the linker resolves
+        if kind == MP_NATIVE_RELOC_FUN_TABLE:
+            return '(mp_uint_t)mp_fun_table'
+        elif kind == MP_NATIVE_RELOC_CONST:
+            return '(mp_uint_t)MP_OBJ_FROM_PTR(&mp_const_%s_obj)' % ('none', 'false', 'true', 'ellipsis')[arg]
+        elif kind == MP_NATIVE_RELOC_QSTR:
+            return global_qstrs[arg].qstr_id
+        elif kind == MP_NATIVE_RELOC_QSTR_OBJ:
+            return '(mp_uint_t)MP_OBJ_NEW_QSTR(%s)' % global_qstrs[arg].qstr_id
+        elif kind == MP_NATIVE_RELOC_OBJ:
+            return '(mp_uint_t)MP_OBJ_FROM_PTR(&%s)' % obj_name
+        else:
+            return '(mp_uint_t)&raw_code_%s' % arg.escaped_name
+
+    def freeze(self, parent_name):
+        if self.arch != MP_NATIVE_ARCH_XTENSAWIN:
+            raise FreezeError(self, 'freezing of native code is only implemented for xtensawin')
+        if self.simple_name is None:
+            self.escaped_name = make_escaped_name(parent_name + 'viper')
+        else:
+            self.escaped_name = make_escaped_name(parent_name + self.simple_name.qstr_esc)
+
+        # emit children first
+        for rc in self.raw_codes:
+            rc.freeze(self.escaped_name + '_')
+
+        # generate the constant objects that the code refers to
+        relocs = {}
+        n_obj = 0
+        for offset, kind, arg in self.relocs:
+            if offset % 4:
+                raise FreezeError(self, 'unaligned relocation at offset %u' % offset)
+            obj_name = None
+            if kind == MP_NATIVE_RELOC_OBJ:
+                obj_name = 'const_obj_%s_%u' % (self.escaped_name, n_obj)
+                n_obj += 1
+                freeze_const_obj(self, obj_name, arg)
+            relocs[offset] = self._reloc_value(kind, arg, obj_name)
+
+        # generate the machine code, as words so that the relocated ones can be
+        # linked against the firmware; it's placed where it can be executed
+        fun_data = bytes_cons(self.fun_data) + bytes_cons(-len(self.fun_data) % 4)
+        print()
+        if self.prelude is not None:
+            print('// frozen native code for file %s, scope %s%s'
+                % (self.source_file.str, parent_name, self.simple_name.str))
+        else:
+            print('// frozen viper code, scope %s<viper>' % parent_name)
+        print('STATIC const mp_uint_t fun_data_%s[%u] MP_PLAT_FROZEN_EXEC_ATTR = {'
+            % (self.escaped_name, len(fun_data) // 4))
+        for i in range(0, len(fun_data), 16):
+            words = []
+            for j in range(i, min(i + 16, len(fun_data)), 4):
+                if j in relocs:
+                    words.append(relocs[j])
+                else:
+                    words.append('0x%08x' % struct.unpack_from('<I', fun_data, j)[0])
+            print('    %s,' % ', '.join(words))
+        print('};')
+
+        # generate the constant table, which has the names of the arguments
+        # and then a pointer to the prelude, as made by the emitter
+        if self.prelude is not None:
+            ip, ip2, _ = extract_prelude(self.prelude)
+            print('STATIC const byte prelude_data_%s[%u] = {' % (self.escaped_name, ip))
+            print('   ', ''.join('0x%02x, ' % b for b in self.prelude[:ip2]))
+            print('   ', self.simple_name.qstr_id, '& 0xff,', self.simple_name.qstr_id, '>> 8,')
+            print('   ', self.source_file.qstr_id, '& 0xff,', self.source_file.qstr_id, '>> 8,')
+            print('   ', ''.join('0x%02x, ' % b for b in self.prelude[ip2 + 4:ip]))
+            print('};')
+            print('STATIC const mp_uint_t const_table_data_%s[%u] = {'
+                % (self.escaped_name, len(self.qstrs) + 1))
+            for qst in self.qstrs:
+                print('    (mp_uint_t)MP_OBJ_NEW_QSTR(%s),' % global_qstrs[qst].qstr_id)
+            print('    (mp_uint_t)prelude_data_%s,' % self.escaped_name)
+            print('};')
+
+        # generate the raw code
+        if self.simple_name is None or self.simple_name.str != '<module>':
+            print('STATIC ', end='')
+        print('const mp_raw_code_t raw_code_%s = {' % self.escaped_name)
+        print('    .kind = %s,' % ('MP_CODE_NATIVE_PY', 'MP_CODE_NATIVE_VIPER')[self.kind == MP_CODE_NATIVE_VIPER])
+        print('    .scope_flags = 0x%02x,' % self.scope_flags)
+        print('    .n_pos_args = %u,' % self.n_pos_args)
+        print('    .data.u_native = {')
+        print('        .fun_data = (void*)fun_data_%s,' % self.escaped_name)
+        if self.prelude is not None:
+            print('        .const_table = const_table_data_%s,' % self.escaped_name)
+        else:
+            print('        .const_table = NULL,')
+        print('        .type_sig = 0x%x,' % self.type_sig)
+        print('        #if MICROPY_PERSISTENT_CODE_SAVE')
+        print('        .fun_data_len = %u,' % len(self.fun_data))
+        print('        .n_reloc = 0,')
+        print('        .relocs = NULL,')
+        print('        #endif')
+        print('    },')
+        print('};')
+
 def read_uint(f):
     i = 0
     while True:
@@ -388,11 +1001,14 @@ def read_uint(f):
 
 global_qstrs = []
 qstr_type = namedtuple('qstr', ('str', 'qstr_esc', 'qstr_id'))
-def read_qstr(f):
-    ln = read_uint(f)
-    data = str_cons(f.read(ln), 'utf8')
+def make_qstr(data):
     qstr_esc = qstrutil.qstr_escape(data)
     global_qstrs.append(qstr_type(data, qstr_esc, 'MP_QSTR_' + qstr_esc))
+    return global_qstrs[-1]
+
+def read_qstr(f):
+    ln = read_uint(f)
+    make_qstr(str_cons(f.read(ln), 'utf8'))
     return len(global_qstrs) - 1
 
 def read_obj(f):
@@ -426,7 +1042,46 @@ def read_bytecode_qstrs(file, bytecode, ip):
             read_qstr_and_pack(file, bytecode, ip + 1)
         ip += sz
 
-def read_raw_code(f):
+def read_raw_code_native(f, kind):
+    fun_data = f.read(read_uint(f))
+    prelude = None
+    qstrs = []
+    if kind == MP_CODE_NATIVE_PY:
+        prelude = bytearray(f.read(read_uint(f)))
+        ip, ip2, prelude_info = extract_prelude(prelude)
+        read_qstr_and_pack(f, prelude, ip2) # simple_name
+        read_qstr_and_pack(f, prelude, ip2 + 2) # source_file
+        qstrs = [read_qstr(f) for _ in range(prelude_info[3] + prelude_info[4])]
+        n_pos_args = prelude_info[3]
+        type_sig = 0
+    else:
+        n_pos_args = read_uint(f)
+        type_sig = read_uint(f)
+    scope_flags = read_uint(f)
+    relocs = []
+    raw_codes = []
+    for _ in range(read_uint(f)):
+        offset = read_uint(f)
+        reloc_kind = bytes_cons(f.read(1))[0]
+        if reloc_kind in (MP_NATIVE_RELOC_QSTR, MP_NATIVE_RELOC_QSTR_OBJ):
+            arg = read_qstr(f)
+        elif reloc_kind == MP_NATIVE_RELOC_OBJ:
+            arg = read_obj(f)
+        elif reloc_kind == MP_NATIVE_RELOC_RAW_CODE:
+            arg = read_raw_code(f, True)
+            raw_codes.append(arg)
+        else:
+            arg = read_uint(f)
+        relocs.append((offset, reloc_kind, arg))
+    return RawCodeNative(kind, fun_data, prelude, qstrs, scope_flags, n_pos_args, type_sig, relocs, raw_codes)
+
+def read_raw_code(f, has_kind):
+    if has_kind:
+        kind = bytes_cons(f.read(1))[0]
+        if kind in (MP_CODE_NATIVE_PY, MP_CODE_NATIVE_VIPER):
+            return read_raw_code_native(f, kind)
+        if kind != MP_CODE_BYTECODE:
+            raise Exception('unsupported raw code kind %u' % kind)
     bc_len = read_uint(f)
     bytecode = bytearray(f.read(bc_len))
     ip, ip2, prelude = extract_prelude(bytecode)
@@ -437,7 +1092,7 @@ def read_raw_code(f):
     n_raw_code = read_uint(f)
     qstrs = [read_qstr(f) for _ in range(prelude[3] + prelude[4])]
     objs = [read_obj(f) for _ in range(n_obj)]
-    raw_codes = [read_raw_code(f) for _ in range(n_raw_code)]
+    raw_codes = [read_raw_code(f, has_kind) for _ in range(n_raw_code)]
     return RawCode(bytecode, qstrs, objs, raw_codes)
 
 def read_mpy(filename):
@@ -450,14 +1105,28 @@ def read_mpy(filename):
         feature_flags = header[2]
         config.MICROPY_OPT_CACHE_MAP_LOOKUP_IN_BYTECODE = (feature_flags & 1) != 0
         config.MICROPY_PY_BUILTINS_STR_UNICODE = (feature_flags & 2) != 0
+        config.MICROPY_OPT_BYTECODE_SUPERINSTRUCTIONS |= (feature_flags & 0x40) != 0
         config.mp_small_int_bits = header[3]
-        return read_raw_code(f)
+        # the upper bits hold the arch of any native code, in which case
+        # every raw code is prefixed by its kind
+        config.native_arch = (feature_flags >> 2) & 0xf
+        return read_raw_code(f, config.native_arch != MP_NATIVE_ARCH_NONE)
 
 def dump_mpy(raw_codes):
     for rc in raw_codes:
         rc.dump()
 
-def freeze_mpy(base_qstrs, raw_codes):
+def freeze_mpy(base_qstrs, raw_codes, rom_globals=False):
+    has_native = any(not isinstance(rc, RawCode) or rc._has_native() for rc in raw_codes)
+    if rom_globals:
+        module_names = []
+        for rc in raw_codes:
+            rc.find_static_globals()
+            name = rc.source_file.str[:-3]
+            if name.endswith('/__init__'):
+                name = name[:-9]
+            module_names.append(make_qstr(name.replace('/', '.')))
+
     # add to qstrs
     new = {}
     for q in global_qstrs:
@@ -471,13 +1140,41 @@ def freeze_mpy(base_qstrs, raw_codes):
     print('#include "py/objint.h"')
     print('#include "py/objstr.h"')
     print('#include "py/emitglue.h"')
+    if has_native:
+        print('#include "py/runtime0.h"')
+    if rom_globals:
+        print('#include "py/objfun.h"')
+        print('#include "py/objgenerator.h"')
+        print('#include "py/objtuple.h"')
+        print('#include "py/frozenmod.h"')
     print()
 
+    if rom_globals:
+        print('#if !MICROPY_MODULE_FROZEN_MPY_ROM_GLOBALS')
+        print('#error "MICROPY_MODULE_FROZEN_MPY_ROM_GLOBALS must be enabled for --rom-globals"')
+    else:
+        print('#if MICROPY_MODULE_FROZEN_MPY_ROM_GLOBALS')
+        print('#error "frozen modules must be built with mpy-tool.py --rom-globals"')
+    print('#endif')
+    print()
+
+    if has_native:
+        print('#if !MICROPY_EMIT_XTENSAWIN')
+        print('#error "frozen native code needs MICROPY_EMIT_XTENSAWIN"')
+        print('#endif')
+        print()
+
     print('#if MICROPY_OPT_CACHE_MAP_LOOKUP_IN_BYTECODE != %u' % config.MICROPY_OPT_CACHE_MAP_LOOKUP_IN_BYTECODE)
     print('#error "incompatible MICROPY_OPT_CACHE_MAP_LOOKUP_IN_BYTECODE"')
     print('#endif')
     print()
 
+    if config.MICROPY_OPT_BYTECODE_SUPERINSTRUCTIONS:
+        print('#if !MICROPY_OPT_BYTECODE_SUPERINSTRUCTIONS')
+        print('#error "frozen bytecode has superinstructions but MICROPY_OPT_BYTECODE_SUPERINSTRUCTIONS is disabled"')
+        print('#endif')
+        print()
+
     print('#if MICROPY_LONGINT_IMPL != %u' % config.MICROPY_LONGINT_IMPL)
     print('#error "incompatible MICROPY_LONGINT_IMPL"')
     print('#endif')
@@ -515,6 +1212,19 @@ def freeze_mpy(base_qstrs, raw_codes):
             print('    MP_QSTR_%s,' % new[i][1])
     print('};')
 
+    print()
+    print('#if MICROPY_QSTR_INDEX')
+    print('STATIC const uint16_t mp_qstr_frozen_const_index_slots[] = {')
+    slots = qstrutil.make_index(config.MICROPY_QSTR_BYTES_IN_HASH, [qstr for _, _, qstr in new])
+    for i in range(0, len(slots), 16):
+        print('    %s,' % ', '.join(str(x) for x in slots[i:i + 16]))
+    print('};')
+    print('STATIC const qstr_index_t mp_qstr_frozen_const_index = {')
+    print('    %u, // mask' % (len(slots) - 1))
+    print('    mp_qstr_frozen_const_index_slots,')
+    print('};')
+    print('#endif')
+
     print()
     print('extern const qstr_pool_t mp_qstr_const_pool;');
     print('const qstr_pool_t mp_qstr_frozen_const_pool = {')
@@ -522,6 +1232,9 @@ def freeze_mpy(base_qstrs, raw_codes):
     print('    MP_QSTRnumber_of, // previous pool size')
     print('    %u, // allocated entries' % len(new))
     print('    %u, // used entries' % len(new))
+    print('    #if MICROPY_QSTR_INDEX')
+    print('    &mp_qstr_frozen_const_index,')
+    print('    #endif')
     print('    {')
     for _, _, qstr in new:
         print('        %s,'
@@ -529,8 +1242,10 @@ def freeze_mpy(base_qstrs, raw_codes):
     print('    },')
     print('};')
 
-    for rc in raw_codes:
+    for i, rc in enumerate(raw_codes):
         rc.freeze(rc.source_file.str.replace('/', '_')[:-3] + '_')
+        if rom_globals and rc.static_globals:
+            rc.freeze_rom_globals(module_names[i])
 
     print()
     print('const char mp_frozen_mpy_names[] = {')
@@ -544,6 +1259,17 @@ def freeze_mpy(base_qstrs, raw_codes):
         print('    &raw_code_%s,' % rc.escaped_name)
     print('};')
 
+    if rom_globals:
+        print()
+        print('const mp_frozen_mpy_globals_t mp_frozen_mpy_globals[] = {')
+        for rc in raw_codes:
+            if rc.static_globals:
+                print('    {&rom_globals_%s, rom_globals_table_%s, %u, %s},'
+                    % (rc.escaped_name, rc.escaped_name, len(rc.static_globals) + 1, ('false', 'true')[rc.has_code]))
+            else:
+                print('    {NULL, NULL, 0, true},')
+        print('};')
+
 def main():
     import argparse
     cmd_parser = argparse.ArgumentParser(description='A tool to work with MicroPython .mpy files.')
@@ -557,6 +1283,8 @@ def main():
         help='long-int implementation used by target (default mpz)')
     cmd_parser.add_argument('-mmpz-dig-size', metavar='N', type=int, default=16,
         help='mpz digit size used by target (default 16)')
+    cmd_parser.add_argument('--rom-globals', action='store_true',
+        help='build the globals of frozen modules at freeze time, in ROM')
     cmd_parser.add_argument('files', nargs='+',
         help='input .mpy files')
     args = cmd_parser.parse_args()
@@ -585,7 +1313,7 @@ def main():
         dump_mpy(raw_codes)
     elif args.freeze:
         try:
-            freeze_mpy(base_qstrs, raw_codes)
+            freeze_mpy(base_qstrs, raw_codes, args.rom_globals)
         except FreezeError as er:
             print(er, file=sys.stderr)
             sys.exit(1)
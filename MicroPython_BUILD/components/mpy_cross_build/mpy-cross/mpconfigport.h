@@ -30,13 +30,15 @@
 #define MICROPY_PERSISTENT_CODE_LOAD (0)
 #define MICROPY_PERSISTENT_CODE_SAVE (1)
 
-#define MICROPY_EMIT_X64            (0)
+#define MICROPY_EMIT_X64            (1)
 #define MICROPY_EMIT_X86            (0)
 #define MICROPY_EMIT_THUMB          (0)
 #define MICROPY_EMIT_INLINE_THUMB   (0)
 #define MICROPY_EMIT_INLINE_THUMB_ARMV7M (0)
 #define MICROPY_EMIT_INLINE_THUMB_FLOAT (0)
 #define MICROPY_EMIT_ARM            (0)
+#define MICROPY_EMIT_XTENSAWIN      (1)
+#define MICROPY_EMIT_NATIVE_PRELUDE_SEPARATE (1)
 
 #define MICROPY_DYNAMIC_COMPILER    (1)
 #define MICROPY_COMP_CONST_FOLDING  (1)
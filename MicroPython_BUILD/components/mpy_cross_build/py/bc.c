@@ -291,11 +291,12 @@ continue2:;
 //     MP_BC_MAKE_CLOSURE
 //     MP_BC_MAKE_CLOSURE_DEFARGS
 //     MP_BC_RAISE_VARARGS
-// There are 4 special opcodes that have an extra byte only when
+// There are 5 special opcodes that have an extra byte only when
 // MICROPY_OPT_CACHE_MAP_LOOKUP_IN_BYTECODE is enabled:
 //     MP_BC_LOAD_NAME
 //     MP_BC_LOAD_GLOBAL
 //     MP_BC_LOAD_ATTR
+//     MP_BC_LOAD_METHOD
 //     MP_BC_STORE_ATTR
 #define OC4(a, b, c, d) (a | (b << 2) | (c << 4) | (d << 6))
 #define U (0) // undefined opcode
@@ -315,10 +316,10 @@ STATIC const byte opcode_format_table[64] = {
     OC4(B, B, V, V), // 0x20-0x23
     OC4(Q, Q, Q, B), // 0x24-0x27
     OC4(V, V, Q, Q), // 0x28-0x2b
-    OC4(U, U, U, U), // 0x2c-0x2f
+    OC4(Q, Q, B, U), // 0x2c-0x2f
     OC4(B, B, B, B), // 0x30-0x33
     OC4(B, O, O, O), // 0x34-0x37
-    OC4(O, O, U, U), // 0x38-0x3b
+    OC4(O, O, O, O), // 0x38-0x3b
     OC4(U, O, B, O), // 0x3c-0x3f
     OC4(O, B, B, O), // 0x40-0x43
     OC4(B, B, O, B), // 0x44-0x47
@@ -386,19 +387,33 @@ uint mp_opcode_format(const byte *ip, size_t *opcode_size) {
     uint f = (opcode_format_table[*ip >> 2] >> (2 * (*ip & 3))) & 3;
     const byte *ip_start = ip;
     if (f == MP_OPCODE_QSTR) {
+        // superinstructions that load a local have its number after the qstr
+        int extra_byte = (*ip == MP_BC_LOAD_FAST_ATTR || *ip == MP_BC_LOAD_FAST_METHOD);
+        if (MICROPY_OPT_CACHE_MAP_LOOKUP_IN_BYTECODE_DYNAMIC) {
+            if (*ip == MP_BC_LOAD_NAME
+                || *ip == MP_BC_LOAD_GLOBAL
+                || *ip == MP_BC_LOAD_ATTR
+                || *ip == MP_BC_LOAD_METHOD
+                || *ip == MP_BC_STORE_ATTR
+                || *ip == MP_BC_LOAD_FAST_ATTR
+                || *ip == MP_BC_LOAD_FAST_METHOD) {
+                extra_byte += 1;
+            }
+        }
+        ip += extra_byte;
         ip += 3;
     } else {
         int extra_byte = (
             *ip == MP_BC_RAISE_VARARGS
             || *ip == MP_BC_MAKE_CLOSURE
             || *ip == MP_BC_MAKE_CLOSURE_DEFARGS
-            #if MICROPY_OPT_CACHE_MAP_LOOKUP_IN_BYTECODE
-            || *ip == MP_BC_LOAD_NAME
-            || *ip == MP_BC_LOAD_GLOBAL
-            || *ip == MP_BC_LOAD_ATTR
-            || *ip == MP_BC_STORE_ATTR
-            #endif
+            || *ip == MP_BC_POP_JUMP_IF_TRUE_COMPARE
+            || *ip == MP_BC_POP_JUMP_IF_FALSE_COMPARE
         );
+        if (*ip == MP_BC_BINARY_OP_FAST_SMALL_INT) {
+            // local number, binary op and small int
+            extra_byte = 3;
+        }
         ip += 1;
         if (f == MP_OPCODE_VAR_UINT) {
             while ((*ip++ & 0x80) != 0) {
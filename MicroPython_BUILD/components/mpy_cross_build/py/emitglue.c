@@ -55,7 +55,10 @@ mp_raw_code_t *mp_emit_glue_new_raw_code(void) {
     return rc;
 }
 
-void mp_emit_glue_assign_bytecode(mp_raw_code_t *rc, const byte *code, mp_uint_t len,
+void mp_emit_glue_assign_bytecode(mp_raw_code_t *rc, const byte *code,
+    #if MICROPY_PERSISTENT_CODE_SAVE || MICROPY_DEBUG_PRINTERS
+    size_t len,
+    #endif
     const mp_uint_t *const_table,
     #if MICROPY_PERSISTENT_CODE_SAVE
     uint16_t n_obj, uint16_t n_raw_code,
@@ -83,7 +86,11 @@ void mp_emit_glue_assign_bytecode(mp_raw_code_t *rc, const byte *code, mp_uint_t
 }
 
 #if MICROPY_EMIT_NATIVE || MICROPY_EMIT_INLINE_ASM
-void mp_emit_glue_assign_native(mp_raw_code_t *rc, mp_raw_code_kind_t kind, void *fun_data, mp_uint_t fun_len, const mp_uint_t *const_table, mp_uint_t n_pos_args, mp_uint_t scope_flags, mp_uint_t type_sig) {
+void mp_emit_glue_assign_native(mp_raw_code_t *rc, mp_raw_code_kind_t kind, void *fun_data, mp_uint_t fun_len, const mp_uint_t *const_table,
+    #if MICROPY_PERSISTENT_CODE_SAVE
+    uint16_t n_reloc, mp_native_reloc_t *relocs,
+    #endif
+    mp_uint_t n_pos_args, mp_uint_t scope_flags, mp_uint_t type_sig) {
     assert(kind == MP_CODE_NATIVE_PY || kind == MP_CODE_NATIVE_VIPER || kind == MP_CODE_NATIVE_ASM);
     rc->kind = kind;
     rc->scope_flags = scope_flags;
@@ -91,6 +98,11 @@ void mp_emit_glue_assign_native(mp_raw_code_t *rc, mp_raw_code_kind_t kind, void
     rc->data.u_native.fun_data = fun_data;
     rc->data.u_native.const_table = const_table;
     rc->data.u_native.type_sig = type_sig;
+    #if MICROPY_PERSISTENT_CODE_SAVE
+    rc->data.u_native.fun_data_len = fun_len;
+    rc->data.u_native.n_reloc = n_reloc;
+    rc->data.u_native.relocs = relocs;
+    #endif
 
 #ifdef DEBUG_PRINT
     DEBUG_printf("assign native: kind=%d fun=%p len=" UINT_FMT " n_pos_args=" UINT_FMT " flags=%x\n", kind, fun_data, fun_len, n_pos_args, (uint)scope_flags);
@@ -113,6 +125,43 @@ void mp_emit_glue_assign_native(mp_raw_code_t *rc, mp_raw_code_kind_t kind, void
 }
 #endif
 
+#if MICROPY_EMIT_NATIVE
+// Native functions with their prelude outside the machine code (see
+// MICROPY_EMIT_NATIVE_PRELUDE_SEPARATE) have a constant table made of the
+// argument names, then a pointer to the prelude, then the prelude itself.
+// The caller must fill in the n_arg_names argument names.
+mp_uint_t *mp_emit_glue_new_native_const_table(size_t n_arg_names, const byte *prelude, size_t prelude_len) {
+    mp_uint_t *ct = m_new(mp_uint_t, n_arg_names + 1 + (prelude_len + sizeof(mp_uint_t) - 1) / sizeof(mp_uint_t));
+    ct[n_arg_names] = (mp_uint_t)&ct[n_arg_names + 1];
+    memcpy(&ct[n_arg_names + 1], prelude, prelude_len);
+    return ct;
+}
+
+// Returns the value of a machine word of native code that was recorded as a
+// relocation; the emitter and the .mpy loader must agree on this
+mp_uint_t mp_native_reloc_value(mp_native_reloc_kind_t kind, mp_uint_t arg) {
+    switch (kind) {
+        case MP_NATIVE_RELOC_FUN_TABLE:
+            return (mp_uint_t)mp_fun_table;
+        case MP_NATIVE_RELOC_CONST: {
+            static const mp_obj_t consts[] = {
+                [MP_NATIVE_CONST_NONE] = mp_const_none,
+                [MP_NATIVE_CONST_FALSE] = mp_const_false,
+                [MP_NATIVE_CONST_TRUE] = mp_const_true,
+                [MP_NATIVE_CONST_ELLIPSIS] = MP_OBJ_FROM_PTR(&mp_const_ellipsis_obj),
+            };
+            assert(arg < MP_ARRAY_SIZE(consts));
+            return (mp_uint_t)consts[arg];
+        }
+        case MP_NATIVE_RELOC_QSTR_OBJ:
+            return (mp_uint_t)MP_OBJ_NEW_QSTR(arg);
+        default:
+            // a qstr, an object or a raw code is its own value
+            return arg;
+    }
+}
+#endif
+
 mp_obj_t mp_make_function_from_raw_code(const mp_raw_code_t *rc, mp_obj_t def_args, mp_obj_t def_kw_args) {
     DEBUG_OP_printf("make_function_from_raw_code %p\n", rc);
     assert(rc != NULL);
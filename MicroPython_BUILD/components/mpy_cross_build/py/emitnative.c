@@ -62,97 +62,52 @@
     || (MICROPY_EMIT_THUMB && N_THUMB) \
     || (MICROPY_EMIT_ARM && N_ARM) \
     || (MICROPY_EMIT_XTENSA && N_XTENSA) \
+    || (MICROPY_EMIT_XTENSAWIN && N_XTENSAWIN) \
 
-// this is defined so that the assembler exports generic assembler API macros
-#define GENERIC_ASM_API (1)
-
-#if N_X64
-
-// x64 specific stuff
-#include "py/asmx64.h"
-#define EXPORT_FUN(name) emit_native_x64_##name
-
-#elif N_X86
-
-// x86 specific stuff
-
-STATIC byte mp_f_n_args[MP_F_NUMBER_OF] = {
-    [MP_F_CONVERT_OBJ_TO_NATIVE] = 2,
-    [MP_F_CONVERT_NATIVE_TO_OBJ] = 2,
-    [MP_F_LOAD_NAME] = 1,
-    [MP_F_LOAD_GLOBAL] = 1,
-    [MP_F_LOAD_BUILD_CLASS] = 0,
-    [MP_F_LOAD_ATTR] = 2,
-    [MP_F_LOAD_METHOD] = 3,
-    [MP_F_LOAD_SUPER_METHOD] = 2,
-    [MP_F_STORE_NAME] = 2,
-    [MP_F_STORE_GLOBAL] = 2,
-    [MP_F_STORE_ATTR] = 3,
-    [MP_F_OBJ_SUBSCR] = 3,
-    [MP_F_OBJ_IS_TRUE] = 1,
-    [MP_F_UNARY_OP] = 2,
-    [MP_F_BINARY_OP] = 3,
-    [MP_F_BUILD_TUPLE] = 2,
-    [MP_F_BUILD_LIST] = 2,
-    [MP_F_LIST_APPEND] = 2,
-    [MP_F_BUILD_MAP] = 1,
-    [MP_F_STORE_MAP] = 3,
-#if MICROPY_PY_BUILTINS_SET
-    [MP_F_BUILD_SET] = 2,
-    [MP_F_STORE_SET] = 2,
-#endif
-    [MP_F_MAKE_FUNCTION_FROM_RAW_CODE] = 3,
-    [MP_F_NATIVE_CALL_FUNCTION_N_KW] = 3,
-    [MP_F_CALL_METHOD_N_KW] = 3,
-    [MP_F_CALL_METHOD_N_KW_VAR] = 3,
-    [MP_F_NATIVE_GETITER] = 2,
-    [MP_F_NATIVE_ITERNEXT] = 1,
-    [MP_F_NLR_PUSH] = 1,
-    [MP_F_NLR_POP] = 0,
-    [MP_F_NATIVE_RAISE] = 1,
-    [MP_F_IMPORT_NAME] = 3,
-    [MP_F_IMPORT_FROM] = 2,
-    [MP_F_IMPORT_ALL] = 1,
-#if MICROPY_PY_BUILTINS_SLICE
-    [MP_F_NEW_SLICE] = 3,
+// Some architectures (eg windowed Xtensa) receive the arguments of the function
+// being emitted in different registers to those used to pass arguments to callees
+#ifdef REG_PARENT_ARG_1
+#define N_PARENT_ARG_REGS (1)
+#else
+#define N_PARENT_ARG_REGS (0)
+#define REG_PARENT_ARG_1 REG_ARG_1
+#define REG_PARENT_ARG_2 REG_ARG_2
+#define REG_PARENT_ARG_3 REG_ARG_3
+#define REG_PARENT_ARG_4 REG_ARG_4
 #endif
-    [MP_F_UNPACK_SEQUENCE] = 3,
-    [MP_F_UNPACK_EX] = 3,
-    [MP_F_DELETE_NAME] = 1,
-    [MP_F_DELETE_GLOBAL] = 1,
-    [MP_F_NEW_CELL] = 1,
-    [MP_F_MAKE_CLOSURE_FROM_RAW_CODE] = 3,
-    [MP_F_SETUP_CODE_STATE] = 5,
-    [MP_F_SMALL_INT_FLOOR_DIVIDE] = 2,
-    [MP_F_SMALL_INT_MODULO] = 2,
-};
-
-#include "py/asmx86.h"
-#define EXPORT_FUN(name) emit_native_x86_##name
-
-#elif N_THUMB
-
-// thumb specific stuff
-#include "py/asmthumb.h"
-#define EXPORT_FUN(name) emit_native_thumb_##name
-
-#elif N_ARM
-
-// ARM specific stuff
-#include "py/asmarm.h"
-#define EXPORT_FUN(name) emit_native_arm_##name
-
-#elif N_XTENSA
-
-// Xtensa specific stuff
-#include "py/asmxtensa.h"
-#define EXPORT_FUN(name) emit_native_xtensa_##name
 
+// Native code saved to a .mpy file must not depend on the firmware that
+// compiled it: calls go through mp_fun_table held in REG_FUN_TABLE, and each
+// remaining firmware-specific word is emitted at a fixed place in the code
+// and recorded as a relocation (see emit_native_mov_reg_reloc)
+#if MICROPY_PERSISTENT_CODE_SAVE && MICROPY_EMIT_NATIVE_PRELUDE_SEPARATE \
+    && defined(REG_FUN_TABLE) && defined(ASM_MOV_REG_IMM_FIX_WORD)
+#define N_RELOC (1)
 #else
+#define N_RELOC (0)
+#endif
 
-#error unknown native emitter
-
+// Layout of nlr_buf_t on the target, which differs from that of the host
+// when cross-compiling; the jmp_buf (or saved registers) follows prev and
+// ret_val
+#if MICROPY_DYNAMIC_COMPILER && N_XTENSAWIN
+#define N_NLR_SETJMP (1)
+#define N_NLR_BUF_WORDS (2 + 17) // windowed newlib jmp_buf
+#elif MICROPY_DYNAMIC_COMPILER && N_X64
+#define N_NLR_SETJMP (0)
+#define N_NLR_BUF_WORDS (2 + 8) // registers saved by nlrx64.c
+#else
+#define N_NLR_SETJMP (MICROPY_NLR_SETJMP)
+#define N_NLR_BUF_WORDS (sizeof(nlr_buf_t) / sizeof(mp_uint_t))
 #endif
+#define N_NLR_JMPBUF_WORD (2)
+
+// define additional generic helper macros
+#define ASM_MOV_LOCAL_IMM_VIA(as, local_num, imm, reg_temp) \
+    do { \
+        ASM_MOV_REG_IMM((as), (reg_temp), (imm)); \
+        ASM_MOV_LOCAL_REG((as), (local_num), (reg_temp)); \
+    } while (false)
 
 #define EMIT_NATIVE_VIPER_TYPE_ERROR(emit, ...) do { \
         *emit->error_slot = mp_obj_new_exception_msg_varg(&mp_type_ViperTypeError, __VA_ARGS__); \
@@ -205,6 +160,15 @@ typedef struct _stack_info_t {
     } data;
 } stack_info_t;
 
+// the kind of try or with block some code is in; the nlr_buf of the first
+// three is still pushed, so it must be popped by a return, break or continue
+typedef enum {
+    BLOCK_EXCEPT,
+    BLOCK_FINALLY,
+    BLOCK_WITH,
+    BLOCK_HANDLER, // except handler or finally body, the nlr_buf is popped
+} block_kind_t;
+
 struct _emit_t {
     mp_obj_t *error_slot;
     int pass;
@@ -226,10 +190,20 @@ struct _emit_t {
     int stack_start;
     int stack_size;
 
+    mp_uint_t block_alloc;
+    mp_uint_t block_depth;
+    byte *block_kind;
+
     bool last_emit_was_return_value;
 
     scope_t *scope;
 
+    #if N_RELOC
+    size_t reloc_alloc;
+    size_t reloc_len;
+    mp_native_reloc_t *relocs;
+    #endif
+
     ASM_T *as;
 };
 
@@ -246,6 +220,10 @@ void EXPORT_FUN(free)(emit_t *emit) {
     m_del_obj(ASM_T, emit->as);
     m_del(vtype_kind_t, emit->local_vtype, emit->local_vtype_alloc);
     m_del(stack_info_t, emit->stack_info, emit->stack_info_alloc);
+    m_del(byte, emit->block_kind, emit->block_alloc);
+    #if N_RELOC
+    m_del(mp_native_reloc_t, emit->relocs, emit->reloc_alloc);
+    #endif
     m_del_obj(emit_t, emit);
 }
 
@@ -283,6 +261,7 @@ STATIC void emit_pre_pop_reg(emit_t *emit, vtype_kind_t *vtype, int reg_dest);
 STATIC void emit_post_push_reg(emit_t *emit, vtype_kind_t vtype, int reg);
 STATIC void emit_native_load_fast(emit_t *emit, qstr qst, mp_uint_t local_num);
 STATIC void emit_native_store_fast(emit_t *emit, qstr qst, mp_uint_t local_num);
+STATIC void emit_native_mov_reg_reloc(emit_t *emit, int reg_dest, mp_native_reloc_kind_t kind, mp_uint_t arg);
 
 #define STATE_START (sizeof(mp_code_state_t) / sizeof(mp_uint_t))
 
@@ -292,6 +271,7 @@ STATIC void emit_native_start_pass(emit_t *emit, pass_kind_t pass, scope_t *scop
     emit->pass = pass;
     emit->stack_start = 0;
     emit->stack_size = 0;
+    emit->block_depth = 0;
     emit->last_emit_was_return_value = false;
     emit->scope = scope;
 
@@ -364,6 +344,8 @@ STATIC void emit_native_start_pass(emit_t *emit, pass_kind_t pass, scope_t *scop
         asm_thumb_mov_reg_i32(emit->as, ASM_THUMB_REG_R7, (mp_uint_t)mp_fun_table);
         #elif N_ARM
         asm_arm_mov_reg_i32(emit->as, ASM_ARM_REG_R7, (mp_uint_t)mp_fun_table);
+        #elif defined(REG_FUN_TABLE)
+        emit_native_mov_reg_reloc(emit, REG_FUN_TABLE, MP_NATIVE_RELOC_FUN_TABLE, 0);
         #endif
 
         #if N_X86
@@ -380,16 +362,18 @@ STATIC void emit_native_start_pass(emit_t *emit, pass_kind_t pass, scope_t *scop
             }
         }
         #else
-        for (int i = 0; i < scope->num_pos_args; i++) {
+        // go in reverse order so an argument register is not overwritten
+        // before it is read, in case the local registers overlap with them
+        for (int i = scope->num_pos_args - 1; i >= 0; i--) {
             if (i == 0) {
-                ASM_MOV_REG_REG(emit->as, REG_LOCAL_1, REG_ARG_1);
+                ASM_MOV_REG_REG(emit->as, REG_LOCAL_1, REG_PARENT_ARG_1);
             } else if (i == 1) {
-                ASM_MOV_REG_REG(emit->as, REG_LOCAL_2, REG_ARG_2);
+                ASM_MOV_REG_REG(emit->as, REG_LOCAL_2, REG_PARENT_ARG_2);
             } else if (i == 2) {
-                ASM_MOV_REG_REG(emit->as, REG_LOCAL_3, REG_ARG_3);
+                ASM_MOV_REG_REG(emit->as, REG_LOCAL_3, REG_PARENT_ARG_3);
             } else {
                 assert(i == 3); // should be true; max 4 args is checked above
-                ASM_MOV_REG_TO_LOCAL(emit->as, REG_ARG_4, i - REG_LOCAL_NUM);
+                ASM_MOV_LOCAL_REG(emit->as, i - REG_LOCAL_NUM, REG_PARENT_ARG_4);
             }
         }
         #endif
@@ -406,6 +390,8 @@ STATIC void emit_native_start_pass(emit_t *emit, pass_kind_t pass, scope_t *scop
         asm_thumb_mov_reg_i32(emit->as, ASM_THUMB_REG_R7, (mp_uint_t)mp_fun_table);
         #elif N_ARM
         asm_arm_mov_reg_i32(emit->as, ASM_ARM_REG_R7, (mp_uint_t)mp_fun_table);
+        #elif defined(REG_FUN_TABLE)
+        emit_native_mov_reg_reloc(emit, REG_FUN_TABLE, MP_NATIVE_RELOC_FUN_TABLE, 0);
         #endif
 
         // prepare incoming arguments for call to mp_setup_code_state
@@ -418,14 +404,31 @@ STATIC void emit_native_start_pass(emit_t *emit, pass_kind_t pass, scope_t *scop
         #endif
 
         // set code_state.fun_bc
-        ASM_MOV_REG_TO_LOCAL(emit->as, REG_ARG_1, offsetof(mp_code_state_t, fun_bc) / sizeof(uintptr_t));
+        ASM_MOV_LOCAL_REG(emit->as, offsetof(mp_code_state_t, fun_bc) / sizeof(uintptr_t), REG_PARENT_ARG_1);
+
+        #if N_PARENT_ARG_REGS
+        // pass n_args, n_kw and args through to mp_setup_code_state
+        ASM_MOV_REG_REG(emit->as, REG_ARG_2, REG_PARENT_ARG_2);
+        ASM_MOV_REG_REG(emit->as, REG_ARG_3, REG_PARENT_ARG_3);
+        ASM_MOV_REG_REG(emit->as, REG_ARG_4, REG_PARENT_ARG_4);
+        #endif
 
+        #if MICROPY_EMIT_NATIVE_PRELUDE_SEPARATE
+        // set code_state.ip to the offset of the prelude from fun_bc->bytecode,
+        // with the prelude pointer taken from the end of the constant table
+        ASM_LOAD_REG_REG_OFFSET(emit->as, REG_LOCAL_1, REG_PARENT_ARG_1, offsetof(mp_obj_fun_bc_t, const_table) / sizeof(uintptr_t));
+        ASM_LOAD_REG_REG_OFFSET(emit->as, REG_LOCAL_1, REG_LOCAL_1, scope->num_pos_args + scope->num_kwonly_args);
+        ASM_LOAD_REG_REG_OFFSET(emit->as, REG_PARENT_ARG_1, REG_PARENT_ARG_1, offsetof(mp_obj_fun_bc_t, bytecode) / sizeof(uintptr_t));
+        ASM_SUB_REG_REG(emit->as, REG_LOCAL_1, REG_PARENT_ARG_1);
+        ASM_MOV_LOCAL_REG(emit->as, offsetof(mp_code_state_t, ip) / sizeof(uintptr_t), REG_LOCAL_1);
+        #else
         // set code_state.ip (offset from start of this function to prelude info)
         // XXX this encoding may change size
-        ASM_MOV_IMM_TO_LOCAL_USING(emit->as, emit->prelude_offset, offsetof(mp_code_state_t, ip) / sizeof(uintptr_t), REG_ARG_1);
+        ASM_MOV_LOCAL_IMM_VIA(emit->as, offsetof(mp_code_state_t, ip) / sizeof(uintptr_t), emit->prelude_offset, REG_ARG_1);
+        #endif
 
         // put address of code_state into first arg
-        ASM_MOV_LOCAL_ADDR_TO_REG(emit->as, 0, REG_ARG_1);
+        ASM_MOV_REG_LOCAL_ADDR(emit->as, REG_ARG_1, 0);
 
         // call mp_setup_code_state to prepare code_state structure
         #if N_THUMB
@@ -438,11 +441,11 @@ STATIC void emit_native_start_pass(emit_t *emit, pass_kind_t pass, scope_t *scop
 
         // cache some locals in registers
         if (scope->num_locals > 0) {
-            ASM_MOV_LOCAL_TO_REG(emit->as, STATE_START + emit->n_state - 1 - 0, REG_LOCAL_1);
+            ASM_MOV_REG_LOCAL(emit->as, REG_LOCAL_1, STATE_START + emit->n_state - 1 - 0);
             if (scope->num_locals > 1) {
-                ASM_MOV_LOCAL_TO_REG(emit->as, STATE_START + emit->n_state - 1 - 1, REG_LOCAL_2);
+                ASM_MOV_REG_LOCAL(emit->as, REG_LOCAL_2, STATE_START + emit->n_state - 1 - 1);
                 if (scope->num_locals > 2) {
-                    ASM_MOV_LOCAL_TO_REG(emit->as, STATE_START + emit->n_state - 1 - 2, REG_LOCAL_3);
+                    ASM_MOV_REG_LOCAL(emit->as, REG_LOCAL_3, STATE_START + emit->n_state - 1 - 2);
                 }
             }
         }
@@ -519,8 +522,32 @@ STATIC void emit_native_end_pass(emit_t *emit) {
     assert(emit->stack_size == 0);
 
     if (emit->pass == MP_PASS_EMIT) {
+        const mp_uint_t *const_table = NULL;
+
+        #if MICROPY_EMIT_NATIVE_PRELUDE_SEPARATE
+        if (!emit->do_viper_types) {
+            // copy the argument names and the prelude out of the executable
+            // memory into a heap block, with a pointer to the prelude (which
+            // is what the entry code loads) stored after the argument names
+            const byte *code = emit->as->base.code_base;
+            size_t n_arg_names = emit->scope->num_pos_args + emit->scope->num_kwonly_args;
+            mp_uint_t *ct = mp_emit_glue_new_native_const_table(n_arg_names,
+                code + emit->prelude_offset, emit->const_table_offset - emit->prelude_offset);
+            // the entries are target words, which may be narrower than a
+            // host word when cross-compiling
+            for (size_t i = 0; i < n_arg_names; ++i) {
+                ct[i] = 0;
+                memcpy(&ct[i], code + emit->const_table_offset + i * ASM_WORD_SIZE, ASM_WORD_SIZE);
+            }
+            const_table = ct;
+        }
+        #endif
+
         void *f = mp_asm_base_get_code(&emit->as->base);
         mp_uint_t f_len = mp_asm_base_get_code_size(&emit->as->base);
+        if (const_table == NULL) {
+            const_table = (mp_uint_t*)((byte*)f + emit->const_table_offset);
+        }
 
         // compute type signature
         // note that the lower 4 bits of a vtype are tho correct MP_NATIVE_TYPE_xxx
@@ -529,9 +556,29 @@ STATIC void emit_native_end_pass(emit_t *emit) {
             type_sig |= (emit->local_vtype[i] & 0xf) << (i * 4 + 4);
         }
 
+        #if N_RELOC
+        // hand the relocations over to the raw code, and only keep the
+        // machine code (not the prelude) for saving
+        mp_native_reloc_t *relocs = m_renew(mp_native_reloc_t, emit->relocs, emit->reloc_alloc, emit->reloc_len);
+        size_t n_reloc = emit->reloc_len;
+        emit->reloc_alloc = 0;
+        emit->reloc_len = 0;
+        emit->relocs = NULL;
+        if (!emit->do_viper_types) {
+            f_len = emit->prelude_offset;
+        }
+        #endif
+
         mp_emit_glue_assign_native(emit->scope->raw_code,
             emit->do_viper_types ? MP_CODE_NATIVE_VIPER : MP_CODE_NATIVE_PY,
-            f, f_len, (mp_uint_t*)((byte*)f + emit->const_table_offset),
+            f, f_len, const_table,
+            #if MICROPY_PERSISTENT_CODE_SAVE
+            #if N_RELOC
+            n_reloc, relocs,
+            #else
+            0, NULL,
+            #endif
+            #endif
             emit->scope->num_pos_args, emit->scope->scope_flags, type_sig);
     }
 }
@@ -606,7 +653,7 @@ STATIC void need_reg_single(emit_t *emit, int reg_needed, int skip_stack_pos) {
             stack_info_t *si = &emit->stack_info[i];
             if (si->kind == STACK_REG && si->data.u_reg == reg_needed) {
                 si->kind = STACK_VALUE;
-                ASM_MOV_REG_TO_LOCAL(emit->as, si->data.u_reg, emit->stack_start + i);
+                ASM_MOV_LOCAL_REG(emit->as, emit->stack_start + i, si->data.u_reg);
             }
         }
     }
@@ -617,7 +664,7 @@ STATIC void need_reg_all(emit_t *emit) {
         stack_info_t *si = &emit->stack_info[i];
         if (si->kind == STACK_REG) {
             si->kind = STACK_VALUE;
-            ASM_MOV_REG_TO_LOCAL(emit->as, si->data.u_reg, emit->stack_start + i);
+            ASM_MOV_LOCAL_REG(emit->as, emit->stack_start + i, si->data.u_reg);
         }
     }
 }
@@ -629,7 +676,7 @@ STATIC void need_stack_settled(emit_t *emit) {
         if (si->kind == STACK_REG) {
             DEBUG_printf("    reg(%u) to local(%u)\n", si->data.u_reg, emit->stack_start + i);
             si->kind = STACK_VALUE;
-            ASM_MOV_REG_TO_LOCAL(emit->as, si->data.u_reg, emit->stack_start + i);
+            ASM_MOV_LOCAL_REG(emit->as, emit->stack_start + i, si->data.u_reg);
         }
     }
     for (int i = 0; i < emit->stack_size; i++) {
@@ -637,7 +684,7 @@ STATIC void need_stack_settled(emit_t *emit) {
         if (si->kind == STACK_IMM) {
             DEBUG_printf("    imm(" INT_FMT ") to local(%u)\n", si->data.u_imm, emit->stack_start + i);
             si->kind = STACK_VALUE;
-            ASM_MOV_IMM_TO_LOCAL_USING(emit->as, si->data.u_imm, emit->stack_start + i, REG_TEMP0);
+            ASM_MOV_LOCAL_IMM_VIA(emit->as, emit->stack_start + i, si->data.u_imm, REG_TEMP0);
         }
     }
 }
@@ -649,7 +696,7 @@ STATIC void emit_access_stack(emit_t *emit, int pos, vtype_kind_t *vtype, int re
     *vtype = si->vtype;
     switch (si->kind) {
         case STACK_VALUE:
-            ASM_MOV_LOCAL_TO_REG(emit->as, emit->stack_start + emit->stack_size - pos, reg_dest);
+            ASM_MOV_REG_LOCAL(emit->as, reg_dest, emit->stack_start + emit->stack_size - pos);
             break;
 
         case STACK_REG:
@@ -659,7 +706,7 @@ STATIC void emit_access_stack(emit_t *emit, int pos, vtype_kind_t *vtype, int re
             break;
 
         case STACK_IMM:
-            ASM_MOV_IMM_TO_REG(emit->as, si->data.u_imm, reg_dest);
+            ASM_MOV_REG_IMM(emit->as, reg_dest, si->data.u_imm);
             break;
     }
 }
@@ -671,7 +718,7 @@ STATIC void emit_fold_stack_top(emit_t *emit, int reg_dest) {
     si[0] = si[1];
     if (si->kind == STACK_VALUE) {
         // if folded element was on the stack we need to put it in a register
-        ASM_MOV_LOCAL_TO_REG(emit->as, emit->stack_start + emit->stack_size - 1, reg_dest);
+        ASM_MOV_REG_LOCAL(emit->as, reg_dest, emit->stack_start + emit->stack_size - 1);
         si->kind = STACK_REG;
         si->data.u_reg = reg_dest;
     }
@@ -758,6 +805,50 @@ STATIC void emit_post_push_reg_reg_reg_reg(emit_t *emit, vtype_kind_t vtypea, in
     emit_post_push_reg(emit, vtyped, regd);
 }
 
+#if N_RELOC
+STATIC void emit_native_add_reloc(emit_t *emit, size_t offset, mp_native_reloc_kind_t kind, mp_uint_t arg) {
+    // the code only has its final layout in the last pass
+    if (emit->pass != MP_PASS_EMIT) {
+        return;
+    }
+    if (emit->reloc_len >= emit->reloc_alloc) {
+        emit->relocs = m_renew(mp_native_reloc_t, emit->relocs, emit->reloc_alloc, emit->reloc_alloc + 16);
+        emit->reloc_alloc += 16;
+    }
+    mp_native_reloc_t *r = &emit->relocs[emit->reloc_len++];
+    r->offset = offset;
+    r->kind = kind;
+    r->arg = arg;
+}
+#endif
+
+// loads a word whose value depends on the firmware running the code
+STATIC void emit_native_mov_reg_reloc(emit_t *emit, int reg_dest, mp_native_reloc_kind_t kind, mp_uint_t arg) {
+    mp_uint_t val = mp_native_reloc_value(kind, arg);
+    #if N_RELOC
+    size_t offset = ASM_MOV_REG_IMM_FIX_WORD(emit->as, reg_dest, val);
+    emit_native_add_reloc(emit, offset, kind, arg);
+    #else
+    if (kind == MP_NATIVE_RELOC_OBJ || kind == MP_NATIVE_RELOC_RAW_CODE) {
+        // stored aligned on a mp_uint_t boundary so the GC can find it
+        ASM_MOV_REG_ALIGNED_IMM(emit->as, reg_dest, val);
+    } else {
+        ASM_MOV_REG_IMM(emit->as, reg_dest, val);
+    }
+    #endif
+}
+
+STATIC void emit_post_push_reloc(emit_t *emit, vtype_kind_t vtype, mp_native_reloc_kind_t kind, mp_uint_t arg) {
+    #if N_RELOC
+    // the word must be emitted now to know where it is, so can't be an immediate
+    need_reg_single(emit, REG_TEMP0, 0);
+    emit_native_mov_reg_reloc(emit, REG_TEMP0, kind, arg);
+    emit_post_push_reg(emit, vtype, REG_TEMP0);
+    #else
+    emit_post_push_imm(emit, vtype, mp_native_reloc_value(kind, arg));
+    #endif
+}
+
 STATIC void emit_call(emit_t *emit, mp_fun_kind_t fun_kind) {
     need_reg_all(emit);
     ASM_CALL_IND(emit->as, mp_fun_table[fun_kind], fun_kind);
@@ -765,30 +856,20 @@ STATIC void emit_call(emit_t *emit, mp_fun_kind_t fun_kind) {
 
 STATIC void emit_call_with_imm_arg(emit_t *emit, mp_fun_kind_t fun_kind, mp_int_t arg_val, int arg_reg) {
     need_reg_all(emit);
-    ASM_MOV_IMM_TO_REG(emit->as, arg_val, arg_reg);
+    ASM_MOV_REG_IMM(emit->as, arg_reg, arg_val);
     ASM_CALL_IND(emit->as, mp_fun_table[fun_kind], fun_kind);
 }
 
-// the first arg is stored in the code aligned on a mp_uint_t boundary
-STATIC void emit_call_with_imm_arg_aligned(emit_t *emit, mp_fun_kind_t fun_kind, mp_int_t arg_val, int arg_reg) {
+STATIC void emit_call_with_qstr_arg(emit_t *emit, mp_fun_kind_t fun_kind, qstr qst, int arg_reg) {
     need_reg_all(emit);
-    ASM_MOV_ALIGNED_IMM_TO_REG(emit->as, arg_val, arg_reg);
+    emit_native_mov_reg_reloc(emit, arg_reg, MP_NATIVE_RELOC_QSTR, qst);
     ASM_CALL_IND(emit->as, mp_fun_table[fun_kind], fun_kind);
 }
 
 STATIC void emit_call_with_2_imm_args(emit_t *emit, mp_fun_kind_t fun_kind, mp_int_t arg_val1, int arg_reg1, mp_int_t arg_val2, int arg_reg2) {
     need_reg_all(emit);
-    ASM_MOV_IMM_TO_REG(emit->as, arg_val1, arg_reg1);
-    ASM_MOV_IMM_TO_REG(emit->as, arg_val2, arg_reg2);
-    ASM_CALL_IND(emit->as, mp_fun_table[fun_kind], fun_kind);
-}
-
-// the first arg is stored in the code aligned on a mp_uint_t boundary
-STATIC void emit_call_with_3_imm_args_and_first_aligned(emit_t *emit, mp_fun_kind_t fun_kind, mp_int_t arg_val1, int arg_reg1, mp_int_t arg_val2, int arg_reg2, mp_int_t arg_val3, int arg_reg3) {
-    need_reg_all(emit);
-    ASM_MOV_ALIGNED_IMM_TO_REG(emit->as, arg_val1, arg_reg1);
-    ASM_MOV_IMM_TO_REG(emit->as, arg_val2, arg_reg2);
-    ASM_MOV_IMM_TO_REG(emit->as, arg_val3, arg_reg3);
+    ASM_MOV_REG_IMM(emit->as, arg_reg1, arg_val1);
+    ASM_MOV_REG_IMM(emit->as, arg_reg2, arg_val2);
     ASM_CALL_IND(emit->as, mp_fun_table[fun_kind], fun_kind);
 }
 
@@ -808,19 +889,17 @@ STATIC void emit_get_stack_pointer_to_reg_for_pop(emit_t *emit, mp_uint_t reg_de
             si->kind = STACK_VALUE;
             switch (si->vtype) {
                 case VTYPE_PYOBJ:
-                    ASM_MOV_IMM_TO_LOCAL_USING(emit->as, si->data.u_imm, emit->stack_start + emit->stack_size - 1 - i, reg_dest);
+                    ASM_MOV_LOCAL_IMM_VIA(emit->as, emit->stack_start + emit->stack_size - 1 - i, si->data.u_imm, reg_dest);
                     break;
                 case VTYPE_BOOL:
-                    if (si->data.u_imm == 0) {
-                        ASM_MOV_IMM_TO_LOCAL_USING(emit->as, (mp_uint_t)mp_const_false, emit->stack_start + emit->stack_size - 1 - i, reg_dest);
-                    } else {
-                        ASM_MOV_IMM_TO_LOCAL_USING(emit->as, (mp_uint_t)mp_const_true, emit->stack_start + emit->stack_size - 1 - i, reg_dest);
-                    }
+                    emit_native_mov_reg_reloc(emit, reg_dest, MP_NATIVE_RELOC_CONST,
+                        si->data.u_imm == 0 ? MP_NATIVE_CONST_FALSE : MP_NATIVE_CONST_TRUE);
+                    ASM_MOV_LOCAL_REG(emit->as, emit->stack_start + emit->stack_size - 1 - i, reg_dest);
                     si->vtype = VTYPE_PYOBJ;
                     break;
                 case VTYPE_INT:
                 case VTYPE_UINT:
-                    ASM_MOV_IMM_TO_LOCAL_USING(emit->as, (uintptr_t)MP_OBJ_NEW_SMALL_INT(si->data.u_imm), emit->stack_start + emit->stack_size - 1 - i, reg_dest);
+                    ASM_MOV_LOCAL_IMM_VIA(emit->as, emit->stack_start + emit->stack_size - 1 - i, (uintptr_t)MP_OBJ_NEW_SMALL_INT(si->data.u_imm), reg_dest);
                     si->vtype = VTYPE_PYOBJ;
                     break;
                 default:
@@ -838,9 +917,9 @@ STATIC void emit_get_stack_pointer_to_reg_for_pop(emit_t *emit, mp_uint_t reg_de
         stack_info_t *si = &emit->stack_info[emit->stack_size - 1 - i];
         if (si->vtype != VTYPE_PYOBJ) {
             mp_uint_t local_num = emit->stack_start + emit->stack_size - 1 - i;
-            ASM_MOV_LOCAL_TO_REG(emit->as, local_num, REG_ARG_1);
+            ASM_MOV_REG_LOCAL(emit->as, REG_ARG_1, local_num);
             emit_call_with_imm_arg(emit, MP_F_CONVERT_NATIVE_TO_OBJ, si->vtype, REG_ARG_2); // arg2 = type
-            ASM_MOV_REG_TO_LOCAL(emit->as, REG_RET, local_num);
+            ASM_MOV_LOCAL_REG(emit->as, local_num, REG_RET);
             si->vtype = VTYPE_PYOBJ;
             DEBUG_printf("  convert_native_to_obj(local_num=" UINT_FMT ")\n", local_num);
         }
@@ -848,7 +927,7 @@ STATIC void emit_get_stack_pointer_to_reg_for_pop(emit_t *emit, mp_uint_t reg_de
 
     // Adujust the stack for a pop of n_pop items, and load the stack pointer into reg_dest.
     adjust_stack(emit, -n_pop);
-    ASM_MOV_LOCAL_ADDR_TO_REG(emit->as, emit->stack_start + emit->stack_size, reg_dest);
+    ASM_MOV_REG_LOCAL_ADDR(emit->as, reg_dest, emit->stack_start + emit->stack_size);
 }
 
 // vtype of all n_push objects is VTYPE_PYOBJ
@@ -858,10 +937,24 @@ STATIC void emit_get_stack_pointer_to_reg_for_push(emit_t *emit, mp_uint_t reg_d
         emit->stack_info[emit->stack_size + i].kind = STACK_VALUE;
         emit->stack_info[emit->stack_size + i].vtype = VTYPE_PYOBJ;
     }
-    ASM_MOV_LOCAL_ADDR_TO_REG(emit->as, emit->stack_start + emit->stack_size, reg_dest);
+    ASM_MOV_REG_LOCAL_ADDR(emit->as, reg_dest, emit->stack_start + emit->stack_size);
     adjust_stack(emit, n_push);
 }
 
+// pushes an nlr_buf_t onto the stack and registers it as the top-most handler;
+// jumps to label when an exception is raised while it is registered
+STATIC void emit_native_push_nlr_buf(emit_t *emit, mp_uint_t label) {
+    emit_get_stack_pointer_to_reg_for_push(emit, REG_ARG_1, N_NLR_BUF_WORDS); // arg1 = pointer to nlr buf
+    emit_call(emit, MP_F_NLR_PUSH);
+    #if N_NLR_SETJMP
+    // MP_F_NLR_PUSH is nlr_push_tail, and setjmp must be called from this frame
+    ASM_MOV_REG_LOCAL_ADDR(emit->as, REG_ARG_1, emit->stack_start + emit->stack_size
+        - N_NLR_BUF_WORDS + N_NLR_JMPBUF_WORD); // arg1 = jmp_buf
+    emit_call(emit, MP_F_SETJMP);
+    #endif
+    ASM_JUMP_IF_REG_NONZERO(emit->as, REG_RET, label);
+}
+
 STATIC void emit_native_label_assign(emit_t *emit, mp_uint_t l) {
     DEBUG_printf("label_assign(" UINT_FMT ")\n", l);
     emit_native_pre(emit);
@@ -881,7 +974,7 @@ STATIC void emit_native_import_name(emit_t *emit, qstr qst) {
         stack_info_t *top = peek_stack(emit, 0);
         if (top->vtype == VTYPE_PTR_NONE) {
             emit_pre_pop_discard(emit);
-            ASM_MOV_IMM_TO_REG(emit->as, (mp_uint_t)mp_const_none, REG_ARG_2);
+            emit_native_mov_reg_reloc(emit, REG_ARG_2, MP_NATIVE_RELOC_CONST, MP_NATIVE_CONST_NONE);
         } else {
             vtype_kind_t vtype_fromlist;
             emit_pre_pop_reg(emit, &vtype_fromlist, REG_ARG_2);
@@ -891,7 +984,7 @@ STATIC void emit_native_import_name(emit_t *emit, qstr qst) {
         // level argument should be an immediate integer
         top = peek_stack(emit, 0);
         assert(top->vtype == VTYPE_INT && top->kind == STACK_IMM);
-        ASM_MOV_IMM_TO_REG(emit->as, (mp_uint_t)MP_OBJ_NEW_SMALL_INT(top->data.u_imm), REG_ARG_3);
+        ASM_MOV_REG_IMM(emit->as, REG_ARG_3, (mp_uint_t)MP_OBJ_NEW_SMALL_INT(top->data.u_imm));
         emit_pre_pop_discard(emit);
 
     } else {
@@ -902,7 +995,7 @@ STATIC void emit_native_import_name(emit_t *emit, qstr qst) {
         assert(vtype_level == VTYPE_PYOBJ);
     }
 
-    emit_call_with_imm_arg(emit, MP_F_IMPORT_NAME, qst, REG_ARG_1); // arg1 = import name
+    emit_call_with_qstr_arg(emit, MP_F_IMPORT_NAME, qst, REG_ARG_1); // arg1 = import name
     emit_post_push_reg(emit, VTYPE_PYOBJ, REG_RET);
 }
 
@@ -912,7 +1005,7 @@ STATIC void emit_native_import_from(emit_t *emit, qstr qst) {
     vtype_kind_t vtype_module;
     emit_access_stack(emit, 1, &vtype_module, REG_ARG_1); // arg1 = module
     assert(vtype_module == VTYPE_PYOBJ);
-    emit_call_with_imm_arg(emit, MP_F_IMPORT_FROM, qst, REG_ARG_2); // arg2 = import name
+    emit_call_with_qstr_arg(emit, MP_F_IMPORT_FROM, qst, REG_ARG_2); // arg2 = import name
     emit_post_push_reg(emit, VTYPE_PYOBJ, REG_RET);
 }
 
@@ -937,20 +1030,22 @@ STATIC void emit_native_load_const_tok(emit_t *emit, mp_token_kind_t tok) {
             case MP_TOKEN_KW_TRUE: vtype = VTYPE_BOOL; val = 1; break;
             default:
                 assert(tok == MP_TOKEN_ELLIPSIS);
-                vtype = VTYPE_PYOBJ; val = (mp_uint_t)&mp_const_ellipsis_obj; break;
+                emit_post_push_reloc(emit, VTYPE_PYOBJ, MP_NATIVE_RELOC_CONST, MP_NATIVE_CONST_ELLIPSIS);
+                return;
         }
+        emit_post_push_imm(emit, vtype, val);
     } else {
         vtype = VTYPE_PYOBJ;
         switch (tok) {
-            case MP_TOKEN_KW_NONE: val = (mp_uint_t)mp_const_none; break;
-            case MP_TOKEN_KW_FALSE: val = (mp_uint_t)mp_const_false; break;
-            case MP_TOKEN_KW_TRUE: val = (mp_uint_t)mp_const_true; break;
+            case MP_TOKEN_KW_NONE: val = MP_NATIVE_CONST_NONE; break;
+            case MP_TOKEN_KW_FALSE: val = MP_NATIVE_CONST_FALSE; break;
+            case MP_TOKEN_KW_TRUE: val = MP_NATIVE_CONST_TRUE; break;
             default:
                 assert(tok == MP_TOKEN_ELLIPSIS);
-                val = (mp_uint_t)&mp_const_ellipsis_obj; break;
+                val = MP_NATIVE_CONST_ELLIPSIS; break;
         }
+        emit_post_push_reloc(emit, vtype, MP_NATIVE_RELOC_CONST, val);
     }
-    emit_post_push_imm(emit, vtype, val);
 }
 
 STATIC void emit_native_load_const_small_int(emit_t *emit, mp_int_t arg) {
@@ -974,14 +1069,14 @@ STATIC void emit_native_load_const_str(emit_t *emit, qstr qst) {
     } else
     */
     {
-        emit_post_push_imm(emit, VTYPE_PYOBJ, (mp_uint_t)MP_OBJ_NEW_QSTR(qst));
+        emit_post_push_reloc(emit, VTYPE_PYOBJ, MP_NATIVE_RELOC_QSTR_OBJ, qst);
     }
 }
 
 STATIC void emit_native_load_const_obj(emit_t *emit, mp_obj_t obj) {
     emit_native_pre(emit);
     need_reg_single(emit, REG_RET, 0);
-    ASM_MOV_ALIGNED_IMM_TO_REG(emit->as, (mp_uint_t)obj, REG_RET);
+    emit_native_mov_reg_reloc(emit, REG_RET, MP_NATIVE_RELOC_OBJ, (mp_uint_t)obj);
     emit_post_push_reg(emit, VTYPE_PYOBJ, REG_RET);
 }
 
@@ -1006,9 +1101,9 @@ STATIC void emit_native_load_fast(emit_t *emit, qstr qst, mp_uint_t local_num) {
     } else {
         need_reg_single(emit, REG_TEMP0, 0);
         if (emit->do_viper_types) {
-            ASM_MOV_LOCAL_TO_REG(emit->as, local_num - REG_LOCAL_NUM, REG_TEMP0);
+            ASM_MOV_REG_LOCAL(emit->as, REG_TEMP0, local_num - REG_LOCAL_NUM);
         } else {
-            ASM_MOV_LOCAL_TO_REG(emit->as, STATE_START + emit->n_state - 1 - local_num, REG_TEMP0);
+            ASM_MOV_REG_LOCAL(emit->as, REG_TEMP0, STATE_START + emit->n_state - 1 - local_num);
         }
         emit_post_push_reg(emit, vtype, REG_TEMP0);
     }
@@ -1029,7 +1124,7 @@ STATIC void emit_native_load_deref(emit_t *emit, qstr qst, mp_uint_t local_num)
 STATIC void emit_native_load_name(emit_t *emit, qstr qst) {
     DEBUG_printf("load_name(%s)\n", qstr_str(qst));
     emit_native_pre(emit);
-    emit_call_with_imm_arg(emit, MP_F_LOAD_NAME, qst, REG_ARG_1);
+    emit_call_with_qstr_arg(emit, MP_F_LOAD_NAME, qst, REG_ARG_1);
     emit_post_push_reg(emit, VTYPE_PYOBJ, REG_RET);
 }
 
@@ -1050,7 +1145,7 @@ STATIC void emit_native_load_global(emit_t *emit, qstr qst) {
     } else if (emit->do_viper_types && qst == MP_QSTR_ptr32) {
         emit_post_push_imm(emit, VTYPE_BUILTIN_CAST, VTYPE_PTR32);
     } else {
-        emit_call_with_imm_arg(emit, MP_F_LOAD_GLOBAL, qst, REG_ARG_1);
+        emit_call_with_qstr_arg(emit, MP_F_LOAD_GLOBAL, qst, REG_ARG_1);
         emit_post_push_reg(emit, VTYPE_PYOBJ, REG_RET);
     }
 }
@@ -1063,7 +1158,7 @@ STATIC void emit_native_load_attr(emit_t *emit, qstr qst) {
     vtype_kind_t vtype_base;
     emit_pre_pop_reg(emit, &vtype_base, REG_ARG_1); // arg1 = base
     assert(vtype_base == VTYPE_PYOBJ);
-    emit_call_with_imm_arg(emit, MP_F_LOAD_ATTR, qst, REG_ARG_2); // arg2 = attribute name
+    emit_call_with_qstr_arg(emit, MP_F_LOAD_ATTR, qst, REG_ARG_2); // arg2 = attribute name
     emit_post_push_reg(emit, VTYPE_PYOBJ, REG_RET);
 }
 
@@ -1071,13 +1166,13 @@ STATIC void emit_native_load_method(emit_t *emit, qstr qst, bool is_super) {
     if (is_super) {
         emit_get_stack_pointer_to_reg_for_pop(emit, REG_ARG_2, 3); // arg2 = dest ptr
         emit_get_stack_pointer_to_reg_for_push(emit, REG_ARG_2, 2); // arg2 = dest ptr
-        emit_call_with_imm_arg(emit, MP_F_LOAD_SUPER_METHOD, qst, REG_ARG_1); // arg1 = method name
+        emit_call_with_qstr_arg(emit, MP_F_LOAD_SUPER_METHOD, qst, REG_ARG_1); // arg1 = method name
     } else {
         vtype_kind_t vtype_base;
         emit_pre_pop_reg(emit, &vtype_base, REG_ARG_1); // arg1 = base
         assert(vtype_base == VTYPE_PYOBJ);
         emit_get_stack_pointer_to_reg_for_push(emit, REG_ARG_3, 2); // arg3 = dest ptr
-        emit_call_with_imm_arg(emit, MP_F_LOAD_METHOD, qst, REG_ARG_2); // arg2 = method name
+        emit_call_with_qstr_arg(emit, MP_F_LOAD_METHOD, qst, REG_ARG_2); // arg2 = method name
     }
 }
 
@@ -1134,7 +1229,7 @@ STATIC void emit_native_load_subscr(emit_t *emit) {
                             break;
                         }
                         #endif
-                        ASM_MOV_IMM_TO_REG(emit->as, index_value, reg_index);
+                        ASM_MOV_REG_IMM(emit->as, reg_index, index_value);
                         ASM_ADD_REG_REG(emit->as, reg_index, reg_base); // add index to base
                         reg_base = reg_index;
                     }
@@ -1151,7 +1246,7 @@ STATIC void emit_native_load_subscr(emit_t *emit) {
                             break;
                         }
                         #endif
-                        ASM_MOV_IMM_TO_REG(emit->as, index_value << 1, reg_index);
+                        ASM_MOV_REG_IMM(emit->as, reg_index, index_value << 1);
                         ASM_ADD_REG_REG(emit->as, reg_index, reg_base); // add 2*index to base
                         reg_base = reg_index;
                     }
@@ -1168,7 +1263,7 @@ STATIC void emit_native_load_subscr(emit_t *emit) {
                             break;
                         }
                         #endif
-                        ASM_MOV_IMM_TO_REG(emit->as, index_value << 2, reg_index);
+                        ASM_MOV_REG_IMM(emit->as, reg_index, index_value << 2);
                         ASM_ADD_REG_REG(emit->as, reg_index, reg_base); // add 4*index to base
                         reg_base = reg_index;
                     }
@@ -1233,9 +1328,9 @@ STATIC void emit_native_store_fast(emit_t *emit, qstr qst, mp_uint_t local_num)
     } else {
         emit_pre_pop_reg(emit, &vtype, REG_TEMP0);
         if (emit->do_viper_types) {
-            ASM_MOV_REG_TO_LOCAL(emit->as, REG_TEMP0, local_num - REG_LOCAL_NUM);
+            ASM_MOV_LOCAL_REG(emit->as, local_num - REG_LOCAL_NUM, REG_TEMP0);
         } else {
-            ASM_MOV_REG_TO_LOCAL(emit->as, REG_TEMP0, STATE_START + emit->n_state - 1 - local_num);
+            ASM_MOV_LOCAL_REG(emit->as, STATE_START + emit->n_state - 1 - local_num, REG_TEMP0);
         }
     }
     emit_post(emit);
@@ -1271,7 +1366,7 @@ STATIC void emit_native_store_name(emit_t *emit, qstr qst) {
     vtype_kind_t vtype;
     emit_pre_pop_reg(emit, &vtype, REG_ARG_2);
     assert(vtype == VTYPE_PYOBJ);
-    emit_call_with_imm_arg(emit, MP_F_STORE_NAME, qst, REG_ARG_1); // arg1 = name
+    emit_call_with_qstr_arg(emit, MP_F_STORE_NAME, qst, REG_ARG_1); // arg1 = name
     emit_post(emit);
 }
 
@@ -1284,7 +1379,7 @@ STATIC void emit_native_store_global(emit_t *emit, qstr qst) {
         emit_call_with_imm_arg(emit, MP_F_CONVERT_NATIVE_TO_OBJ, vtype, REG_ARG_2); // arg2 = type
         ASM_MOV_REG_REG(emit->as, REG_ARG_2, REG_RET);
     }
-    emit_call_with_imm_arg(emit, MP_F_STORE_GLOBAL, qst, REG_ARG_1); // arg1 = name
+    emit_call_with_qstr_arg(emit, MP_F_STORE_GLOBAL, qst, REG_ARG_1); // arg1 = name
     emit_post(emit);
 }
 
@@ -1293,7 +1388,7 @@ STATIC void emit_native_store_attr(emit_t *emit, qstr qst) {
     emit_pre_pop_reg_reg(emit, &vtype_base, REG_ARG_1, &vtype_val, REG_ARG_3); // arg1 = base, arg3 = value
     assert(vtype_base == VTYPE_PYOBJ);
     assert(vtype_val == VTYPE_PYOBJ);
-    emit_call_with_imm_arg(emit, MP_F_STORE_ATTR, qst, REG_ARG_2); // arg2 = attribute name
+    emit_call_with_qstr_arg(emit, MP_F_STORE_ATTR, qst, REG_ARG_2); // arg2 = attribute name
     emit_post(emit);
 }
 
@@ -1354,7 +1449,7 @@ STATIC void emit_native_store_subscr(emit_t *emit) {
                             break;
                         }
                         #endif
-                        ASM_MOV_IMM_TO_REG(emit->as, index_value, reg_index);
+                        ASM_MOV_REG_IMM(emit->as, reg_index, index_value);
                         #if N_ARM
                         asm_arm_strb_reg_reg_reg(emit->as, reg_value, reg_base, reg_index);
                         return;
@@ -1375,7 +1470,7 @@ STATIC void emit_native_store_subscr(emit_t *emit) {
                             break;
                         }
                         #endif
-                        ASM_MOV_IMM_TO_REG(emit->as, index_value << 1, reg_index);
+                        ASM_MOV_REG_IMM(emit->as, reg_index, index_value << 1);
                         #if N_ARM
                         asm_arm_strh_reg_reg_reg(emit->as, reg_value, reg_base, reg_index);
                         return;
@@ -1396,7 +1491,7 @@ STATIC void emit_native_store_subscr(emit_t *emit) {
                             break;
                         }
                         #endif
-                        ASM_MOV_IMM_TO_REG(emit->as, index_value << 2, reg_index);
+                        ASM_MOV_REG_IMM(emit->as, reg_index, index_value << 2);
                         #if N_ARM
                         asm_arm_str_reg_reg_reg(emit->as, reg_value, reg_base, reg_index);
                         return;
@@ -1494,13 +1589,13 @@ STATIC void emit_native_delete_deref(emit_t *emit, qstr qst, mp_uint_t local_num
 
 STATIC void emit_native_delete_name(emit_t *emit, qstr qst) {
     emit_native_pre(emit);
-    emit_call_with_imm_arg(emit, MP_F_DELETE_NAME, qst, REG_ARG_1);
+    emit_call_with_qstr_arg(emit, MP_F_DELETE_NAME, qst, REG_ARG_1);
     emit_post(emit);
 }
 
 STATIC void emit_native_delete_global(emit_t *emit, qstr qst) {
     emit_native_pre(emit);
-    emit_call_with_imm_arg(emit, MP_F_DELETE_GLOBAL, qst, REG_ARG_1);
+    emit_call_with_qstr_arg(emit, MP_F_DELETE_GLOBAL, qst, REG_ARG_1);
     emit_post(emit);
 }
 
@@ -1508,7 +1603,8 @@ STATIC void emit_native_delete_attr(emit_t *emit, qstr qst) {
     vtype_kind_t vtype_base;
     emit_pre_pop_reg(emit, &vtype_base, REG_ARG_1); // arg1 = base
     assert(vtype_base == VTYPE_PYOBJ);
-    emit_call_with_2_imm_args(emit, MP_F_STORE_ATTR, qst, REG_ARG_2, (mp_uint_t)MP_OBJ_NULL, REG_ARG_3); // arg2 = attribute name, arg3 = value (null for delete)
+    ASM_MOV_REG_IMM(emit->as, REG_ARG_3, (mp_uint_t)MP_OBJ_NULL); // arg3 = value (null for delete)
+    emit_call_with_qstr_arg(emit, MP_F_STORE_ATTR, qst, REG_ARG_2); // arg2 = attribute name
     emit_post(emit);
 }
 
@@ -1613,14 +1709,43 @@ STATIC void emit_native_jump_if_or_pop(emit_t *emit, bool cond, mp_uint_t label)
     emit_post(emit);
 }
 
+STATIC void emit_native_push_block(emit_t *emit, block_kind_t kind) {
+    if (emit->block_depth == emit->block_alloc) {
+        emit->block_kind = m_renew(byte, emit->block_kind, emit->block_alloc, emit->block_alloc + 4);
+        emit->block_alloc += 4;
+    }
+    emit->block_kind[emit->block_depth++] = kind;
+}
+
+// pop the nlr_bufs of the innermost n try/with blocks, which a return, break
+// or continue leaves
+STATIC void emit_native_unwind_blocks(emit_t *emit, mp_uint_t n) {
+    assert(n <= emit->block_depth);
+    mp_uint_t n_pop = 0;
+    for (mp_uint_t i = emit->block_depth - n; i < emit->block_depth; i++) {
+        if (emit->block_kind[i] == BLOCK_FINALLY || emit->block_kind[i] == BLOCK_WITH) {
+            // the finally block or __exit__ would have to run here
+            *emit->error_slot = mp_obj_new_exception_msg(&mp_type_SyntaxError,
+                "native code can't return, break or continue out of a try/finally or with");
+            return;
+        }
+        if (emit->block_kind[i] == BLOCK_EXCEPT) {
+            n_pop += 1;
+        }
+    }
+    while (n_pop--) {
+        emit_call(emit, MP_F_NLR_POP);
+    }
+}
+
 STATIC void emit_native_break_loop(emit_t *emit, mp_uint_t label, mp_uint_t except_depth) {
-    (void)except_depth;
-    emit_native_jump(emit, label & ~MP_EMIT_BREAK_FROM_FOR); // TODO properly
+    emit_native_unwind_blocks(emit, except_depth);
+    emit_native_jump(emit, label & ~MP_EMIT_BREAK_FROM_FOR);
 }
 
 STATIC void emit_native_continue_loop(emit_t *emit, mp_uint_t label, mp_uint_t except_depth) {
-    (void)except_depth;
-    emit_native_jump(emit, label); // TODO properly
+    emit_native_unwind_blocks(emit, except_depth);
+    emit_native_jump(emit, label);
 }
 
 STATIC void emit_native_setup_with(emit_t *emit, mp_uint_t label) {
@@ -1632,7 +1757,7 @@ STATIC void emit_native_setup_with(emit_t *emit, mp_uint_t label) {
     emit_access_stack(emit, 1, &vtype, REG_ARG_1); // arg1 = ctx_mgr
     assert(vtype == VTYPE_PYOBJ);
     emit_get_stack_pointer_to_reg_for_push(emit, REG_ARG_3, 2); // arg3 = dest ptr
-    emit_call_with_imm_arg(emit, MP_F_LOAD_METHOD, MP_QSTR___exit__, REG_ARG_2);
+    emit_call_with_qstr_arg(emit, MP_F_LOAD_METHOD, MP_QSTR___exit__, REG_ARG_2);
     // stack: (..., ctx_mgr, __exit__, self)
 
     emit_pre_pop_reg(emit, &vtype, REG_ARG_3); // self
@@ -1645,7 +1770,7 @@ STATIC void emit_native_setup_with(emit_t *emit, mp_uint_t label) {
 
     // get __enter__ method
     emit_get_stack_pointer_to_reg_for_push(emit, REG_ARG_3, 2); // arg3 = dest ptr
-    emit_call_with_imm_arg(emit, MP_F_LOAD_METHOD, MP_QSTR___enter__, REG_ARG_2); // arg2 = method name
+    emit_call_with_qstr_arg(emit, MP_F_LOAD_METHOD, MP_QSTR___enter__, REG_ARG_2); // arg2 = method name
     // stack: (..., __exit__, self, __enter__, self)
 
     // call __enter__ method
@@ -1656,11 +1781,10 @@ STATIC void emit_native_setup_with(emit_t *emit, mp_uint_t label) {
 
     // need to commit stack because we may jump elsewhere
     need_stack_settled(emit);
-    emit_get_stack_pointer_to_reg_for_push(emit, REG_ARG_1, sizeof(nlr_buf_t) / sizeof(mp_uint_t)); // arg1 = pointer to nlr buf
-    emit_call(emit, MP_F_NLR_PUSH);
-    ASM_JUMP_IF_REG_NONZERO(emit->as, REG_RET, label);
+    emit_native_push_nlr_buf(emit, label);
+    emit_native_push_block(emit, BLOCK_WITH);
 
-    emit_access_stack(emit, sizeof(nlr_buf_t) / sizeof(mp_uint_t) + 1, &vtype, REG_RET); // access return value of __enter__
+    emit_access_stack(emit, N_NLR_BUF_WORDS + 1, &vtype, REG_RET); // access return value of __enter__
     emit_post_push_reg(emit, VTYPE_PYOBJ, REG_RET); // push return value of __enter__
     // stack: (..., __exit__, self, as_value, nlr_buf, as_value)
 }
@@ -1671,13 +1795,14 @@ STATIC void emit_native_with_cleanup(emit_t *emit, mp_uint_t label) {
     // stack: (..., __exit__, self, as_value, nlr_buf)
     emit_native_pre(emit);
     emit_call(emit, MP_F_NLR_POP);
-    adjust_stack(emit, -(mp_int_t)(sizeof(nlr_buf_t) / sizeof(mp_uint_t)) - 1);
+    emit->block_kind[emit->block_depth - 1] = BLOCK_HANDLER;
+    adjust_stack(emit, -(mp_int_t)N_NLR_BUF_WORDS - 1);
     // stack: (..., __exit__, self)
 
     // call __exit__
-    emit_post_push_imm(emit, VTYPE_PYOBJ, (mp_uint_t)mp_const_none);
-    emit_post_push_imm(emit, VTYPE_PYOBJ, (mp_uint_t)mp_const_none);
-    emit_post_push_imm(emit, VTYPE_PYOBJ, (mp_uint_t)mp_const_none);
+    emit_post_push_reloc(emit, VTYPE_PYOBJ, MP_NATIVE_RELOC_CONST, MP_NATIVE_CONST_NONE);
+    emit_post_push_reloc(emit, VTYPE_PYOBJ, MP_NATIVE_RELOC_CONST, MP_NATIVE_CONST_NONE);
+    emit_post_push_reloc(emit, VTYPE_PYOBJ, MP_NATIVE_RELOC_CONST, MP_NATIVE_CONST_NONE);
     emit_get_stack_pointer_to_reg_for_pop(emit, REG_ARG_3, 5);
     emit_call_with_2_imm_args(emit, MP_F_CALL_METHOD_N_KW, 3, REG_ARG_1, 0, REG_ARG_2);
 
@@ -1711,7 +1836,7 @@ STATIC void emit_native_with_cleanup(emit_t *emit, mp_uint_t label) {
     ASM_LOAD_REG_REG_OFFSET(emit->as, REG_ARG_2, REG_ARG_1, 0); // get type(exc)
     emit_post_push_reg(emit, VTYPE_PYOBJ, REG_ARG_2); // push type(exc)
     emit_post_push_reg(emit, VTYPE_PYOBJ, REG_ARG_1); // push exc value
-    emit_post_push_imm(emit, VTYPE_PYOBJ, (mp_uint_t)mp_const_none); // traceback info
+    emit_post_push_reloc(emit, VTYPE_PYOBJ, MP_NATIVE_RELOC_CONST, MP_NATIVE_CONST_NONE); // traceback info
     // stack: (..., exc, __exit__, self, type(exc), exc, traceback)
 
     // call __exit__ method
@@ -1728,24 +1853,27 @@ STATIC void emit_native_with_cleanup(emit_t *emit, mp_uint_t label) {
 
     // replace exc with None
     emit_pre_pop_discard(emit);
-    emit_post_push_imm(emit, VTYPE_PYOBJ, (mp_uint_t)mp_const_none);
+    emit_post_push_reloc(emit, VTYPE_PYOBJ, MP_NATIVE_RELOC_CONST, MP_NATIVE_CONST_NONE);
 
     // end of with cleanup nlr_catch block
     emit_native_label_assign(emit, label + 1);
 }
 
-STATIC void emit_native_setup_except(emit_t *emit, mp_uint_t label) {
+STATIC void emit_native_setup_block(emit_t *emit, mp_uint_t label, block_kind_t kind) {
     emit_native_pre(emit);
     // need to commit stack because we may jump elsewhere
     need_stack_settled(emit);
-    emit_get_stack_pointer_to_reg_for_push(emit, REG_ARG_1, sizeof(nlr_buf_t) / sizeof(mp_uint_t)); // arg1 = pointer to nlr buf
-    emit_call(emit, MP_F_NLR_PUSH);
-    ASM_JUMP_IF_REG_NONZERO(emit->as, REG_RET, label);
+    emit_native_push_nlr_buf(emit, label);
+    emit_native_push_block(emit, kind);
     emit_post(emit);
 }
 
+STATIC void emit_native_setup_except(emit_t *emit, mp_uint_t label) {
+    emit_native_setup_block(emit, label, BLOCK_EXCEPT);
+}
+
 STATIC void emit_native_setup_finally(emit_t *emit, mp_uint_t label) {
-    emit_native_setup_except(emit, label);
+    emit_native_setup_block(emit, label, BLOCK_FINALLY);
 }
 
 STATIC void emit_native_end_finally(emit_t *emit) {
@@ -1758,6 +1886,7 @@ STATIC void emit_native_end_finally(emit_t *emit) {
     emit_pre_pop_reg(emit, &vtype, REG_ARG_1); // get nlr_buf.ret_val
     emit_pre_pop_discard(emit); // discard nlr_buf.prev
     emit_call(emit, MP_F_NATIVE_RAISE);
+    emit->block_depth -= 1;
     emit_post(emit);
 }
 
@@ -1773,7 +1902,7 @@ STATIC void emit_native_get_iter(emit_t *emit, bool use_stack) {
         emit_call(emit, MP_F_NATIVE_GETITER);
     } else {
         // mp_getiter will allocate the iter_buf on the heap
-        ASM_MOV_IMM_TO_REG(emit->as, 0, REG_ARG_2);
+        ASM_MOV_REG_IMM(emit->as, REG_ARG_2, 0);
         emit_call(emit, MP_F_NATIVE_GETITER);
         emit_post_push_reg(emit, VTYPE_PYOBJ, REG_RET);
     }
@@ -1784,7 +1913,7 @@ STATIC void emit_native_for_iter(emit_t *emit, mp_uint_t label) {
     emit_get_stack_pointer_to_reg_for_pop(emit, REG_ARG_1, MP_OBJ_ITER_BUF_NSLOTS);
     adjust_stack(emit, MP_OBJ_ITER_BUF_NSLOTS);
     emit_call(emit, MP_F_NATIVE_ITERNEXT);
-    ASM_MOV_IMM_TO_REG(emit->as, (mp_uint_t)MP_OBJ_STOP_ITERATION, REG_TEMP1);
+    ASM_MOV_REG_IMM(emit->as, REG_TEMP1, (mp_uint_t)MP_OBJ_STOP_ITERATION);
     ASM_JUMP_IF_REG_EQ(emit->as, REG_RET, REG_TEMP1, label);
     emit_post_push_reg(emit, VTYPE_PYOBJ, REG_RET);
 }
@@ -1799,7 +1928,8 @@ STATIC void emit_native_for_iter_end(emit_t *emit) {
 STATIC void emit_native_pop_block(emit_t *emit) {
     emit_native_pre(emit);
     emit_call(emit, MP_F_NLR_POP);
-    adjust_stack(emit, -(mp_int_t)(sizeof(nlr_buf_t) / sizeof(mp_uint_t)) + 1);
+    emit->block_kind[emit->block_depth - 1] = BLOCK_HANDLER;
+    adjust_stack(emit, -(mp_int_t)N_NLR_BUF_WORDS + 1);
     emit_post(emit);
 }
 
@@ -1949,7 +2079,7 @@ STATIC void emit_native_binary_op(emit_t *emit, mp_binary_op_t op) {
                 ASM_ARM_CC_NE,
             };
             asm_arm_setcc_reg(emit->as, REG_RET, ccs[op - MP_BINARY_OP_LESS]);
-            #elif N_XTENSA
+            #elif N_XTENSA || N_XTENSAWIN
             static uint8_t ccs[6] = {
                 ASM_XTENSA_CC_LT,
                 0x80 | ASM_XTENSA_CC_LT, // for GT we'll swap args
@@ -2047,7 +2177,9 @@ STATIC void emit_native_build_slice(emit_t *emit, mp_uint_t n_args) {
         emit_pre_pop_reg_reg(emit, &vtype_stop, REG_ARG_2, &vtype_start, REG_ARG_1); // arg1 = start, arg2 = stop
         assert(vtype_start == VTYPE_PYOBJ);
         assert(vtype_stop == VTYPE_PYOBJ);
-        emit_call_with_imm_arg(emit, MP_F_NEW_SLICE, (mp_uint_t)mp_const_none, REG_ARG_3); // arg3 = step
+        need_reg_all(emit);
+        emit_native_mov_reg_reloc(emit, REG_ARG_3, MP_NATIVE_RELOC_CONST, MP_NATIVE_CONST_NONE); // arg3 = step
+        emit_call(emit, MP_F_NEW_SLICE);
         emit_post_push_reg(emit, VTYPE_PYOBJ, REG_RET);
     } else {
         assert(n_args == 3);
@@ -2113,14 +2245,18 @@ STATIC void emit_native_make_function(emit_t *emit, scope_t *scope, mp_uint_t n_
     // call runtime, with type info for args, or don't support dict/default params, or only support Python objects for them
     emit_native_pre(emit);
     if (n_pos_defaults == 0 && n_kw_defaults == 0) {
-        emit_call_with_3_imm_args_and_first_aligned(emit, MP_F_MAKE_FUNCTION_FROM_RAW_CODE, (mp_uint_t)scope->raw_code, REG_ARG_1, (mp_uint_t)MP_OBJ_NULL, REG_ARG_2, (mp_uint_t)MP_OBJ_NULL, REG_ARG_3);
+        need_reg_all(emit);
+        ASM_MOV_REG_IMM(emit->as, REG_ARG_2, (mp_uint_t)MP_OBJ_NULL);
+        ASM_MOV_REG_IMM(emit->as, REG_ARG_3, (mp_uint_t)MP_OBJ_NULL);
     } else {
         vtype_kind_t vtype_def_tuple, vtype_def_dict;
         emit_pre_pop_reg_reg(emit, &vtype_def_dict, REG_ARG_3, &vtype_def_tuple, REG_ARG_2);
         assert(vtype_def_tuple == VTYPE_PYOBJ);
         assert(vtype_def_dict == VTYPE_PYOBJ);
-        emit_call_with_imm_arg_aligned(emit, MP_F_MAKE_FUNCTION_FROM_RAW_CODE, (mp_uint_t)scope->raw_code, REG_ARG_1);
+        need_reg_all(emit);
     }
+    emit_native_mov_reg_reloc(emit, REG_ARG_1, MP_NATIVE_RELOC_RAW_CODE, (mp_uint_t)scope->raw_code);
+    emit_call(emit, MP_F_MAKE_FUNCTION_FROM_RAW_CODE);
     emit_post_push_reg(emit, VTYPE_PYOBJ, REG_RET);
 }
 
@@ -2128,13 +2264,13 @@ STATIC void emit_native_make_closure(emit_t *emit, scope_t *scope, mp_uint_t n_c
     emit_native_pre(emit);
     if (n_pos_defaults == 0 && n_kw_defaults == 0) {
         emit_get_stack_pointer_to_reg_for_pop(emit, REG_ARG_3, n_closed_over);
-        ASM_MOV_IMM_TO_REG(emit->as, n_closed_over, REG_ARG_2);
+        ASM_MOV_REG_IMM(emit->as, REG_ARG_2, n_closed_over);
     } else {
         emit_get_stack_pointer_to_reg_for_pop(emit, REG_ARG_3, n_closed_over + 2);
-        ASM_MOV_IMM_TO_REG(emit->as, 0x100 | n_closed_over, REG_ARG_2);
+        ASM_MOV_REG_IMM(emit->as, REG_ARG_2, 0x100 | n_closed_over);
     }
-    ASM_MOV_ALIGNED_IMM_TO_REG(emit->as, (mp_uint_t)scope->raw_code, REG_ARG_1);
-    ASM_CALL_IND(emit->as, mp_fun_table[MP_F_MAKE_CLOSURE_FROM_RAW_CODE], MP_F_MAKE_CLOSURE_FROM_RAW_CODE);
+    emit_native_mov_reg_reloc(emit, REG_ARG_1, MP_NATIVE_RELOC_RAW_CODE, (mp_uint_t)scope->raw_code);
+    emit_call(emit, MP_F_MAKE_CLOSURE_FROM_RAW_CODE);
     emit_post_push_reg(emit, VTYPE_PYOBJ, REG_RET);
 }
 
@@ -2208,13 +2344,14 @@ STATIC void emit_native_call_method(emit_t *emit, mp_uint_t n_positional, mp_uin
 
 STATIC void emit_native_return_value(emit_t *emit) {
     DEBUG_printf("return_value\n");
+    emit_native_unwind_blocks(emit, emit->block_depth);
     if (emit->do_viper_types) {
         if (peek_vtype(emit, 0) == VTYPE_PTR_NONE) {
             emit_pre_pop_discard(emit);
             if (emit->return_vtype == VTYPE_PYOBJ) {
-                ASM_MOV_IMM_TO_REG(emit->as, (mp_uint_t)mp_const_none, REG_RET);
+                emit_native_mov_reg_reloc(emit, REG_RET, MP_NATIVE_RELOC_CONST, MP_NATIVE_CONST_NONE);
             } else {
-                ASM_MOV_IMM_TO_REG(emit->as, 0, REG_RET);
+                ASM_MOV_REG_IMM(emit->as, REG_RET, 0);
             }
         } else {
             vtype_kind_t vtype;
@@ -292,13 +292,25 @@
 #define MICROPY_EMIT_XTENSA (0)
 #endif
 
+// Whether to emit Xtensa-Windowed native code
+#ifndef MICROPY_EMIT_XTENSAWIN
+#define MICROPY_EMIT_XTENSAWIN (0)
+#endif
+
 // Whether to enable the Xtensa inline assembler
 #ifndef MICROPY_EMIT_INLINE_XTENSA
 #define MICROPY_EMIT_INLINE_XTENSA (0)
 #endif
 
 // Convenience definition for whether any native emitter is enabled
-#define MICROPY_EMIT_NATIVE (MICROPY_EMIT_X64 || MICROPY_EMIT_X86 || MICROPY_EMIT_THUMB || MICROPY_EMIT_ARM || MICROPY_EMIT_XTENSA)
+#define MICROPY_EMIT_NATIVE (MICROPY_EMIT_X64 || MICROPY_EMIT_X86 || MICROPY_EMIT_THUMB || MICROPY_EMIT_ARM || MICROPY_EMIT_XTENSA || MICROPY_EMIT_XTENSAWIN)
+
+// Whether the prelude and argument names of native functions are copied out
+// of the executable memory, for ports where that memory can only be accessed
+// with word loads (eg the IRAM of the esp32)
+#ifndef MICROPY_EMIT_NATIVE_PRELUDE_SEPARATE
+#define MICROPY_EMIT_NATIVE_PRELUDE_SEPARATE (MICROPY_EMIT_XTENSAWIN)
+#endif
 
 // Convenience definition for whether any inline assembler emitter is enabled
 #define MICROPY_EMIT_INLINE_ASM (MICROPY_EMIT_INLINE_THUMB || MICROPY_EMIT_INLINE_XTENSA)
@@ -320,9 +332,11 @@
 #if MICROPY_DYNAMIC_COMPILER
 #define MICROPY_OPT_CACHE_MAP_LOOKUP_IN_BYTECODE_DYNAMIC (mp_dynamic_compiler.opt_cache_map_lookup_in_bytecode)
 #define MICROPY_PY_BUILTINS_STR_UNICODE_DYNAMIC (mp_dynamic_compiler.py_builtins_str_unicode)
+#define MICROPY_OPT_BYTECODE_SUPERINSTRUCTIONS_DYNAMIC (mp_dynamic_compiler.opt_bytecode_superinstructions)
 #else
 #define MICROPY_OPT_CACHE_MAP_LOOKUP_IN_BYTECODE_DYNAMIC MICROPY_OPT_CACHE_MAP_LOOKUP_IN_BYTECODE
 #define MICROPY_PY_BUILTINS_STR_UNICODE_DYNAMIC MICROPY_PY_BUILTINS_STR_UNICODE
+#define MICROPY_OPT_BYTECODE_SUPERINSTRUCTIONS_DYNAMIC MICROPY_OPT_BYTECODE_SUPERINSTRUCTIONS
 #endif
 
 // Whether to enable constant folding; eg 1+2 rewritten as 3
@@ -396,6 +410,15 @@
 #define MICROPY_OPT_CACHE_MAP_LOOKUP_IN_BYTECODE (0)
 #endif
 
+// Whether the bytecode emitter fuses common sequences of opcodes into
+// superinstructions: LOAD_FAST followed by LOAD_ATTR or LOAD_METHOD, LOAD_FAST
+// and a small int followed by a binary op, and a comparison followed by a
+// conditional jump.  Fewer opcodes are dispatched for about the same bytecode
+// size, at the cost of a bit of extra code ROM for the VM.
+#ifndef MICROPY_OPT_BYTECODE_SUPERINSTRUCTIONS
+#define MICROPY_OPT_BYTECODE_SUPERINSTRUCTIONS (0)
+#endif
+
 // Whether to use fast versions of bitwise operations (and, or, xor) when the
 // arguments are both positive.  Increases Thumb2 code size by about 250 bytes.
 #ifndef MICROPY_OPT_MPZ_BITWISE
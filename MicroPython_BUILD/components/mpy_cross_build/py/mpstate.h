@@ -46,6 +46,8 @@ typedef struct mp_dynamic_compiler_t {
     uint8_t small_int_bits; // must be <= host small_int_bits
     bool opt_cache_map_lookup_in_bytecode;
     bool py_builtins_str_unicode;
+    bool opt_bytecode_superinstructions;
+    uint8_t native_arch; // architecture to emit native code for, MP_NATIVE_ARCH_xxx
 } mp_dynamic_compiler_t;
 extern mp_dynamic_compiler_t mp_dynamic_compiler;
 #endif
@@ -243,6 +243,25 @@ const byte *mp_bytecode_print_str(const byte *ip) {
         case MP_BC_LOAD_METHOD:
             DECODE_QSTR;
             printf("LOAD_METHOD %s", qstr_str(qst));
+            if (MICROPY_OPT_CACHE_MAP_LOOKUP_IN_BYTECODE) {
+                printf(" (cache=%u)", *ip++);
+            }
+            break;
+
+        case MP_BC_LOAD_FAST_ATTR:
+            DECODE_QSTR;
+            printf("LOAD_FAST_ATTR " UINT_FMT " %s", (mp_uint_t)*ip++, qstr_str(qst));
+            if (MICROPY_OPT_CACHE_MAP_LOOKUP_IN_BYTECODE) {
+                printf(" (cache=%u)", *ip++);
+            }
+            break;
+
+        case MP_BC_LOAD_FAST_METHOD:
+            DECODE_QSTR;
+            printf("LOAD_FAST_METHOD " UINT_FMT " %s", (mp_uint_t)*ip++, qstr_str(qst));
+            if (MICROPY_OPT_CACHE_MAP_LOOKUP_IN_BYTECODE) {
+                printf(" (cache=%u)", *ip++);
+            }
             break;
 
         case MP_BC_LOAD_SUPER_METHOD:
@@ -355,6 +374,20 @@ const byte *mp_bytecode_print_str(const byte *ip) {
             printf("JUMP_IF_FALSE_OR_POP " UINT_FMT, (mp_uint_t)(ip + unum - mp_showbc_code_start));
             break;
 
+        case MP_BC_POP_JUMP_IF_TRUE_COMPARE:
+            DECODE_SLABEL;
+            printf("POP_JUMP_IF_TRUE_COMPARE " UINT_FMT " %s", (mp_uint_t)(ip + unum - mp_showbc_code_start),
+                qstr_str(mp_binary_op_method_name[*ip]));
+            ip += 1;
+            break;
+
+        case MP_BC_POP_JUMP_IF_FALSE_COMPARE:
+            DECODE_SLABEL;
+            printf("POP_JUMP_IF_FALSE_COMPARE " UINT_FMT " %s", (mp_uint_t)(ip + unum - mp_showbc_code_start),
+                qstr_str(mp_binary_op_method_name[*ip]));
+            ip += 1;
+            break;
+
         case MP_BC_SETUP_WITH:
             DECODE_ULABEL; // loop-like labels are always forward
             printf("SETUP_WITH " UINT_FMT, (mp_uint_t)(ip + unum - mp_showbc_code_start));
@@ -532,6 +565,12 @@ const byte *mp_bytecode_print_str(const byte *ip) {
             printf("IMPORT_STAR");
             break;
 
+        case MP_BC_BINARY_OP_FAST_SMALL_INT:
+            printf("BINARY_OP_FAST_SMALL_INT " UINT_FMT " " INT_FMT " %s", (mp_uint_t)ip[0],
+                (mp_int_t)(int8_t)ip[2], qstr_str(mp_binary_op_method_name[ip[1]]));
+            ip += 3;
+            break;
+
         default:
             if (ip[-1] < MP_BC_LOAD_CONST_SMALL_INT_MULTI + 64) {
                 printf("LOAD_CONST_SMALL_INT " INT_FMT, (mp_int_t)ip[-1] - MP_BC_LOAD_CONST_SMALL_INT_MULTI - 16);